@@ -0,0 +1,44 @@
+# Fails the build when any of the library's own objects references the C or C++ heap.
+#
+# Invoked as a post-build step with:
+#   -DNM=<nm tool> -DOBJECTS=<object files> -DFILTER=<regex selecting the library's own objects>
+
+if (NOT NM OR NOT OBJECTS)
+    message(FATAL_ERROR "check_no_heap.cmake needs NM and OBJECTS")
+endif()
+
+set(HEAP_SYMBOLS "^(malloc|calloc|realloc|free|strdup|_Znw.*|_Zna.*|_Zdl.*|_Zda.*)$")
+set(violations "")
+
+foreach(object IN LISTS OBJECTS)
+    if (FILTER AND NOT object MATCHES "${FILTER}")
+        continue()
+    endif()
+
+    execute_process(
+        COMMAND ${NM} -u ${object}
+        OUTPUT_VARIABLE symbols
+        RESULT_VARIABLE result
+    )
+
+    if (NOT result EQUAL 0)
+        message(FATAL_ERROR "${NM} failed on ${object}")
+    endif()
+
+    string(REPLACE "\n" ";" lines "${symbols}")
+
+    foreach(line IN LISTS lines)
+        string(REGEX REPLACE "^[ \t]*U[ \t]+" "" symbol "${line}")
+        string(STRIP "${symbol}" symbol)
+
+        if (symbol MATCHES "${HEAP_SYMBOLS}")
+            get_filename_component(name ${object} NAME)
+            list(APPEND violations "${name}: ${symbol}")
+        endif()
+    endforeach()
+endforeach()
+
+if (violations)
+    string(REPLACE ";" "\n  " report "${violations}")
+    message(FATAL_ERROR "pico-usbnet must not use the heap, but references:\n  ${report}")
+endif()
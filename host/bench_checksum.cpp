@@ -0,0 +1,54 @@
+// Host run of ChecksumBench. Cycles per byte assume the CPU runs at
+// --cpu-mhz, by default the first "cpu MHz" in /proc/cpuinfo.
+//
+//   bench_checksum [--length 1514] [--rounds 200000] [--cpu-mhz N]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "pico-usbnet/ChecksumBench.h"
+
+static uint32_t hostCpuMhz() {
+    FILE *cpuinfo = fopen("/proc/cpuinfo", "r");
+    char line[256];
+    double mhz = 0;
+
+    while (cpuinfo && fgets(line, sizeof(line), cpuinfo)) {
+        if (sscanf(line, "cpu MHz : %lf", &mhz) == 1) {
+            break;
+        }
+    }
+
+    if (cpuinfo) {
+        fclose(cpuinfo);
+    }
+
+    return mhz > 0 ? (uint32_t)mhz : 1000;
+}
+
+int main(int argc, char **argv) {
+    uint32_t length = 1514;
+    uint32_t rounds = 200000;
+    uint32_t mhz = 0;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--length")) {
+            length = (uint32_t)strtoul(argv[i + 1], nullptr, 0);
+        } else if (!strcmp(argv[i], "--rounds")) {
+            rounds = (uint32_t)strtoul(argv[i + 1], nullptr, 0);
+        } else if (!strcmp(argv[i], "--cpu-mhz")) {
+            mhz = (uint32_t)strtoul(argv[i + 1], nullptr, 0);
+        } else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    ChecksumBench::Result result;
+
+    ChecksumBench::run(result, (uint16_t)length, rounds);
+    ChecksumBench::print(result, (mhz ? mhz : hostCpuMhz()) * 1000000);
+
+    return result.ok ? 0 : 1;
+}
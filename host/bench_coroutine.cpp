@@ -0,0 +1,219 @@
+// Cost of waking a coroutine compared with the raw callback path. An event
+// source stands in for lwIP: it calls a registered function with an argument,
+// the way tcp_recv() callbacks are called.
+//
+//   callback   the function handles the event itself (hand-rolled state machine)
+//   resume     the function resumes the waiting coroutine directly
+//   executor   the function schedules the coroutine and Executor::poll() resumes
+//              it, which is what AsyncConnection does under USBNetwork::work()
+//
+//   bench_coroutine [--rounds 1000000] [--cpu-mhz N]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+extern "C" {
+    #include "pico/stdlib.h"
+}
+
+#include "pico-usbnet/Executor.h"
+
+typedef void (*EventCallback)(void *arg, uint32_t value);
+
+// Called through a volatile pointer so the compiler cannot inline the handler
+static EventCallback volatile event_callback;
+static void *volatile event_arg;
+
+static void raiseEvent(uint32_t value) {
+    event_callback(event_arg, value);
+}
+
+struct Counter {
+    uint32_t events;
+    uint64_t sum;
+};
+
+static void countEvent(void *arg, uint32_t value) {
+    Counter *counter = static_cast<Counter *>(arg);
+
+    counter->events++;
+    counter->sum += value;
+}
+
+// Awaitable event, shaped like AsyncConnection::ReadAwaiter
+struct Event {
+    std::coroutine_handle<> waiter;
+    uint32_t value;
+    bool ready;
+
+    bool await_ready() const noexcept { return ready; }
+    void await_suspend(std::coroutine_handle<> handle) noexcept { waiter = handle; }
+    uint32_t await_resume() noexcept {
+        ready = false;
+        return value;
+    }
+};
+
+static void resumeWaiter(void *arg, uint32_t value) {
+    Event *event = static_cast<Event *>(arg);
+    std::coroutine_handle<> waiter = event->waiter;
+
+    event->value = value;
+    event->ready = true;
+    event->waiter = nullptr;
+
+    if (waiter) {
+        waiter.resume();
+    }
+}
+
+static void scheduleWaiter(void *arg, uint32_t value) {
+    Event *event = static_cast<Event *>(arg);
+
+    event->value = value;
+    event->ready = true;
+
+    if (event->waiter) {
+        Executor::schedule(event->waiter);
+        event->waiter = nullptr;
+    }
+}
+
+static Task consume(Event &event, Counter &counter, uint32_t rounds) {
+    while (counter.events < rounds) {
+        uint32_t value = co_await event;
+
+        counter.events++;
+        counter.sum += value;
+    }
+}
+
+static uint64_t expectedSum(uint32_t rounds) {
+    return (uint64_t)rounds * (rounds + 1) / 2;
+}
+
+static bool runCallback(uint32_t rounds, uint64_t &us) {
+    Counter counter = {};
+
+    event_callback = countEvent;
+    event_arg = &counter;
+
+    uint64_t start = time_us_64();
+
+    for (uint32_t i = 1; i <= rounds; i++) {
+        raiseEvent(i);
+    }
+
+    us = time_us_64() - start;
+
+    return counter.events == rounds && counter.sum == expectedSum(rounds);
+}
+
+static bool runCoroutine(uint32_t rounds, bool viaExecutor, uint64_t &us) {
+    Counter counter = {};
+    Event event = {};
+
+    event_callback = viaExecutor ? scheduleWaiter : resumeWaiter;
+    event_arg = &event;
+
+    if (!Executor::spawn(consume(event, counter, rounds))) {
+        return false;
+    }
+
+    // Run the task up to its first co_await
+    Executor::poll();
+
+    uint64_t start = time_us_64();
+
+    for (uint32_t i = 1; i <= rounds; i++) {
+        raiseEvent(i);
+
+        if (viaExecutor) {
+            Executor::poll();
+        }
+    }
+
+    us = time_us_64() - start;
+
+    return counter.events == rounds && counter.sum == expectedSum(rounds);
+}
+
+static Task idle() {
+    co_await Executor::sleep(1000);
+}
+
+// The frame pool refuses a task instead of allocating, and takes frames back
+static bool checkFramePool() {
+    Task tasks[PICONET_CORO_FRAMES];
+
+    for (Task &task : tasks) {
+        task = idle();
+
+        if (!task.valid()) {
+            return false;
+        }
+    }
+
+    if (idle().valid()) {
+        return false;
+    }
+
+    tasks[0] = Task();
+
+    return idle().valid();
+}
+
+static uint32_t hostCpuMhz() {
+    FILE *cpuinfo = fopen("/proc/cpuinfo", "r");
+    char line[256];
+    double mhz = 0;
+
+    while (cpuinfo && fgets(line, sizeof(line), cpuinfo)) {
+        if (sscanf(line, "cpu MHz : %lf", &mhz) == 1) {
+            break;
+        }
+    }
+
+    if (cpuinfo) {
+        fclose(cpuinfo);
+    }
+
+    return mhz > 0 ? (uint32_t)mhz : 1000;
+}
+
+int main(int argc, char **argv) {
+    uint32_t rounds = 1000000;
+    uint32_t mhz = 0;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--rounds")) {
+            rounds = (uint32_t)strtoul(argv[i + 1], nullptr, 0);
+        } else if (!strcmp(argv[i], "--cpu-mhz")) {
+            mhz = (uint32_t)strtoul(argv[i + 1], nullptr, 0);
+        } else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    if (!mhz) {
+        mhz = hostCpuMhz();
+    }
+
+    const char *const names[] = {"callback", "resume", "executor"};
+    uint64_t us[3] = {};
+    bool ok = runCallback(rounds, us[0]) && runCoroutine(rounds, false, us[1]) &&
+              runCoroutine(rounds, true, us[2]) && checkFramePool();
+
+    printf("coroutine resume cost: %lu events, %s\n", (unsigned long)rounds, ok ? "ok" : "FAILED");
+
+    for (size_t i = 0; i < 3 && ok; i++) {
+        double ns = us[i] * 1000.0 / rounds;
+
+        printf("  %-9s %7.1f ns/event, %6.1f cycles at %lu MHz\n", names[i], ns, ns * mhz / 1000,
+               (unsigned long)mhz);
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+// DNSResponder on the host: checks the answer to each kind of query, then
+// measures queries per second over a mix of them. Only the responder is
+// timed; on the device lwIP and the USB link add their own cost per query.
+//
+//   bench_dns [--rounds 1000000]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+extern "C" {
+    #include "pico/stdlib.h"
+}
+
+#include "pico-usbnet/DNSResponder.h"
+
+#define TYPE_A      1
+#define TYPE_AAAA   28
+
+struct Query {
+    const char *name;
+    uint16_t type;
+    uint8_t rcode;
+    bool answer;
+    uint8_t wire[64];
+    size_t length;
+};
+
+static Query queries[] = {
+    {PICONET_HOSTNAME "." PICONET_DNS_DOMAIN, TYPE_A, 0, true, {}, 0},
+    {PICONET_HOSTNAME, TYPE_A, 0, true, {}, 0},
+    {PICONET_HOSTNAME "." PICONET_DNS_DOMAIN, TYPE_AAAA, 0, false, {}, 0},
+    {"missing." PICONET_DNS_DOMAIN, TYPE_A, 3, false, {}, 0},
+    {"example.com", TYPE_A, 5, false, {}, 0},
+};
+
+static const size_t query_count = sizeof(queries) / sizeof(queries[0]);
+
+static size_t buildQuery(const char *name, uint16_t type, uint16_t id, uint8_t *out) {
+    const uint8_t header[12] = {(uint8_t)(id >> 8), (uint8_t)id, 0x01, 0x00, 0, 1, 0, 0, 0, 0, 0, 0};
+    size_t length = sizeof(header);
+
+    memcpy(out, header, sizeof(header));
+
+    while (*name) {
+        const char *dot = strchr(name, '.');
+        size_t label = dot ? (size_t)(dot - name) : strlen(name);
+
+        out[length++] = (uint8_t)label;
+        memcpy(out + length, name, label);
+        length += label;
+        name += label + (dot ? 1 : 0);
+    }
+
+    out[length++] = 0;
+    out[length++] = (uint8_t)(type >> 8);
+    out[length++] = (uint8_t)type;
+    out[length++] = 0;
+    out[length++] = 1;
+
+    return length;
+}
+
+static bool check(DNSResponder &responder, const Query &query, uint32_t address) {
+    uint8_t response[128];
+    size_t size = responder.respond(query.wire, query.length, response, sizeof(response));
+
+    if (size < 12 || response[0] != query.wire[0] || response[1] != query.wire[1] || !(response[2] & 0x80) ||
+        (response[3] & 0x0f) != query.rcode || response[7] != (query.answer ? 1 : 0)) {
+        printf("FAILED: %s type %u\n", query.name, query.type);
+        return false;
+    }
+
+    if (query.answer && (size != query.length + DNSResponder::answerLength ||
+                         memcmp(response + size - 4, &address, 4) != 0)) {
+        printf("FAILED: %s answer\n", query.name);
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv) {
+    uint32_t rounds = 1000000;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--rounds")) {
+            rounds = (uint32_t)strtoul(argv[i + 1], nullptr, 0);
+        } else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    DNSResponder responder;
+    const uint8_t device[4] = {192, 168, 7, 1};
+    uint32_t address;
+
+    memcpy(&address, device, 4);
+
+    bool ok = responder.addRecord(PICONET_HOSTNAME, address);
+
+    for (size_t i = 0; i < query_count; i++) {
+        queries[i].length = buildQuery(queries[i].name, queries[i].type, (uint16_t)(0x1000 + i), queries[i].wire);
+        ok = check(responder, queries[i], address) && ok;
+    }
+
+    // Malformed queries get no response at all
+    uint8_t response[128];
+    uint8_t truncated[12] = {0x12, 0x34, 0x01, 0x00, 0, 1};
+
+    ok = ok && responder.respond(truncated, 8, response, sizeof(response)) == 0;
+
+    responder.resetStats();
+
+    uint64_t start = time_us_64();
+    size_t bytes = 0;
+
+    for (uint32_t i = 0; i < rounds; i++) {
+        const Query &query = queries[i % query_count];
+
+        bytes += responder.respond(query.wire, query.length, response, sizeof(response));
+    }
+
+    uint64_t us = time_us_64() - start;
+    const DNSResponder::Stats &stats = responder.getStats();
+
+    ok = ok && stats.queries == rounds && bytes > 0;
+
+    printf("dns responder: %s\n", ok ? "ok" : "FAILED");
+
+    if (ok && us) {
+        printf("  %lu queries in %llu us: %.2f M queries/s, %.1f ns each\n", (unsigned long)rounds,
+               (unsigned long long)us, rounds / (double)us, us * 1000.0 / rounds);
+        printf("  %lu answered, %lu no data, %lu nxdomain, %lu refused\n", (unsigned long)stats.answered,
+               (unsigned long)stats.noData, (unsigned long)stats.nxDomain, (unsigned long)stats.refused);
+    }
+
+    return ok ? 0 : 1;
+}
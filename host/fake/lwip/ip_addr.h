@@ -0,0 +1,16 @@
+#ifndef PICONET_HOST_FAKE_LWIP_IP_ADDR_H
+#define PICONET_HOST_FAKE_LWIP_IP_ADDR_H
+
+// IPv4-only ip_addr_t for host builds of classes that only pass addresses
+// around (PacketFilter). Same layout as lwIP's: network byte order.
+
+#include <stdint.h>
+
+typedef struct ip_addr {
+    uint32_t addr;
+} ip_addr_t;
+
+#define IP_ADDR4(ipaddr, a, b, c, d) \
+    ((ipaddr)->addr = (uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+#endif // PICONET_HOST_FAKE_LWIP_IP_ADDR_H
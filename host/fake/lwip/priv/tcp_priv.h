@@ -0,0 +1,18 @@
+#ifndef PICONET_HOST_FAKE_LWIP_TCP_PRIV_H
+#define PICONET_HOST_FAKE_LWIP_TCP_PRIV_H
+
+// The one private list ConnectionManager::getTimeWaitCount() walks
+
+#include "lwip/tcp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern struct tcp_pcb *tcp_tw_pcbs;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PICONET_HOST_FAKE_LWIP_TCP_PRIV_H
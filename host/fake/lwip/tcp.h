@@ -0,0 +1,113 @@
+#ifndef PICONET_HOST_FAKE_LWIP_TCP_H
+#define PICONET_HOST_FAKE_LWIP_TCP_H
+
+// The raw TCP API ConnectionManager uses, served by a fake pcb pool in the
+// test that links it (host/test_connection_manager.cpp). Names, error codes
+// and callback signatures are lwIP's; the pcb keeps only the fields the
+// fake and ConnectionManager touch.
+
+#include <stdint.h>
+
+#include "lwip/ip_addr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint8_t u8_t;
+typedef uint16_t u16_t;
+typedef uint32_t u32_t;
+typedef int8_t err_t;
+
+#define ERR_OK          0
+#define ERR_MEM         -1
+#define ERR_VAL         -6
+#define ERR_USE         -8
+#define ERR_ISCONN      -10
+#define ERR_CONN        -11
+#define ERR_ABRT        -13
+#define ERR_RST         -14
+
+#define LWIP_MAX(x, y)  (((x) > (y)) ? (x) : (y))
+
+// The fake has one address, so any will do
+#define IP_ADDR_ANY     ((const ip_addr_t *)0)
+
+#define SOF_REUSEADDR   0x04U
+#define SOF_KEEPALIVE   0x08U
+#define SOF_INHERITED   (SOF_REUSEADDR | SOF_KEEPALIVE)
+
+#define ip_set_option(pcb, opt)  ((pcb)->so_options |= (u8_t)(opt))
+
+#define TCP_WRITE_FLAG_COPY 0x01
+
+struct pbuf {
+    struct pbuf *next;
+    void *payload;
+    u16_t tot_len;
+    u16_t len;
+};
+
+u8_t pbuf_free(struct pbuf *p);
+
+enum tcp_state {
+    CLOSED,
+    LISTEN,
+    ESTABLISHED,
+    FIN_WAIT_1,         // closed here, waiting for the peer's FIN
+    CLOSE_WAIT,         // the peer closed first
+    TIME_WAIT
+};
+
+struct tcp_pcb;
+
+typedef err_t (*tcp_accept_fn)(void *arg, struct tcp_pcb *newpcb, err_t err);
+typedef err_t (*tcp_recv_fn)(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err);
+typedef err_t (*tcp_sent_fn)(void *arg, struct tcp_pcb *tpcb, u16_t len);
+typedef err_t (*tcp_poll_fn)(void *arg, struct tcp_pcb *tpcb);
+typedef void (*tcp_err_fn)(void *arg, err_t err);
+
+struct tcp_pcb {
+    struct tcp_pcb *next;
+    enum tcp_state state;
+    u8_t so_options;
+    u16_t local_port;
+    void *callback_arg;
+    tcp_accept_fn accept;
+    tcp_recv_fn recv;
+    tcp_sent_fn sent;
+    tcp_poll_fn poll;
+    tcp_err_fn errf;
+    u8_t pollinterval;
+    u8_t polltmr;
+    u32_t tmr;          // when it entered TIME_WAIT, in ms
+    u16_t snd_buf;
+    u32_t keep_idle;
+    u32_t keep_intvl;
+    u32_t keep_cnt;
+};
+
+#define tcp_sndbuf(pcb)     ((pcb)->snd_buf)
+
+struct tcp_pcb *tcp_new(void);
+err_t tcp_bind(struct tcp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port);
+struct tcp_pcb *tcp_listen_with_backlog(struct tcp_pcb *pcb, u8_t backlog);
+err_t tcp_close(struct tcp_pcb *pcb);
+void tcp_abort(struct tcp_pcb *pcb);
+
+void tcp_arg(struct tcp_pcb *pcb, void *arg);
+void tcp_accept(struct tcp_pcb *pcb, tcp_accept_fn accept);
+void tcp_recv(struct tcp_pcb *pcb, tcp_recv_fn recv);
+void tcp_sent(struct tcp_pcb *pcb, tcp_sent_fn sent);
+void tcp_poll(struct tcp_pcb *pcb, tcp_poll_fn poll, u8_t interval);
+void tcp_err(struct tcp_pcb *pcb, tcp_err_fn err);
+
+err_t tcp_write(struct tcp_pcb *pcb, const void *dataptr, u16_t len, u8_t apiflags);
+err_t tcp_output(struct tcp_pcb *pcb);
+void tcp_recved(struct tcp_pcb *pcb, u16_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PICONET_HOST_FAKE_LWIP_TCP_H
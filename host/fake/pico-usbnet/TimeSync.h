@@ -0,0 +1,18 @@
+#ifndef PICONET_TIME_SYNC_H
+#define PICONET_TIME_SYNC_H
+
+// Stands in for the real TimeSync, which needs lwIP, in host builds of the
+// classes that only read the clock (BlockRing). Synced with a fixed offset.
+
+#include <cstdint>
+
+class TimeSync {
+public:
+    int64_t offsetUs = 0;
+    bool synced = false;
+
+    bool isSynced() const { return synced; }
+    int64_t toHostTimeUs(uint64_t deviceUs) const { return (int64_t)deviceUs + offsetUs; }
+};
+
+#endif // PICONET_TIME_SYNC_H
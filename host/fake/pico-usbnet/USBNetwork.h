@@ -0,0 +1,19 @@
+#ifndef PICONET_MANAGER_H
+#define PICONET_MANAGER_H
+
+// Stands in for the real USBNetwork, which needs TinyUSB and lwIP, in host
+// builds of the classes that only ask when the current frame arrived
+// (ConnectionManager). The test sets the time.
+
+#include <cstdint>
+
+#include "pico/stdlib.h"
+
+class USBNetwork {
+public:
+    static uint64_t receiveTimeUs;
+
+    static uint64_t getReceiveTimeUs() { return receiveTimeUs; }
+};
+
+#endif // PICONET_MANAGER_H
@@ -0,0 +1,23 @@
+#ifndef PICONET_HOST_FAKE_TUSB_H
+#define PICONET_HOST_FAKE_TUSB_H
+
+// The vendor-class calls VendorStream makes, served by a fake bulk IN
+// endpoint in the test that links it (host/test_block_ring.cpp).
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool tud_vendor_mounted(void);
+uint32_t tud_vendor_write_available(void);
+uint32_t tud_vendor_write(const void *buffer, uint32_t bufsize);
+uint32_t tud_vendor_write_flush(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PICONET_HOST_FAKE_TUSB_H
@@ -0,0 +1,10 @@
+#ifndef PICONET_HOST_LWIP_ARCH_H
+#define PICONET_HOST_LWIP_ARCH_H
+
+// The one lwIP type LwipLock needs, so it builds on the host without lwIP
+
+#include <stdint.h>
+
+typedef uint32_t sys_prot_t;
+
+#endif // PICONET_HOST_LWIP_ARCH_H
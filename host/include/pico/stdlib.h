@@ -0,0 +1,28 @@
+#ifndef PICONET_HOST_PICO_STDLIB_H
+#define PICONET_HOST_PICO_STDLIB_H
+
+// Host stand-ins for the Pico SDK time calls used by the platform-independent
+// classes. The clock is the host's monotonic clock, counted from start-up.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint64_t time_us_64(void);
+
+static inline uint32_t time_us_32(void) {
+    return (uint32_t)time_us_64();
+}
+
+void sleep_us(uint64_t us);
+
+static inline void tight_loop_contents(void) {}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PICONET_HOST_PICO_STDLIB_H
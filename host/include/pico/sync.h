@@ -0,0 +1,69 @@
+#ifndef PICONET_HOST_PICO_SYNC_H
+#define PICONET_HOST_PICO_SYNC_H
+
+// Host stand-ins for the RP2040 spinlocks and core number. Threads play the
+// cores: each calls host_set_core_num() first. As on the chip, reading a
+// spinlock claims it (non-zero when this read took it) and
+// spin_unlock_unsafe() releases it, so code that reads the lock directly
+// behaves as it does on the device.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pico/stdlib.h"
+
+#ifndef __cplusplus
+#error "the host spinlocks are C++ only"
+#endif
+
+extern "C++" {
+#include <atomic>
+
+struct spin_lock_t {
+    std::atomic<uint32_t> held;
+
+    operator uint32_t() volatile {
+        return held.exchange(1, std::memory_order_acquire) ? 0 : 1;
+    }
+};
+
+inline void host_spin_unlock(volatile spin_lock_t *lock) {
+    lock->held.store(0, std::memory_order_release);
+}
+}
+
+#define PICO_SPINLOCK_ID_OS1 14
+
+#define __mem_fence_acquire() std::atomic_thread_fence(std::memory_order_acquire)
+#define __mem_fence_release() std::atomic_thread_fence(std::memory_order_release)
+
+spin_lock_t *spin_lock_instance(unsigned lock_num);
+
+static inline void spin_lock_unsafe_blocking(spin_lock_t *lock) {
+    while (!*lock) {
+        tight_loop_contents();
+    }
+}
+
+static inline void spin_unlock_unsafe(spin_lock_t *lock) {
+    host_spin_unlock(lock);
+}
+
+// Interrupts do not exist on the host; the masks only have to round-trip
+static inline uint32_t save_and_disable_interrupts(void) {
+    return 0;
+}
+
+static inline void restore_interrupts(uint32_t status) {
+    (void)status;
+}
+
+unsigned get_core_num(void);
+void host_set_core_num(unsigned core);
+
+// No exception handlers on the host: code always runs in thread mode
+static inline unsigned __get_current_exception(void) {
+    return 0;
+}
+
+#endif // PICONET_HOST_PICO_SYNC_H
@@ -0,0 +1,33 @@
+#include <chrono>
+#include <thread>
+
+extern "C" {
+    #include "pico/stdlib.h"
+    #include "pico/sync.h"
+}
+
+static const std::chrono::steady_clock::time_point boot = std::chrono::steady_clock::now();
+
+static spin_lock_t spin_locks[32];
+static thread_local unsigned core_num = 0;
+
+uint64_t time_us_64(void) {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - boot).count();
+}
+
+void sleep_us(uint64_t us) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+spin_lock_t *spin_lock_instance(unsigned lock_num) {
+    return &spin_locks[lock_num];
+}
+
+unsigned get_core_num(void) {
+    return core_num;
+}
+
+void host_set_core_num(unsigned core) {
+    core_num = core;
+}
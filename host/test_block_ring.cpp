@@ -0,0 +1,328 @@
+// BlockRing and VendorStream against a fake vendor bulk IN endpoint: the
+// endpoint FIFO has the device's size (CFG_TUD_VENDOR_TX_BUFSIZE), and a
+// simulated host drains it and parses the byte stream the way
+// tools/usbfs_reader.c does. Checks that blocks arrive whole and in order
+// while the reader keeps up, that a stalled reader costs overruns but never
+// a torn block, and that unplugging detaches the stream. Then times the
+// device-side path (append, poll, endpoint copy) per byte.
+//
+//   block_ring_test [--megabytes 64]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+extern "C" {
+    #include "pico/stdlib.h"
+    #include "tusb.h"
+}
+
+#include "pico-usbnet/BlockRing.h"
+#include "pico-usbnet/TimeSync.h"
+#include "pico-usbnet/VendorStream.h"
+
+#define FIFO_SIZE   512
+
+static int failures;
+
+static void check(bool condition, const char *what) {
+    if (!condition) {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+// Fake endpoint: VendorStream writes into the FIFO, the host side reads it out
+static bool mounted;
+static uint8_t fifo[FIFO_SIZE];
+static uint32_t fifo_used;
+static uint32_t flushes;
+
+extern "C" bool tud_vendor_mounted(void) {
+    return mounted;
+}
+
+extern "C" uint32_t tud_vendor_write_available(void) {
+    return FIFO_SIZE - fifo_used;
+}
+
+extern "C" uint32_t tud_vendor_write(const void *buffer, uint32_t bufsize) {
+    uint32_t room = FIFO_SIZE - fifo_used;
+    uint32_t count = bufsize < room ? bufsize : room;
+
+    memcpy(fifo + fifo_used, buffer, count);
+    fifo_used += count;
+
+    return count;
+}
+
+extern "C" uint32_t tud_vendor_write_flush(void) {
+    flushes++;
+
+    return fifo_used;
+}
+
+struct Reader {
+    std::vector<uint8_t> pending;
+    uint32_t blocks = 0;
+    uint32_t gaps = 0;
+    uint32_t torn = 0;
+    uint32_t nextSequence = 0;
+    bool started = false;
+    int64_t lastTimestamp = 0;
+    uint32_t lastFlags = 0;
+
+    void reset() {
+        pending.clear();
+        started = false;
+    }
+
+    // Takes up to `length` bytes off the endpoint, as the host's bulk reads would
+    void drain(uint32_t length = FIFO_SIZE) {
+        uint32_t count = length < fifo_used ? length : fifo_used;
+
+        pending.insert(pending.end(), fifo, fifo + count);
+        memmove(fifo, fifo + count, fifo_used - count);
+        fifo_used -= count;
+
+        parse();
+    }
+
+    void parse() {
+        size_t at = 0;
+
+        while (pending.size() - at >= sizeof(BlockHeader)) {
+            BlockHeader header;
+
+            memcpy(&header, pending.data() + at, sizeof(header));
+
+            if (header.magic != PICONET_BLOCK_MAGIC || header.length > PICONET_BLOCK_RING_SIZE) {
+                torn++;
+                pending.clear();
+
+                return;
+            }
+
+            if (pending.size() - at < sizeof(header) + header.length) {
+                break;
+            }
+
+            checkPayload(pending.data() + at + sizeof(header), header.length);
+
+            if (started && header.sequence != nextSequence) {
+                gaps++;
+            }
+
+            started = true;
+            nextSequence = header.sequence + 1;
+            lastTimestamp = header.timestampUs;
+            lastFlags = header.flags;
+            blocks++;
+            at += sizeof(header) + header.length;
+        }
+
+        pending.erase(pending.begin(), pending.begin() + at);
+    }
+
+    // The producer writes a running word counter, so a block is intact if its words count up
+    void checkPayload(const uint8_t *payload, uint32_t length) {
+        uint32_t first;
+
+        memcpy(&first, payload, 4);
+
+        for (uint32_t i = 4; i + 4 <= length; i += 4) {
+            uint32_t word;
+
+            memcpy(&word, payload + i, 4);
+
+            if (word != first + i / 4) {
+                torn++;
+
+                return;
+            }
+        }
+    }
+};
+
+struct Producer {
+    uint32_t counter = 0;
+
+    // Appends `words` counter words in one call
+    void append(BlockRing &ring, size_t words, uint64_t timeUs = 0) {
+        uint32_t buffer[64];
+
+        while (words) {
+            size_t count = words < 64 ? words : 64;
+
+            for (size_t i = 0; i < count; i++) {
+                buffer[i] = counter++;
+            }
+
+            ring.append(buffer, count * 4, timeUs);
+            words -= count;
+        }
+    }
+};
+
+static const size_t block_words = PICONET_BLOCK_RING_SIZE / 4;
+
+static void testKeepingUp() {
+    BlockRing ring;
+    VendorStream stream;
+    Producer producer;
+    Reader reader;
+
+    mounted = false;
+    stream.start(ring);
+
+    // Unplugged: the stream does not hold the ring back
+    producer.append(ring, block_words * PICONET_BLOCK_RING_BLOCKS * 2);
+    stream.poll();
+    check(fifo_used == 0 && stream.getStats().attaches == 0, "unmounted stream stays detached");
+    check(ring.getStats().overruns[0] == 0 && ring.getStats().dropped == 0, "nothing waits on a detached stream");
+
+    mounted = true;
+    stream.poll();
+
+    for (int round = 0; round < 4000; round++) {
+        producer.append(ring, 37);
+        stream.poll();
+        reader.drain();
+    }
+
+    ring.seal();
+
+    for (int i = 0; i < 100 && (fifo_used || ring.getStats().blocks > reader.blocks); i++) {
+        stream.poll();
+        reader.drain();
+    }
+
+    uint32_t expected = (uint32_t)(4000 * 37 / block_words);
+
+    check(stream.getStats().attaches == 1, "stream attaches once mounted");
+    check(reader.blocks >= expected && reader.gaps == 0 && reader.torn == 0, "blocks arrive whole and in order");
+    check(ring.getStats().overruns[0] == 0 && ring.getStats().dropped == 0, "a reader that keeps up loses nothing");
+    check(reader.pending.empty() && flushes > 0, "stream drained and flushed");
+
+    stream.stop();
+}
+
+static void testStalledReader() {
+    BlockRing ring;
+    VendorStream stream;
+    Producer producer;
+    Reader reader;
+    TimeSync clock;
+
+    mounted = true;
+    fifo_used = 0;
+    clock.synced = true;
+    clock.offsetUs = 1000000;
+    ring.setTimeSync(&clock);
+    stream.start(ring);
+    stream.poll();
+
+    // The host stops reading for a few ring lengths, then catches up a packet at a time
+    for (int round = 0; round < 400; round++) {
+        producer.append(ring, block_words / 8, 5000);
+        stream.poll();
+
+        if (round > 300) {
+            reader.drain(64);
+        }
+    }
+
+    size_t unsent;
+
+    // The stream is the ring's only consumer, so it is consumer 0
+    for (int i = 0; i < 2000 && (fifo_used || ring.peek(0, unsent) != nullptr); i++) {
+        stream.poll();
+        reader.drain(64);
+    }
+
+    check(ring.getStats().overruns[0] > 0, "stalled reader overruns");
+    check(reader.torn == 0, "overruns never tear a block");
+    check(reader.gaps > 0 && reader.blocks > 0, "reader sees the gap and resumes");
+    check(reader.lastFlags == PICONET_BLOCK_FLAG_HOST_TIME && reader.lastTimestamp == 1005000,
+          "blocks carry host time while synced");
+
+    // Unplugged part way through a block: the next mount starts on a block boundary
+    producer.append(ring, block_words);
+    stream.poll();
+    reader.drain(100);
+    mounted = false;
+    stream.poll();
+    fifo_used = 0;
+    reader.reset();
+
+    producer.append(ring, block_words * 2);
+    mounted = true;
+    uint32_t before = reader.torn;
+
+    for (int i = 0; i < 10; i++) {
+        producer.append(ring, block_words);
+        stream.poll();
+        reader.drain();
+    }
+
+    check(stream.getStats().attaches == 2 && reader.torn == before && reader.blocks > 0,
+          "remount starts on a block boundary");
+
+    stream.stop();
+}
+
+static void benchmark(uint32_t megabytes) {
+    BlockRing ring;
+    VendorStream stream;
+    Producer producer;
+    Reader reader;
+
+    mounted = true;
+    fifo_used = 0;
+    stream.start(ring);
+    stream.poll();
+
+    size_t chunks = (size_t)megabytes * 1024 * 1024 / 256;
+    uint64_t start = time_us_64();
+
+    for (size_t i = 0; i < chunks; i++) {
+        producer.append(ring, 64);
+        stream.poll();
+        fifo_used = 0;
+    }
+
+    uint64_t us = time_us_64() - start;
+
+    stream.stop();
+
+    if (us) {
+        printf("  %lu MB through ring and endpoint in %llu us: %.0f MB/s, %.2f ns/byte (host CPU)\n",
+               (unsigned long)megabytes, (unsigned long long)us, megabytes * 1048576.0 / us,
+               us * 1000.0 / (megabytes * 1048576.0));
+    }
+}
+
+int main(int argc, char **argv) {
+    uint32_t megabytes = 64;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--megabytes")) {
+            megabytes = (uint32_t)strtoul(argv[i + 1], nullptr, 0);
+        } else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    testKeepingUp();
+    testStalledReader();
+
+    printf("block ring and vendor stream: %s\n", failures ? "FAILED" : "ok");
+
+    if (!failures) {
+        benchmark(megabytes);
+    }
+
+    return failures ? 1 : 0;
+}
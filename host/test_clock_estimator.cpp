@@ -0,0 +1,160 @@
+// ClockEstimator fed with exchanges against a simulated host clock of known
+// offset and skew. Each leg of an exchange gets a fixed latency plus random
+// queueing delay, and some exchanges are held up on one leg only, as a host
+// busy with other traffic would. Checks when the estimate becomes usable, and
+// that the drift it recovers and its host time stay within bounds of the truth.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "pico-usbnet/ClockEstimator.h"
+
+#define EXCHANGE_INTERVAL_US    250000
+
+static int failures;
+
+static void check(bool condition, const char *what) {
+    if (!condition) {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+struct Link {
+    double skewPpb;             // host clock rate against the device's, minus one
+    int64_t offsetUs;           // host minus device at device time 0
+    uint32_t baseUs;            // fixed one-way latency
+    uint32_t queueUs;           // largest random queueing delay per leg; most are far shorter
+    uint32_t stallUs;           // one-sided hold-up of every tenth exchange
+    uint32_t state;
+
+    uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+
+        return state;
+    }
+
+    double jitter() {
+        double r = (next() >> 8) / 16777216.0;
+
+        return queueUs * r * r * r;
+    }
+
+    double hostAt(double deviceUs) const {
+        return deviceUs * (1.0 + skewPpb * 1e-9) + (double)offsetUs;
+    }
+
+    double deviceAt(double hostUs) const {
+        return (hostUs - (double)offsetUs) / (1.0 + skewPpb * 1e-9);
+    }
+
+    // One exchange starting at device time t1; true when it closed a window
+    bool exchange(ClockEstimator &estimator, uint64_t t1, uint32_t index) {
+        double up = baseUs + jitter();
+        double down = baseUs + jitter();
+
+        if (stallUs && index % 10 == 3) {
+            (index & 1 ? up : down) += stallUs;
+        }
+
+        int64_t t2 = (int64_t)llround(hostAt((double)t1 + up));
+        int64_t t3 = t2 + 20 + (int64_t)(jitter() / 8);
+        uint64_t t4 = (uint64_t)llround(deviceAt((double)t3) + down);
+        uint32_t delayUs;
+
+        return estimator.addExchange(t1, t2, t3, t4, delayUs);
+    }
+};
+
+struct Result {
+    double driftErrorPpb;
+    double hostErrorUs;         // at the last exchange
+    double aheadErrorUs;        // one second later, with no exchange in between
+};
+
+static Result run(Link link, uint32_t exchanges) {
+    ClockEstimator estimator;
+    uint64_t deviceUs = 5000000;
+
+    for (uint32_t i = 0; i < exchanges; i++) {
+        link.exchange(estimator, deviceUs, i);
+        deviceUs += EXCHANGE_INTERVAL_US;
+    }
+
+    Result result;
+
+    result.driftErrorPpb = estimator.getDriftPpb() - link.skewPpb;
+    result.hostErrorUs = estimator.toHostTimeUs(deviceUs) - link.hostAt((double)deviceUs);
+    result.aheadErrorUs = estimator.toHostTimeUs(deviceUs + 1000000) - link.hostAt((double)deviceUs + 1000000);
+
+    return result;
+}
+
+static void testStartup() {
+    Link link = {40000, 1500000000, 150, 0, 0, 1};
+    ClockEstimator estimator;
+    uint64_t deviceUs = 1000000;
+    uint32_t i = 0;
+
+    check(!estimator.isSynced(), "not synced before any exchange");
+
+    // The first window is half length
+    for (; i < (PICONET_TIMESYNC_WINDOW + 1) / 2 - 1; i++, deviceUs += EXCHANGE_INTERVAL_US) {
+        check(!link.exchange(estimator, deviceUs, i), "no point before the first window closes");
+    }
+
+    check(!estimator.isSynced(), "not synced within the first window");
+    check(link.exchange(estimator, deviceUs, i++), "first window closes early");
+    check(estimator.isSynced() && estimator.getDriftPpb() == 0, "synced on the first point, drift still 0");
+    // Without jitter every sample ties, so the window keeps its first
+    check(std::llabs(estimator.toHostTimeUs(1000000) - (int64_t)link.hostAt(1000000)) <= 2,
+          "first point gives the offset");
+
+    deviceUs += EXCHANGE_INTERVAL_US;
+
+    for (uint32_t closed = 0; !closed; i++, deviceUs += EXCHANGE_INTERVAL_US) {
+        closed = link.exchange(estimator, deviceUs, i);
+    }
+
+    check(estimator.getPointCount() == 2 && estimator.getDriftPpb() != 0, "second point gives a drift");
+}
+
+// Worst errors over several seeds of the same link
+static void testLink(const char *name, Link link, double driftBoundPpb, double hostBoundUs) {
+    // Enough windows to fill every point, then a few more so the oldest ones have rolled out
+    uint32_t exchanges = (PICONET_TIMESYNC_WINDOW + 1) / 2 + (PICONET_TIMESYNC_POINTS + 3) * PICONET_TIMESYNC_WINDOW;
+    Result worst = {};
+
+    for (uint32_t seed = 1; seed <= 20; seed++) {
+        link.state = seed * 2654435761u;
+
+        Result result = run(link, exchanges);
+
+        worst.driftErrorPpb = std::fmax(worst.driftErrorPpb, std::fabs(result.driftErrorPpb));
+        worst.hostErrorUs = std::fmax(worst.hostErrorUs, std::fabs(result.hostErrorUs));
+        worst.aheadErrorUs = std::fmax(worst.aheadErrorUs, std::fabs(result.aheadErrorUs));
+    }
+
+    printf("  %-22s skew %+8.0f ppb: drift error %6.0f ppb, host time error %5.1f us now, %5.1f us 1 s ahead\n",
+           name, link.skewPpb, worst.driftErrorPpb, worst.hostErrorUs, worst.aheadErrorUs);
+
+    check(worst.driftErrorPpb <= driftBoundPpb, "drift within bounds");
+    check(worst.hostErrorUs <= hostBoundUs && worst.aheadErrorUs <= hostBoundUs, "host time within bounds");
+}
+
+int main() {
+    testStartup();
+
+    // skew, offset, latency, queueing, stalls
+    testLink("no jitter", {40000, 1500000000, 150, 0, 0, 0}, 5, 2);
+    testLink("queueing", {40000, 1500000000, 150, 400, 0, 0}, 6000, 40);
+    testLink("queueing and stalls", {-120000, -3000000, 150, 400, 20000, 0}, 6000, 40);
+    testLink("slow host", {50000, 86400000000, 500, 1000, 50000, 0}, 15000, 120);
+
+    printf("clock estimator: %s\n", failures ? "FAILED" : "ok");
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,546 @@
+// ConnectionManager against a fake lwIP TCP layer: a pool of
+// PICONET_CONN_SLOTS + 2 pcbs, as the lwipopts planner sizes it for the
+// manager (PICONET_PLAN_TIME_WAIT_PCBS), that recycles its oldest TIME_WAIT
+// pcb when it runs dry, as tcp_alloc() does, and simulated clients in place
+// of the host. Runs LoopbackBench's reconnect storm (connect, send a byte,
+// the server closes) with graceful and abortive closes and times it, then
+// checks eviction and refusal, idle aborts, peer resets and closes, and a
+// restart while TIME_WAIT pcbs still hold the port.
+//
+// The connect times LoopbackBench reports come from lwIP's handshake over the
+// loopback netif, so they stay on the target; this covers the manager's side.
+//
+//   connection_manager_test [--connections 100000]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+extern "C" {
+    #include "pico/stdlib.h"
+    #include "lwip/priv/tcp_priv.h"
+}
+
+#include "pico-usbnet/ConnectionManager.h"
+#include "pico-usbnet/USBNetwork.h"
+
+#define POOL_SIZE   (PICONET_CONN_SLOTS + 2)
+#define PORT        5559
+
+static int failures;
+
+static void check(bool condition, const char *what) {
+    if (!condition) {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+uint64_t USBNetwork::receiveTimeUs;
+
+// A client on the host; pcb is the device's side of its connection, null once that is gone
+struct Client {
+    struct tcp_pcb *pcb;
+    bool reset;
+    uint32_t received;
+};
+
+// Fake stack: the pcb pool, one listen pcb from its own pool as in lwIP, and the slow timer's clock
+static struct tcp_pcb pool[POOL_SIZE];
+static bool used[POOL_SIZE];
+static Client *peers[POOL_SIZE];
+static struct tcp_pcb listener;
+static bool listening;
+static uint32_t now_ms;
+static uint32_t recycled;
+static uint32_t pbufs_freed;
+static bool close_fails;
+
+struct tcp_pcb *tcp_tw_pcbs;
+
+static size_t pcbsInUse() {
+    size_t count = 0;
+
+    for (bool inUse : used) {
+        count += inUse;
+    }
+
+    return count;
+}
+
+static void unlinkTimeWait(struct tcp_pcb *pcb) {
+    for (struct tcp_pcb **link = &tcp_tw_pcbs; *link; link = &(*link)->next) {
+        if (*link == pcb) {
+            *link = pcb->next;
+            return;
+        }
+    }
+}
+
+// Back to the pool; a client still attached sees a reset, or the end of a clean close
+static void release(struct tcp_pcb *pcb, bool reset) {
+    size_t i = (size_t)(pcb - pool);
+
+    if (pcb->state == TIME_WAIT) {
+        unlinkTimeWait(pcb);
+    }
+
+    if (peers[i]) {
+        peers[i]->pcb = nullptr;
+        peers[i]->reset = reset;
+        peers[i] = nullptr;
+    }
+
+    used[i] = false;
+}
+
+static struct tcp_pcb *allocate() {
+    for (size_t i = 0; i < POOL_SIZE; i++) {
+        if (!used[i]) {
+            used[i] = true;
+            pool[i] = tcp_pcb();
+            pool[i].snd_buf = 2920;
+
+            return &pool[i];
+        }
+    }
+
+    struct tcp_pcb *oldest = nullptr;
+
+    for (struct tcp_pcb *pcb = tcp_tw_pcbs; pcb; pcb = pcb->next) {
+        if (!oldest || now_ms - pcb->tmr >= now_ms - oldest->tmr) {
+            oldest = pcb;
+        }
+    }
+
+    if (!oldest) {
+        return nullptr;
+    }
+
+    release(oldest, false);
+    recycled++;
+
+    return allocate();
+}
+
+extern "C" u8_t pbuf_free(struct pbuf *p) {
+    pbufs_freed++;
+
+    return 1;
+}
+
+extern "C" struct tcp_pcb *tcp_new(void) {
+    return allocate();
+}
+
+// With SO_REUSE a port is shared only when both pcbs allow it; TIME_WAIT pcbs count
+extern "C" err_t tcp_bind(struct tcp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port) {
+    for (size_t i = 0; i < POOL_SIZE; i++) {
+        struct tcp_pcb *other = &pool[i];
+
+        if (used[i] && other != pcb && other->local_port == port &&
+            !(pcb->so_options & other->so_options & SOF_REUSEADDR)) {
+            return ERR_USE;
+        }
+    }
+
+    if (listening && listener.local_port == port) {
+        return ERR_USE;
+    }
+
+    pcb->local_port = port;
+
+    return ERR_OK;
+}
+
+extern "C" struct tcp_pcb *tcp_listen_with_backlog(struct tcp_pcb *pcb, u8_t backlog) {
+    if (listening) {
+        return nullptr;
+    }
+
+    listener = *pcb;
+    listener.state = LISTEN;
+    listening = true;
+    release(pcb, false);
+
+    return &listener;
+}
+
+extern "C" err_t tcp_close(struct tcp_pcb *pcb) {
+    if (pcb == &listener) {
+        listening = false;
+
+        return ERR_OK;
+    }
+
+    // lwIP's answer when it has no memory for the FIN
+    if (close_fails) {
+        return ERR_MEM;
+    }
+
+    if (pcb->state == ESTABLISHED) {
+        pcb->state = FIN_WAIT_1;
+    } else {
+        release(pcb, false);
+    }
+
+    return ERR_OK;
+}
+
+// As in lwIP, the error callback runs after the pcb is freed
+extern "C" void tcp_abort(struct tcp_pcb *pcb) {
+    tcp_err_fn errf = pcb->errf;
+    void *arg = pcb->callback_arg;
+
+    release(pcb, true);
+
+    if (errf) {
+        errf(arg, ERR_ABRT);
+    }
+}
+
+extern "C" void tcp_arg(struct tcp_pcb *pcb, void *arg) {
+    pcb->callback_arg = arg;
+}
+
+extern "C" void tcp_accept(struct tcp_pcb *pcb, tcp_accept_fn accept) {
+    pcb->accept = accept;
+}
+
+extern "C" void tcp_recv(struct tcp_pcb *pcb, tcp_recv_fn recv) {
+    pcb->recv = recv;
+}
+
+extern "C" void tcp_sent(struct tcp_pcb *pcb, tcp_sent_fn sent) {
+    pcb->sent = sent;
+}
+
+extern "C" void tcp_poll(struct tcp_pcb *pcb, tcp_poll_fn poll, u8_t interval) {
+    pcb->poll = poll;
+    pcb->pollinterval = interval;
+}
+
+extern "C" void tcp_err(struct tcp_pcb *pcb, tcp_err_fn err) {
+    pcb->errf = err;
+}
+
+extern "C" err_t tcp_write(struct tcp_pcb *pcb, const void *dataptr, u16_t len, u8_t apiflags) {
+    if (len > pcb->snd_buf) {
+        return ERR_MEM;
+    }
+
+    peers[pcb - pool]->received += len;
+
+    return ERR_OK;
+}
+
+extern "C" err_t tcp_output(struct tcp_pcb *pcb) {
+    return ERR_OK;
+}
+
+extern "C" void tcp_recved(struct tcp_pcb *pcb, u16_t len) {}
+
+// The client's SYN; false when it was refused or found no free pcb
+static bool connect(Client &client) {
+    client = Client();
+
+    struct tcp_pcb *pcb = listening ? allocate() : nullptr;
+
+    if (!pcb) {
+        return false;
+    }
+
+    pcb->state = ESTABLISHED;
+    pcb->local_port = listener.local_port;
+    pcb->so_options = listener.so_options & SOF_INHERITED;
+    client.pcb = pcb;
+    peers[pcb - pool] = &client;
+
+    USBNetwork::receiveTimeUs = time_us_64();
+
+    if (listener.accept(listener.callback_arg, pcb, ERR_OK) == ERR_ABRT) {
+        check(client.pcb == nullptr, "an aborted accept frees its pcb");
+
+        return false;
+    }
+
+    return true;
+}
+
+static void send(Client &client, uint8_t byte) {
+    struct tcp_pcb *pcb = client.pcb;
+
+    if (!pcb || pcb->state != ESTABLISHED || !pcb->recv) {
+        return;
+    }
+
+    struct pbuf p = {nullptr, &byte, 1, 1};
+    uint32_t freed = pbufs_freed;
+
+    pcb->recv(pcb->callback_arg, pcb, &p, ERR_OK);
+    check(pbufs_freed == freed + 1, "every pbuf freed once");
+}
+
+// The client's FIN, or its answer to the device's
+static void finish(Client &client) {
+    struct tcp_pcb *pcb = client.pcb;
+
+    if (!pcb) {
+        return;
+    }
+
+    if (pcb->state == FIN_WAIT_1) {
+        // The device closed first, so its side waits out TIME_WAIT
+        pcb->state = TIME_WAIT;
+        pcb->tmr = now_ms;
+        pcb->next = tcp_tw_pcbs;
+        tcp_tw_pcbs = pcb;
+        peers[pcb - pool] = nullptr;
+        client.pcb = nullptr;
+
+        return;
+    }
+
+    pcb->state = CLOSE_WAIT;
+
+    if (pcb->recv) {
+        pcb->recv(pcb->callback_arg, pcb, nullptr, ERR_OK);
+    }
+}
+
+// A reset from the client, or keepalive giving up on it
+static void resetPeer(Client &client) {
+    struct tcp_pcb *pcb = client.pcb;
+
+    if (!pcb) {
+        return;
+    }
+
+    tcp_err_fn errf = pcb->errf;
+    void *arg = pcb->callback_arg;
+
+    release(pcb, true);
+
+    if (errf) {
+        errf(arg, ERR_RST);
+    }
+}
+
+// lwIP's slow timer, every 500 ms: poll callbacks and TIME_WAIT expiry
+static void advance(uint32_t ms) {
+    for (uint32_t end = now_ms + ms; now_ms < end;) {
+        now_ms += 500;
+
+        for (size_t i = 0; i < POOL_SIZE; i++) {
+            struct tcp_pcb *pcb = &pool[i];
+
+            if (!used[i]) {
+                continue;
+            }
+
+            if (pcb->state == TIME_WAIT) {
+                if (now_ms - pcb->tmr > 2 * PICONET_TCP_MSL_MS) {
+                    release(pcb, false);
+                }
+            } else if (pcb->poll && ++pcb->polltmr >= pcb->pollinterval) {
+                pcb->polltmr = 0;
+                pcb->poll(pcb->callback_arg, pcb);
+            }
+        }
+    }
+}
+
+static ConnectionManager *manager;
+static int accepted_id;
+static int closed_id;
+static uint32_t closes;
+
+static void reset(ConnectionManager &instance) {
+    manager = &instance;
+    accepted_id = -1;
+    closed_id = -1;
+    closes = 0;
+    recycled = 0;
+    instance.onAccept([](int id) { accepted_id = id; });
+    instance.onClose([](int id) { closed_id = id; closes++; });
+}
+
+// LoopbackBench's storm: the server ends each session as soon as the client's byte arrives
+static void testChurn(bool abortive, uint32_t connections) {
+    ConnectionManager server;
+
+    reset(server);
+    server.onReceive([](int id, struct pbuf *p) { manager->close(id); });
+    server.setAbortiveClose(abortive);
+    check(server.start(PORT) == ERR_OK, "manager starts");
+
+    uint32_t completed = 0;
+    size_t maxTimeWait = 0;
+    uint64_t start = time_us_64();
+
+    for (uint32_t i = 0; i < connections; i++) {
+        Client client;
+
+        if (!connect(client)) {
+            continue;
+        }
+
+        send(client, 'x');
+
+        // Gracefully the device's FIN is waiting and the client answers it; abortively it got a reset
+        bool fin = client.pcb && client.pcb->state == FIN_WAIT_1;
+
+        finish(client);
+
+        if (abortive ? client.reset : fin && !client.reset) {
+            completed++;
+        }
+
+        maxTimeWait = LWIP_MAX(maxTimeWait, ConnectionManager::getTimeWaitCount());
+    }
+
+    uint64_t us = time_us_64() - start;
+    const ConnectionManager::Stats &stats = server.getStats();
+
+    check(completed == connections, "every connection of the storm completes");
+    check(stats.accepted == connections && stats.localCloses == connections && closes == connections,
+          "every session accepted and closed by the device");
+    check(stats.refused == 0 && stats.evicted == 0 && stats.active == 0, "storm needs no eviction and leaves none open");
+    check(pcbsInUse() == ConnectionManager::getTimeWaitCount(), "only TIME_WAIT pcbs left behind");
+
+    if (abortive) {
+        check(maxTimeWait == 0, "abortive close leaves no TIME_WAIT");
+    } else {
+        check(maxTimeWait == POOL_SIZE && recycled > 0, "graceful close fills the pool with TIME_WAIT, recycled");
+    }
+
+    printf("  churn, %s close: %lu connections in %llu us, %.2f us each (host CPU), up to %lu in TIME_WAIT, "
+           "%lu recycled\n", abortive ? "abortive" : "graceful", (unsigned long)connections,
+           (unsigned long long)us, (double)us / connections, (unsigned long)maxTimeWait, (unsigned long)recycled);
+
+    server.stop();
+}
+
+static void testRestart() {
+    ConnectionManager server;
+
+    reset(server);
+    check(ConnectionManager::getTimeWaitCount() > 0, "graceful storm left TIME_WAIT on the port");
+
+    // The fake holds the port like lwIP, so the restart below is a real test of SO_REUSEADDR
+    struct tcp_pcb *plain = tcp_new();
+
+    check(tcp_bind(plain, IP_ADDR_ANY, PORT) == ERR_USE, "TIME_WAIT holds the port without SO_REUSEADDR");
+    tcp_close(plain);
+
+    check(server.start(PORT) == ERR_OK, "restart binds while TIME_WAIT holds the port");
+    check(server.start(PORT) == ERR_ISCONN, "second start refused");
+    server.stop();
+
+    advance(2 * PICONET_TCP_MSL_MS + 1000);
+    check(ConnectionManager::getTimeWaitCount() == 0 && pcbsInUse() == 0, "TIME_WAIT ends after 2 MSL");
+}
+
+static void testEviction() {
+    ConnectionManager server;
+    Client clients[PICONET_CONN_SLOTS];
+    Client late;
+
+    reset(server);
+    check(server.start(PORT) == ERR_OK, "manager starts");
+
+    for (Client &client : clients) {
+        check(connect(client), "client gets a slot");
+    }
+
+    check(!connect(late) && late.reset && server.getStats().refused == 1,
+          "full table with no session idle long enough refuses");
+
+    // All idle long enough, then all but the first hear from their clients
+    advance(PICONET_CONN_EVICT_IDLE_S * 1000);
+
+    for (size_t i = 1; i < PICONET_CONN_SLOTS; i++) {
+        send(clients[i], 'x');
+    }
+
+    check(connect(late) && server.getStats().evicted == 1, "full table evicts for a new client");
+    check(clients[0].reset && !clients[0].pcb && closed_id == accepted_id, "longest idle session evicted, slot reused");
+    check(server.getStats().active == PICONET_CONN_SLOTS, "table full again");
+
+    server.stop();
+
+    bool allReset = late.reset;
+
+    for (Client &client : clients) {
+        allReset = allReset && client.reset;
+    }
+
+    check(allReset && pcbsInUse() == 0 && server.getStats().active == 0, "stop aborts every session");
+}
+
+static void testSessions() {
+    ConnectionManager server;
+    Client a, b, c, d;
+
+    reset(server);
+    check(server.start(PORT) == ERR_OK, "manager starts");
+
+    check(connect(a), "client connects");
+    int idA = accepted_id;
+
+    check((a.pcb->so_options & SOF_KEEPALIVE) && a.pcb->keep_idle == PICONET_CONN_KEEPALIVE_S * 1000,
+          "sessions keep alive");
+    check(server.write(idA, "hi", 2) == ERR_OK && a.received == 2 && server.getAvailableSize(idA) > 0,
+          "write reaches the client");
+
+    check(connect(b), "second client connects");
+    int idB = accepted_id;
+
+    resetPeer(b);
+    check(!server.isOpen(idB) && closed_id == idB && server.getStats().resets == 1, "peer reset ends the session");
+
+    // The device answers a client's FIN with its own, so the client holds TIME_WAIT, not the device
+    check(connect(c), "third client connects");
+    finish(c);
+    check(!c.pcb && !c.reset && server.getStats().remoteCloses == 1 && ConnectionManager::getTimeWaitCount() == 0,
+          "client closing first leaves no TIME_WAIT here");
+
+    check(connect(d), "fourth client connects");
+    close_fails = true;
+    server.close(accepted_id);
+    close_fails = false;
+    check(d.reset && ConnectionManager::getTimeWaitCount() == 0, "a close lwIP cannot send falls back to abort");
+
+    // a has been quiet since its write
+    advance(PICONET_CONN_IDLE_TIMEOUT_S * 1000);
+    check(a.reset && !server.isOpen(idA) && server.getStats().idleAborts == 1, "idle session aborted");
+
+    server.onAccept([](int id) { manager->abort(id); });
+    check(!connect(a) && a.reset, "an accept callback may abort its session");
+    check(server.getStats().active == 0 && pcbsInUse() == 0, "nothing left open");
+
+    server.stop();
+}
+
+int main(int argc, char **argv) {
+    uint32_t connections = 100000;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--connections")) {
+            connections = (uint32_t)strtoul(argv[i + 1], nullptr, 0);
+        } else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    testChurn(true, connections);
+    testChurn(false, connections);
+    testRestart();
+    testEviction();
+    testSessions();
+
+    printf("connection manager: %s\n", failures ? "FAILED" : "ok");
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,147 @@
+// CopyEngine's dispatch: the threshold, the CPU fallback when the engine is
+// full, finish() waiting out background copies, and the other core copying
+// on the CPU without touching the engine. A deferred engine stands in for
+// the DMA one; it only completes its copies when polled through busy().
+
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+extern "C" {
+    #include "pico/sync.h"
+}
+
+#include "pico-usbnet/CopyEngine.h"
+
+static int failures;
+
+static void check(bool condition, const char *what) {
+    if (!condition) {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+class DeferredCopyEngine final : public CopyEngine {
+public:
+    static const size_t depth = 2;
+
+    uint32_t started = 0;
+
+    bool start(void *dst, const void *src, size_t length) override {
+        if (pending == depth) {
+            return false;
+        }
+
+        copies[pending++] = {dst, src, length};
+        started++;
+
+        return true;
+    }
+
+    // Lands one copy per poll
+    bool busy() override {
+        if (!pending) {
+            return false;
+        }
+
+        const Copy &copy = copies[--pending];
+        memcpy(copy.dst, copy.src, copy.length);
+
+        return true;
+    }
+
+private:
+    struct Copy {
+        void *dst;
+        const void *src;
+        size_t length;
+    };
+
+    Copy copies[depth];
+    size_t pending = 0;
+};
+
+static uint8_t source[1024];
+
+static void fill(uint8_t *buffer, size_t length, uint8_t seed) {
+    for (size_t i = 0; i < length; i++) {
+        buffer[i] = (uint8_t)(seed + i * 7);
+    }
+}
+
+static void testCpuEngine() {
+    CpuCopyEngine cpu;
+    uint8_t out[300] = {};
+
+    CopyEngine::install(&cpu, 64);
+
+    check(CopyEngine::copyAsync(out, source, sizeof(out)), "large copy goes to the engine");
+    check(!memcmp(out, source, sizeof(out)), "cpu engine copies at once");
+    check(!cpu.busy(), "cpu engine is never busy");
+
+    CopyEngine::install(nullptr);
+}
+
+static void testDeferredEngine() {
+    DeferredCopyEngine engine;
+    uint8_t out[4][256] = {};
+    uint8_t small[16] = {};
+
+    CopyEngine::install(&engine, 128);
+
+    check(!CopyEngine::copyAsync(small, source, sizeof(small)) && engine.started == 0,
+          "copy below the threshold stays on the CPU");
+    check(!memcmp(small, source, sizeof(small)), "short copy is complete on return");
+
+    check(CopyEngine::copyAsync(out[0], source, 256), "first copy offloaded");
+    check(CopyEngine::copyAsync(out[1], source + 256, 256), "second copy offloaded");
+    check(!CopyEngine::copyAsync(out[2], source + 512, 256) && engine.started == 2,
+          "full engine falls back to the CPU");
+    check(!memcmp(out[2], source + 512, 256), "fallback copy is complete on return");
+
+    CopyEngine::finish();
+    check(!memcmp(out[0], source, 256) && !memcmp(out[1], source + 256, 256), "finish waits for every copy");
+
+    CopyEngine::copy(out[3], source + 768, 256);
+    check(!memcmp(out[3], source + 768, 256) && !engine.busy(), "copy returns with the bytes in place");
+
+    // Replacing the engine lands what is still in flight on the old one
+    memset(out[0], 0, sizeof(out[0]));
+    check(CopyEngine::copyAsync(out[0], source + 512, 256), "copy before reinstalling");
+    CopyEngine::install(nullptr);
+    check(!memcmp(out[0], source + 512, 256), "install finishes the old engine");
+}
+
+static void testOtherCore() {
+    DeferredCopyEngine engine;
+    uint8_t out[512] = {};
+    bool offloaded = true;
+
+    CopyEngine::install(&engine, 64);
+
+    std::thread core1([&] {
+        host_set_core_num(1);
+        offloaded = CopyEngine::copyAsync(out, source, sizeof(out));
+        CopyEngine::finish();
+    });
+
+    core1.join();
+
+    check(!offloaded && engine.started == 0, "other core does not use the engine");
+    check(!memcmp(out, source, sizeof(out)), "other core copies on the CPU");
+
+    CopyEngine::install(nullptr);
+}
+
+int main() {
+    fill(source, sizeof(source), 3);
+
+    testCpuEngine();
+    testDeferredEngine();
+    testOtherCore();
+
+    printf("copy engine: %s\n", failures ? "FAILED" : "ok");
+
+    return failures ? 1 : 0;
+}
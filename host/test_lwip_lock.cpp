@@ -0,0 +1,60 @@
+// Two threads standing in for the two cores take LwipLock the way lwIP does,
+// nested, and check that their critical sections never overlap. Built once
+// with PICONET_LWIP_LOCK_STATS and once without; a lock that fails to hand
+// over between the cores hangs here, and ctest's timeout reports it.
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+extern "C" {
+    #include "pico/sync.h"
+}
+
+#include "pico-usbnet/LwipLock.h"
+
+static uint64_t counter;
+static std::atomic<int> inside;
+static std::atomic<uint32_t> overlaps;
+
+static void hammer(unsigned core, uint32_t rounds) {
+    host_set_core_num(core);
+
+    for (uint32_t i = 0; i < rounds; i++) {
+        sys_prot_t outer = LwipLock::protect();
+
+        if (inside.fetch_add(1) != 0) {
+            overlaps++;
+        }
+
+        sys_prot_t inner = LwipLock::protect();
+        counter++;
+        LwipLock::unprotect(inner);
+
+        inside.fetch_sub(1);
+        LwipLock::unprotect(outer);
+    }
+}
+
+int main(int argc, char **argv) {
+    uint32_t rounds = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 0) : 1000000;
+
+    std::thread core0(hammer, 0, rounds);
+    std::thread core1(hammer, 1, rounds);
+
+    core0.join();
+    core1.join();
+
+    LwipLock::Stats stats = LwipLock::getStats();
+    bool ok = counter == 2ull * rounds && overlaps == 0;
+
+#if PICONET_LWIP_LOCK_STATS
+    ok = ok && stats.acquisitions == 2 * rounds + 1;
+#endif
+
+    printf("%llu sections, %u overlapping, %u acquisitions, %u contended: %s\n", (unsigned long long)counter,
+           overlaps.load(), stats.acquisitions, stats.contentions, ok ? "ok" : "FAILED");
+
+    return ok ? 0 : 1;
+}
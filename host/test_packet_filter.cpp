@@ -0,0 +1,110 @@
+// PacketFilter on hand-built IPv4 frames: port rules, the FastPath handoff,
+// and fragmented datagrams, which FastPath must leave to lwIP whole.
+
+#include <cstdio>
+#include <cstring>
+
+#include "pico-usbnet/PacketFilter.h"
+
+#define FAST_PORT   5557
+
+static int failures;
+
+static void check(bool condition, const char *what) {
+    if (!condition) {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+static uint32_t handled;
+static uint16_t handledLength;
+
+static void fastHandler(const uint8_t *payload, uint16_t len, const ip_addr_t *addr, uint16_t port) {
+    handled++;
+    handledLength = len;
+}
+
+// Ethernet + IPv4 + UDP; `flags` is the MF bit and offset in 8-byte units, as in the header
+static uint16_t buildUdp(uint8_t *frame, uint16_t dstPort, uint16_t payload, uint16_t udpLength, uint16_t flags) {
+    memset(frame, 0, 14 + 20 + 8 + payload);
+
+    frame[12] = 0x08;
+    frame[13] = 0x00;
+
+    uint8_t *ip = frame + 14;
+    uint16_t total = (uint16_t)(20 + 8 + payload);
+
+    ip[0] = 0x45;
+    ip[2] = (uint8_t)(total >> 8);
+    ip[3] = (uint8_t)total;
+    ip[6] = (uint8_t)(flags >> 8);
+    ip[7] = (uint8_t)flags;
+    ip[8] = 64;
+    ip[9] = 17;
+    ip[12] = 192;
+    ip[13] = 168;
+    ip[14] = 7;
+    ip[15] = 16;
+
+    uint8_t *udp = ip + 20;
+
+    udp[0] = 0xc0;
+    udp[1] = 0x01;
+    udp[2] = (uint8_t)(dstPort >> 8);
+    udp[3] = (uint8_t)dstPort;
+    udp[4] = (uint8_t)(udpLength >> 8);
+    udp[5] = (uint8_t)udpLength;
+
+    return (uint16_t)(14 + total);
+}
+
+int main() {
+    PacketFilter filter;
+    uint8_t frame[1514];
+    uint16_t size;
+
+    int fast = filter.addFastPath(FAST_PORT, fastHandler);
+
+    check(fast >= 0, "add fast path");
+
+    // Unfragmented datagram: handled in full
+    size = buildUdp(frame, FAST_PORT, 100, 108, 0);
+    check(filter.process(frame, size) == FilterAction::FastPath && handled == 1 && handledLength == 100,
+          "whole datagram takes the fast path");
+
+    // First fragment (MF set, offset 0): the UDP header claims more than the frame carries
+    size = buildUdp(frame, FAST_PORT, 1000, 3008, 0x2000);
+    check(filter.process(frame, size) == FilterAction::Pass && handled == 1, "first fragment goes to lwIP");
+
+    // Later and last fragments have no UDP header at all
+    size = buildUdp(frame, FAST_PORT, 1000, 0, 0x2000 | 126);
+    check(filter.process(frame, size) == FilterAction::Pass && handled == 1, "middle fragment goes to lwIP");
+
+    size = buildUdp(frame, FAST_PORT, 500, 0, 252);
+    check(filter.process(frame, size) == FilterAction::Pass && handled == 1, "last fragment goes to lwIP");
+    check(filter.getHits(fast) == 1, "fragments do not count as fast path hits");
+
+    // Drop rules still see the port of a first fragment
+    PacketFilter drops;
+    int mdns = -1;
+
+    for (int i = 0; i < drops.getRuleCount(); i++) {
+        if (drops.getRule(i).dstPort == 5353) {
+            mdns = i;
+        }
+    }
+
+    size = buildUdp(frame, 5353, 1000, 3008, 0x2000);
+    check(mdns >= 0 && drops.process(frame, size) == FilterAction::Drop, "first fragment matches a port drop rule");
+
+    size = buildUdp(frame, 5353, 100, 108, 0);
+    check(drops.process(frame, size) == FilterAction::Drop, "port drop rule");
+
+    size = buildUdp(frame, 9999, 100, 108, 0);
+    check(drops.process(frame, size) == FilterAction::Pass, "other ports pass");
+
+    printf("packet filter: %s\n", failures ? "FAILED" : "ok");
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,146 @@
+// Scheduler's deadline heap driven with synthetic times: run order, phase
+// keeping and catch-up of periodic tasks, and tasks that cancel themselves
+// and schedule a new one from their own callback, which takes over their slot.
+
+#include <cstdio>
+
+#include "pico-usbnet/Scheduler.h"
+
+static int failures;
+
+static void check(bool condition, const char *what) {
+    if (!condition) {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+static Scheduler *scheduler;
+static uint64_t ran[64];
+static size_t ranCount;
+
+static void record(uint64_t deadlineUs) {
+    if (ranCount < 64) {
+        ran[ranCount] = deadlineUs;
+    }
+
+    ranCount++;
+}
+
+static void reset(Scheduler &instance) {
+    scheduler = &instance;
+    ranCount = 0;
+}
+
+// Runs everything left and checks the heap hands deadlines out in order, each once
+static bool drainsInOrder(Scheduler &instance, uint64_t untilUs) {
+    uint64_t last = 0;
+
+    while (instance.nextDeadlineUs() <= untilUs) {
+        uint64_t next = instance.nextDeadlineUs();
+
+        if (next < last) {
+            return false;
+        }
+
+        last = next;
+        instance.runDue(next);
+    }
+
+    return true;
+}
+
+static void testOrder() {
+    Scheduler instance;
+    const uint64_t deadlines[] = {500, 100, 400, 200, 300};
+
+    reset(instance);
+
+    for (uint64_t deadline : deadlines) {
+        check(instance.scheduleAt(record, deadline) >= 0, "schedule one-shot");
+    }
+
+    check(instance.nextDeadlineUs() == 100, "earliest deadline first");
+    check(instance.runDue(250) == 2 && ran[0] == 100 && ran[1] == 200, "due tasks run in order");
+    check(instance.runDue(1000) == 3 && ran[4] == 500, "rest run in order");
+    check(instance.nextDeadlineUs() == UINT64_MAX, "one-shots lapse");
+
+    for (int i = 0; i < PICONET_SCHED_TASKS; i++) {
+        check(instance.scheduleAt(record, 2000 + i) >= 0, "lapsed slots are free again");
+    }
+
+    check(instance.scheduleAt(record, 3000) < 0, "full scheduler refuses");
+}
+
+static void testPeriodic() {
+    Scheduler instance;
+
+    reset(instance);
+
+    int id = instance.schedulePeriodic(record, 100, 1000);
+
+    check(instance.runDue(1000) == 1 && ran[0] == 1000, "first run at the first deadline");
+    check(instance.nextDeadlineUs() == 1100, "next deadline keeps the phase");
+
+    // Ten periods late: PICONET_SCHED_CATCH_UP runs with their own deadlines, the rest skipped
+    size_t runs = instance.runDue(2050);
+
+    check(runs == PICONET_SCHED_CATCH_UP && ran[1] == 1100 && ran[runs] == 1000 + 100 * runs, "catch-up runs");
+    check(instance.getStats(id).missed == 10 - PICONET_SCHED_CATCH_UP, "periods beyond catch-up are missed");
+    check(instance.nextDeadlineUs() == 2100, "phase kept after skipping");
+
+    instance.cancel(id);
+    check(instance.nextDeadlineUs() == UINT64_MAX, "cancel removes the task");
+}
+
+// Cancels itself and schedules a replacement, which gets the same slot
+static int selfId;
+static bool replacementPeriodic;
+static uint32_t replacementRuns;
+
+static void replacement(uint64_t deadlineUs) {
+    replacementRuns++;
+}
+
+static void replaceSelf(uint64_t deadlineUs) {
+    record(deadlineUs);
+    scheduler->cancel(selfId);
+
+    int id = replacementPeriodic ? scheduler->schedulePeriodic(replacement, 1000, deadlineUs + 50)
+                                 : scheduler->scheduleAt(replacement, deadlineUs + 50);
+
+    check(id == selfId, "replacement reuses the slot");
+}
+
+static void testSelfReplace(bool periodic) {
+    Scheduler instance;
+
+    reset(instance);
+    replacementPeriodic = periodic;
+    replacementRuns = 0;
+
+    // Other tasks around it, so a slot queued twice would disturb the heap
+    instance.scheduleAt(record, 5000);
+    selfId = instance.schedulePeriodic(replaceSelf, 100, 1000);
+    instance.schedulePeriodic(record, 300, 1200);
+
+    // Runs the first pass only: the replacement must not inherit the old task's catch-up
+    check(instance.runDue(1000) == 1 && ranCount == 1, "self-replacing task runs once");
+    check(instance.nextDeadlineUs() == 1050, "replacement queued once, at its own deadline");
+
+    check(drainsInOrder(instance, periodic ? 3100 : 10000), "heap intact after slot reuse");
+    check(replacementRuns == (periodic ? 3u : 1u), "replacement runs on its own schedule");
+
+    instance.cancel(selfId);
+}
+
+int main() {
+    testOrder();
+    testPeriodic();
+    testSelfReplace(false);
+    testSelfReplace(true);
+
+    printf("scheduler: %s\n", failures ? "FAILED" : "ok");
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,94 @@
+// StaticVector, RingQueue and ObjectPool at and past their capacity: every
+// refusal has to be reported, never turned into a silent truncation.
+
+#include <cstdio>
+
+#include "pico-usbnet/StaticContainers.h"
+
+static int failures;
+
+static void check(bool condition, const char *what) {
+    if (!condition) {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+static void testVector() {
+    StaticVector<int, 4> vector;
+    const int values[] = {1, 2, 3, 4, 5};
+
+    check(vector.assign(values, 4) && vector.size() == 4 && vector[3] == 4, "assign to capacity");
+    check(!vector.assign(values, 5), "assign past capacity fails");
+    check(vector.size() == 4 && vector[0] == 1, "failed assign leaves the vector unchanged");
+    check(!vector.push_back(6), "push_back on a full vector fails");
+
+    vector.clear();
+    check(vector.assign(values, 0) && vector.empty(), "assign nothing");
+    check(!vector.assign(nullptr, 2), "assign from null fails");
+    check(vector.push_back(7) && vector.size() == 1 && vector[0] == 7, "push_back after clear");
+}
+
+static void testQueue() {
+    RingQueue<int, 3> queue;
+    int value = 0;
+
+    for (int round = 0; round < 5; round++) {
+        check(queue.push(round) && queue.push(round + 1) && queue.push(round + 2), "fill queue");
+        check(!queue.push(99) && queue.full(), "push on a full queue fails");
+        check(queue.pop(value) && value == round, "pop in order");
+        check(queue.push(round + 3), "push after pop wraps");
+
+        for (int i = 1; i <= 3; i++) {
+            check(queue.pop(value) && value == round + i, "drain in order");
+        }
+
+        check(!queue.pop(value) && queue.empty(), "pop on an empty queue fails");
+    }
+}
+
+struct Counted {
+    static int alive;
+    int id;
+
+    explicit Counted(int id) : id(id) { alive++; }
+    ~Counted() { alive--; }
+};
+
+int Counted::alive = 0;
+
+static void testPool() {
+    ObjectPool<Counted, 3> pool;
+    Counted *objects[3];
+
+    for (int i = 0; i < 3; i++) {
+        objects[i] = pool.acquire(i);
+        check(objects[i] && objects[i]->id == i && pool.owns(objects[i]), "acquire");
+    }
+
+    check(!pool.acquire(3) && pool.available() == 0, "acquire on an empty pool fails");
+
+    pool.release(objects[1]);
+    check(Counted::alive == 2 && pool.available() == 1, "release destroys the object");
+
+    Counted *again = pool.acquire(4);
+    check(again == objects[1] && again->id == 4, "released slot is reused");
+
+    Counted outside(5);
+    check(!pool.owns(&outside), "foreign object is not owned");
+
+    pool.release(objects[0]);
+    pool.release(objects[2]);
+    pool.release(again);
+    check(Counted::alive == 1 && pool.used() == 0, "all released");
+}
+
+int main() {
+    testVector();
+    testQueue();
+    testPool();
+
+    printf("static containers: %s\n", failures ? "FAILED" : "ok");
+
+    return failures ? 1 : 0;
+}
@@ -32,6 +32,8 @@
 #ifndef __LWIPOPTS_H__
 #define __LWIPOPTS_H__
 
+#include "pico-usbnet/config.h"
+
 /* Prevent having to link sys_arch.c (we don't test the API layers in unit tests) */
 #define ETH_PAD_SIZE                    0
 
@@ -45,7 +47,7 @@
 #define LWIP_MULTICAST_PING             1
 #define LWIP_NETCONN                    0
 #define LWIP_RAW                        0
-#define LWIP_SINGLE_NETIF               1
+#define LWIP_SINGLE_NETIF               (PICONET_NETIFS == 1)
 #define LWIP_SOCKET                     0
 #define LWIP_TCP                        1
 #define LWIP_TCP_KEEPALIVE              1
@@ -54,9 +56,47 @@
 #define MEM_ALIGNMENT                   4
 #define NO_SYS                          1
 
-#define TCP_MSS                         (1500 /*mtu*/ - 20 /*iphdr*/ - 20 /*tcphhr*/)
-#define TCP_SND_BUF                     (2 * TCP_MSS)
+#define TCP_MSS                         (PICONET_MTU - 20 /*iphdr*/ - 20 /*tcphhr*/)
+
+/* Pool buffers stay standard frame sized; jumbo frames are received as pbuf chains */
+#define PBUF_POOL_BUFSIZE               ((1500 /*mtu*/ + 14 /*ethhdr*/ + MEM_ALIGNMENT - 1) & ~(MEM_ALIGNMENT - 1))
+
+/* TCP windows, heap and pools are derived from the RAM budget of the selected profile */
+#include "lwipopts_profile.h"
 
 #define ETHARP_SUPPORT_STATIC_ENTRIES   1
 
+/* Listeners rebind while old connections are in TIME_WAIT, which is kept short */
+#define SO_REUSE                        1
+#define TCP_MSL                         PICONET_TCP_MSL_MS
+
+/* Packets to the device's own address are queued and fed back by USBNetwork::work() */
+#define LWIP_NETIF_LOOPBACK             PICONET_LOOPBACK
+#define LWIP_LOOPBACK_MAX_PBUFS         PICONET_LOOPBACK_MAX_PBUFS
+/* Local interfaces (PICONET_NETIFS) take the place of lwIP's 127.0.0.1 netif */
+#define LWIP_HAVE_LOOPIF                0
+
+#if PICONET_NETIFS > 1
+/* lwIP's per-netif counters, which the local interfaces report as their stats */
+#define LWIP_STATS                      1
+#define MIB2_STATS                      1
+#endif
+
+/* One timer beyond lwIP's own, for TimeSync's exchanges */
+#define MEMP_NUM_SYS_TIMEOUT            (LWIP_NUM_SYS_TIMEOUT_INTERNAL + 1)
+
+#if PICONET_POOL_CALIBRATION
+#define LWIP_STATS                      1
+#define MEM_STATS                       1
+#define MEMP_STATS                      1
+#endif
+
+/* Word-wide checksum engine (src/checksum.c); TCP and UDP payloads are summed while copied */
+#include "pico-usbnet/checksum.h"
+
+#define LWIP_CHECKSUM_CTRL_PER_NETIF    1
+#define LWIP_CHECKSUM_ON_COPY           1
+#define LWIP_CHKSUM                     usbnet_chksum
+#define LWIP_CHKSUM_COPY(dst, src, len) usbnet_chksum_copy(dst, src, len)
+
 #endif /* __LWIPOPTS_H__ */
@@ -0,0 +1,166 @@
+#ifndef __LWIPOPTS_PROFILE_H__
+#define __LWIPOPTS_PROFILE_H__
+
+/*
+ * RAM budget planner for lwIP, included from lwipopts.h.
+ *
+ * The profile picks a default budget and how large windows may grow; the TCP
+ * buffers, the heap and the pools are then derived from the budget and
+ * PICONET_TCP_CONNECTIONS, and the pcb pools from every TCP and UDP user the
+ * library configures. Any derived value can still be overridden, but the build
+ * fails if the resulting set does not fit together or exceeds the budget.
+ *
+ * Element costs are approximations of the lwIP structures on a 32-bit target.
+ */
+
+#if PICONET_LWIP_PROFILE == PICONET_PROFILE_LOW_RAM
+#define PICONET_PLAN_DEFAULT_BUDGET     (16 * 1024)
+#define PICONET_PLAN_MAX_SEGMENTS       2
+#define LWIP_WND_SCALE                  0
+#elif PICONET_LWIP_PROFILE == PICONET_PROFILE_BALANCED
+#define PICONET_PLAN_DEFAULT_BUDGET     (48 * 1024)
+#define PICONET_PLAN_MAX_SEGMENTS       8
+#define LWIP_WND_SCALE                  0
+#elif PICONET_LWIP_PROFILE == PICONET_PROFILE_MAX_THROUGHPUT
+#define PICONET_PLAN_DEFAULT_BUDGET     (160 * 1024)
+#define PICONET_PLAN_MAX_SEGMENTS       64
+#define LWIP_WND_SCALE                  1
+#else
+#error "Unknown PICONET_LWIP_PROFILE"
+#endif
+
+#ifndef PICONET_LWIP_RAM_BUDGET
+#define PICONET_LWIP_RAM_BUDGET         PICONET_PLAN_DEFAULT_BUDGET
+#endif
+
+#if PICONET_TCP_CONNECTIONS < 1
+#error "PICONET_TCP_CONNECTIONS must be at least 1"
+#endif
+
+/* Element costs: pool buffer with its pbuf header, tcp_seg, tcp_pcb, udp_pcb */
+#define PICONET_PLAN_POOL_ELEM          (PBUF_POOL_BUFSIZE + 16)
+#define PICONET_PLAN_SEG_ELEM           24
+#define PICONET_PLAN_PCB_ELEM           160
+#define PICONET_PLAN_UDP_PCB_ELEM       32
+/* Heap kept back for ARP queueing, ICMP replies and DHCP/DNS responses */
+#define PICONET_PLAN_HEAP_RESERVE       1600
+/* Pool buffers kept back for frames that are not TCP payload */
+#define PICONET_PLAN_POOL_RESERVE       4
+
+/* Pool buffers one full-sized frame occupies */
+#define PICONET_PLAN_FRAME_BUFS         ((PICONET_MTU + 14 + PBUF_POOL_BUFSIZE - 1) / PBUF_POOL_BUFSIZE)
+
+/* Cost of one receive segment (pool buffers plus an ooseq tcp_seg) and of one
+ * send segment (heap copy, pbuf header and the queued tcp_segs) */
+#define PICONET_PLAN_RX_SEG_COST        (PICONET_PLAN_FRAME_BUFS * PICONET_PLAN_POOL_ELEM + PICONET_PLAN_SEG_ELEM)
+#define PICONET_PLAN_TX_SEG_COST        (TCP_MSS + 16 + 4 * PICONET_PLAN_SEG_ELEM)
+
+/* Connected pcbs of every TCP consumer the library configures, whether or not
+ * it shares the window budget: application connections, HTTP and WebSocket
+ * clients, ConnectionManager sessions, and pcbs lingering in TIME_WAIT.
+ * Never fewer than lwIP's own default of 5. */
+#define PICONET_PLAN_TIME_WAIT_PCBS     2
+#define PICONET_PLAN_TCP_PCBS           (PICONET_TCP_CONNECTIONS + PICONET_HTTP_CONNECTIONS + PICONET_WS_CLIENTS + \
+                                         PICONET_CONN_SLOTS + PICONET_PLAN_TIME_WAIT_PCBS)
+
+#ifndef MEMP_NUM_TCP_PCB
+#define MEMP_NUM_TCP_PCB                (PICONET_PLAN_TCP_PCBS > 5 ? PICONET_PLAN_TCP_PCBS : 5)
+#endif
+
+/* DHCP, DNS, RPCServer and TimeSync, plus the application's own sockets */
+#ifndef MEMP_NUM_UDP_PCB
+#define MEMP_NUM_UDP_PCB                (4 + PICONET_UDP_SOCKETS)
+#endif
+
+#define PICONET_PLAN_FIXED              (MEMP_NUM_TCP_PCB * PICONET_PLAN_PCB_ELEM + \
+                                         MEMP_NUM_UDP_PCB * PICONET_PLAN_UDP_PCB_ELEM + PICONET_PLAN_HEAP_RESERVE + \
+                                         PICONET_PLAN_POOL_RESERVE * PICONET_PLAN_POOL_ELEM)
+
+#if PICONET_LWIP_RAM_BUDGET <= PICONET_PLAN_FIXED
+#error "PICONET_LWIP_RAM_BUDGET does not even cover the fixed lwIP allocations"
+#endif
+
+/* Half of each connection's share receives, half sends */
+#define PICONET_PLAN_SHARE              ((PICONET_LWIP_RAM_BUDGET - PICONET_PLAN_FIXED) / PICONET_TCP_CONNECTIONS / 2)
+#define PICONET_PLAN_CAP(n)             ((n) < PICONET_PLAN_MAX_SEGMENTS ? (n) : PICONET_PLAN_MAX_SEGMENTS)
+#define PICONET_PLAN_RX_SEGS            PICONET_PLAN_CAP(PICONET_PLAN_SHARE / PICONET_PLAN_RX_SEG_COST)
+#define PICONET_PLAN_TX_SEGS            PICONET_PLAN_CAP(PICONET_PLAN_SHARE / PICONET_PLAN_TX_SEG_COST)
+
+#ifndef TCP_WND
+#define TCP_WND                         (PICONET_PLAN_RX_SEGS * TCP_MSS)
+#endif
+
+#ifndef TCP_SND_BUF
+#define TCP_SND_BUF                     (PICONET_PLAN_TX_SEGS * TCP_MSS)
+#endif
+
+#ifndef TCP_SND_QUEUELEN
+#define TCP_SND_QUEUELEN                ((4 * (TCP_SND_BUF) + (TCP_MSS - 1)) / (TCP_MSS))
+#endif
+
+#ifndef MEMP_NUM_TCP_SEG
+#define MEMP_NUM_TCP_SEG                (PICONET_TCP_CONNECTIONS * (TCP_SND_QUEUELEN + (TCP_WND + TCP_MSS - 1) / TCP_MSS))
+#endif
+
+#ifndef MEM_SIZE
+#define MEM_SIZE                        (PICONET_TCP_CONNECTIONS * TCP_SND_BUF * (TCP_MSS + 16) / TCP_MSS + PICONET_PLAN_HEAP_RESERVE)
+#endif
+
+#ifndef PBUF_POOL_SIZE
+#define PBUF_POOL_SIZE                  (PICONET_TCP_CONNECTIONS * ((TCP_WND + TCP_MSS - 1) / TCP_MSS) * PICONET_PLAN_FRAME_BUFS + \
+                                         PICONET_PLAN_POOL_RESERVE)
+#endif
+
+/* The receive window is advertised scaled down by 2^TCP_RCV_SCALE */
+#if LWIP_WND_SCALE
+#if TCP_WND <= 0xffff
+#define TCP_RCV_SCALE                   0
+#elif (TCP_WND >> 1) <= 0xffff
+#define TCP_RCV_SCALE                   1
+#elif (TCP_WND >> 2) <= 0xffff
+#define TCP_RCV_SCALE                   2
+#elif (TCP_WND >> 3) <= 0xffff
+#define TCP_RCV_SCALE                   3
+#else
+#define TCP_RCV_SCALE                   4
+#endif
+#endif
+
+/* Consistency checks */
+#if TCP_WND < 2 * TCP_MSS || TCP_SND_BUF < 2 * TCP_MSS
+#error "lwIP RAM budget is too small for two segments per direction; raise PICONET_LWIP_RAM_BUDGET or lower PICONET_TCP_CONNECTIONS"
+#endif
+
+#if !LWIP_WND_SCALE && TCP_WND > 0xffff
+#error "TCP_WND above 64 KiB needs the max-throughput profile (LWIP_WND_SCALE)"
+#endif
+
+#if PBUF_POOL_SIZE < PICONET_TCP_CONNECTIONS * ((TCP_WND + TCP_MSS - 1) / TCP_MSS) * PICONET_PLAN_FRAME_BUFS
+#error "PBUF_POOL_SIZE cannot hold the receive window of every connection"
+#endif
+
+#if MEM_SIZE < PICONET_TCP_CONNECTIONS * TCP_SND_BUF
+#error "MEM_SIZE cannot hold the send buffer of every connection"
+#endif
+
+#if MEMP_NUM_TCP_SEG < TCP_SND_QUEUELEN
+#error "MEMP_NUM_TCP_SEG must be at least TCP_SND_QUEUELEN"
+#endif
+
+#if MEMP_NUM_TCP_PCB < PICONET_TCP_CONNECTIONS + PICONET_WS_CLIENTS
+#error "MEMP_NUM_TCP_PCB leaves no pcb for some of the connections and WebSocket clients configured"
+#endif
+
+#if MEMP_NUM_UDP_PCB < 4
+#error "MEMP_NUM_UDP_PCB must cover DHCP, DNS, RPCServer and TimeSync"
+#endif
+
+#define PICONET_PLAN_TOTAL              (MEM_SIZE + PBUF_POOL_SIZE * PICONET_PLAN_POOL_ELEM + \
+                                         MEMP_NUM_TCP_SEG * PICONET_PLAN_SEG_ELEM + MEMP_NUM_TCP_PCB * PICONET_PLAN_PCB_ELEM + \
+                                         MEMP_NUM_UDP_PCB * PICONET_PLAN_UDP_PCB_ELEM)
+
+#if PICONET_PLAN_TOTAL > PICONET_LWIP_RAM_BUDGET
+#error "lwIP heap and pools exceed PICONET_LWIP_RAM_BUDGET"
+#endif
+
+#endif /* __LWIPOPTS_PROFILE_H__ */
@@ -0,0 +1,114 @@
+#ifndef PICONET_ASYNC_H
+#define PICONET_ASYNC_H
+
+#include "pico-usbnet/config.h"
+
+#if PICONET_COROUTINES
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "pico-usbnet/Executor.h"
+#include "pico-usbnet/StaticContainers.h"
+
+extern "C" {
+    #include "lwip/tcp.h"
+}
+
+// Coroutine API over the raw lwIP callbacks. Everything runs on the single
+// executor that USBNetwork::work() polls, so no locking is involved, and
+// coroutine frames come from a fixed pool instead of the heap.
+//
+//   Task serve(AsyncServer &server) {
+//       AsyncConnection *conn = co_await server.accept();
+//       uint8_t buf[64];
+//       int n = co_await conn->read(buf, sizeof(buf));
+//       co_await conn->write(std::span<const uint8_t>(buf, n));
+//       conn->close();
+//   }
+
+class AsyncConnection {
+public:
+    struct ReadAwaiter {
+        AsyncConnection *connection;
+        uint8_t *buffer;
+        uint16_t size;
+
+        bool await_ready() const noexcept;
+        void await_suspend(std::coroutine_handle<> handle) noexcept;
+        // Bytes read, 0 once the peer closed, or a negative err_t
+        int await_resume() noexcept;
+    };
+
+    struct WriteAwaiter {
+        AsyncConnection *connection;
+
+        bool await_ready() noexcept;
+        void await_suspend(std::coroutine_handle<> handle) noexcept;
+        // ERR_OK once everything is queued to lwIP
+        err_t await_resume() noexcept;
+    };
+
+    explicit AsyncConnection(struct tcp_pcb *pcb);
+
+    ReadAwaiter read(void *buffer, uint16_t size);
+    WriteAwaiter write(std::span<const uint8_t> data);
+
+    // Closes the connection and returns this object to the connection pool
+    void close();
+
+    bool isOpen() const { return pcb != nullptr && !remoteClosed; }
+
+private:
+    friend class AsyncServer;
+
+    struct tcp_pcb *pcb;
+    struct pbuf *received;
+    bool remoteClosed;
+    err_t error;
+
+    std::coroutine_handle<> reader;
+    std::coroutine_handle<> writer;
+
+    const uint8_t *pendingData;
+    size_t pendingLength;
+
+    void flush();
+    void wake(std::coroutine_handle<> &handle);
+    void detach();
+
+    static err_t receiveWrapper(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err);
+    static err_t sentWrapper(void *arg, struct tcp_pcb *tpcb, u16_t len);
+    static void errorWrapper(void *arg, err_t err);
+};
+
+class AsyncServer {
+public:
+    struct AcceptAwaiter {
+        AsyncServer *server;
+
+        bool await_ready() const noexcept;
+        void await_suspend(std::coroutine_handle<> handle) noexcept;
+        // nullptr if the server is not listening
+        AsyncConnection *await_resume() noexcept;
+    };
+
+    AsyncServer();
+    ~AsyncServer();
+
+    err_t listen(const ip_addr_t *ipaddr, uint16_t port);
+    AcceptAwaiter accept();
+    void close();
+
+private:
+    struct tcp_pcb *pcb;
+    RingQueue<AsyncConnection *, PICONET_CORO_BACKLOG> accepted;
+    std::coroutine_handle<> acceptor;
+
+    static err_t acceptWrapper(void *arg, struct tcp_pcb *newpcb, err_t err);
+};
+
+#endif // PICONET_COROUTINES
+
+#endif // PICONET_ASYNC_H
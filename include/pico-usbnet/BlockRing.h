@@ -0,0 +1,88 @@
+#ifndef PICONET_BLOCK_RING_H
+#define PICONET_BLOCK_RING_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "pico-usbnet/config.h"
+
+// Block as it goes on the wire, little-endian: this header, then `length`
+// payload bytes. Consecutive blocks follow each other without padding.
+#define PICONET_BLOCK_MAGIC             0x4B4C4250u    // "PBLK"
+#define PICONET_BLOCK_FLAG_HOST_TIME    0x01           // timestamp is host time (TimeSync), not device time
+
+struct BlockHeader {
+    uint32_t magic;
+    uint32_t sequence;
+    uint32_t length;
+    uint32_t flags;
+    int64_t timestampUs;        // time of the first sample
+};
+
+static_assert(sizeof(BlockHeader) == 24, "BlockHeader is a wire format");
+
+class TimeSync;
+
+// Fixed ring of sample blocks shared by several consumers (VendorStream,
+// a TCP socket, ...). Each consumer reads every block at its own pace,
+// possibly a few bytes at a time; a slot is reused once all of them are done.
+//
+// The producer never waits. A consumer that is more than a quarter of the ring
+// behind when it finishes a block skips to the newest one, and one that has
+// not started on a slot the producer needs loses it; both count as overruns.
+// Only if a consumer is part way through that slot are the new samples
+// dropped instead, so no consumer ever sends a torn block.
+class BlockRing {
+public:
+    static constexpr size_t blockSize = sizeof(BlockHeader) + PICONET_BLOCK_RING_SIZE;
+
+    struct Stats {
+        uint32_t blocks;        // sealed
+        uint32_t dropped;       // payload bytes refused
+        uint32_t overruns[PICONET_BLOCK_RING_CONSUMERS];
+    };
+
+    BlockRing();
+
+    // Consumer id, or -1 when all are taken; reading starts with the next sealed block
+    int attach();
+    void detach(int consumer);
+
+    // Blocks are stamped in host time while the clock is synced, device time otherwise
+    void setTimeSync(const TimeSync *timeSync);
+
+    // A new block takes the time of the data that opens it (time_us_64())
+    void append(const void *data, size_t length, uint64_t deviceTimeUs);
+    // Send the block being filled as it is, e.g. before going idle
+    void seal();
+
+    // Unsent bytes of the consumer's current block, or nullptr if it has caught up
+    const uint8_t *peek(int consumer, size_t &length) const;
+    void consume(int consumer, size_t length);
+
+    const Stats &getStats() const { return stats; }
+    void resetStats();
+
+private:
+    struct Slot {
+        alignas(4) uint8_t data[blockSize];
+        uint8_t readers;        // consumers still to finish it
+    };
+
+    Slot slots[PICONET_BLOCK_RING_BLOCKS];
+    size_t head;                // slot being filled
+    size_t fill;
+    bool open;
+    uint32_t sequence;
+    uint8_t attached;
+    const TimeSync *clock;
+    size_t tail[PICONET_BLOCK_RING_CONSUMERS];
+    size_t offset[PICONET_BLOCK_RING_CONSUMERS];
+    Stats stats;
+
+    bool startBlock(uint64_t deviceTimeUs);
+    BlockHeader *header(size_t slot) { return reinterpret_cast<BlockHeader *>(slots[slot].data); }
+    const BlockHeader *header(size_t slot) const { return reinterpret_cast<const BlockHeader *>(slots[slot].data); }
+};
+
+#endif // PICONET_BLOCK_RING_H
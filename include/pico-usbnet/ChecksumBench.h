@@ -0,0 +1,26 @@
+#ifndef PICONET_CHECKSUM_BENCH_H
+#define PICONET_CHECKSUM_BENCH_H
+
+#include <cstdint>
+
+// Times the checksum engine (checksum.h) against a byte-pair reference sum
+// and plain memcpy() on frame-sized buffers, cycling through the four word
+// alignments lwIP hands it, and checks every result against the reference.
+// Builds for the device and for the host (host/bench_checksum.cpp); print()
+// turns times into cycles per byte with the CPU clock the caller passes.
+class ChecksumBench {
+public:
+    struct Result {
+        bool ok;
+        uint64_t bytes;         // per function
+        uint32_t referenceUs;
+        uint32_t sumUs;         // usbnet_chksum()
+        uint32_t copyUs;        // usbnet_chksum_copy()
+        uint32_t memcpyUs;
+    };
+
+    static bool run(Result &result, uint16_t length = 1514, uint32_t rounds = 2000);
+    static void print(const Result &result, uint32_t cpuHz);
+};
+
+#endif // PICONET_CHECKSUM_BENCH_H
@@ -0,0 +1,52 @@
+#ifndef PICONET_CLOCK_ESTIMATOR_H
+#define PICONET_CLOCK_ESTIMATOR_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "pico-usbnet/config.h"
+
+// Host clock against device time (time_us_64()), from NTP-style exchanges:
+// t1 device send, t2 host receive, t3 host send, t4 device receive. Each
+// window of PICONET_TIMESYNC_WINDOW exchanges is reduced to its minimum-delay
+// sample, the one least disturbed by queueing; offset and drift are a
+// least-squares line through the latest PICONET_TIMESYNC_POINTS of those.
+//
+// No I/O of its own: TimeSync runs the exchanges over lwIP and feeds them in.
+class ClockEstimator {
+public:
+    ClockEstimator();
+
+    // True when the exchange closed a window and the line was refitted.
+    // delayUs is the exchange's round trip without host processing.
+    bool addExchange(uint64_t t1, int64_t t2, int64_t t3, uint64_t t4, uint32_t &delayUs);
+
+    bool isSynced() const { return pointCount > 0; }
+    // Points the line goes through; the drift is 0 until there are two
+    size_t getPointCount() const { return pointCount; }
+    int64_t toHostTimeUs(uint64_t deviceUs) const;
+    int32_t getDriftPpb() const;
+
+private:
+    struct Point {
+        uint64_t deviceUs;
+        int64_t offsetUs;       // host minus device
+        uint32_t delayUs;
+    };
+
+    Point best;                 // minimum-delay sample of the current window
+    uint16_t windowCount;
+    Point points[PICONET_TIMESYNC_POINTS];
+    size_t pointCount;
+    size_t nextPoint;
+
+    // Model: offset = refOffsetUs + drift * (device time - refUs)
+    uint64_t refUs;
+    int64_t refOffsetUs;
+    double drift;
+
+    void addPoint(const Point &point);
+    void fit();
+};
+
+#endif // PICONET_CLOCK_ESTIMATOR_H
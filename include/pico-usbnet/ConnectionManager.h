@@ -0,0 +1,107 @@
+#ifndef PICONET_CONNECTION_MANAGER_H
+#define PICONET_CONNECTION_MANAGER_H
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+    #include "lwip/tcp.h"
+}
+
+#include "pico-usbnet/config.h"
+
+// TCP server for clients that reconnect often. Session state lives in a
+// fixed table of PICONET_CONN_SLOTS; the pcbs come from lwIP's static pool.
+//
+// Keeping that pool free is the point:
+//  - the listener is bound with SO_REUSEADDR, so a restart never waits out
+//    TIME_WAIT on its port
+//  - when the device closes first it can abort instead (setAbortiveClose()),
+//    which leaves no TIME_WAIT pcb behind; otherwise TIME_WAIT lasts
+//    2 * PICONET_TCP_MSL_MS and lwIP reuses the oldest when the pool runs dry
+//  - sessions idle for PICONET_CONN_IDLE_TIMEOUT_S are aborted, and keepalive
+//    finds peers that went away without a FIN
+//  - a client arriving while every slot is taken evicts the session idle the
+//    longest, if that is at least PICONET_CONN_EVICT_IDLE_S; only if none
+//    qualifies is it refused
+//
+// Sessions are identified by their slot index.
+class ConnectionManager {
+public:
+    typedef void (*AcceptCallback)(int id);
+    // The pbuf is freed when the callback returns
+    typedef void (*ReceiveCallback)(int id, struct pbuf *p);
+    // Every session ends here, whoever closed it
+    typedef void (*CloseCallback)(int id);
+
+    struct Stats {
+        uint32_t accepted;
+        uint32_t refused;       // all slots busy, none idle long enough to evict
+        uint32_t evicted;
+        uint32_t idleAborts;
+        uint32_t remoteCloses;
+        uint32_t localCloses;
+        uint32_t resets;        // peer reset or lwIP error
+        uint16_t active;
+        uint16_t maxActive;
+        // From the frame completing the handshake reaching the driver to the accept callback
+        uint32_t lastAcceptUs;
+        uint32_t maxAcceptUs;
+        uint64_t totalAcceptUs;
+    };
+
+    ConnectionManager();
+    ~ConnectionManager();
+
+    err_t start(uint16_t port, uint8_t backlog = PICONET_CONN_SLOTS);
+    void stop();
+
+    void onAccept(AcceptCallback callback);
+    void onReceive(ReceiveCallback callback);
+    void onClose(CloseCallback callback);
+
+    // Close by reset rather than FIN, so the device never holds TIME_WAIT
+    void setAbortiveClose(bool abortive);
+
+    // Copies the data and sends it right away
+    err_t write(int id, const void *data, uint16_t len);
+    uint16_t getAvailableSize(int id) const;
+    void close(int id);
+    void abort(int id);
+    bool isOpen(int id) const;
+
+    // pcbs in TIME_WAIT across the whole stack
+    static size_t getTimeWaitCount();
+
+    const Stats &getStats() const { return stats; }
+    void resetStats();
+
+private:
+    struct Session {
+        ConnectionManager *manager;
+        struct tcp_pcb *pcb;
+        uint8_t idleSeconds;
+    };
+
+    struct tcp_pcb *pcb;
+    Session sessions[PICONET_CONN_SLOTS];
+    bool abortiveClose;
+    Stats stats;
+
+    AcceptCallback acceptCallback;
+    ReceiveCallback receiveCallback;
+    CloseCallback closeCallback;
+
+    int idOf(const Session *session) const { return (int)(session - sessions); }
+    Session *evictionCandidate();
+    void end(Session *session, bool abortive);
+    void release(Session *session);
+
+    static err_t acceptWrapper(void *arg, struct tcp_pcb *newpcb, err_t err);
+    static err_t receiveWrapper(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err);
+    static err_t sentWrapper(void *arg, struct tcp_pcb *tpcb, u16_t len);
+    static err_t pollWrapper(void *arg, struct tcp_pcb *tpcb);
+    static void errorWrapper(void *arg, err_t err);
+};
+
+#endif // PICONET_CONNECTION_MANAGER_H
@@ -0,0 +1,92 @@
+#ifndef PICONET_COPY_ENGINE_H
+#define PICONET_COPY_ENGINE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "pico-usbnet/config.h"
+#include "pico-usbnet/StaticContainers.h"
+
+// Moves frame and payload bytes at the few large-copy sites of the network
+// paths (USB frames in and out, UDP::send). Copies of at least the installed
+// threshold go to the engine, which may finish them in the background;
+// shorter ones, and anything the engine cannot take, are copied on the CPU
+// straight away. lwIP's own MEMCPY stays memcpy(): its copies are mostly
+// headers, too short to pay for setting up a transfer.
+//
+// The engine is only used from thread mode on the core that installed it.
+// Calls from an interrupt handler or from the other core copy on the CPU,
+// so they never touch the engine's queue while its owner is using it.
+//
+// Copies that overlap checksumming (LWIP_CHECKSUM_ON_COPY, verified receive)
+// stay fused on the CPU: the data has to be read by the CPU anyway.
+class CopyEngine {
+public:
+    // Begin copying; false when the engine cannot take the copy right now
+    virtual bool start(void *dst, const void *src, size_t length) = 0;
+    // True while copies started on this engine are still running
+    virtual bool busy() = 0;
+
+    void wait();
+
+    // Engine used by the network paths (nullptr: CPU only) and the smallest copy it gets
+    static void install(CopyEngine *engine, size_t threshold = PICONET_COPY_THRESHOLD);
+    static CopyEngine *getInstalled();
+
+    // True if the copy was handed to the engine; the destination is only valid after finish()
+    static bool copyAsync(void *dst, const void *src, size_t length);
+    static void finish();
+    // Copy and wait for it
+    static void copy(void *dst, const void *src, size_t length);
+
+protected:
+    ~CopyEngine() = default;
+
+private:
+    static CopyEngine *installed;
+    static size_t threshold;
+    static unsigned ownerCore;
+
+    // True if the caller may use the installed engine
+    static bool usable();
+};
+
+// Plain memcpy(), complete when start() returns. Used on host builds and as
+// the reference the DMA engine is checked against.
+class CpuCopyEngine final : public CopyEngine {
+public:
+    bool start(void *dst, const void *src, size_t length) override;
+    bool busy() override { return false; }
+};
+
+#if PICONET_COPY_DMA
+// One DMA channel working through a queue of copies. Word transfers are used
+// when source and destination share their alignment, with the odd head and
+// tail bytes copied on the CPU; other copies run byte-wide.
+class DmaCopyEngine final : public CopyEngine {
+public:
+    DmaCopyEngine();
+
+    // Claim a free channel; false if there is none
+    bool claim();
+    void unclaim();
+
+    bool start(void *dst, const void *src, size_t length) override;
+    bool busy() override;
+
+private:
+    struct Segment {
+        void *dst;
+        const void *src;
+        uint32_t count;
+        bool words;
+    };
+
+    int channel;
+    RingQueue<Segment, PICONET_COPY_DMA_QUEUE> queue;
+
+    void kick();
+};
+#endif
+
+#endif // PICONET_COPY_ENGINE_H
@@ -0,0 +1,136 @@
+#ifndef PICONET_DHCP_SERVER_H
+#define PICONET_DHCP_SERVER_H
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+    #include "lwip/udp.h"
+    #include "lwip/ip_addr.h"
+}
+
+#include "pico-usbnet/config.h"
+#include "pico-usbnet/StaticContainers.h"
+
+// Range of addresses handed out to hosts. A zero 'first' starts the pool
+// right after the device address. An explicit address list, set with
+// setAddresses(), replaces the range; addresses outside the subnet are ignored.
+struct DHCPPool {
+    ip_addr_t first = IPADDR4_INIT(0);
+    uint16_t size = PICONET_DHCP_POOL_SIZE;
+    uint32_t leaseTime = PICONET_DHCP_LEASE_TIME;   // seconds
+    StaticVector<ip_addr_t, PICONET_DHCP_MAX_ENTRIES> addresses;
+
+    // False, with the list unchanged, if there are more than PICONET_DHCP_MAX_ENTRIES
+    [[nodiscard]] bool setAddresses(const ip_addr_t *list, size_t count) { return addresses.assign(list, count); }
+
+    template <size_t N>
+    void setAddresses(const ip_addr_t (&list)[N]) {
+        static_assert(N <= PICONET_DHCP_MAX_ENTRIES, "raise PICONET_DHCP_MAX_ENTRIES");
+        (void)addresses.assign(list, N);
+    }
+};
+
+// DHCP server for the USB link. Leases live in an open-addressing hash table
+// keyed by MAC, so lookups stay O(1) however large the pool is; a host keeps
+// its address for as long as its slot is not reclaimed. Granted leases are
+// installed as static ARP entries, up to PICONET_DHCP_STATIC_ARP of them, so
+// the first packets to a new host skip ARP resolution.
+//
+// With PICONET_DHCP_PERSIST the bindings are written to flash
+// PICONET_DHCP_SAVE_DELAY_MS after a change, from lwIP's timers rather than
+// the packet callback, so a burst of grants costs one sector write. Programming
+// flash stalls XIP: if core 1 runs code from flash, it has to be parked
+// (multicore_lockout) around start(), stop() and the lwIP timers.
+class DHCPServer {
+public:
+    struct Stats {
+        uint32_t discovers;
+        uint32_t offers;
+        uint32_t acks;
+        uint32_t naks;
+        uint32_t releases;
+        uint32_t exhausted;     // DISCOVERs left unanswered for lack of an address
+        uint32_t arpSeeded;
+        uint32_t arpDynamic;    // grants left to ARP because the static entries were used up
+        uint32_t flashWrites;
+        uint32_t firstAckMs;    // from start() to the first ACK, 0 until then
+    };
+
+    DHCPServer();
+    ~DHCPServer();
+
+    void configure(const ip_addr_t &serverIp, const ip_addr_t &netmask, const ip_addr_t &router,
+                   const ip_addr_t &dns, const char *domain, const DHCPPool &pool);
+
+    err_t start(uint16_t port = 67);
+    void stop();
+
+    // Forget every binding, including the persisted ones
+    void clearLeases();
+    size_t getLeaseCount() const { return leaseCount; }
+
+    const Stats &getStats() const { return stats; }
+    void resetStats();
+
+private:
+    enum LeaseState : uint8_t { Empty, Offered, Bound };
+
+    struct Lease {
+        uint8_t mac[6];
+        uint16_t offset;        // index into the pool
+        uint32_t expiry;        // sys_now() deadline
+        LeaseState state;
+        bool saved;             // binding already in flash
+        bool arpStatic;         // has a static ARP entry
+    };
+
+    struct udp_pcb *pcb;
+    Lease leases[PICONET_DHCP_LEASES];
+    size_t leaseCount;
+    uint8_t used[(PICONET_DHCP_POOL_MAX + 7) / 8];
+
+    ip4_addr_t serverIp;
+    ip4_addr_t netmask;
+    ip4_addr_t router;
+    ip4_addr_t dns;
+    const char *domain;
+    uint32_t poolFirst;         // host byte order
+    uint16_t poolSize;
+    uint32_t leaseTime;
+    // Explicit pool, host byte order; empty when the pool is a range
+    StaticVector<uint32_t, PICONET_DHCP_MAX_ENTRIES> addresses;
+    size_t staticArp;
+    bool savePending;
+
+    uint32_t startedAt;
+    Stats stats;
+
+    Lease *find(const uint8_t *mac);
+    Lease *insert(const uint8_t *mac, uint16_t offset);
+    void remove(Lease *lease);
+    bool allocate(const uint8_t *mac, uint32_t requested, uint16_t &offset);
+    bool reclaimExpired();
+    void reserveFixed();
+
+    bool isUsed(uint16_t offset) const { return used[offset / 8] & (1u << (offset % 8)); }
+    void setUsed(uint16_t offset, bool value);
+    bool offsetOf(uint32_t address, uint16_t &offset) const;
+    uint32_t addressAt(uint16_t offset) const;
+    void addressOf(uint16_t offset, ip4_addr_t *address) const;
+
+    void seedArp(Lease *lease);
+    void unseedArp(Lease *lease);
+    void load();
+    void scheduleSave();
+    void save();
+
+    void handleMessage(struct pbuf *p);
+    void reply(const uint8_t *request, uint8_t type, const Lease *lease, bool unicast);
+
+    static void receiveWrapper(void *arg, struct udp_pcb *upcb, struct pbuf *p,
+                               const ip_addr_t *addr, uint16_t port);
+    static void saveWrapper(void *arg);
+};
+
+#endif // PICONET_DHCP_SERVER_H
@@ -0,0 +1,66 @@
+#ifndef PICONET_DNS_RESPONDER_H
+#define PICONET_DNS_RESPONDER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "pico-usbnet/config.h"
+#include "pico-usbnet/StaticContainers.h"
+
+// Record table and wire-format logic of DNSServer, over plain byte buffers.
+// Records are kept in wire format with their answer precomputed, so a query
+// costs one table scan and one copy. Every query gets an answer:
+//   - known name, A query:   the address
+//   - known name, other type: empty NOERROR, so AAAA lookups do not wait
+//   - unknown name in the local domain (or a bare label): NXDOMAIN
+//   - anything else: REFUSED, so the host moves on to its other resolvers
+class DNSResponder {
+public:
+    struct Stats {
+        uint32_t queries;
+        uint32_t answered;
+        uint32_t noData;
+        uint32_t nxDomain;
+        uint32_t refused;
+        uint32_t malformed;
+    };
+
+    // Pointer to the question name, type A, class IN, TTL, RDLENGTH, address
+    static constexpr size_t answerLength = 16;
+
+    DNSResponder();
+
+    // Names are relative to the local domain, e.g. "pico" for "pico.usb";
+    // address as in ip4_addr_t, in network byte order
+    bool addRecord(const char *name, uint32_t address);
+    void clear();
+
+    void setDomain(const char *domain);
+
+    // Builds the response to a query; 0 if there is none to send (malformed,
+    // or capacity short of length + answerLength)
+    size_t respond(const uint8_t *query, size_t length, uint8_t *response, size_t capacity);
+
+    const Stats &getStats() const { return stats; }
+    void resetStats();
+
+private:
+    // Longest wire-format name handled (RFC 1035 limit)
+    static constexpr size_t maxNameLength = 255;
+
+    struct Record {
+        uint8_t name[64];
+        uint8_t nameLength;
+        uint32_t hash;
+        uint8_t answer[answerLength];
+    };
+
+    StaticVector<Record, PICONET_DNS_MAX_RECORDS> records;
+    uint8_t domain[64];
+    uint8_t domainLength;
+    Stats stats;
+
+    const Record *find(const uint8_t *name, size_t length) const;
+};
+
+#endif // PICONET_DNS_RESPONDER_H
@@ -0,0 +1,46 @@
+#ifndef PICONET_DNS_SERVER_H
+#define PICONET_DNS_SERVER_H
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+    #include "lwip/udp.h"
+    #include "lwip/ip_addr.h"
+}
+
+#include "pico-usbnet/config.h"
+#include "pico-usbnet/DNSResponder.h"
+
+// Authoritative responder for the names on the USB link: a DNSResponder on a
+// UDP socket. See DNSResponder.h for how queries are answered.
+class DNSServer {
+public:
+    typedef DNSResponder::Stats Stats;
+
+    DNSServer();
+    ~DNSServer();
+
+    // Names are relative to the local domain, e.g. "pico" for "pico.usb"
+    bool addRecord(const char *name, const ip_addr_t &addr);
+    void clear();
+
+    void setDomain(const char *domain);
+
+    err_t start(uint16_t port = 53);
+    void stop();
+
+    const Stats &getStats() const { return responder.getStats(); }
+    void resetStats();
+
+private:
+    struct udp_pcb *pcb;
+    DNSResponder responder;
+
+    void handleQuery(struct pbuf *p, const ip_addr_t *addr, uint16_t port);
+
+    static void receiveWrapper(void *arg, struct udp_pcb *upcb, struct pbuf *p,
+                               const ip_addr_t *addr, uint16_t port);
+};
+
+#endif // PICONET_DNS_SERVER_H
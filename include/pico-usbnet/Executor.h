@@ -0,0 +1,91 @@
+#ifndef PICONET_EXECUTOR_H
+#define PICONET_EXECUTOR_H
+
+#include "pico-usbnet/config.h"
+
+#if PICONET_COROUTINES
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+
+// Coroutine tasks and the single executor that runs them. Frames come from a
+// fixed pool instead of the heap. Nothing here touches lwIP; the awaitables
+// over lwIP callbacks are in Async.h.
+
+class Task {
+public:
+    struct promise_type {
+        std::coroutine_handle<> continuation;
+        bool detached = false;
+
+        // Frames are carved from the static frame pool; nullptr makes the
+        // coroutine call return an invalid Task instead of allocating
+        static void *operator new(size_t size) noexcept;
+        static void operator delete(void *frame) noexcept;
+        static Task get_return_object_on_allocation_failure() { return Task(); }
+
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        struct FinalAwaiter {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept;
+            void await_resume() noexcept {}
+        };
+
+        FinalAwaiter final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() {}
+    };
+
+    Task() : handle(nullptr) {}
+    Task(Task &&other) noexcept : handle(other.handle) { other.handle = nullptr; }
+    Task &operator=(Task &&other) noexcept;
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+    ~Task();
+
+    bool valid() const { return handle != nullptr; }
+
+    // Awaiting a Task runs it to completion before the awaiting coroutine continues
+    bool await_ready() const noexcept { return !handle || handle.done(); }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept;
+    void await_resume() noexcept {}
+
+private:
+    friend class Executor;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+class Executor {
+public:
+    // Start a detached task; false if the frame pool or the ready queue is exhausted
+    static bool spawn(Task task);
+
+    // Queue a suspended coroutine to be resumed by the next poll()
+    static bool schedule(std::coroutine_handle<> handle);
+
+    // Resume ready coroutines and expire sleeps; called from USBNetwork::work()
+    static void poll();
+
+    struct SleepAwaiter {
+        uint32_t deadline;
+
+        bool await_ready() const noexcept;
+        void await_suspend(std::coroutine_handle<> handle) noexcept;
+        void await_resume() const noexcept {}
+    };
+
+    static SleepAwaiter sleep(uint32_t ms);
+};
+
+#endif // PICONET_COROUTINES
+
+#endif // PICONET_EXECUTOR_H
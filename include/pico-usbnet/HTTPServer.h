@@ -0,0 +1,93 @@
+#ifndef PICONET_HTTP_SERVER_H
+#define PICONET_HTTP_SERVER_H
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+    #include "lwip/tcp.h"
+}
+
+#include "pico-usbnet/config.h"
+
+// Web content packed by tools/pack_web.py (see piconet_add_web_image() in
+// CMakeLists.txt). Headers and bodies are const data in XIP flash and are
+// queued to lwIP by reference, never copied.
+
+// One encoding of an asset: complete response header plus body. Each
+// encoding has its own strong ETag, since their bytes differ.
+struct WebVariant {
+    const char *header;
+    uint16_t headerLength;
+    const uint8_t *body;
+    uint32_t bodyLength;
+    const char *etag;           // quoted, as sent in the ETag header
+    const char *notModified;    // complete 304 response
+    uint16_t notModifiedLength;
+};
+
+struct WebAsset {
+    const char *path;
+    WebVariant identity;
+    WebVariant gzip;            // body is nullptr when compression did not pay off
+};
+
+// Assets sorted by path (strcmp order)
+struct WebImage {
+    const WebAsset *assets;
+    size_t count;
+};
+
+// Static file server for a WebImage. Supports GET and HEAD, keep-alive and
+// pipelined requests, Accept-Encoding negotiation and If-None-Match.
+class HTTPServer {
+public:
+    struct Stats {
+        uint32_t requests;
+        uint32_t gzipResponses;
+        uint32_t notModified;
+        uint32_t notFound;
+        uint32_t rejected;      // malformed, oversized or non GET/HEAD requests
+        uint32_t refused;       // connections dropped because the pool was full
+        uint32_t bytesQueued;
+    };
+
+    HTTPServer();
+    ~HTTPServer();
+
+    err_t start(const WebImage &image, uint16_t port = 80);
+    void stop();
+
+    // Exact match on the request path, without query string
+    const WebAsset *find(const char *path, size_t length) const;
+
+    const Stats &getStats() const { return stats; }
+    void resetStats();
+
+    // Connection pool and request buffer, shared by every server instance
+    static size_t getSharedSize();
+
+    // Per-connection state, defined in HTTPServer.cpp
+    struct Connection;
+
+private:
+    struct tcp_pcb *pcb;
+    const WebImage *image;
+    Connection *connections;
+    Stats stats;
+
+    err_t service(Connection *connection);
+    bool nextRequest(Connection *connection);
+    void respond(Connection *connection, const char *request, size_t length);
+    void send(Connection *connection);
+    err_t closeConnection(Connection *connection);
+    void release(Connection *connection);
+
+    static err_t acceptWrapper(void *arg, struct tcp_pcb *newpcb, err_t err);
+    static err_t receiveWrapper(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err);
+    static err_t sentWrapper(void *arg, struct tcp_pcb *tpcb, u16_t len);
+    static err_t pollWrapper(void *arg, struct tcp_pcb *tpcb);
+    static void errorWrapper(void *arg, err_t err);
+};
+
+#endif // PICONET_HTTP_SERVER_H
@@ -0,0 +1,90 @@
+#ifndef PICONET_LOOPBACK_BENCH_H
+#define PICONET_LOOPBACK_BENCH_H
+
+#include <cstdint>
+
+#include "pico-usbnet/config.h"
+#include "pico-usbnet/USBNetwork.h"
+
+#if PICONET_LOOPBACK
+// Self-test and stack-cost benchmark that never touches the USB driver: a TCP
+// client streams to a TCP server, then a UDP client makes echo calls to an
+// RPCServer, all on the device's own address through lwIP's loopback path.
+// Works after init() with or without a host attached, or after initLoopback().
+//
+// The TCP stream runs once per MTU in 576, 1500, 4000 and PICONET_MTU, as far
+// as PICONET_MTU allows, with the interface MTU lowered for each run, so the
+// segment size follows it.
+//
+// print() names the lwIP profile (PICONET_LWIP_PROFILE) and the windows and
+// pools it planned, so runs of builds with different profiles compare directly.
+//
+// All phases are driven by network.work(), so the times include everything
+// the stack does per packet: headers, checksums, copies and the TCP state
+// machine on both ends.
+//
+// A third phase is a reconnect storm against a ConnectionManager: the client
+// connects, sends a byte and the server closes, over and over; once with a
+// graceful close, which leaves the server's side in TIME_WAIT, and once with
+// an abortive one, which does not.
+//
+// With a local interface (PICONET_NETIFS > 1) an isolation phase makes echo
+// calls while a TCP stream runs to the USB interface's address, first to that
+// same address, where they share the stream's loopback queue, then to the
+// local interface's own, and compares round trips and losses.
+//
+// With PICONET_POOL_CALIBRATION each phase (and each MTU) is recorded as one
+// scenario of a PoolCalibration sweep.
+//
+// Runs on the target only, since it needs lwIP. The parts of the per-packet
+// cost that do not (checksums, DNS answers, the coroutine executor, the copy
+// engine) have host benchmarks and tests under host/, and the reconnect storm
+// also runs there against a fake lwIP TCP layer, for ConnectionManager's side.
+class LoopbackBench {
+public:
+    struct Churn {
+        uint32_t connections;
+        uint32_t failed;        // connect refused, reset or timed out
+        uint32_t us;
+        uint32_t connectMeanUs;
+        uint32_t connectMaxUs;
+        uint32_t maxTimeWait;   // most pcbs in TIME_WAIT at once
+        uint32_t evicted;
+        uint32_t refused;
+    };
+
+    struct Isolation {
+        uint32_t roundTrips;
+        uint32_t lost;          // no reply within 20 ms
+        uint32_t meanUs;
+        uint32_t maxUs;
+    };
+
+    struct Stream {
+        uint16_t mtu;
+        uint32_t bytes;
+        uint32_t us;
+    };
+
+    static const size_t MaxStreams = 4;
+
+    struct Result {
+        bool ok;
+        Stream tcp[MaxStreams];
+        size_t streams;
+        uint32_t roundTrips;
+        uint32_t roundTripUs;   // all round trips together
+        Churn graceful;
+        Churn abortive;
+        Isolation shared;       // echo calls to the USB interface's address under load
+        Isolation separate;     // and to the local interface's
+    };
+
+    // Blocks until all phases finish or time out
+    static bool run(USBNetwork &network, Result &result,
+                    uint32_t tcpBytes = 256 * 1024, uint32_t roundTrips = 1000, uint32_t connections = 2000);
+    static void print(const Result &result);
+};
+#endif
+
+#endif // PICONET_LOOPBACK_BENCH_H
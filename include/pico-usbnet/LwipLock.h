@@ -0,0 +1,30 @@
+#ifndef PICONET_LWIP_LOCK_H
+#define PICONET_LWIP_LOCK_H
+
+extern "C" {
+    #include "lwip/arch.h"
+}
+
+#include "pico-usbnet/config.h"
+
+// Recursive lock behind sys_arch_protect()/sys_arch_unprotect(). Interrupts are
+// masked while it is held; in dual-core mode a hardware spinlock keeps the other
+// core out, and the owning core may re-enter without touching the spinlock.
+class LwipLock {
+public:
+    struct Stats {
+        uint32_t acquisitions;  // outermost acquisitions only
+        uint32_t contentions;   // acquisitions that found the other core holding the lock
+        uint32_t maxHoldUs;
+        uint64_t totalHoldUs;
+    };
+
+    static sys_prot_t protect();
+    static void unprotect(sys_prot_t state);
+
+    // Zeroed unless PICONET_LWIP_LOCK_STATS is enabled
+    static Stats getStats();
+    static void resetStats();
+};
+
+#endif // PICONET_LWIP_LOCK_H
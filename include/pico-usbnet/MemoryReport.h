@@ -0,0 +1,21 @@
+#ifndef PICONET_MEMORY_REPORT_H
+#define PICONET_MEMORY_REPORT_H
+
+#include <cstddef>
+
+// Static RAM footprint of each subsystem. Everything here is reserved at link
+// time; the library core does not touch the heap.
+class MemoryReport {
+public:
+    struct Entry {
+        const char *name;
+        size_t bytes;
+    };
+
+    // Fills at most maxEntries entries and returns how many exist in total
+    static size_t collect(Entry *entries, size_t maxEntries);
+    static size_t total();
+    static void print();
+};
+
+#endif // PICONET_MEMORY_REPORT_H
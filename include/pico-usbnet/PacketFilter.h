@@ -0,0 +1,64 @@
+#ifndef PICONET_PACKET_FILTER_H
+#define PICONET_PACKET_FILTER_H
+
+#include <cstdint>
+
+extern "C" {
+    #include "lwip/ip_addr.h"
+}
+
+#include "pico-usbnet/config.h"
+
+enum class FilterAction : uint8_t {
+    Pass,       // hand the frame to lwIP
+    Drop,       // give the buffer back to TinyUSB untouched
+    FastPath    // deliver the UDP payload straight to a handler, bypassing lwIP
+};
+
+// A zero field matches anything. Ports are known for IPv4 TCP/UDP that is
+// unfragmented or a first fragment. FastPath rules only take unfragmented
+// datagrams; fragments go on to the next rule and, failing that, to lwIP.
+struct FilterRule {
+    uint16_t etherType;
+    uint8_t ipProtocol;
+    uint16_t dstPort;
+    FilterAction action;
+};
+
+typedef void (*FastPathHandler)(const uint8_t *payload, uint16_t len, const ip_addr_t *addr, uint16_t port);
+
+class PacketFilter {
+public:
+    PacketFilter();
+
+    // Rules are evaluated in insertion order, first match wins.
+    // Both return the rule index or -1 when the table is full.
+    int addRule(const FilterRule &rule);
+    int addFastPath(uint16_t udpPort, FastPathHandler handler);
+    void clear();
+
+    // Classify a raw Ethernet frame; FastPath frames are dispatched before returning
+    FilterAction process(const uint8_t *frame, uint16_t size);
+
+    int getRuleCount() const;
+    const FilterRule &getRule(int index) const;
+    uint32_t getHits(int index) const;
+    uint32_t getPassed() const;
+    void resetCounters();
+
+private:
+    struct Entry {
+        FilterRule rule;
+        FastPathHandler handler;
+        uint32_t hits;
+    };
+
+    Entry rules[PICONET_FILTER_MAX_RULES];
+    int ruleCount;
+    uint32_t passed;
+
+    void addDefaultRules();
+    static void dispatch(const Entry &entry, const uint8_t *ip, uint16_t ipLen, uint16_t headerLen);
+};
+
+#endif // PICONET_PACKET_FILTER_H
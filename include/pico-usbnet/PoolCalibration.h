@@ -0,0 +1,41 @@
+#ifndef PICONET_POOL_CALIBRATION_H
+#define PICONET_POOL_CALIBRATION_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "pico-usbnet/config.h"
+
+// Calibration mode for the lwIP heap and memp pools: run real or benchmark
+// traffic with PICONET_POOL_CALIBRATION enabled, then print the recommended
+// lwipopts fragment. Values can be passed as compile definitions, since the
+// planner in lwipopts_profile.h only derives what is not already defined.
+//
+// For a sweep, reset() before each scenario and endScenario() after it; the
+// recommendation then covers the worst scenario for every pool and names it.
+// LoopbackBench sweeps its own phases this way.
+class PoolCalibration {
+public:
+    struct Pool {
+        const char *option;     // lwipopts name, e.g. "MEMP_NUM_TCP_SEG"
+        uint32_t configured;    // elements, or bytes for MEM_SIZE
+        uint32_t highWater;
+        uint32_t failures;      // allocations refused because the pool was empty
+        uint32_t recommended;
+        const char *scenario;   // where the high-water mark was reached, in a sweep
+    };
+
+    // Fills at most maxPools entries and returns how many exist in total
+    static size_t collect(Pool *pools, size_t maxPools);
+
+    // Start a new measurement window
+    static void reset();
+
+    // Fold the window into the sweep under the scenario's name
+    static void endScenario(const char *name);
+    static void clearSweep();
+
+    static void printRecommendation();
+};
+
+#endif // PICONET_POOL_CALIBRATION_H
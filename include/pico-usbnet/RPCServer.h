@@ -0,0 +1,122 @@
+#ifndef PICONET_RPC_SERVER_H
+#define PICONET_RPC_SERVER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+extern "C" {
+    #include "lwip/udp.h"
+    #include "lwip/ip_addr.h"
+}
+
+#include "pico-usbnet/config.h"
+
+// Binary request/response protocol over UDP, little-endian throughout.
+//
+// Datagram:  version (1) | flags (1) | call count (1) | reserved (1) | request id (4)
+// Call:      method (2) | length (2) | arguments
+// Result:    status (2) | length (2) | payload
+//
+// A response carries one result per call, in order, under the request's id.
+// Calls past a truncated one still get a result, with status BadArguments.
+// A batch whose results cannot all fit a reply is dropped as malformed.
+// Clients retry with the same id; the server answers a retry from its reply
+// cache instead of running the calls again, so every call runs at most once.
+
+#define PICONET_RPC_VERSION         1
+#define PICONET_RPC_FLAG_RESPONSE   0x01
+#define PICONET_RPC_HEADER_SIZE     8
+#define PICONET_RPC_CALL_HEADER     4
+
+// Echoes its arguments; handled by the server itself
+#define PICONET_RPC_METHOD_ECHO     0xFFFF
+
+enum class RpcStatus : uint16_t {
+    Ok = 0,
+    UnknownMethod = 1,
+    BadArguments = 2,
+    ResultTooLarge = 3,
+    Failed = 4,
+    // Handlers may return their own codes from here on
+    User = 0x100
+};
+
+struct RpcCall {
+    const uint8_t *args;
+    uint16_t argLength;
+    uint8_t *result;
+    uint16_t resultCapacity;
+    uint16_t resultLength;
+
+    // Appends to the result; false, writing nothing, if it would not fit.
+    // Handlers write through this rather than through result directly.
+    bool write(const void *data, uint16_t length) {
+        if (length > resultCapacity - resultLength) {
+            return false;
+        }
+
+        memcpy(result + resultLength, data, length);
+        resultLength += length;
+
+        return true;
+    }
+};
+
+typedef RpcStatus (*RpcHandler)(RpcCall &call);
+
+// Handlers indexed by method id, normally a const array in flash:
+//   static const RpcHandler methods[] = {getTemperature, setFrequency};
+//   rpc.start(RpcTable(methods));
+struct RpcTable {
+    template <size_t N>
+    constexpr RpcTable(const RpcHandler (&handlers)[N]) : handlers(handlers), count(N) {}
+
+    const RpcHandler *handlers;
+    size_t count;
+};
+
+class RPCServer {
+public:
+    struct Stats {
+        uint32_t datagrams;
+        uint32_t calls;
+        uint32_t retries;       // answered from the reply cache
+        uint32_t unknownMethods;
+        uint32_t malformed;
+    };
+
+    RPCServer();
+    ~RPCServer();
+
+    err_t start(const RpcTable &table, uint16_t port = 5556);
+    void stop();
+
+    const Stats &getStats() const { return stats; }
+    void resetStats();
+
+private:
+    struct Reply {
+        ip_addr_t addr;
+        uint16_t port;
+        uint32_t requestId;
+        uint16_t length;        // 0 for an unused slot
+        uint8_t data[PICONET_RPC_MAX_DATAGRAM];
+    };
+
+    struct udp_pcb *pcb;
+    const RpcHandler *handlers;
+    size_t handlerCount;
+    Reply replies[PICONET_RPC_REPLY_CACHE];
+    size_t nextReply;
+    Stats stats;
+
+    Reply *findReply(const ip_addr_t *addr, uint16_t port, uint32_t requestId);
+    void handleRequest(struct pbuf *p, const ip_addr_t *addr, uint16_t port);
+    void sendReply(const Reply &reply, const ip_addr_t *addr, uint16_t port);
+
+    static void receiveWrapper(void *arg, struct udp_pcb *upcb, struct pbuf *p,
+                               const ip_addr_t *addr, uint16_t port);
+};
+
+#endif // PICONET_RPC_SERVER_H
@@ -0,0 +1,107 @@
+#ifndef PICONET_RATE_CONTROLLER_H
+#define PICONET_RATE_CONTROLLER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "pico-usbnet/config.h"
+#include "pico-usbnet/TCP.h"
+
+// How a producer thins its samples at one degradation level
+enum class RateMode : uint8_t {
+    Full,       // every sample
+    Average,    // the mean of each run of `factor` samples
+    Decimate    // every `factor`-th sample
+};
+
+struct RateLevel {
+    RateMode mode;
+    uint8_t factor;
+    uint8_t codec;      // encoding tier, meaning is up to the application (0: native)
+};
+
+// In-band report: this marker, little-endian, then level, mode, factor, codec.
+// As a float it is a quiet NaN no sensor produces; as two int16 words its high
+// half is above the range of samples scaled to +-32000.
+#define PICONET_RATE_REPORT_MARKER  0x7FC05243u
+#define PICONET_RATE_REPORT_SIZE    8
+
+// Steps a producer down a ladder of RateLevels when the send path backs up,
+// and back up once it has drained, instead of letting writes fail.
+//
+// Pressure is the fullest of the TCP send buffer, the segment queue and the
+// TX scheduler queues, sampled on every update() and smoothed once per
+// PICONET_RATE_INTERVAL_MS. At or above the high threshold, or on any write
+// refused with ERR_MEM, the producer drops one level. It climbs one level
+// after the recover count of intervals below the low threshold in which the
+// peer acknowledged at least as much as was written.
+class RateController {
+public:
+    struct Stats {
+        uint32_t intervals;
+        uint32_t degrades;
+        uint32_t restores;
+        uint32_t overflows;     // writes refused since the controller started watching
+        uint32_t samplesIn;
+        uint32_t samplesOut;
+        uint8_t pressure;       // smoothed, percent
+        uint8_t maxLevel;
+    };
+
+    RateController();
+
+    // Levels from full quality down, copied; false if empty or over PICONET_RATE_MAX_LEVELS
+    bool setPolicy(const RateLevel *levels, size_t count);
+    void setThresholds(uint8_t highPercent, uint8_t lowPercent,
+                       uint16_t recoverIntervals = PICONET_RATE_RECOVER_INTERVALS);
+
+    // Sample the connection; true when the level changed and should be reported
+    bool update(TCP &tcp, uint32_t nowMs);
+    // The same for other transports: occupancy in percent, a write was refused,
+    // and the peer has taken at least what was written since the last call
+    bool update(uint8_t pressure, bool overflow, bool draining, uint32_t nowMs);
+    // Back to full quality, e.g. for a new connection
+    void reset();
+
+    // Feed one sample; true when `out` holds a sample to send
+    bool reduce(float in, float &out);
+
+    const RateLevel &getLevel() const { return levels[level]; }
+    size_t getLevelIndex() const { return level; }
+    // Writes PICONET_RATE_REPORT_SIZE bytes describing the current level
+    size_t encodeReport(uint8_t *out) const;
+
+    const Stats &getStats() const { return stats; }
+    void resetStats();
+
+private:
+    RateLevel levels[PICONET_RATE_MAX_LEVELS];
+    size_t levelCount;
+    size_t level;
+
+    uint8_t highPercent;
+    uint8_t lowPercent;
+    uint16_t recoverIntervals;
+    uint16_t quietIntervals;
+    uint16_t holdIntervals;     // no pressure-driven step down until this runs out
+
+    bool started;
+    uint32_t intervalStartMs;
+    uint8_t peak;               // highest pressure seen this interval
+    uint16_t smoothed;          // percent * 4
+    bool draining;
+
+    uint32_t lastWritten;
+    uint32_t lastAcked;
+    uint32_t lastMemErrors;
+
+    float sum;
+    uint8_t phase;
+
+    Stats stats;
+
+    bool evaluate(bool overflow, uint32_t nowMs);
+    void setLevel(size_t index);
+};
+
+#endif // PICONET_RATE_CONTROLLER_H
@@ -0,0 +1,72 @@
+#ifndef PICONET_SCHEDULER_H
+#define PICONET_SCHEDULER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "pico-usbnet/config.h"
+
+// Deadline queue of application tasks, a binary heap keyed by time_us_64().
+// USBNetwork::service() runs what is due and spends the time until the next
+// deadline (or lwIP timeout, whichever is earlier) on the network.
+//
+// A periodic task keeps its phase: the next deadline is the last one plus the
+// period, never the time it actually ran. One that falls behind runs up to
+// PICONET_SCHED_CATCH_UP times per pass, once for each overdue period with
+// that period's deadline; periods beyond that are skipped and counted as missed.
+class Scheduler {
+public:
+    // Called with the deadline the run belongs to, not the current time
+    typedef void (*Task)(uint64_t deadlineUs);
+
+    struct TaskStats {
+        uint32_t runs;
+        uint32_t missed;        // periods skipped
+        uint32_t lastLateUs;    // start of the last run after its deadline
+        uint32_t maxLateUs;
+        uint64_t totalLateUs;
+    };
+
+    Scheduler();
+
+    // Task id, or -1 when all PICONET_SCHED_TASKS slots are taken. A first
+    // deadline of 0 means one period from now.
+    int schedulePeriodic(Task task, uint32_t periodUs, uint64_t firstUs = 0);
+    int scheduleAt(Task task, uint64_t deadlineUs);
+    // Ids of one-shot tasks lapse once they have run
+    void cancel(int id);
+
+    // Earliest deadline, UINT64_MAX when nothing is scheduled
+    uint64_t nextDeadlineUs() const;
+    // Runs every task due at nowUs, earliest first; the number of runs
+    size_t runDue(uint64_t nowUs);
+
+    const TaskStats &getStats(int id) const { return slots[id].stats; }
+    void resetStats();
+
+private:
+    struct Slot {
+        Task task;
+        uint32_t periodUs;      // 0 for one-shot
+        uint64_t deadlineUs;
+        uint8_t heapIndex;
+        bool active;
+        // Bumped each time the slot is handed out, so runDue() notices a task
+        // that cancelled itself and had its slot reused from its own callback
+        uint32_t generation;
+        TaskStats stats;
+    };
+
+    Slot slots[PICONET_SCHED_TASKS];
+    uint8_t heap[PICONET_SCHED_TASKS];
+    size_t heapSize;
+
+    int allocate(Task task, uint32_t periodUs, uint64_t deadlineUs);
+    void push(uint8_t slot);
+    void remove(size_t index);
+    void siftUp(size_t index);
+    void siftDown(size_t index);
+    void place(size_t index, uint8_t slot);
+};
+
+#endif // PICONET_SCHEDULER_H
@@ -0,0 +1,173 @@
+#ifndef PICONET_STATIC_CONTAINERS_H
+#define PICONET_STATIC_CONTAINERS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+// Fixed-capacity containers for the heap-free library core. Storage is part of
+// the object, so the RAM footprint is known at link time and shows up in the
+// memory report.
+
+// Vector of trivially copyable elements with room for N of them
+template <typename T, size_t N>
+class StaticVector {
+public:
+    StaticVector() : count(0) {}
+
+    // All of values or nothing: false, and the vector unchanged, if they do not fit
+    [[nodiscard]] bool assign(const T *values, size_t length) {
+        if (length > N || (length && !values)) {
+            return false;
+        }
+
+        for (size_t i = 0; i < length; i++) {
+            items[i] = values[i];
+        }
+
+        count = length;
+
+        return true;
+    }
+
+    [[nodiscard]] bool push_back(const T &value) {
+        if (count >= N) {
+            return false;
+        }
+
+        items[count++] = value;
+
+        return true;
+    }
+
+    void clear() { count = 0; }
+
+    size_t size() const { return count; }
+    static constexpr size_t capacity() { return N; }
+    bool empty() const { return count == 0; }
+    bool full() const { return count == N; }
+
+    T *data() { return items; }
+    const T *data() const { return items; }
+    T &operator[](size_t index) { return items[index]; }
+    const T &operator[](size_t index) const { return items[index]; }
+
+    T *begin() { return items; }
+    T *end() { return items + count; }
+    const T *begin() const { return items; }
+    const T *end() const { return items + count; }
+
+private:
+    T items[N];
+    size_t count;
+};
+
+// Single-producer FIFO of N elements
+template <typename T, size_t N>
+class RingQueue {
+public:
+    RingQueue() : head(0), count(0) {}
+
+    bool push(const T &value) {
+        if (count >= N) {
+            return false;
+        }
+
+        items[(head + count) % N] = value;
+        count++;
+
+        return true;
+    }
+
+    bool pop(T &value) {
+        if (count == 0) {
+            return false;
+        }
+
+        value = items[head];
+        head = (head + 1) % N;
+        count--;
+
+        return true;
+    }
+
+    T &front() { return items[head]; }
+    const T &front() const { return items[head]; }
+
+    void clear() { head = count = 0; }
+
+    size_t size() const { return count; }
+    static constexpr size_t capacity() { return N; }
+    bool empty() const { return count == 0; }
+    bool full() const { return count == N; }
+
+private:
+    T items[N];
+    size_t head;
+    size_t count;
+};
+
+// Pool of N objects constructed in place; acquire() returns nullptr when exhausted
+template <typename T, size_t N>
+class ObjectPool {
+public:
+    ObjectPool() : freeCount(N) {
+        for (size_t i = 0; i < N; i++) {
+            freeList[i] = static_cast<uint16_t>(N - 1 - i);
+        }
+    }
+
+    ~ObjectPool() = default;
+
+    ObjectPool(const ObjectPool &) = delete;
+    ObjectPool &operator=(const ObjectPool &) = delete;
+
+    template <typename... Args>
+    T *acquire(Args &&...args) {
+        if (freeCount == 0) {
+            return nullptr;
+        }
+
+        uint16_t index = freeList[--freeCount];
+
+        return new (slot(index)) T(std::forward<Args>(args)...);
+    }
+
+    void release(T *object) {
+        if (!object) {
+            return;
+        }
+
+        size_t index = (reinterpret_cast<unsigned char *>(object) - storage[0].bytes) / sizeof(Slot);
+
+        object->~T();
+        freeList[freeCount++] = static_cast<uint16_t>(index);
+    }
+
+    bool owns(const T *object) const {
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(object);
+
+        return p >= storage[0].bytes && p < storage[N - 1].bytes + sizeof(Slot) &&
+               (p - storage[0].bytes) % sizeof(Slot) == 0;
+    }
+
+    size_t available() const { return freeCount; }
+    size_t used() const { return N - freeCount; }
+    static constexpr size_t capacity() { return N; }
+
+private:
+    static_assert(N > 0 && N <= 0xffff, "ObjectPool capacity out of range");
+
+    struct Slot {
+        alignas(T) unsigned char bytes[sizeof(T)];
+    };
+
+    void *slot(size_t index) { return storage[index].bytes; }
+
+    Slot storage[N];
+    uint16_t freeList[N];
+    size_t freeCount;
+};
+
+#endif // PICONET_STATIC_CONTAINERS_H
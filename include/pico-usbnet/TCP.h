@@ -3,23 +3,44 @@
 
 #include "lwip/tcp.h"
 
+#include "pico-usbnet/TxScheduler.h"
+
 class TCP {
 public:
+    struct Stats {
+        uint32_t written;       // bytes accepted by write()
+        uint32_t acked;         // bytes the peer acknowledged
+        uint32_t memErrors;     // writes refused for lack of buffer space
+    };
+
     TCP();
     ~TCP();
 
     void init();
     void keepAlive(bool enable, uint32_t interval);
-    void bind(const ip_addr_t *ipaddr, uint16_t port);
+    // reuseAddress (SO_REUSEADDR) lets a restarted listener bind while connections of its last run are in TIME_WAIT
+    void bind(const ip_addr_t *ipaddr, uint16_t port, bool reuseAddress = false);
     void listen();
+    // Close the listening pcb; an accepted connection stays open until close()
+    void stopListening();
+    // Client side: open a connection; onConnect() reports the outcome
+    err_t connect(const ip_addr_t *ipaddr, uint16_t port);
     void close();
     err_t send(const void *data, uint16_t len);
     err_t send();
     err_t write(const void *data, uint16_t len);
     uint16_t getAvailableSize();
+    // Segments queued for sending, out of TCP_SND_QUEUELEN
+    uint16_t getQueueLength();
+    bool isConnected() const { return client != nullptr; }
+    const Stats &getStats() const { return stats; }
+    // Transmit class of this socket's frames, carried in the IP TOS byte
+    void setPriority(TxClass txClass);
 
     // Callback setters
     void onAccept(void (*callback)(struct tcp_pcb *newpcb, err_t err));
+    void onConnect(void (*callback)(err_t err));
+    // The pbuf is freed when the callback returns
     void onReceive(void (*callback)(struct pbuf *p));
     void onSent(void (*callback)(err_t err));
     void onError(void (*callback)(err_t err));
@@ -28,18 +49,25 @@ public:
 private:
     struct tcp_pcb* pcb;
     struct tcp_pcb* client;
+    // Kept apart from pcb, which acceptWrapper() points at the accepted connection
+    struct tcp_pcb* listener;
+    uint8_t tos;
+    Stats stats;
 
     // Callbacks
     void (*receiveCallback)(struct pbuf *p);
     void (*errorCallback)(err_t err);
     void (*closeCallback)();
     void (*acceptCallback)(struct tcp_pcb *newpcb, err_t err);
+    void (*connectCallback)(err_t err);
     void (*sentCallback)(err_t err);
 
     // Static callback wrappers
     static err_t receiveWrapper(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err);
     static void errorWrapper(void *arg, err_t err);
+    static void pcbErrorWrapper(void *arg, err_t err);
     static err_t acceptWrapper(void *arg, struct tcp_pcb *newpcb, err_t err);
+    static err_t connectWrapper(void *arg, struct tcp_pcb *tpcb, err_t err);
     static void closeWrapper(void *arg);
     static err_t sentWrapper(void *arg, struct tcp_pcb *tpcb, u16_t len);
 };
@@ -0,0 +1,101 @@
+#ifndef PICONET_TIME_SYNC_H
+#define PICONET_TIME_SYNC_H
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+    #include "lwip/udp.h"
+    #include "lwip/ip_addr.h"
+}
+
+#include "pico-usbnet/config.h"
+#include "pico-usbnet/ClockEstimator.h"
+
+// NTP-style exchange with a time server on the host (tools/timesync_host.py),
+// little-endian throughout, 40 bytes:
+//
+//   version (1) | type (1) | flags (1) | reserved (1) | sequence (4)
+//   a (8) | b (8) | c (8) | drift ppb (4) | delay us (4)
+//
+// Announce  host -> device  the sender is the time server
+// Request   device -> host  a: device send time, b: the device's estimate of
+//                           host time at a (0 until synced), drift and delay
+//                           as currently estimated
+// Response  host -> device  a: echoed, b: host receive time, c: host send time
+//
+// The device times its requests when linkoutput hands them to the driver and
+// the responses when networkReceiveHandler takes them from it, so USB and
+// lwIP queueing on the device side stay out of the measurement.
+
+#define PICONET_TIMESYNC_VERSION        1
+#define PICONET_TIMESYNC_MESSAGE_SIZE   40
+#define PICONET_TIMESYNC_FLAG_SYNCED    0x01
+
+enum class TimeSyncType : uint8_t {
+    Announce = 0,
+    Request = 1,
+    Response = 2
+};
+
+// In-band stamp for streams: this marker, little-endian, 4 reserved bytes,
+// then the host time in microseconds (int64). Like the rate report marker it
+// is a NaN as a float and out of range for samples scaled to +-32000.
+#define PICONET_TIMESYNC_STAMP_MARKER   0x7FC05354u
+#define PICONET_TIMESYNC_STAMP_SIZE     16
+
+// Keeps device time (time_us_64()) convertible to host time. Runs the
+// exchanges and hands their timestamps to a ClockEstimator, which does the
+// windowing and the fit.
+class TimeSync {
+public:
+    struct Stats {
+        uint32_t requests;
+        uint32_t responses;
+        uint32_t stale;         // late or unmatched responses
+        uint32_t points;
+        uint32_t lastDelayUs;   // round trip without host processing
+        uint32_t minDelayUs;
+        int32_t upUs;           // one-way device -> host of the last exchange, by the model
+        int32_t downUs;         // one-way host -> device
+    };
+
+    TimeSync();
+    ~TimeSync();
+
+    err_t start(uint16_t port = PICONET_TIMESYNC_PORT);
+    void stop();
+    // Server to query; an announce from the host sets it too
+    void setServer(const ip_addr_t &addr, uint16_t port);
+
+    bool isSynced() const { return estimator.isSynced(); }
+    int64_t toHostTimeUs(uint64_t deviceUs) const { return estimator.toHostTimeUs(deviceUs); }
+    int32_t getDriftPpb() const { return estimator.getDriftPpb(); }
+    // Writes PICONET_TIMESYNC_STAMP_SIZE bytes; host time 0 while not synced
+    size_t encodeStamp(uint8_t *out, uint64_t deviceUs) const;
+
+    const Stats &getStats() const { return stats; }
+    void resetStats();
+
+private:
+    struct udp_pcb *pcb;
+    ip_addr_t server;
+    uint16_t serverPort;
+    bool hasServer;
+
+    uint32_t sequence;
+    bool pending;
+    uint64_t sentUs;
+
+    ClockEstimator estimator;
+    Stats stats;
+
+    void sendRequest();
+    void handleResponse(const uint8_t *message);
+
+    static void timerWrapper(void *arg);
+    static void receiveWrapper(void *arg, struct udp_pcb *upcb, struct pbuf *p,
+                               const ip_addr_t *addr, uint16_t port);
+};
+
+#endif // PICONET_TIME_SYNC_H
@@ -0,0 +1,98 @@
+#ifndef PICONET_TX_SCHEDULER_H
+#define PICONET_TX_SCHEDULER_H
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+    #include "lwip/pbuf.h"
+}
+
+#include "pico-usbnet/config.h"
+#include "pico-usbnet/StaticContainers.h"
+
+// Transmit classes. Control is served with strict priority; the others share
+// the remaining link time by deficit round robin according to their weights.
+enum class TxClass : uint8_t {
+    Control,    // ARP, ICMP, DHCP, DNS, bare TCP ACK/SYN/RST
+    Normal,     // anything not classified otherwise
+    Bulk,       // streams marked with setPriority() or setPortClass()
+    Count
+};
+
+// Orders outbound frames when the USB link is busy. A frame that finds every
+// queue empty and the driver free is sent straight away; otherwise lwIP's
+// pbuf is referenced (or copied, when it points at volatile data) and queued
+// until USBNetwork drains it.
+//
+// TCP segments without payload (ACKs, SYNs) always go to Control. Other frames
+// are classified by DSCP first, so TCP::setPriority()/UDP::setPriority()
+// override everything else, then by the port table, then by protocol.
+class TxScheduler {
+public:
+    struct ClassStats {
+        uint32_t sent;
+        uint32_t direct;        // sent without being queued
+        uint32_t copied;        // queued as a copy of volatile data
+        uint32_t stalls;        // queue full, sender waited for the link
+        uint16_t depth;
+        uint16_t maxDepth;
+        uint32_t totalLatencyUs;
+        uint32_t maxLatencyUs;
+    };
+
+    TxScheduler();
+
+    // IP TOS byte that makes a socket's frames land in the class
+    static uint8_t tosFor(TxClass txClass);
+
+    // Frames from or to the local port go to the class; false when the table is full
+    bool setPortClass(uint16_t port, TxClass txClass);
+    void clearPortClasses();
+    // Share of the link between the non-control classes (minimum 1)
+    void setWeight(TxClass txClass, uint8_t weight);
+
+    TxClass classify(struct pbuf *p) const;
+
+    // ERR_WOULDBLOCK when the class queue is full, ERR_MEM when a copy fails
+    err_t enqueue(struct pbuf *p, TxClass txClass, uint32_t nowUs);
+    // Next frame to send, or nullptr; it stays queued until pop()
+    struct pbuf *peek(TxClass &txClass);
+    // Drop the frame returned by peek() once it has been handed to the driver
+    void pop(TxClass txClass, uint32_t nowUs);
+    void countDirect(TxClass txClass);
+    // Free everything queued, e.g. when the host resets the link
+    void clear();
+
+    bool empty() const { return queued == 0; }
+
+    const ClassStats &getStats(TxClass txClass) const { return stats[(size_t)txClass]; }
+    void resetStats();
+
+private:
+    static constexpr size_t classCount = (size_t)TxClass::Count;
+
+    struct Entry {
+        struct pbuf *p;
+        uint32_t queuedUs;
+    };
+
+    struct PortClass {
+        uint16_t port;
+        TxClass txClass;
+    };
+
+    RingQueue<Entry, PICONET_TX_QUEUE_DEPTH> queues[classCount];
+    StaticVector<PortClass, PICONET_TX_PORT_CLASSES> ports;
+    uint32_t quantum[classCount];
+    uint32_t deficit[classCount];
+    size_t current;             // class holding the round robin turn
+    bool freshTurn;             // its quantum has not been added yet
+    size_t queued;
+    ClassStats stats[classCount];
+
+    bool lookupPort(uint16_t port, TxClass &txClass) const;
+    void nextTurn();
+};
+
+#endif // PICONET_TX_SCHEDULER_H
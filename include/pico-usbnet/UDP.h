@@ -8,6 +8,8 @@ extern "C" {
     #include "lwip/ip_addr.h"
 }
 
+#include "pico-usbnet/TxScheduler.h"
+
 class UDP {
 public:
     UDP();
@@ -15,13 +17,18 @@ public:
 
     void init();
     void bind(const ip_addr_t *ipaddr, uint16_t port);
+    // Peer that send() goes to
+    void connect(const ip_addr_t *ipaddr, uint16_t port);
     void send(const void *data, uint16_t len);
     void close();
+    // Transmit class of this socket's frames, carried in the IP TOS byte
+    void setPriority(TxClass txClass);
 
     void onReceive(void (*callback)(struct pbuf *p, const ip_addr_t *addr, uint16_t port));
 
 private:
     struct udp_pcb *pcb;
+    uint8_t tos;
     void (*receiveCallback)(struct pbuf *p, const ip_addr_t *addr, uint16_t port);
 
     static void receiveWrapper(void *arg, struct udp_pcb *upcb, struct pbuf *p,
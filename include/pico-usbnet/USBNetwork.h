@@ -1,33 +1,124 @@
 #ifndef PICONET_MANAGER_H
 #define PICONET_MANAGER_H
-#include <vector>
+#include <cstddef>
 
 extern "C"
 {
 // HIPPY FIX
-#include "dhserver.h"
-#include "dnserver.h"
 #include "lwip/apps/httpd.h"
 #include "lwip/init.h"
 #include "lwip/tcp.h"
 #include "lwip/timeouts.h"
+#include "lwip/etharp.h"
+#include "netif/ethernet.h"
 #include "pico/stdlib.h"
 #include "pico/sync.h"
 #include "tusb.h"
 }
 
+#include "pico-usbnet/config.h"
+#include "pico-usbnet/DHCPServer.h"
+#include "pico-usbnet/DNSServer.h"
+#include "pico-usbnet/PacketFilter.h"
+#include "pico-usbnet/Scheduler.h"
+#include "pico-usbnet/StaticContainers.h"
+#include "pico-usbnet/TxScheduler.h"
+
+// Bring-up milestones reported by USBNetwork::work(), each at most once per boot
+enum class NetworkEvent : uint8_t {
+    InterfaceUp,    // lwIP netif configured and up
+    DhcpReady,      // DHCP and DNS servers listening
+    UsbMounted,     // host enumerated the device
+    LinkUp,         // host brought up the RNDIS/ECM interface
+    FirstOffer,     // first DHCPOFFER sent
+    FirstLease,     // first DHCPACK sent
+    FirstByte,      // first TCP payload sent to the host
+    Count
+};
+
+// TinyUSB has a single network function, so there is one Usb interface at most
+enum class InterfaceKind : uint8_t {
+    Usb,            // RNDIS/ECM link to the host, always interface 0
+    Local           // device-local address with its own loopback queue (PICONET_LOOPBACK)
+};
+
+struct InterfaceStats {
+    uint32_t rxFrames;
+    uint32_t rxBytes;
+    uint32_t rxDropped;     // busy, out of pbufs or corrupt
+    uint32_t txFrames;
+    uint32_t txBytes;
+    uint32_t txDropped;     // refused by the link or its queue
+};
+
 class USBNetwork
 {
 public:
+    typedef void (*EventCallback)(NetworkEvent event, uint32_t timeUs);
+
     USBNetwork(
         const ip_addr_t &ipaddr,
         const ip_addr_t &netmask,
         const ip_addr_t &gateway,
-        const std::vector<dhcp_entry_t> &dhcpEntries = std::vector<dhcp_entry_t>());
+        const DHCPPool &dhcpPool = DHCPPool());
+
+    // Starts USB and lwIP and returns; the rest of bring-up is driven by work()
     void init();
+    // lwIP only, without USB: the device can only reach itself (needs PICONET_LOOPBACK)
+    void initLoopback();
+    // Blocking helper: runs work() until the DHCP server is listening
     void waitForNetworkUp();
-    void startDhcpServer();
+    err_t startDhcpServer();
     void work();
+    // Main loop step for paced producers: runs the scheduler's due tasks, then
+    // network work until the next deadline or for at most PICONET_SCHED_SLICE_US
+    void service();
+
+    // Called from work() as each milestone is reached; timeUs is time_us_32() at the event
+    void onEvent(EventCallback callback);
+    bool isReady() const { return reached(NetworkEvent::DhcpReady); }
+    bool reached(NetworkEvent event) const { return event_mask & (1u << (uint8_t)event); }
+    // Microseconds since boot at which the event happened; 0 until then
+    uint32_t getEventTimeUs(NetworkEvent event) const;
+    // Boot-to-event timings for every milestone reached so far
+    void printBootTimings() const;
+
+    // Adds a device-local interface before init(); its index, or -1 when all PICONET_NETIFS are in use.
+    // Traffic the device sends to that address has a queue of its own, apart from the USB interface's.
+    int addLocalInterface(const ip_addr_t &ipaddr, const ip_addr_t &netmask);
+    size_t getInterfaceCount() const { return interface_count; }
+    InterfaceKind getInterfaceKind(size_t index) const { return interfaces[index].kind; }
+    const ip_addr_t &getIPAddress(size_t index = 0) const { return interfaces[index].ipaddr; }
+    // Local interfaces take theirs from lwIP's counters of their loopback queue, see pollLocal()
+    const InterfaceStats &getInterfaceStats(size_t index) const { return interfaces[index].stats; }
+    void resetInterfaceStats();
+    void printInterfaceStats() const;
+
+    // USB interface MTU at run time, between 576 and PICONET_MTU; connections opened
+    // afterwards size their segments from it
+    void setMTU(uint16_t mtu);
+    uint16_t getMTU() const { return interfaces[0].netif.mtu; }
+
+    static PacketFilter &getPacketFilter();
+    static TxScheduler &getTxScheduler();
+
+    // Answers PICONET_HOSTNAME.PICONET_DNS_DOMAIN with the device address; started by startDhcpServer()
+    DNSServer &getDNSServer();
+    DHCPServer &getDHCPServer();
+    Scheduler &getScheduler() { return scheduler; }
+
+    // Microseconds from the host bringing up the interface to the first TCP payload sent to it; 0 until then
+    static uint32_t getTimeToFirstByteUs();
+
+    // time_us_64() at which the frame lwIP is processing arrived from the host (or left the loopback queue)
+    static uint64_t getReceiveTimeUs();
+    // Note when the frame built from p is handed to the driver; 0 from getTransmitTimeUs() until then,
+    // and for good if the frame is dropped. nullptr cancels a pending stamp.
+    static void stampTransmit(struct pbuf *p);
+    static uint64_t getTransmitTimeUs();
+
+    // Skip IP/TCP/UDP/ICMP checksum verification on frames this interface receives and rely on the USB CRC
+    void setTrustLinkChecksums(bool trust);
 
     // TinyUSB network callback handlers
     static void networkInitHandler();
@@ -36,24 +127,67 @@ public:
 
 private:
     void serviceTraffic();
+    bool hasPendingWork() const;
+    static void drainTx();
+    static void transmit(struct pbuf *p);
+    void advanceInit();
+    void emit(NetworkEvent event, uint32_t timeUs);
+
+    bool started;
+    bool usb;
+    uint8_t event_mask;
+    uint32_t event_us[(size_t)NetworkEvent::Count];
+    EventCallback event_callback;
+
+    DHCPServer dhcp_server;
+    DNSServer dns_server;
+    Scheduler scheduler;
 
-    std::vector<dhcp_entry_t> dhcp_entries;
-    dhcp_config_t dhcp_config;
+    struct Interface {
+        struct netif netif;
+        InterfaceKind kind;
+        ip_addr_t ipaddr;
+        ip_addr_t netmask;
+        ip_addr_t gateway;
+        InterfaceStats stats;
+    };
 
-    struct netif netif_data;
-    // Network configuration
-    ip_addr_t ipaddr;
-    ip_addr_t netmask;
-    ip_addr_t gateway;
+    // Interface 0 is the USB one, configured by the constructor
+    Interface interfaces[PICONET_NETIFS];
+    size_t interface_count;
+    // Set per interface with setTrustLinkChecksums()
+    bool trust_link_checksums;
 
     void initNetworkInterface();
+    void pollLocal(Interface &interface);
 
+    // The instance whose netif TinyUSB's callbacks feed; they carry no context of their own
+    static USBNetwork *usb_interface;
+    // Its USB interface's stats, counted by the driver callbacks and linkoutput_fn()
+    static InterfaceStats *usb_stats;
     static struct pbuf *received_frame;
+    static PacketFilter packet_filter;
+    static TxScheduler tx_scheduler;
+    // Set when networkReceiveHandler already verified the frame's checksums while copying it
+    static bool received_verified;
+    // Set while the copy engine is still filling received_frame
+    static bool received_copying;
+    static uint32_t link_up_us;
+    static uint32_t first_byte_us;
+    static uint64_t received_us;
+    static struct pbuf *stamp_pbuf;
+    static uint64_t stamped_us;
+    // Releases the stamp if it is still waiting on p
+    static void dropStamp(struct pbuf *p);
     // Link output function for lwIP
     static err_t linkoutput_fn(struct netif *netif, struct pbuf *p);
+    // Hands a frame to the driver or the transmit queue
+    static err_t sendFrame(struct pbuf *p);
     // Standard output function for lwIP
     static err_t output_fn(struct netif *netif, struct pbuf *p, const ip_addr_t *addr);
     static err_t netifInitCallback(struct netif *netif);
+    static err_t localOutput(struct netif *netif, struct pbuf *p, const ip_addr_t *addr);
+    static err_t localInitCallback(struct netif *netif);
 };
 
 #endif // PICONET_MANAGER_H
\ No newline at end of file
@@ -0,0 +1,37 @@
+#ifndef PICONET_VENDOR_STREAM_H
+#define PICONET_VENDOR_STREAM_H
+
+#include <cstdint>
+
+#include "pico-usbnet/config.h"
+#include "pico-usbnet/BlockRing.h"
+
+#if PICONET_VENDOR_BULK
+// Sends BlockRing blocks over the vendor bulk IN endpoint, bypassing
+// Ethernet, IP and TCP; read them with tools/usbfs_reader.c. The stream is
+// attached to the ring only while the host has the interface configured, so
+// an unplugged reader costs the other consumers nothing.
+class VendorStream {
+public:
+    struct Stats {
+        uint32_t bytes;
+        uint32_t attaches;
+    };
+
+    VendorStream();
+
+    void start(BlockRing &ring);
+    void stop();
+    // Move what the endpoint FIFO has room for; call from the main loop after USBNetwork::work()
+    void poll();
+
+    const Stats &getStats() const { return stats; }
+
+private:
+    BlockRing *ring;
+    int consumer;
+    Stats stats;
+};
+#endif
+
+#endif // PICONET_VENDOR_STREAM_H
@@ -0,0 +1,110 @@
+#ifndef PICONET_WEBSOCKET_SERVER_H
+#define PICONET_WEBSOCKET_SERVER_H
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+    #include "lwip/tcp.h"
+}
+
+#include "pico-usbnet/config.h"
+
+// WebSocket endpoint for streaming to browsers (RFC 6455).
+//
+// send() appends application messages to a shared block; the block becomes a
+// single frame once it is full, once some client has nothing in flight, or on
+// flush(). Each client gets the frame header copied into its send buffer and
+// the block itself queued by reference, so the payload is written once however
+// many clients are connected. A client that has no room for a frame skips it
+// instead of holding up the producer, so slow clients see a decimated stream.
+//
+// Message boundaries are not preserved: a frame is the bytes of one or more
+// send() calls back to back, with nothing in between. A message is never
+// split across frames, so a client can take a frame apart again if every
+// message has the same size (as the sample stream in main.cpp does) or
+// carries its own length. A skipped frame loses all the messages in it.
+//
+// Frames from clients are delivered to the message callback one at a time;
+// fragments of a larger message arrive as separate calls.
+class WebSocketServer {
+public:
+    typedef void (*MessageCallback)(const uint8_t *data, size_t length, bool text);
+
+    struct Stats {
+        uint32_t messages;      // accepted by send()
+        uint32_t dropped;       // rejected by send(): no client, too large or no free block
+        uint32_t frames;        // blocks sealed into frames
+        uint32_t framesSent;    // frames queued to clients
+        uint32_t framesSkipped; // frames a client had no room for
+        uint32_t handshakes;
+        uint32_t rejected;      // failed handshakes and protocol errors
+        uint32_t refused;       // connections dropped because the pool was full
+    };
+
+    WebSocketServer();
+    ~WebSocketServer();
+
+    err_t start(uint16_t port = 8080);
+    void stop();
+
+    // Frames carry text (opcode 1) instead of binary (opcode 2)
+    void setTextFrames(bool text);
+    void onMessage(MessageCallback callback);
+
+    // Queue a message for every open client; false if it was dropped. It may share
+    // a frame with the messages around it, see above.
+    bool send(const void *data, size_t length);
+    // Send what has been coalesced so far
+    void flush();
+
+    size_t getClientCount() const;
+
+    const Stats &getStats() const { return stats; }
+    void resetStats();
+
+    // Client pool and handshake/message buffers, shared by every server instance
+    static size_t getSharedSize();
+
+    // Per-client state, defined in WebSocketServer.cpp
+    struct Client;
+
+private:
+    struct Block {
+        uint16_t length;
+        uint8_t refs;           // clients that have not had it acknowledged yet
+        uint8_t data[PICONET_WS_BLOCK_SIZE];
+    };
+
+    struct tcp_pcb *pcb;
+    Client *clients;
+    Block blocks[PICONET_WS_BLOCKS];
+    Block *open;                // block send() appends to
+    bool text;
+    MessageCallback messageCallback;
+    Stats stats;
+
+    Block *allocate();
+    void unref(Block *block);
+    void seal();
+    bool writeFrame(Client *client, Block *block);
+    bool hasIdleClient() const;
+
+    err_t service(Client *client);
+    bool handshake(Client *client);
+    bool nextFrame(Client *client);
+    err_t writeCopy(Client *client, const void *data, size_t length);
+    void sendClose(Client *client, uint16_t status);
+    void discardReceived(Client *client);
+    err_t finish(Client *client);
+    void release(Client *client);
+    void acknowledge(Client *client, uint16_t length);
+
+    static err_t acceptWrapper(void *arg, struct tcp_pcb *newpcb, err_t err);
+    static err_t receiveWrapper(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err);
+    static err_t sentWrapper(void *arg, struct tcp_pcb *tpcb, u16_t len);
+    static err_t pollWrapper(void *arg, struct tcp_pcb *tpcb);
+    static void errorWrapper(void *arg, err_t err);
+};
+
+#endif // PICONET_WEBSOCKET_SERVER_H
@@ -0,0 +1,23 @@
+#ifndef PICONET_CHECKSUM_H
+#define PICONET_CHECKSUM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Internet checksum engine plugged into lwIP through LWIP_CHKSUM and LWIP_CHKSUM_COPY.
+ * Both return the folded, non-inverted one's complement sum in network byte order,
+ * like lwip_standard_chksum(). */
+uint16_t usbnet_chksum(const void *dataptr, int len);
+
+/* memcpy() that sums the bytes it moves; falls back to two passes when src and dst
+ * are not equally word aligned */
+uint16_t usbnet_chksum_copy(void *dst, const void *src, uint16_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PICONET_CHECKSUM_H
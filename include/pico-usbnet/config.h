@@ -0,0 +1,399 @@
+#ifndef PICONET_CONFIG_H
+#define PICONET_CONFIG_H
+
+/* Build-time options shared by the library, lwipopts.h and tusb_config.h.
+ * Every option can be overridden with a compile definition. */
+
+/* IP MTU of the USB link. A point-to-point link is not bound to 1500, so jumbo
+ * frames can be used up to PICONET_MAX_MTU; TinyUSB buffers, TCP_MSS and the pbuf
+ * pool follow this value. */
+#ifndef PICONET_MTU
+#define PICONET_MTU                     1500
+#endif
+
+#define PICONET_MAX_MTU                 9000
+
+#if PICONET_MTU < 576 || PICONET_MTU > PICONET_MAX_MTU
+#error "PICONET_MTU must be between 576 and PICONET_MAX_MTU"
+#endif
+
+/* lwIP memory profile, see include/lwip/lwipopts_profile.h */
+#define PICONET_PROFILE_LOW_RAM         0
+#define PICONET_PROFILE_BALANCED        1
+#define PICONET_PROFILE_MAX_THROUGHPUT  2
+
+#ifndef PICONET_LWIP_PROFILE
+#define PICONET_LWIP_PROFILE            PICONET_PROFILE_BALANCED
+#endif
+
+/* Concurrent TCP connections the profile's RAM budget is shared between */
+#ifndef PICONET_TCP_CONNECTIONS
+#define PICONET_TCP_CONNECTIONS         1
+#endif
+
+/* UDP sockets (UDP objects) the application keeps open beside the library's
+ * own DHCP, DNS, RPCServer and TimeSync pcbs */
+#ifndef PICONET_UDP_SOCKETS
+#define PICONET_UDP_SOCKETS             2
+#endif
+
+/* PICONET_LWIP_RAM_BUDGET (bytes for heap and pools) defaults per profile */
+
+/* Record lwIP heap/pool high-water marks and failures and print a tuned lwipopts
+ * fragment (PoolCalibration); forces LWIP_STATS on */
+#ifndef PICONET_POOL_CALIBRATION
+#define PICONET_POOL_CALIBRATION        0
+#endif
+
+/* Headroom added on top of the observed high-water marks, in percent */
+#ifndef PICONET_CALIBRATION_HEADROOM
+#define PICONET_CALIBRATION_HEADROOM    25
+#endif
+
+/* C++20 coroutine API (Async.h); enabled by the PICONET_COROUTINES CMake option */
+#ifndef PICONET_COROUTINES
+#define PICONET_COROUTINES              0
+#endif
+
+/* Static coroutine frame pool: number of frames and bytes per frame */
+#ifndef PICONET_CORO_FRAMES
+#define PICONET_CORO_FRAMES             8
+#endif
+
+#ifndef PICONET_CORO_FRAME_SIZE
+#define PICONET_CORO_FRAME_SIZE         512
+#endif
+
+/* Coroutines waiting to be resumed, and pending sleeps */
+#ifndef PICONET_CORO_READY_QUEUE
+#define PICONET_CORO_READY_QUEUE        16
+#endif
+
+#ifndef PICONET_CORO_TIMERS
+#define PICONET_CORO_TIMERS             8
+#endif
+
+/* Open AsyncConnections, and accepted connections an AsyncServer may queue */
+#ifndef PICONET_CORO_CONNECTIONS
+#define PICONET_CORO_CONNECTIONS        4
+#endif
+
+#ifndef PICONET_CORO_BACKLOG
+#define PICONET_CORO_BACKLOG            4
+#endif
+
+/* HTTPServer: concurrent connections, request header buffer and idle timeout */
+#ifndef PICONET_HTTP_CONNECTIONS
+#define PICONET_HTTP_CONNECTIONS        4
+#endif
+
+#ifndef PICONET_HTTP_REQUEST_SIZE
+#define PICONET_HTTP_REQUEST_SIZE       1024
+#endif
+
+#ifndef PICONET_HTTP_IDLE_TIMEOUT_S
+#define PICONET_HTTP_IDLE_TIMEOUT_S     10
+#endif
+
+/* WebSocketServer: clients, shared frame blocks (one frame each, referenced by
+ * every client until acknowledged), handshake and inbound message buffers, and
+ * how long a handshake or close may stall */
+#ifndef PICONET_WS_CLIENTS
+#define PICONET_WS_CLIENTS              4
+#endif
+
+#ifndef PICONET_WS_BLOCKS
+#define PICONET_WS_BLOCKS               6
+#endif
+
+#ifndef PICONET_WS_BLOCK_SIZE
+#define PICONET_WS_BLOCK_SIZE           1456
+#endif
+
+#ifndef PICONET_WS_REQUEST_SIZE
+#define PICONET_WS_REQUEST_SIZE         512
+#endif
+
+#ifndef PICONET_WS_MESSAGE_SIZE
+#define PICONET_WS_MESSAGE_SIZE         256
+#endif
+
+#ifndef PICONET_WS_TIMEOUT_S
+#define PICONET_WS_TIMEOUT_S            5
+#endif
+
+/* RPCServer: largest request or reply datagram, and replies kept to answer retries */
+#ifndef PICONET_RPC_MAX_DATAGRAM
+#define PICONET_RPC_MAX_DATAGRAM        512
+#endif
+
+#ifndef PICONET_RPC_REPLY_CACHE
+#define PICONET_RPC_REPLY_CACHE         4
+#endif
+
+/* DNS responder: local domain (also handed out by DHCP), device name, record table and TTL */
+#ifndef PICONET_DNS_DOMAIN
+#define PICONET_DNS_DOMAIN              "usb"
+#endif
+
+#ifndef PICONET_HOSTNAME
+#define PICONET_HOSTNAME                "pico"
+#endif
+
+#ifndef PICONET_DNS_MAX_RECORDS
+#define PICONET_DNS_MAX_RECORDS         8
+#endif
+
+#ifndef PICONET_DNS_TTL
+#define PICONET_DNS_TTL                 300
+#endif
+
+/* DHCP server: lease table slots (power of two), largest address pool and
+ * default pool size and lease time */
+#ifndef PICONET_DHCP_LEASES
+#define PICONET_DHCP_LEASES             32
+#endif
+
+#if (PICONET_DHCP_LEASES & (PICONET_DHCP_LEASES - 1)) != 0
+#error "PICONET_DHCP_LEASES must be a power of two"
+#endif
+
+#ifndef PICONET_DHCP_POOL_MAX
+#define PICONET_DHCP_POOL_MAX           256
+#endif
+
+#ifndef PICONET_DHCP_POOL_SIZE
+#define PICONET_DHCP_POOL_SIZE          8
+#endif
+
+#ifndef PICONET_DHCP_LEASE_TIME
+#define PICONET_DHCP_LEASE_TIME         (24 * 60 * 60)
+#endif
+
+/* Longest explicit address list a DHCPPool can hold instead of a range */
+#ifndef PICONET_DHCP_MAX_ENTRIES
+#define PICONET_DHCP_MAX_ENTRIES        8
+#endif
+
+/* Leases that get a static ARP entry; the rest resolve through ARP as usual.
+ * Must stay below lwIP's ARP_TABLE_SIZE (10) so dynamic entries keep room. */
+#ifndef PICONET_DHCP_STATIC_ARP
+#define PICONET_DHCP_STATIC_ARP         4
+#endif
+
+/* Keep DHCP bindings in the flash sector at PICONET_DHCP_FLASH_OFFSET across reboots */
+#ifndef PICONET_DHCP_PERSIST
+#define PICONET_DHCP_PERSIST            0
+#endif
+
+#ifndef PICONET_DHCP_FLASH_OFFSET
+#define PICONET_DHCP_FLASH_OFFSET       (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+#endif
+
+/* Binding changes within this window go to flash in one sector write */
+#ifndef PICONET_DHCP_SAVE_DELAY_MS
+#define PICONET_DHCP_SAVE_DELAY_MS      2000
+#endif
+
+/* Early packet filter run in the USB receive callback, before a pbuf is allocated */
+#ifndef PICONET_FILTER_ENABLED
+#define PICONET_FILTER_ENABLED          1
+#endif
+
+#ifndef PICONET_FILTER_MAX_RULES
+#define PICONET_FILTER_MAX_RULES        16
+#endif
+
+/* Drop IPv6, mDNS, LLMNR, SSDP and NetBIOS chatter from the host by default */
+#ifndef PICONET_FILTER_DEFAULT_RULES
+#define PICONET_FILTER_DEFAULT_RULES    1
+#endif
+
+/* Prioritised transmit queues (TxScheduler): frames queued per class while
+ * the link is busy, DRR weights of the Normal and Bulk classes, and ports
+ * with a fixed class */
+#ifndef PICONET_TX_SCHEDULER
+#define PICONET_TX_SCHEDULER            1
+#endif
+
+#ifndef PICONET_TX_QUEUE_DEPTH
+#define PICONET_TX_QUEUE_DEPTH          16
+#endif
+
+#ifndef PICONET_TX_WEIGHT_NORMAL
+#define PICONET_TX_WEIGHT_NORMAL        4
+#endif
+
+#ifndef PICONET_TX_WEIGHT_BULK
+#define PICONET_TX_WEIGHT_BULK          1
+#endif
+
+#ifndef PICONET_TX_PORT_CLASSES
+#define PICONET_TX_PORT_CLASSES         8
+#endif
+
+/* CopyEngine: DMA offload of frame copies, the smallest copy worth handing to
+ * the engine, and copies the DMA engine can have queued */
+#ifndef PICONET_COPY_DMA
+#define PICONET_COPY_DMA                1
+#endif
+
+#ifndef PICONET_COPY_THRESHOLD
+#define PICONET_COPY_THRESHOLD          256
+#endif
+
+#ifndef PICONET_COPY_DMA_QUEUE
+#define PICONET_COPY_DMA_QUEUE          8
+#endif
+
+/* RateController: interval between decisions, send-path occupancy (percent)
+ * that degrades the producer and that counts towards restoring it, and quiet
+ * intervals needed before stepping back up */
+#ifndef PICONET_RATE_INTERVAL_MS
+#define PICONET_RATE_INTERVAL_MS        100
+#endif
+
+#ifndef PICONET_RATE_HIGH_PERCENT
+#define PICONET_RATE_HIGH_PERCENT       75
+#endif
+
+#ifndef PICONET_RATE_LOW_PERCENT
+#define PICONET_RATE_LOW_PERCENT        25
+#endif
+
+#ifndef PICONET_RATE_RECOVER_INTERVALS
+#define PICONET_RATE_RECOVER_INTERVALS  10
+#endif
+
+#ifndef PICONET_RATE_MAX_LEVELS
+#define PICONET_RATE_MAX_LEVELS         8
+#endif
+
+/* In-process loopback: packets the device addresses to itself go back up the
+ * stack without the USB driver, so clients and servers on the device can talk
+ * to each other (LoopbackBench, USBNetwork::initLoopback()) */
+#ifndef PICONET_LOOPBACK
+#define PICONET_LOOPBACK                0
+#endif
+
+#ifndef PICONET_LOOPBACK_MAX_PBUFS
+#define PICONET_LOOPBACK_MAX_PBUFS      16
+#endif
+
+/* First of the two ports LoopbackBench listens on */
+#ifndef PICONET_LOOPBACK_BENCH_PORT
+#define PICONET_LOOPBACK_BENCH_PORT     5600
+#endif
+
+/* Network interfaces: the USB one plus device-local ones added with
+ * USBNetwork::addLocalInterface(), each with its own address and loopback
+ * queue, so on-device control traffic does not wait behind bulk data sent to
+ * the USB address. TinyUSB has a single network function, so only one of
+ * them can be a USB interface. */
+#ifndef PICONET_NETIFS
+#define PICONET_NETIFS                  1
+#endif
+
+#if PICONET_NETIFS < 1 || (PICONET_NETIFS > 1 && !PICONET_LOOPBACK)
+#error "PICONET_NETIFS above 1 needs PICONET_LOOPBACK"
+#endif
+
+/* TimeSync: UDP port, seconds between exchanges with the host, exchanges
+ * reduced to one minimum-delay point, and points the drift is fitted over */
+#ifndef PICONET_TIMESYNC_PORT
+#define PICONET_TIMESYNC_PORT           5557
+#endif
+
+#ifndef PICONET_TIMESYNC_INTERVAL_MS
+#define PICONET_TIMESYNC_INTERVAL_MS    250
+#endif
+
+#ifndef PICONET_TIMESYNC_WINDOW
+#define PICONET_TIMESYNC_WINDOW         8
+#endif
+
+#ifndef PICONET_TIMESYNC_POINTS
+#define PICONET_TIMESYNC_POINTS         8
+#endif
+
+/* Raw sample channel: a vendor bulk interface next to the network interface
+ * (composite device), fed from a BlockRing of blocks of this many payload
+ * bytes, shared by up to this many consumers */
+#ifndef PICONET_VENDOR_BULK
+#define PICONET_VENDOR_BULK             0
+#endif
+
+#ifndef PICONET_BLOCK_RING_BLOCKS
+#define PICONET_BLOCK_RING_BLOCKS       8
+#endif
+
+#ifndef PICONET_BLOCK_RING_SIZE
+#define PICONET_BLOCK_RING_SIZE         2048
+#endif
+
+#ifndef PICONET_BLOCK_RING_CONSUMERS
+#define PICONET_BLOCK_RING_CONSUMERS    2
+#endif
+
+/* ConnectionManager: session slots, seconds without traffic before a session
+ * is aborted, idle seconds that let a session be evicted for a new client
+ * when every slot is taken, and keepalive idle time that finds dead peers */
+#ifndef PICONET_CONN_SLOTS
+#define PICONET_CONN_SLOTS              PICONET_TCP_CONNECTIONS
+#endif
+
+#ifndef PICONET_CONN_IDLE_TIMEOUT_S
+#define PICONET_CONN_IDLE_TIMEOUT_S     30
+#endif
+
+#ifndef PICONET_CONN_EVICT_IDLE_S
+#define PICONET_CONN_EVICT_IDLE_S       2
+#endif
+
+#ifndef PICONET_CONN_KEEPALIVE_S
+#define PICONET_CONN_KEEPALIVE_S        10
+#endif
+
+/* TIME_WAIT lasts twice this. Nothing stays in flight on a USB link for long,
+ * so the 60 s lwIP assumes for the internet only ties up pcbs. */
+#ifndef PICONET_TCP_MSL_MS
+#define PICONET_TCP_MSL_MS              1000
+#endif
+
+/* Scheduler behind USBNetwork::service(): task slots, longest stretch of
+ * network processing between two looks at the task queue, runs a late
+ * periodic task gets per pass before overdue periods are skipped, and whether
+ * to wait for an interrupt (wfe) while nothing is due */
+#ifndef PICONET_SCHED_TASKS
+#define PICONET_SCHED_TASKS             8
+#endif
+
+#ifndef PICONET_SCHED_SLICE_US
+#define PICONET_SCHED_SLICE_US          500
+#endif
+
+#ifndef PICONET_SCHED_CATCH_UP
+#define PICONET_SCHED_CATCH_UP          4
+#endif
+
+#ifndef PICONET_SCHED_IDLE_WFE
+#define PICONET_SCHED_IDLE_WFE          1
+#endif
+
+/* lwIP critical sections: 1 when lwIP is only ever used from one core, which
+ * reduces SYS_ARCH_PROTECT to an interrupt disable */
+#ifndef PICONET_LWIP_LOCK_SINGLE_CORE
+#define PICONET_LWIP_LOCK_SINGLE_CORE   0
+#endif
+
+/* Hardware spinlock guarding lwIP when both cores may enter the stack */
+#ifndef PICONET_LWIP_LOCK_SPINLOCK_ID
+#define PICONET_LWIP_LOCK_SPINLOCK_ID   PICO_SPINLOCK_ID_OS1
+#endif
+
+/* Count acquisitions, contention and hold times of the lwIP lock */
+#ifndef PICONET_LWIP_LOCK_STATS
+#define PICONET_LWIP_LOCK_STATS         0
+#endif
+
+#endif // PICONET_CONFIG_H
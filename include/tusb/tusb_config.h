@@ -26,6 +26,8 @@
 #ifndef _TUSB_CONFIG_H_
 #define _TUSB_CONFIG_H_
 
+#include "pico-usbnet/config.h"
+
 #ifdef __cplusplus
  extern "C" {
 #endif
@@ -99,12 +101,19 @@
 #define CFG_TUD_MSC               0
 #define CFG_TUD_HID               0
 #define CFG_TUD_MIDI              0
-#define CFG_TUD_VENDOR            0
+#define CFG_TUD_VENDOR            PICONET_VENDOR_BULK
 #define CFG_TUD_NET               1
 
 // HIPPY FIX
 #define CFG_TUD_ECM_RNDIS         CFG_TUD_NET
 
+// Largest Ethernet frame (without FCS); sizes the driver's RX/TX buffers and the ECM wMaxSegmentSize
+#define CFG_TUD_NET_MTU           (PICONET_MTU + 14)
+
+// Vendor bulk sample channel; the TX FIFO holds a few full-speed packets so blocks stream without gaps
+#define CFG_TUD_VENDOR_RX_BUFSIZE 64
+#define CFG_TUD_VENDOR_TX_BUFSIZE 512
+
 #ifdef __cplusplus
  }
 #endif
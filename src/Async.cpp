@@ -0,0 +1,287 @@
+#include "pico-usbnet/Async.h"
+
+#if PICONET_COROUTINES
+
+static ObjectPool<AsyncConnection, PICONET_CORO_CONNECTIONS> connection_pool;
+
+// AsyncConnection
+
+AsyncConnection::AsyncConnection(struct tcp_pcb *pcb)
+    : pcb(pcb), received(nullptr), remoteClosed(false), error(ERR_OK),
+      reader(nullptr), writer(nullptr), pendingData(nullptr), pendingLength(0) {
+    tcp_arg(pcb, this);
+    tcp_recv(pcb, receiveWrapper);
+    tcp_sent(pcb, sentWrapper);
+    tcp_err(pcb, errorWrapper);
+}
+
+AsyncConnection::ReadAwaiter AsyncConnection::read(void *buffer, uint16_t size) {
+    return ReadAwaiter{this, static_cast<uint8_t *>(buffer), size};
+}
+
+AsyncConnection::WriteAwaiter AsyncConnection::write(std::span<const uint8_t> data) {
+    pendingData = data.data();
+    pendingLength = data.size();
+
+    return WriteAwaiter{this};
+}
+
+void AsyncConnection::close() {
+    detach();
+    connection_pool.release(this);
+}
+
+void AsyncConnection::detach() {
+    if (pcb) {
+        tcp_arg(pcb, NULL);
+        tcp_recv(pcb, NULL);
+        tcp_sent(pcb, NULL);
+        tcp_err(pcb, NULL);
+
+        if (tcp_close(pcb) != ERR_OK) {
+            tcp_abort(pcb);
+        }
+
+        pcb = nullptr;
+    }
+
+    if (received) {
+        pbuf_free(received);
+        received = nullptr;
+    }
+}
+
+void AsyncConnection::flush() {
+    while (pendingLength && pcb) {
+        size_t chunk = LWIP_MIN(LWIP_MIN((size_t)tcp_sndbuf(pcb), pendingLength), (size_t)0xffff);
+
+        if (!chunk) {
+            break;
+        }
+
+        u8_t flags = TCP_WRITE_FLAG_COPY | (chunk < pendingLength ? TCP_WRITE_FLAG_MORE : 0);
+        err_t result = tcp_write(pcb, pendingData, (u16_t)chunk, flags);
+
+        if (result == ERR_MEM) {
+            break;
+        }
+
+        if (result != ERR_OK) {
+            error = result;
+            pendingLength = 0;
+            break;
+        }
+
+        pendingData += chunk;
+        pendingLength -= chunk;
+    }
+
+    if (pcb) {
+        tcp_output(pcb);
+    }
+}
+
+void AsyncConnection::wake(std::coroutine_handle<> &handle) {
+    if (handle) {
+        Executor::schedule(handle);
+        handle = nullptr;
+    }
+}
+
+bool AsyncConnection::ReadAwaiter::await_ready() const noexcept {
+    return connection->received || connection->remoteClosed || !connection->pcb;
+}
+
+void AsyncConnection::ReadAwaiter::await_suspend(std::coroutine_handle<> handle) noexcept {
+    connection->reader = handle;
+}
+
+int AsyncConnection::ReadAwaiter::await_resume() noexcept {
+    if (connection->received) {
+        u16_t count = pbuf_copy_partial(connection->received, buffer, size, 0);
+
+        connection->received = pbuf_free_header(connection->received, count);
+
+        if (connection->pcb) {
+            tcp_recved(connection->pcb, count);
+        }
+
+        return count;
+    }
+
+    return connection->error != ERR_OK ? connection->error : 0;
+}
+
+bool AsyncConnection::WriteAwaiter::await_ready() noexcept {
+    connection->flush();
+
+    return connection->pendingLength == 0 || !connection->pcb;
+}
+
+void AsyncConnection::WriteAwaiter::await_suspend(std::coroutine_handle<> handle) noexcept {
+    connection->writer = handle;
+}
+
+err_t AsyncConnection::WriteAwaiter::await_resume() noexcept {
+    if (connection->error != ERR_OK) {
+        return connection->error;
+    }
+
+    return connection->pendingLength ? ERR_CLSD : ERR_OK;
+}
+
+err_t AsyncConnection::receiveWrapper(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err) {
+    AsyncConnection *instance = static_cast<AsyncConnection *>(arg);
+
+    if (!p) {
+        instance->remoteClosed = true;
+        instance->wake(instance->reader);
+
+        return ERR_OK;
+    }
+
+    if (err != ERR_OK) {
+        pbuf_free(p);
+
+        return err;
+    }
+
+    if (instance->received) {
+        pbuf_cat(instance->received, p);
+    } else {
+        instance->received = p;
+    }
+
+    instance->wake(instance->reader);
+
+    return ERR_OK;
+}
+
+err_t AsyncConnection::sentWrapper(void *arg, struct tcp_pcb *tpcb, u16_t len) {
+    AsyncConnection *instance = static_cast<AsyncConnection *>(arg);
+
+    instance->flush();
+
+    if (instance->pendingLength == 0 || instance->error != ERR_OK) {
+        instance->wake(instance->writer);
+    }
+
+    return ERR_OK;
+}
+
+void AsyncConnection::errorWrapper(void *arg, err_t err) {
+    AsyncConnection *instance = static_cast<AsyncConnection *>(arg);
+
+    // lwIP has already freed the pcb
+    instance->pcb = nullptr;
+    instance->error = err;
+    instance->wake(instance->reader);
+    instance->wake(instance->writer);
+}
+
+// AsyncServer
+
+AsyncServer::AsyncServer() : pcb(nullptr), acceptor(nullptr) {}
+
+AsyncServer::~AsyncServer() {
+    close();
+}
+
+err_t AsyncServer::listen(const ip_addr_t *ipaddr, uint16_t port) {
+    struct tcp_pcb *newpcb = tcp_new();
+
+    if (!newpcb) {
+        return ERR_MEM;
+    }
+
+    err_t result = tcp_bind(newpcb, ipaddr, port);
+
+    if (result != ERR_OK) {
+        tcp_close(newpcb);
+
+        return result;
+    }
+
+    pcb = tcp_listen_with_backlog(newpcb, PICONET_CORO_BACKLOG);
+
+    if (!pcb) {
+        tcp_close(newpcb);
+
+        return ERR_MEM;
+    }
+
+    tcp_arg(pcb, this);
+    tcp_accept(pcb, acceptWrapper);
+
+    return ERR_OK;
+}
+
+AsyncServer::AcceptAwaiter AsyncServer::accept() {
+    return AcceptAwaiter{this};
+}
+
+void AsyncServer::close() {
+    if (pcb) {
+        tcp_arg(pcb, NULL);
+        tcp_accept(pcb, NULL);
+        tcp_close(pcb);
+        pcb = nullptr;
+    }
+
+    AsyncConnection *connection;
+
+    while (accepted.pop(connection)) {
+        connection->close();
+    }
+
+    if (acceptor) {
+        Executor::schedule(acceptor);
+        acceptor = nullptr;
+    }
+}
+
+bool AsyncServer::AcceptAwaiter::await_ready() const noexcept {
+    return !server->accepted.empty() || !server->pcb;
+}
+
+void AsyncServer::AcceptAwaiter::await_suspend(std::coroutine_handle<> handle) noexcept {
+    server->acceptor = handle;
+}
+
+AsyncConnection *AsyncServer::AcceptAwaiter::await_resume() noexcept {
+    AsyncConnection *connection = nullptr;
+
+    server->accepted.pop(connection);
+
+    return connection;
+}
+
+err_t AsyncServer::acceptWrapper(void *arg, struct tcp_pcb *newpcb, err_t err) {
+    AsyncServer *instance = static_cast<AsyncServer *>(arg);
+
+    if (err != ERR_OK || !newpcb) {
+        return ERR_VAL;
+    }
+
+    // Returning an error makes lwIP abort the new connection
+    if (instance->accepted.full()) {
+        return ERR_MEM;
+    }
+
+    AsyncConnection *connection = connection_pool.acquire(newpcb);
+
+    if (!connection) {
+        return ERR_MEM;
+    }
+
+    instance->accepted.push(connection);
+
+    if (instance->acceptor) {
+        Executor::schedule(instance->acceptor);
+        instance->acceptor = nullptr;
+    }
+
+    return ERR_OK;
+}
+
+#endif // PICONET_COROUTINES
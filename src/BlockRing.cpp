@@ -0,0 +1,165 @@
+#include <cstring>
+
+#include "pico-usbnet/BlockRing.h"
+#include "pico-usbnet/TimeSync.h"
+
+static_assert(PICONET_BLOCK_RING_CONSUMERS <= 8, "consumers are tracked in a byte");
+static_assert(PICONET_BLOCK_RING_BLOCKS >= 2, "the ring needs a slot to fill and one to send");
+
+BlockRing::BlockRing()
+    : slots(), head(0), fill(0), open(false), sequence(0), attached(0), clock(nullptr), tail(), offset(), stats() {}
+
+int BlockRing::attach() {
+    for (int i = 0; i < PICONET_BLOCK_RING_CONSUMERS; i++) {
+        if (!(attached & (1u << i))) {
+            attached |= 1u << i;
+            tail[i] = head;
+            offset[i] = 0;
+
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void BlockRing::detach(int consumer) {
+    if (consumer < 0 || consumer >= PICONET_BLOCK_RING_CONSUMERS) {
+        return;
+    }
+
+    for (Slot &slot : slots) {
+        slot.readers &= ~(1u << consumer);
+    }
+
+    attached &= ~(1u << consumer);
+}
+
+void BlockRing::setTimeSync(const TimeSync *timeSync) {
+    clock = timeSync;
+}
+
+void BlockRing::resetStats() {
+    stats = Stats();
+}
+
+bool BlockRing::startBlock(uint64_t deviceTimeUs) {
+    Slot &slot = slots[head];
+
+    for (int i = 0; i < PICONET_BLOCK_RING_CONSUMERS; i++) {
+        // Only the oldest unread block can be in the way, and its reader is at it
+        if ((slot.readers & (1u << i)) && offset[i]) {
+            return false;
+        }
+    }
+
+    for (int i = 0; i < PICONET_BLOCK_RING_CONSUMERS; i++) {
+        if (slot.readers & (1u << i)) {
+            stats.overruns[i]++;
+            tail[i] = (head + 1) % PICONET_BLOCK_RING_BLOCKS;
+        }
+    }
+
+    slot.readers = 0;
+
+    BlockHeader *block = header(head);
+
+    block->magic = PICONET_BLOCK_MAGIC;
+    block->sequence = sequence;
+    block->length = 0;
+
+    // Once per block, so the conversion stays off the per-sample path
+    if (clock && clock->isSynced()) {
+        block->flags = PICONET_BLOCK_FLAG_HOST_TIME;
+        block->timestampUs = clock->toHostTimeUs(deviceTimeUs);
+    } else {
+        block->flags = 0;
+        block->timestampUs = (int64_t)deviceTimeUs;
+    }
+
+    fill = 0;
+    open = true;
+
+    return true;
+}
+
+void BlockRing::append(const void *data, size_t length, uint64_t deviceTimeUs) {
+    const uint8_t *in = static_cast<const uint8_t *>(data);
+
+    while (length) {
+        if (!open && !startBlock(deviceTimeUs)) {
+            stats.dropped += length;
+
+            return;
+        }
+
+        size_t chunk = PICONET_BLOCK_RING_SIZE - fill;
+
+        if (chunk > length) {
+            chunk = length;
+        }
+
+        memcpy(slots[head].data + sizeof(BlockHeader) + fill, in, chunk);
+        fill += chunk;
+        in += chunk;
+        length -= chunk;
+
+        if (fill == PICONET_BLOCK_RING_SIZE) {
+            seal();
+        }
+    }
+}
+
+void BlockRing::seal() {
+    if (!open || fill == 0) {
+        return;
+    }
+
+    header(head)->length = (uint32_t)fill;
+    slots[head].readers = attached;
+
+    sequence++;
+    head = (head + 1) % PICONET_BLOCK_RING_BLOCKS;
+    open = false;
+    stats.blocks++;
+}
+
+const uint8_t *BlockRing::peek(int consumer, size_t &length) const {
+    const Slot &slot = slots[tail[consumer]];
+
+    if (!(slot.readers & (1u << consumer))) {
+        return nullptr;
+    }
+
+    length = sizeof(BlockHeader) + header(tail[consumer])->length - offset[consumer];
+
+    return slot.data + offset[consumer];
+}
+
+void BlockRing::consume(int consumer, size_t length) {
+    size_t slot = tail[consumer];
+
+    offset[consumer] += length;
+
+    if (offset[consumer] < sizeof(BlockHeader) + header(slot)->length) {
+        return;
+    }
+
+    slots[slot].readers &= ~(1u << consumer);
+    offset[consumer] = 0;
+    tail[consumer] = (slot + 1) % PICONET_BLOCK_RING_BLOCKS;
+
+    // A consumer more than a quarter ring behind skips to the newest block: it
+    // must not start on a slot the producer will need before it can finish
+    size_t behind = (head + PICONET_BLOCK_RING_BLOCKS - tail[consumer]) % PICONET_BLOCK_RING_BLOCKS;
+
+    if (behind <= PICONET_BLOCK_RING_BLOCKS / 4) {
+        return;
+    }
+
+    for (; behind > 1; behind--) {
+        slots[tail[consumer]].readers &= ~(1u << consumer);
+        tail[consumer] = (tail[consumer] + 1) % PICONET_BLOCK_RING_BLOCKS;
+        stats.overruns[consumer]++;
+    }
+}
@@ -0,0 +1,112 @@
+#include <cstdio>
+#include <cstring>
+
+#include "pico-usbnet/ChecksumBench.h"
+#include "pico-usbnet/checksum.h"
+
+extern "C" {
+    #include "pico/stdlib.h"
+}
+
+#define BENCH_MAX_LENGTH    2048
+
+static uint8_t source[BENCH_MAX_LENGTH + 4];
+static uint8_t target[BENCH_MAX_LENGTH + 4];
+
+// Sum of 16-bit words as they lie in memory, which is what lwip_standard_chksum()
+// returns on a little-endian CPU whatever the alignment
+static uint16_t referenceSum(const uint8_t *data, uint16_t length) {
+    uint32_t acc = 0;
+    uint16_t i = 0;
+
+    for (; i + 1 < length; i += 2) {
+        acc += (uint32_t)data[i] | ((uint32_t)data[i + 1] << 8);
+    }
+
+    if (i < length) {
+        acc += data[i];
+    }
+
+    acc = (acc >> 16) + (acc & 0xffff);
+    acc = (acc >> 16) + (acc & 0xffff);
+
+    return (uint16_t)acc;
+}
+
+bool ChecksumBench::run(Result &result, uint16_t length, uint32_t rounds) {
+    result = Result();
+    result.ok = true;
+
+    if (length > BENCH_MAX_LENGTH) {
+        length = BENCH_MAX_LENGTH;
+    }
+
+    for (size_t i = 0; i < sizeof(source); i++) {
+        source[i] = (uint8_t)(i * 131 + 7);
+    }
+
+    // The sums feed back into the data so no pass can be optimised away
+    volatile uint16_t sink = 0;
+    uint64_t start = time_us_64();
+
+    for (uint32_t i = 0; i < rounds; i++) {
+        sink = sink + referenceSum(source + (i & 3), length);
+    }
+
+    result.referenceUs = (uint32_t)(time_us_64() - start);
+    start = time_us_64();
+
+    for (uint32_t i = 0; i < rounds; i++) {
+        sink = sink + usbnet_chksum(source + (i & 3), length);
+    }
+
+    result.sumUs = (uint32_t)(time_us_64() - start);
+    start = time_us_64();
+
+    // Source and target share their misalignment, which is the case the fused loop handles
+    for (uint32_t i = 0; i < rounds; i++) {
+        sink = sink + usbnet_chksum_copy(target + (i & 3), source + (i & 3), length);
+    }
+
+    result.copyUs = (uint32_t)(time_us_64() - start);
+    start = time_us_64();
+
+    for (uint32_t i = 0; i < rounds; i++) {
+        memcpy(target + (i & 3), source + (i & 3), length);
+        sink = sink + target[i & 3];
+    }
+
+    result.memcpyUs = (uint32_t)(time_us_64() - start);
+    result.bytes = (uint64_t)length * rounds;
+
+    // Every alignment and odd length against the reference, with and without the copy
+    for (uint16_t offset = 0; offset < 4; offset++) {
+        for (uint16_t size = 0; size <= 67; size++) {
+            uint16_t expected = referenceSum(source + offset, size);
+
+            result.ok = result.ok && usbnet_chksum(source + offset, size) == expected;
+            result.ok = result.ok && usbnet_chksum_copy(target + offset, source + offset, size) == expected &&
+                        memcmp(target + offset, source + offset, size) == 0;
+            result.ok = result.ok && usbnet_chksum_copy(target + ((offset + 1) & 3), source + offset, size) == expected;
+        }
+
+        result.ok = result.ok && usbnet_chksum(source + offset, length) == referenceSum(source + offset, length);
+    }
+
+    return result.ok;
+}
+
+void ChecksumBench::print(const Result &result, uint32_t cpuHz) {
+    const char *const names[] = {"reference", "usbnet_chksum", "usbnet_chksum_copy", "memcpy"};
+    const uint32_t times[] = {result.referenceUs, result.sumUs, result.copyUs, result.memcpyUs};
+
+    printf("pico-usbnet checksum bench: %s, %llu bytes each, %lu MHz\n", result.ok ? "ok" : "FAILED",
+           (unsigned long long)result.bytes, (unsigned long)(cpuHz / 1000000));
+
+    for (size_t i = 0; i < 4; i++) {
+        double cycles = (double)times[i] * cpuHz / 1e6;
+
+        printf("  %-20s %8lu us  %6.2f cycles/byte\n", names[i], (unsigned long)times[i],
+               result.bytes ? cycles / (double)result.bytes : 0.0);
+    }
+}
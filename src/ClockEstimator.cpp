@@ -0,0 +1,91 @@
+#include "pico-usbnet/ClockEstimator.h"
+
+ClockEstimator::ClockEstimator()
+    : best(), windowCount(0), points(), pointCount(0), nextPoint(0),
+      refUs(0), refOffsetUs(0), drift(0) {}
+
+int64_t ClockEstimator::toHostTimeUs(uint64_t deviceUs) const {
+    int64_t elapsed = (int64_t)(deviceUs - refUs);
+
+    return (int64_t)deviceUs + refOffsetUs + (int64_t)(drift * (double)elapsed);
+}
+
+int32_t ClockEstimator::getDriftPpb() const {
+    return (int32_t)(drift * 1e9);
+}
+
+bool ClockEstimator::addExchange(uint64_t t1, int64_t t2, int64_t t3, uint64_t t4, uint32_t &delayUs) {
+    int64_t delay = (int64_t)(t4 - t1) - (t3 - t2);
+    Point sample;
+
+    sample.deviceUs = t1;
+    sample.offsetUs = ((t2 - (int64_t)t1) + (t3 - (int64_t)t4)) / 2;
+    sample.delayUs = delay > 0 ? (uint32_t)delay : 0;
+    delayUs = sample.delayUs;
+
+    if (windowCount == 0 || sample.delayUs < best.delayUs) {
+        best = sample;
+    }
+
+    // The first window is shorter so streams get host time sooner
+    if (++windowCount < (pointCount ? PICONET_TIMESYNC_WINDOW : (PICONET_TIMESYNC_WINDOW + 1) / 2)) {
+        return false;
+    }
+
+    addPoint(best);
+    windowCount = 0;
+
+    return true;
+}
+
+void ClockEstimator::addPoint(const Point &point) {
+    points[nextPoint] = point;
+    nextPoint = (nextPoint + 1) % PICONET_TIMESYNC_POINTS;
+
+    if (pointCount < PICONET_TIMESYNC_POINTS) {
+        pointCount++;
+    }
+
+    fit();
+}
+
+void ClockEstimator::fit() {
+    const Point &newest = points[(nextPoint + PICONET_TIMESYNC_POINTS - 1) % PICONET_TIMESYNC_POINTS];
+
+    refUs = newest.deviceUs;
+    refOffsetUs = newest.offsetUs;
+
+    if (pointCount < 2) {
+        return;
+    }
+
+    // Relative to the newest point, so doubles keep microsecond precision
+    double meanX = 0;
+    double meanY = 0;
+
+    for (size_t i = 0; i < pointCount; i++) {
+        meanX += (double)(int64_t)(points[i].deviceUs - newest.deviceUs);
+        meanY += (double)(points[i].offsetUs - newest.offsetUs);
+    }
+
+    meanX /= pointCount;
+    meanY /= pointCount;
+
+    double sxx = 0;
+    double sxy = 0;
+
+    for (size_t i = 0; i < pointCount; i++) {
+        double x = (double)(int64_t)(points[i].deviceUs - newest.deviceUs) - meanX;
+        double y = (double)(points[i].offsetUs - newest.offsetUs) - meanY;
+
+        sxx += x * x;
+        sxy += x * y;
+    }
+
+    if (sxx > 0) {
+        drift = sxy / sxx;
+    }
+
+    // The line's value at the newest point, rather than that point alone
+    refOffsetUs = newest.offsetUs + (int64_t)(meanY - drift * meanX);
+}
@@ -0,0 +1,324 @@
+#include "pico-usbnet/ConnectionManager.h"
+#include "pico-usbnet/USBNetwork.h"
+
+// Private lwIP state, read by getTimeWaitCount() and nowhere else
+extern "C" {
+    #include "lwip/priv/tcp_priv.h"
+}
+
+// tcp_poll() runs every 2 coarse ticks, i.e. once a second
+#define CONN_POLL_INTERVAL 2
+
+// Keepalive probes once the idle time is up: one a second, three unanswered drop the peer
+#define CONN_KEEPALIVE_INTERVAL_MS  1000
+#define CONN_KEEPALIVE_PROBES       3
+
+// Set when a callback of the application aborted the pcb lwIP is calling us for
+static struct tcp_pcb *aborted_pcb = nullptr;
+
+ConnectionManager::ConnectionManager()
+    : pcb(nullptr), sessions(), abortiveClose(false), stats(),
+      acceptCallback(nullptr), receiveCallback(nullptr), closeCallback(nullptr) {}
+
+ConnectionManager::~ConnectionManager() {
+    stop();
+}
+
+err_t ConnectionManager::start(uint16_t port, uint8_t backlog) {
+    if (pcb) {
+        return ERR_ISCONN;
+    }
+
+    struct tcp_pcb *newpcb = tcp_new();
+
+    if (!newpcb) {
+        return ERR_MEM;
+    }
+
+    // Connections of an earlier run may still be in TIME_WAIT on this port
+    ip_set_option(newpcb, SOF_REUSEADDR);
+
+    err_t result = tcp_bind(newpcb, IP_ADDR_ANY, port);
+
+    if (result != ERR_OK) {
+        tcp_close(newpcb);
+
+        return result;
+    }
+
+    pcb = tcp_listen_with_backlog(newpcb, backlog);
+
+    if (!pcb) {
+        tcp_close(newpcb);
+
+        return ERR_MEM;
+    }
+
+    tcp_arg(pcb, this);
+    tcp_accept(pcb, acceptWrapper);
+
+    return ERR_OK;
+}
+
+void ConnectionManager::stop() {
+    if (pcb) {
+        tcp_arg(pcb, NULL);
+        tcp_accept(pcb, NULL);
+        tcp_close(pcb);
+        pcb = nullptr;
+    }
+
+    for (Session &session : sessions) {
+        if (session.pcb) {
+            end(&session, true);
+        }
+    }
+}
+
+void ConnectionManager::onAccept(AcceptCallback callback) {
+    acceptCallback = callback;
+}
+
+void ConnectionManager::onReceive(ReceiveCallback callback) {
+    receiveCallback = callback;
+}
+
+void ConnectionManager::onClose(CloseCallback callback) {
+    closeCallback = callback;
+}
+
+void ConnectionManager::setAbortiveClose(bool abortive) {
+    abortiveClose = abortive;
+}
+
+err_t ConnectionManager::write(int id, const void *data, uint16_t len) {
+    if (!isOpen(id)) {
+        return ERR_CONN;
+    }
+
+    struct tcp_pcb *tpcb = sessions[id].pcb;
+    err_t result = tcp_write(tpcb, data, len, TCP_WRITE_FLAG_COPY);
+
+    if (result == ERR_OK) {
+        sessions[id].idleSeconds = 0;
+        result = tcp_output(tpcb);
+    }
+
+    return result;
+}
+
+uint16_t ConnectionManager::getAvailableSize(int id) const {
+    return isOpen(id) ? tcp_sndbuf(sessions[id].pcb) : 0;
+}
+
+void ConnectionManager::close(int id) {
+    if (isOpen(id)) {
+        stats.localCloses++;
+        end(&sessions[id], abortiveClose);
+    }
+}
+
+void ConnectionManager::abort(int id) {
+    if (isOpen(id)) {
+        stats.localCloses++;
+        end(&sessions[id], true);
+    }
+}
+
+bool ConnectionManager::isOpen(int id) const {
+    return id >= 0 && id < PICONET_CONN_SLOTS && sessions[id].pcb != nullptr;
+}
+
+// lwIP has no public way to count TIME_WAIT pcbs, and sessions cannot count
+// them either: a pcb leaves TIME_WAIT inside lwIP's timers, or is recycled by
+// tcp_alloc(), without a callback. So this walks lwIP's private list, read-only
+// and from the lwIP context like everything else here. If that list changes in
+// an lwIP upgrade, only this function needs to follow.
+size_t ConnectionManager::getTimeWaitCount() {
+    size_t count = 0;
+
+    for (struct tcp_pcb *tpcb = tcp_tw_pcbs; tpcb != NULL; tpcb = tpcb->next) {
+        count++;
+    }
+
+    return count;
+}
+
+void ConnectionManager::resetStats() {
+    uint16_t active = stats.active;
+
+    stats = Stats();
+    stats.active = active;
+    stats.maxActive = active;
+}
+
+ConnectionManager::Session *ConnectionManager::evictionCandidate() {
+    Session *candidate = nullptr;
+
+    for (Session &session : sessions) {
+        if (session.pcb && session.idleSeconds >= PICONET_CONN_EVICT_IDLE_S &&
+            (!candidate || session.idleSeconds > candidate->idleSeconds)) {
+            candidate = &session;
+        }
+    }
+
+    return candidate;
+}
+
+// Detaches the session from its pcb and closes it; the pcb is gone at once when abortive
+void ConnectionManager::end(Session *session, bool abortive) {
+    struct tcp_pcb *tpcb = session->pcb;
+
+    tcp_arg(tpcb, NULL);
+    tcp_recv(tpcb, NULL);
+    tcp_sent(tpcb, NULL);
+    tcp_poll(tpcb, NULL, 0);
+    tcp_err(tpcb, NULL);
+
+    if (abortive || tcp_close(tpcb) != ERR_OK) {
+        tcp_abort(tpcb);
+        aborted_pcb = tpcb;
+    }
+
+    release(session);
+}
+
+void ConnectionManager::release(Session *session) {
+    session->pcb = nullptr;
+    stats.active--;
+
+    if (closeCallback) {
+        closeCallback(idOf(session));
+    }
+}
+
+err_t ConnectionManager::acceptWrapper(void *arg, struct tcp_pcb *newpcb, err_t err) {
+    ConnectionManager *instance = static_cast<ConnectionManager*>(arg);
+
+    if (err != ERR_OK || !newpcb) {
+        return ERR_VAL;
+    }
+
+    uint64_t now = time_us_64();
+    uint64_t arrived = USBNetwork::getReceiveTimeUs();
+    Session *session = nullptr;
+
+    for (Session &candidate : instance->sessions) {
+        if (!candidate.pcb) {
+            session = &candidate;
+            break;
+        }
+    }
+
+    // A reconnecting client usually left its previous session behind, idle
+    if (!session && (session = instance->evictionCandidate()) != nullptr) {
+        instance->stats.evicted++;
+        instance->end(session, true);
+    }
+
+    if (!session) {
+        instance->stats.refused++;
+        tcp_abort(newpcb);
+
+        return ERR_ABRT;
+    }
+
+    session->manager = instance;
+    session->pcb = newpcb;
+    session->idleSeconds = 0;
+
+    Stats &stats = instance->stats;
+
+    stats.accepted++;
+    stats.active++;
+    stats.maxActive = LWIP_MAX(stats.maxActive, stats.active);
+
+    if (arrived && arrived <= now) {
+        stats.lastAcceptUs = (uint32_t)(now - arrived);
+        stats.maxAcceptUs = LWIP_MAX(stats.maxAcceptUs, stats.lastAcceptUs);
+        stats.totalAcceptUs += stats.lastAcceptUs;
+    }
+
+    // Peers that vanish without a FIN are found well before the idle timeout
+    ip_set_option(newpcb, SOF_KEEPALIVE);
+    newpcb->keep_idle = PICONET_CONN_KEEPALIVE_S * 1000;
+    newpcb->keep_intvl = CONN_KEEPALIVE_INTERVAL_MS;
+    newpcb->keep_cnt = CONN_KEEPALIVE_PROBES;
+
+    tcp_arg(newpcb, session);
+    tcp_recv(newpcb, receiveWrapper);
+    tcp_sent(newpcb, sentWrapper);
+    tcp_err(newpcb, errorWrapper);
+    tcp_poll(newpcb, pollWrapper, CONN_POLL_INTERVAL);
+
+    aborted_pcb = nullptr;
+
+    if (instance->acceptCallback) {
+        instance->acceptCallback(instance->idOf(session));
+    }
+
+    return aborted_pcb == newpcb ? ERR_ABRT : ERR_OK;
+}
+
+err_t ConnectionManager::receiveWrapper(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err) {
+    Session *session = static_cast<Session*>(arg);
+    ConnectionManager *instance = session->manager;
+
+    // The peer closed its side; closing ours too means no TIME_WAIT here
+    if (!p) {
+        aborted_pcb = nullptr;
+        instance->stats.remoteCloses++;
+        instance->end(session, false);
+
+        return aborted_pcb == tpcb ? ERR_ABRT : ERR_OK;
+    }
+
+    if (err != ERR_OK) {
+        pbuf_free(p);
+
+        return err;
+    }
+
+    session->idleSeconds = 0;
+    tcp_recved(tpcb, p->tot_len);
+
+    aborted_pcb = nullptr;
+
+    if (instance->receiveCallback) {
+        instance->receiveCallback(instance->idOf(session), p);
+    }
+
+    pbuf_free(p);
+
+    return aborted_pcb == tpcb ? ERR_ABRT : ERR_OK;
+}
+
+err_t ConnectionManager::sentWrapper(void *arg, struct tcp_pcb *tpcb, u16_t len) {
+    Session *session = static_cast<Session*>(arg);
+
+    session->idleSeconds = 0;
+
+    return ERR_OK;
+}
+
+err_t ConnectionManager::pollWrapper(void *arg, struct tcp_pcb *tpcb) {
+    Session *session = static_cast<Session*>(arg);
+    ConnectionManager *instance = session->manager;
+
+    if (++session->idleSeconds >= PICONET_CONN_IDLE_TIMEOUT_S) {
+        instance->stats.idleAborts++;
+        instance->end(session, true);
+
+        return ERR_ABRT;
+    }
+
+    return ERR_OK;
+}
+
+void ConnectionManager::errorWrapper(void *arg, err_t err) {
+    Session *session = static_cast<Session*>(arg);
+
+    // lwIP has already freed the pcb
+    session->manager->stats.resets++;
+    session->manager->release(session);
+}
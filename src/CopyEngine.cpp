@@ -0,0 +1,147 @@
+#include <cstring>
+
+#include "pico-usbnet/CopyEngine.h"
+
+extern "C" {
+    #include "pico/stdlib.h"
+    #include "pico/sync.h"
+}
+
+#if PICONET_COPY_DMA
+#include "hardware/dma.h"
+#endif
+
+CopyEngine *CopyEngine::installed = nullptr;
+size_t CopyEngine::threshold = PICONET_COPY_THRESHOLD;
+unsigned CopyEngine::ownerCore = 0;
+
+void CopyEngine::wait() {
+    while (busy()) {
+    }
+}
+
+void CopyEngine::install(CopyEngine *engine, size_t threshold) {
+    // Nothing may still be in flight on the engine being replaced
+    finish();
+
+    installed = engine;
+    CopyEngine::threshold = threshold;
+    ownerCore = get_core_num();
+}
+
+bool CopyEngine::usable() {
+    return installed && get_core_num() == ownerCore && !__get_current_exception();
+}
+
+CopyEngine *CopyEngine::getInstalled() {
+    return installed;
+}
+
+bool CopyEngine::copyAsync(void *dst, const void *src, size_t length) {
+    if (length >= threshold && usable() && installed->start(dst, src, length)) {
+        return true;
+    }
+
+    memcpy(dst, src, length);
+
+    return false;
+}
+
+void CopyEngine::finish() {
+    // Anywhere else, nothing was started on the engine
+    if (usable()) {
+        installed->wait();
+    }
+}
+
+void CopyEngine::copy(void *dst, const void *src, size_t length) {
+    if (copyAsync(dst, src, length)) {
+        finish();
+    }
+}
+
+bool CpuCopyEngine::start(void *dst, const void *src, size_t length) {
+    memcpy(dst, src, length);
+
+    return true;
+}
+
+#if PICONET_COPY_DMA
+DmaCopyEngine::DmaCopyEngine() : channel(-1) {}
+
+bool DmaCopyEngine::claim() {
+    if (channel < 0) {
+        channel = dma_claim_unused_channel(false);
+    }
+
+    return channel >= 0;
+}
+
+void DmaCopyEngine::unclaim() {
+    if (channel >= 0) {
+        wait();
+        dma_channel_unclaim(channel);
+        channel = -1;
+    }
+}
+
+bool DmaCopyEngine::start(void *dst, const void *src, size_t length) {
+    if (channel < 0 || queue.full()) {
+        return false;
+    }
+
+    uint8_t *out = static_cast<uint8_t *>(dst);
+    const uint8_t *in = static_cast<const uint8_t *>(src);
+    size_t head = (4 - ((uintptr_t)out & 3)) & 3;
+
+    if ((((uintptr_t)out ^ (uintptr_t)in) & 3) == 0 && length >= head + 4) {
+        // Equally aligned: CPU for the ragged ends, DMA words for the rest
+        size_t words = (length - head) / 4;
+        size_t tail = length - head - words * 4;
+
+        memcpy(out, in, head);
+        memcpy(out + head + words * 4, in + head + words * 4, tail);
+
+        queue.push({out + head, in + head, (uint32_t)words, true});
+    } else {
+        queue.push({out, in, (uint32_t)length, false});
+    }
+
+    kick();
+
+    return true;
+}
+
+bool DmaCopyEngine::busy() {
+    if (channel < 0) {
+        return false;
+    }
+
+    if (dma_channel_is_busy(channel)) {
+        return true;
+    }
+
+    if (queue.empty()) {
+        return false;
+    }
+
+    kick();
+
+    return true;
+}
+
+void DmaCopyEngine::kick() {
+    Segment segment;
+
+    if (dma_channel_is_busy(channel) || !queue.pop(segment)) {
+        return;
+    }
+
+    dma_channel_config config = dma_channel_get_default_config(channel);
+    channel_config_set_transfer_data_size(&config, segment.words ? DMA_SIZE_32 : DMA_SIZE_8);
+    channel_config_set_read_increment(&config, true);
+    channel_config_set_write_increment(&config, true);
+
+    dma_channel_configure(channel, &config, segment.dst, segment.src, segment.count, true);
+}
+#endif
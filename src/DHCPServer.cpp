@@ -0,0 +1,827 @@
+#include <cstring>
+
+#include "pico-usbnet/DHCPServer.h"
+
+extern "C" {
+    #include "lwip/etharp.h"
+    #include "lwip/timeouts.h"
+
+#if PICONET_DHCP_PERSIST
+    #include "hardware/flash.h"
+    #include "hardware/sync.h"
+#endif
+}
+
+#define DHCP_CLIENT_PORT        68
+#define DHCP_OPTIONS_OFFSET     240
+#define DHCP_MIN_REPLY          300
+#define DHCP_MAGIC              0x63825363
+
+#define DHCP_DISCOVER           1
+#define DHCP_OFFER              2
+#define DHCP_REQUEST            3
+#define DHCP_DECLINE            4
+#define DHCP_ACK                5
+#define DHCP_NAK                6
+#define DHCP_RELEASE            7
+#define DHCP_INFORM             8
+
+#define OPTION_PAD              0
+#define OPTION_SUBNET_MASK      1
+#define OPTION_ROUTER           3
+#define OPTION_DNS              6
+#define OPTION_DOMAIN           15
+#define OPTION_REQUESTED_IP     50
+#define OPTION_LEASE_TIME       51
+#define OPTION_MESSAGE_TYPE     53
+#define OPTION_SERVER_ID        54
+#define OPTION_RENEWAL_TIME     58
+#define OPTION_REBINDING_TIME   59
+#define OPTION_END              255
+
+// How long an offered address is held for the client's REQUEST
+#define OFFER_HOLD_MS           (60 * 1000)
+
+static_assert(PICONET_DHCP_STATIC_ARP < ARP_TABLE_SIZE, "static ARP entries would fill the ARP table");
+static_assert(PICONET_DHCP_MAX_ENTRIES <= PICONET_DHCP_POOL_MAX, "address list larger than the pool bitmap");
+
+static uint8_t message_buffer[576];
+
+static uint32_t readBE32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint8_t *writeBE32(uint8_t *p, uint32_t value) {
+    p[0] = (uint8_t)(value >> 24);
+    p[1] = (uint8_t)(value >> 16);
+    p[2] = (uint8_t)(value >> 8);
+    p[3] = (uint8_t)value;
+
+    return p + 4;
+}
+
+static uint8_t *writeAddressOption(uint8_t *p, uint8_t code, const ip4_addr_t &address) {
+    *p++ = code;
+    *p++ = 4;
+    memcpy(p, &address.addr, 4);
+
+    return p + 4;
+}
+
+static uint32_t hashMac(const uint8_t *mac) {
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < 6; i++) {
+        hash = (hash ^ mac[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+static bool expired(uint32_t deadline) {
+    return (int32_t)(sys_now() - deadline) >= 0;
+}
+
+#if PICONET_DHCP_PERSIST
+#define STORE_MAGIC             0x50444843  // "CHDP"
+
+struct StoredHeader {
+    uint32_t magic;
+    uint32_t poolFirst;
+    uint16_t poolSize;
+    uint16_t count;
+    uint32_t checksum;
+};
+
+struct StoredLease {
+    uint8_t mac[6];
+    uint16_t offset;
+};
+
+#define STORE_SIZE ((sizeof(StoredHeader) + PICONET_DHCP_LEASES * sizeof(StoredLease) + FLASH_PAGE_SIZE - 1) / \
+                    FLASH_PAGE_SIZE * FLASH_PAGE_SIZE)
+
+static_assert(STORE_SIZE <= FLASH_SECTOR_SIZE, "DHCP bindings do not fit in one flash sector");
+
+static uint8_t flash_image[STORE_SIZE];
+
+static uint32_t checksum(const uint8_t *data, size_t length) {
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+
+    return hash;
+}
+#endif
+
+DHCPServer::DHCPServer()
+    : pcb(nullptr), leases(), leaseCount(0), used(), serverIp(), netmask(), router(), dns(),
+      domain(nullptr), poolFirst(0), poolSize(0), leaseTime(PICONET_DHCP_LEASE_TIME), staticArp(0),
+      savePending(false), startedAt(0), stats() {}
+
+DHCPServer::~DHCPServer() {
+    stop();
+}
+
+void DHCPServer::configure(const ip_addr_t &serverIp, const ip_addr_t &netmask, const ip_addr_t &router,
+                           const ip_addr_t &dns, const char *domain, const DHCPPool &pool) {
+    // Drop bindings (and their ARP entries) from any previous pool
+    clearLeases();
+
+    this->serverIp = *ip_2_ip4(&serverIp);
+    this->netmask = *ip_2_ip4(&netmask);
+    this->router = *ip_2_ip4(&router);
+    this->dns = *ip_2_ip4(&dns);
+    this->domain = domain;
+
+    uint32_t server = lwip_ntohl(ip4_addr_get_u32(&this->serverIp));
+    uint32_t mask = lwip_ntohl(ip4_addr_get_u32(&this->netmask));
+    uint32_t first = lwip_ntohl(ip4_addr_get_u32(ip_2_ip4(&pool.first)));
+    // Keep the pool inside the subnet, short of its broadcast address
+    uint32_t broadcast = (server & mask) | ~mask;
+
+    addresses.clear();
+
+    for (const ip_addr_t &entry : pool.addresses) {
+        uint32_t address = lwip_ntohl(ip4_addr_get_u32(ip_2_ip4(&entry)));
+
+        if ((address & mask) == (server & mask) && address != broadcast && address != (server & mask)) {
+            (void)addresses.push_back(address);
+        }
+    }
+
+    leaseTime = LWIP_MIN(pool.leaseTime, (uint32_t)(0x7fffffff / 1000));
+    memset(used, 0, sizeof(used));
+
+    if (!pool.addresses.empty()) {
+        // Stored bindings are matched against the first address and the count
+        poolFirst = addresses.empty() ? 0 : addresses[0];
+        poolSize = (uint16_t)addresses.size();
+        reserveFixed();
+
+        return;
+    }
+
+    if (first == 0) {
+        first = server + 1;
+    }
+
+    uint32_t size = LWIP_MIN((uint32_t)pool.size, (uint32_t)PICONET_DHCP_POOL_MAX);
+
+    if ((first & mask) != (server & mask) || first >= broadcast) {
+        size = 0;
+    } else {
+        size = LWIP_MIN(size, broadcast - first);
+    }
+
+    poolFirst = first;
+    poolSize = (uint16_t)size;
+    reserveFixed();
+}
+
+err_t DHCPServer::start(uint16_t port) {
+    if (pcb) {
+        return ERR_ISCONN;
+    }
+
+    pcb = udp_new();
+
+    if (!pcb) {
+        return ERR_MEM;
+    }
+
+    err_t result = udp_bind(pcb, IP_ADDR_ANY, port);
+
+    if (result != ERR_OK) {
+        udp_remove(pcb);
+        pcb = nullptr;
+
+        return result;
+    }
+
+    udp_recv(pcb, receiveWrapper, this);
+    startedAt = sys_now();
+
+    load();
+
+    return ERR_OK;
+}
+
+void DHCPServer::stop() {
+    if (pcb) {
+        udp_remove(pcb);
+        pcb = nullptr;
+    }
+
+    // Write out the batch still waiting for its timer
+    if (savePending) {
+        sys_untimeout(saveWrapper, this);
+        savePending = false;
+        save();
+    }
+}
+
+void DHCPServer::clearLeases() {
+    bool persisted = false;
+
+    for (Lease &lease : leases) {
+        if (lease.state != Empty) {
+            unseedArp(&lease);
+        }
+
+        persisted |= lease.saved;
+        lease.state = Empty;
+        lease.saved = false;
+    }
+
+    leaseCount = 0;
+    memset(used, 0, sizeof(used));
+    reserveFixed();
+
+    if (persisted) {
+        scheduleSave();
+    }
+}
+
+void DHCPServer::reserveFixed() {
+    // Never hand out the device or the router
+    const ip4_addr_t *fixed[] = {&serverIp, &router};
+
+    for (const ip4_addr_t *address : fixed) {
+        uint16_t offset;
+
+        if (offsetOf(lwip_ntohl(ip4_addr_get_u32(address)), offset)) {
+            setUsed(offset, true);
+        }
+    }
+}
+
+void DHCPServer::resetStats() {
+    stats = Stats();
+}
+
+void DHCPServer::setUsed(uint16_t offset, bool value) {
+    if (value) {
+        used[offset / 8] |= (uint8_t)(1u << (offset % 8));
+    } else {
+        used[offset / 8] &= (uint8_t)~(1u << (offset % 8));
+    }
+}
+
+bool DHCPServer::offsetOf(uint32_t address, uint16_t &offset) const {
+    if (addresses.empty()) {
+        if (address - poolFirst >= poolSize) {
+            return false;
+        }
+
+        offset = (uint16_t)(address - poolFirst);
+
+        return true;
+    }
+
+    for (size_t i = 0; i < addresses.size(); i++) {
+        if (addresses[i] == address) {
+            offset = (uint16_t)i;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+uint32_t DHCPServer::addressAt(uint16_t offset) const {
+    return addresses.empty() ? poolFirst + offset : addresses[offset];
+}
+
+void DHCPServer::addressOf(uint16_t offset, ip4_addr_t *address) const {
+    ip4_addr_set_u32(address, lwip_htonl(addressAt(offset)));
+}
+
+DHCPServer::Lease *DHCPServer::find(const uint8_t *mac) {
+    size_t index = hashMac(mac) & (PICONET_DHCP_LEASES - 1);
+
+    while (leases[index].state != Empty) {
+        if (memcmp(leases[index].mac, mac, 6) == 0) {
+            return &leases[index];
+        }
+
+        index = (index + 1) & (PICONET_DHCP_LEASES - 1);
+    }
+
+    return nullptr;
+}
+
+DHCPServer::Lease *DHCPServer::insert(const uint8_t *mac, uint16_t offset) {
+    // One slot always stays empty so probing terminates
+    if (leaseCount >= PICONET_DHCP_LEASES - 1 && !reclaimExpired()) {
+        return nullptr;
+    }
+
+    size_t index = hashMac(mac) & (PICONET_DHCP_LEASES - 1);
+
+    while (leases[index].state != Empty) {
+        index = (index + 1) & (PICONET_DHCP_LEASES - 1);
+    }
+
+    Lease &lease = leases[index];
+
+    memcpy(lease.mac, mac, 6);
+    lease.offset = offset;
+    lease.expiry = sys_now() + OFFER_HOLD_MS;
+    lease.state = Offered;
+    lease.saved = false;
+    lease.arpStatic = false;
+    leaseCount++;
+
+    return &lease;
+}
+
+// Backward-shift deletion keeps every probe sequence intact without tombstones
+void DHCPServer::remove(Lease *lease) {
+    size_t hole = lease - leases;
+    size_t index = hole;
+
+    leases[hole].state = Empty;
+    leaseCount--;
+
+    while (true) {
+        index = (index + 1) & (PICONET_DHCP_LEASES - 1);
+
+        if (leases[index].state == Empty) {
+            break;
+        }
+
+        size_t home = hashMac(leases[index].mac) & (PICONET_DHCP_LEASES - 1);
+        bool reachable = hole <= index ? (hole < home && home <= index) : (hole < home || home <= index);
+
+        if (!reachable) {
+            leases[hole] = leases[index];
+            leases[index].state = Empty;
+            hole = index;
+        }
+    }
+}
+
+bool DHCPServer::allocate(const uint8_t *mac, uint32_t requested, uint16_t &offset) {
+    if (!poolSize) {
+        return false;
+    }
+
+    uint16_t wanted;
+
+    if (offsetOf(requested, wanted) && !isUsed(wanted)) {
+        offset = wanted;
+        setUsed(offset, true);
+
+        return true;
+    }
+
+    // Start from the MAC's hash so a host tends to get the same address back
+    for (int attempt = 0; attempt < 2; attempt++) {
+        uint16_t start = hashMac(mac) % poolSize;
+
+        for (uint16_t i = 0; i < poolSize; i++) {
+            uint16_t candidate = (uint16_t)((start + i) % poolSize);
+
+            if (!isUsed(candidate)) {
+                offset = candidate;
+                setUsed(offset, true);
+
+                return true;
+            }
+        }
+
+        if (!reclaimExpired()) {
+            break;
+        }
+    }
+
+    return false;
+}
+
+bool DHCPServer::reclaimExpired() {
+    bool reclaimed = false;
+    bool persisted = false;
+
+    for (size_t i = 0; i < PICONET_DHCP_LEASES;) {
+        Lease &lease = leases[i];
+
+        if (lease.state == Empty || !expired(lease.expiry)) {
+            i++;
+            continue;
+        }
+
+        unseedArp(&lease);
+        persisted |= lease.saved;
+        setUsed(lease.offset, false);
+        // The shift may move another lease into slot i, so look at it again
+        remove(&lease);
+        reclaimed = true;
+    }
+
+    if (persisted) {
+        scheduleSave();
+    }
+
+    return reclaimed;
+}
+
+void DHCPServer::seedArp(Lease *lease) {
+    // Static entries never leave the ARP table; keep room for dynamic ones
+    if (staticArp >= PICONET_DHCP_STATIC_ARP) {
+        stats.arpDynamic++;
+
+        return;
+    }
+
+    ip4_addr_t address;
+    struct eth_addr ethaddr;
+
+    addressOf(lease->offset, &address);
+    memcpy(ethaddr.addr, lease->mac, 6);
+
+    if (etharp_add_static_entry(&address, &ethaddr) == ERR_OK) {
+        lease->arpStatic = true;
+        staticArp++;
+        stats.arpSeeded++;
+    } else {
+        stats.arpDynamic++;
+    }
+}
+
+void DHCPServer::unseedArp(Lease *lease) {
+    if (!lease->arpStatic) {
+        return;
+    }
+
+    ip4_addr_t address;
+
+    addressOf(lease->offset, &address);
+    etharp_remove_static_entry(&address);
+    lease->arpStatic = false;
+    staticArp--;
+}
+
+void DHCPServer::load() {
+#if PICONET_DHCP_PERSIST
+    const uint8_t *stored = reinterpret_cast<const uint8_t *>(XIP_BASE + PICONET_DHCP_FLASH_OFFSET);
+    StoredHeader header;
+
+    memcpy(&header, stored, sizeof(header));
+
+    // Bindings for a different pool are stale
+    if (header.magic != STORE_MAGIC || header.poolFirst != poolFirst || header.poolSize != poolSize ||
+        header.count > PICONET_DHCP_LEASES - 1) {
+        return;
+    }
+
+    const uint8_t *records = stored + sizeof(header);
+
+    if (checksum(records, header.count * sizeof(StoredLease)) != header.checksum) {
+        return;
+    }
+
+    for (uint16_t i = 0; i < header.count; i++) {
+        StoredLease record;
+        memcpy(&record, records + i * sizeof(StoredLease), sizeof(record));
+
+        if (record.offset >= poolSize || isUsed(record.offset) || find(record.mac)) {
+            continue;
+        }
+
+        Lease *lease = insert(record.mac, record.offset);
+
+        if (!lease) {
+            break;
+        }
+
+        setUsed(record.offset, true);
+        lease->state = Bound;
+        lease->expiry = sys_now() + leaseTime * 1000;
+        lease->saved = true;
+        seedArp(lease);
+    }
+#endif
+}
+
+void DHCPServer::scheduleSave() {
+#if PICONET_DHCP_PERSIST
+    if (!savePending) {
+        savePending = true;
+        sys_timeout(PICONET_DHCP_SAVE_DELAY_MS, saveWrapper, this);
+    }
+#endif
+}
+
+void DHCPServer::saveWrapper(void *arg) {
+    DHCPServer *instance = static_cast<DHCPServer*>(arg);
+
+    instance->savePending = false;
+    instance->save();
+}
+
+void DHCPServer::save() {
+#if PICONET_DHCP_PERSIST
+    StoredHeader header = {STORE_MAGIC, poolFirst, poolSize, 0, 0};
+    uint8_t *records = flash_image + sizeof(header);
+
+    memset(flash_image, 0xff, sizeof(flash_image));
+
+    for (Lease &lease : leases) {
+        if (lease.state != Bound) {
+            continue;
+        }
+
+        StoredLease record;
+        memcpy(record.mac, lease.mac, 6);
+        record.offset = lease.offset;
+        memcpy(records + header.count * sizeof(StoredLease), &record, sizeof(record));
+
+        header.count++;
+        lease.saved = true;
+    }
+
+    header.checksum = checksum(records, header.count * sizeof(StoredLease));
+    memcpy(flash_image, &header, sizeof(header));
+
+    uint32_t state = save_and_disable_interrupts();
+    flash_range_erase(PICONET_DHCP_FLASH_OFFSET, FLASH_SECTOR_SIZE);
+    flash_range_program(PICONET_DHCP_FLASH_OFFSET, flash_image, sizeof(flash_image));
+    restore_interrupts(state);
+
+    stats.flashWrites++;
+#endif
+}
+
+void DHCPServer::handleMessage(struct pbuf *p) {
+    uint16_t length = pbuf_copy_partial(p, message_buffer, sizeof(message_buffer), 0);
+    const uint8_t *request = message_buffer;
+
+    // BOOTREQUEST over Ethernet carrying the DHCP magic cookie
+    if (length < DHCP_OPTIONS_OFFSET || request[0] != 1 || request[1] != 1 || request[2] != 6 ||
+        readBE32(request + 236) != DHCP_MAGIC) {
+        return;
+    }
+
+    uint8_t type = 0;
+    uint32_t requested = 0;
+    uint32_t serverId = 0;
+
+    for (size_t offset = DHCP_OPTIONS_OFFSET; offset < length;) {
+        uint8_t code = request[offset++];
+
+        if (code == OPTION_PAD) {
+            continue;
+        }
+
+        if (code == OPTION_END || offset >= length || offset + 1 + request[offset] > length) {
+            break;
+        }
+
+        uint8_t size = request[offset++];
+        const uint8_t *value = request + offset;
+
+        if (code == OPTION_MESSAGE_TYPE && size == 1) {
+            type = value[0];
+        } else if (code == OPTION_REQUESTED_IP && size == 4) {
+            requested = readBE32(value);
+        } else if (code == OPTION_SERVER_ID && size == 4) {
+            serverId = readBE32(value);
+        }
+
+        offset += size;
+    }
+
+    const uint8_t *mac = request + 28;
+    uint32_t ciaddr = readBE32(request + 12);
+    uint32_t server = lwip_ntohl(ip4_addr_get_u32(&serverIp));
+    Lease *lease = find(mac);
+
+    switch (type) {
+    case DHCP_DISCOVER: {
+        stats.discovers++;
+
+        if (!lease) {
+            uint16_t offset;
+
+            if (!allocate(mac, requested, offset)) {
+                stats.exhausted++;
+
+                return;
+            }
+
+            lease = insert(mac, offset);
+
+            if (!lease) {
+                setUsed(offset, false);
+                stats.exhausted++;
+
+                return;
+            }
+        } else if (lease->state == Offered) {
+            lease->expiry = sys_now() + OFFER_HOLD_MS;
+        }
+
+        reply(request, DHCP_OFFER, lease, false);
+        stats.offers++;
+        break;
+    }
+
+    case DHCP_REQUEST: {
+        // The client picked another server's offer
+        if (serverId && serverId != server) {
+            if (lease && lease->state == Offered) {
+                setUsed(lease->offset, false);
+                remove(lease);
+            }
+
+            return;
+        }
+
+        uint32_t target = requested ? requested : ciaddr;
+
+        if (lease && addressAt(lease->offset) != target) {
+            if (lease->state == Bound) {
+                reply(request, DHCP_NAK, nullptr, false);
+                stats.naks++;
+
+                return;
+            }
+
+            setUsed(lease->offset, false);
+            remove(lease);
+            lease = nullptr;
+        }
+
+        // INIT-REBOOT or a renewal from a host we no longer know about
+        if (!lease) {
+            uint16_t offset;
+
+            if (!offsetOf(target, offset) || isUsed(offset) || !(lease = insert(mac, offset))) {
+                reply(request, DHCP_NAK, nullptr, false);
+                stats.naks++;
+
+                return;
+            }
+
+            setUsed(offset, true);
+        }
+
+        bool granted = lease->state != Bound;
+
+        lease->state = Bound;
+        lease->expiry = sys_now() + leaseTime * 1000;
+
+        if (granted) {
+            seedArp(lease);
+        }
+
+        if (!lease->saved) {
+            scheduleSave();
+        }
+
+        reply(request, DHCP_ACK, lease, ciaddr != 0);
+        stats.acks++;
+
+        if (!stats.firstAckMs) {
+            stats.firstAckMs = LWIP_MAX(sys_now() - startedAt, (uint32_t)1);
+        }
+        break;
+    }
+
+    case DHCP_DECLINE:
+        // Someone else answers to that address: keep it out of the pool until reboot
+        if (lease) {
+            bool persisted = lease->saved;
+
+            unseedArp(lease);
+            remove(lease);
+
+            if (persisted) {
+                scheduleSave();
+            }
+        }
+        break;
+
+    case DHCP_RELEASE:
+        if (lease && lease->state == Bound) {
+            bool persisted = lease->saved;
+
+            unseedArp(lease);
+            setUsed(lease->offset, false);
+            remove(lease);
+            stats.releases++;
+
+            if (persisted) {
+                scheduleSave();
+            }
+        }
+        break;
+
+    case DHCP_INFORM:
+        // Configured by other means; only hand out the options
+        if (ciaddr) {
+            reply(request, DHCP_ACK, nullptr, true);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+void DHCPServer::reply(const uint8_t *request, uint8_t type, const Lease *lease, bool unicast) {
+    size_t domainLength = domain ? strlen(domain) : 0;
+
+    if (domainLength > 255) {
+        domainLength = 0;
+    }
+
+    size_t size = LWIP_MAX((size_t)DHCP_MIN_REPLY, (size_t)DHCP_OPTIONS_OFFSET + 60 + domainLength);
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, (u16_t)size, PBUF_RAM);
+
+    if (!p) {
+        return;
+    }
+
+    uint8_t *out = static_cast<uint8_t *>(p->payload);
+
+    memset(out, 0, size);
+    out[0] = 2;                                 // BOOTREPLY
+    out[1] = 1;
+    out[2] = 6;
+    memcpy(out + 4, request + 4, 4);            // xid
+    memcpy(out + 10, request + 10, 2);          // flags
+    memcpy(out + 12, request + 12, 4);          // ciaddr
+    memcpy(out + 24, request + 24, 20);         // giaddr, chaddr
+    writeBE32(out + 236, DHCP_MAGIC);
+
+    if (lease) {
+        ip4_addr_t address;
+        addressOf(lease->offset, &address);
+        memcpy(out + 16, &address.addr, 4);     // yiaddr
+    }
+
+    uint8_t *option = out + DHCP_OPTIONS_OFFSET;
+
+    *option++ = OPTION_MESSAGE_TYPE;
+    *option++ = 1;
+    *option++ = type;
+    option = writeAddressOption(option, OPTION_SERVER_ID, serverIp);
+
+    if (type != DHCP_NAK) {
+        if (lease) {
+            *option++ = OPTION_LEASE_TIME;
+            *option++ = 4;
+            option = writeBE32(option, leaseTime);
+            *option++ = OPTION_RENEWAL_TIME;
+            *option++ = 4;
+            option = writeBE32(option, leaseTime / 2);
+            *option++ = OPTION_REBINDING_TIME;
+            *option++ = 4;
+            option = writeBE32(option, leaseTime / 8 * 7);
+        }
+
+        option = writeAddressOption(option, OPTION_SUBNET_MASK, netmask);
+
+        if (ip4_addr_get_u32(&router)) {
+            option = writeAddressOption(option, OPTION_ROUTER, router);
+        }
+
+        if (ip4_addr_get_u32(&dns)) {
+            option = writeAddressOption(option, OPTION_DNS, dns);
+        }
+
+        if (domainLength) {
+            *option++ = OPTION_DOMAIN;
+            *option++ = (uint8_t)domainLength;
+            memcpy(option, domain, domainLength);
+            option += domainLength;
+        }
+    }
+
+    *option = OPTION_END;
+
+    // Clients without an address only hear broadcasts
+    ip_addr_t destination;
+    ip_addr_copy(destination, *IP_ADDR_BROADCAST);
+
+    if (unicast) {
+        memcpy(&ip_2_ip4(&destination)->addr, request + 12, 4);
+    }
+
+    udp_sendto(pcb, p, &destination, DHCP_CLIENT_PORT);
+    pbuf_free(p);
+}
+
+void DHCPServer::receiveWrapper(void *arg, struct udp_pcb *upcb, struct pbuf *p,
+                                const ip_addr_t *addr, uint16_t port) {
+    DHCPServer *instance = static_cast<DHCPServer*>(arg);
+
+    instance->handleMessage(p);
+
+    pbuf_free(p);
+}
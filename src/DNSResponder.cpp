@@ -0,0 +1,262 @@
+#include <cstring>
+
+#include "pico-usbnet/DNSResponder.h"
+
+#define DNS_HEADER_SIZE     12
+#define DNS_FLAG_QR         0x80
+#define DNS_FLAG_AA         0x04
+#define DNS_FLAG_RD         0x01
+#define DNS_TYPE_A          1
+#define DNS_TYPE_ANY        255
+#define DNS_CLASS_IN        1
+#define DNS_CLASS_ANY       255
+
+enum DnsRcode : uint8_t {
+    RCODE_NOERROR = 0,
+    RCODE_FORMERR = 1,
+    RCODE_NXDOMAIN = 3,
+    RCODE_NOTIMP = 4,
+    RCODE_REFUSED = 5,
+};
+
+static uint32_t hashName(const uint8_t *name, size_t length) {
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ name[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+// "a.b" -> "\1a\1b" in lowercase, without the root label; 0 if it does not fit
+static size_t encodeName(const char *text, uint8_t *out, size_t capacity) {
+    size_t length = 0;
+
+    while (*text) {
+        const char *dot = strchr(text, '.');
+        size_t label = dot ? (size_t)(dot - text) : strlen(text);
+
+        if (label == 0 || label > 63 || length + 1 + label > capacity) {
+            return 0;
+        }
+
+        out[length++] = (uint8_t)label;
+
+        for (size_t i = 0; i < label; i++) {
+            char c = text[i];
+            out[length++] = (uint8_t)((c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c);
+        }
+
+        text += label + (dot ? 1 : 0);
+    }
+
+    return length;
+}
+
+DNSResponder::DNSResponder() : domainLength(0), stats() {
+    setDomain(PICONET_DNS_DOMAIN);
+}
+
+bool DNSResponder::addRecord(const char *name, uint32_t address) {
+    Record record;
+
+    record.nameLength = (uint8_t)encodeName(name, record.name, sizeof(record.name));
+
+    if (!record.nameLength) {
+        return false;
+    }
+
+    record.hash = hashName(record.name, record.nameLength);
+
+    uint32_t ttl = PICONET_DNS_TTL;
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&address);
+    const uint8_t answer[answerLength] = {
+        0xc0, DNS_HEADER_SIZE,                  // name: pointer to the question
+        0x00, DNS_TYPE_A,
+        0x00, DNS_CLASS_IN,
+        (uint8_t)(ttl >> 24), (uint8_t)(ttl >> 16), (uint8_t)(ttl >> 8), (uint8_t)ttl,
+        0x00, 0x04,
+        bytes[0], bytes[1], bytes[2], bytes[3],
+    };
+
+    memcpy(record.answer, answer, answerLength);
+
+    // Re-adding a name replaces its address
+    for (Record &existing : records) {
+        if (existing.hash == record.hash && existing.nameLength == record.nameLength &&
+            memcmp(existing.name, record.name, record.nameLength) == 0) {
+            existing = record;
+
+            return true;
+        }
+    }
+
+    return records.push_back(record);
+}
+
+void DNSResponder::clear() {
+    records.clear();
+}
+
+void DNSResponder::setDomain(const char *domain) {
+    domainLength = (uint8_t)encodeName(domain, this->domain, sizeof(this->domain));
+}
+
+
+void DNSResponder::resetStats() {
+    stats = Stats();
+}
+
+const DNSResponder::Record *DNSResponder::find(const uint8_t *name, size_t length) const {
+    uint32_t hash = hashName(name, length);
+
+    for (const Record &record : records) {
+        if (record.hash == hash && record.nameLength == length && memcmp(record.name, name, length) == 0) {
+            return &record;
+        }
+    }
+
+    return nullptr;
+}
+
+size_t DNSResponder::respond(const uint8_t *query, size_t length, uint8_t *response, size_t capacity) {
+
+    // Too short to answer, or a response looping back
+    if (length < DNS_HEADER_SIZE || (query[2] & DNS_FLAG_QR) || capacity < length + answerLength) {
+        stats.malformed++;
+
+        return 0;
+    }
+
+    stats.queries++;
+
+    uint8_t opcode = (query[2] >> 3) & 0x0f;
+    uint16_t questions = (query[4] << 8) | query[5];
+    uint8_t rcode = RCODE_NOERROR;
+    size_t questionEnd = DNS_HEADER_SIZE;
+    const Record *record = nullptr;
+    bool answer = false;
+
+    // Lowercased question name without the root label
+    uint8_t name[maxNameLength];
+    size_t nameLength = 0;
+    size_t labels = 0;
+
+    if (opcode != 0) {
+        rcode = RCODE_NOTIMP;
+    } else if (questions != 1) {
+        rcode = RCODE_FORMERR;
+    } else {
+        size_t offset = DNS_HEADER_SIZE;
+        bool valid = false;
+
+        while (offset < length) {
+            uint8_t label = query[offset++];
+
+            if (label == 0) {
+                valid = true;
+                break;
+            }
+
+            // Compression pointers never appear in a query's only question
+            if ((label & 0xc0) || offset + label > length || nameLength + 1 + label > sizeof(name)) {
+                break;
+            }
+
+            name[nameLength++] = label;
+
+            for (uint8_t i = 0; i < label; i++) {
+                uint8_t c = query[offset++];
+                name[nameLength++] = (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+            }
+
+            labels++;
+        }
+
+        if (!valid || offset + 4 > length) {
+            rcode = RCODE_FORMERR;
+        } else {
+            uint16_t type = (query[offset] << 8) | query[offset + 1];
+            uint16_t qclass = (query[offset + 2] << 8) | query[offset + 3];
+            questionEnd = offset + 4;
+
+            // Strip the local domain; a bare label is taken as local too
+            size_t localLength = 0;
+            bool local = false;
+
+            if (nameLength == domainLength && memcmp(name, domain, domainLength) == 0) {
+                local = true;
+            } else if (labels == 1) {
+                local = true;
+                localLength = nameLength;
+            } else if (domainLength && nameLength > domainLength &&
+                       memcmp(name + nameLength - domainLength, domain, domainLength) == 0) {
+                // The suffix must start on a label boundary
+                size_t boundary = 0;
+
+                while (boundary < nameLength - domainLength) {
+                    boundary += 1 + name[boundary];
+                }
+
+                local = boundary == nameLength - domainLength;
+                localLength = boundary;
+            }
+
+            if (!local || (qclass != DNS_CLASS_IN && qclass != DNS_CLASS_ANY)) {
+                rcode = RCODE_REFUSED;
+            } else if (localLength == 0) {
+                // The domain itself exists but has no address
+                rcode = RCODE_NOERROR;
+            } else if ((record = find(name, localLength)) == nullptr) {
+                rcode = RCODE_NXDOMAIN;
+            } else {
+                answer = type == DNS_TYPE_A || type == DNS_TYPE_ANY;
+            }
+        }
+    }
+
+    // Echo the question when it parsed, as resolvers match on it
+    bool echo = rcode != RCODE_FORMERR && rcode != RCODE_NOTIMP;
+    size_t questionLength = echo ? questionEnd - DNS_HEADER_SIZE : 0;
+    size_t size = DNS_HEADER_SIZE + questionLength + (answer ? answerLength : 0);
+
+    uint8_t *out = response;
+
+    out[0] = query[0];
+    out[1] = query[1];
+    out[2] = DNS_FLAG_QR | (opcode << 3) | DNS_FLAG_AA | (query[2] & DNS_FLAG_RD);
+    out[3] = rcode;
+    out[4] = 0;
+    out[5] = echo ? 1 : 0;
+    out[6] = 0;
+    out[7] = answer ? 1 : 0;
+    memset(out + 8, 0, 4);
+
+    memcpy(out + DNS_HEADER_SIZE, query + DNS_HEADER_SIZE, questionLength);
+
+    if (answer) {
+        memcpy(out + DNS_HEADER_SIZE + questionLength, record->answer, answerLength);
+    }
+
+    switch (rcode) {
+    case RCODE_NOERROR:
+        if (answer) {
+            stats.answered++;
+        } else {
+            stats.noData++;
+        }
+        break;
+    case RCODE_NXDOMAIN:
+        stats.nxDomain++;
+        break;
+    case RCODE_REFUSED:
+        stats.refused++;
+        break;
+    default:
+        stats.malformed++;
+        break;
+    }
+
+    return size;
+}
@@ -0,0 +1,88 @@
+#include "pico-usbnet/DNSServer.h"
+
+// Queries without EDNS are at most 512 bytes; only the question is needed
+static uint8_t query_buffer[512];
+
+DNSServer::DNSServer() : pcb(nullptr) {}
+
+DNSServer::~DNSServer() {
+    stop();
+}
+
+bool DNSServer::addRecord(const char *name, const ip_addr_t &addr) {
+    return responder.addRecord(name, ip4_addr_get_u32(ip_2_ip4(&addr)));
+}
+
+void DNSServer::clear() {
+    responder.clear();
+}
+
+void DNSServer::setDomain(const char *domain) {
+    responder.setDomain(domain);
+}
+
+err_t DNSServer::start(uint16_t port) {
+    if (pcb) {
+        return ERR_ISCONN;
+    }
+
+    pcb = udp_new();
+
+    if (!pcb) {
+        return ERR_MEM;
+    }
+
+    err_t result = udp_bind(pcb, IP_ADDR_ANY, port);
+
+    if (result != ERR_OK) {
+        udp_remove(pcb);
+        pcb = nullptr;
+
+        return result;
+    }
+
+    udp_recv(pcb, receiveWrapper, this);
+
+    return ERR_OK;
+}
+
+void DNSServer::stop() {
+    if (pcb) {
+        udp_remove(pcb);
+        pcb = nullptr;
+    }
+}
+
+void DNSServer::resetStats() {
+    responder.resetStats();
+}
+
+void DNSServer::handleQuery(struct pbuf *p, const ip_addr_t *addr, uint16_t port) {
+    uint16_t length = pbuf_copy_partial(p, query_buffer, sizeof(query_buffer), 0);
+
+    // The response echoes the question, so it is never longer than the query plus one answer
+    struct pbuf *response = pbuf_alloc(PBUF_TRANSPORT, (u16_t)(length + DNSResponder::answerLength), PBUF_RAM);
+
+    if (!response) {
+        return;
+    }
+
+    size_t size = responder.respond(query_buffer, length, static_cast<uint8_t *>(response->payload),
+                                    response->len);
+
+    if (size) {
+        pbuf_realloc(response, (u16_t)size);
+        udp_sendto(pcb, response, addr, port);
+    }
+
+    pbuf_free(response);
+}
+
+void DNSServer::receiveWrapper(void *arg, struct udp_pcb *upcb, struct pbuf *p,
+                               const ip_addr_t *addr, uint16_t port) {
+    DNSServer *instance = static_cast<DNSServer*>(arg);
+
+    instance->handleQuery(p, addr, port);
+
+    pbuf_free(p);
+}
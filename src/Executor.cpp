@@ -0,0 +1,159 @@
+#include "pico-usbnet/Executor.h"
+
+#if PICONET_COROUTINES
+
+extern "C" {
+    #include "pico/stdlib.h"
+}
+
+#include "pico-usbnet/StaticContainers.h"
+
+// Same clock as lwIP's sys_now(), without depending on lwIP
+static uint32_t nowMs() {
+    return (uint32_t)(time_us_64() / 1000);
+}
+
+struct alignas(alignof(std::max_align_t)) Frame {
+    unsigned char bytes[PICONET_CORO_FRAME_SIZE];
+};
+
+static Frame frames[PICONET_CORO_FRAMES];
+static bool frame_used[PICONET_CORO_FRAMES];
+
+struct Timer {
+    uint32_t deadline;
+    std::coroutine_handle<> handle;
+};
+
+static RingQueue<std::coroutine_handle<>, PICONET_CORO_READY_QUEUE> ready_queue;
+static Timer timers[PICONET_CORO_TIMERS];
+static size_t timer_count = 0;
+
+// Task
+
+void *Task::promise_type::operator new(size_t size) noexcept {
+    if (size > sizeof(Frame)) {
+        return nullptr;
+    }
+
+    for (size_t i = 0; i < PICONET_CORO_FRAMES; i++) {
+        if (!frame_used[i]) {
+            frame_used[i] = true;
+
+            return frames[i].bytes;
+        }
+    }
+
+    return nullptr;
+}
+
+void Task::promise_type::operator delete(void *frame) noexcept {
+    size_t index = static_cast<Frame *>(frame) - frames;
+
+    if (index < PICONET_CORO_FRAMES) {
+        frame_used[index] = false;
+    }
+}
+
+std::coroutine_handle<> Task::promise_type::FinalAwaiter::await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+    promise_type &promise = handle.promise();
+
+    if (promise.continuation) {
+        return promise.continuation;
+    }
+
+    if (promise.detached) {
+        handle.destroy();
+    }
+
+    return std::noop_coroutine();
+}
+
+Task &Task::operator=(Task &&other) noexcept {
+    if (this != &other) {
+        if (handle) {
+            handle.destroy();
+        }
+
+        handle = other.handle;
+        other.handle = nullptr;
+    }
+
+    return *this;
+}
+
+Task::~Task() {
+    if (handle) {
+        handle.destroy();
+    }
+}
+
+std::coroutine_handle<> Task::await_suspend(std::coroutine_handle<> awaiting) noexcept {
+    handle.promise().continuation = awaiting;
+
+    return handle;
+}
+
+// Executor
+
+bool Executor::spawn(Task task) {
+    if (!task.valid()) {
+        return false;
+    }
+
+    task.handle.promise().detached = true;
+
+    if (!schedule(task.handle)) {
+        return false;
+    }
+
+    // The executor owns the frame now; it is destroyed when the task finishes
+    task.handle = nullptr;
+
+    return true;
+}
+
+bool Executor::schedule(std::coroutine_handle<> handle) {
+    return ready_queue.push(handle);
+}
+
+void Executor::poll() {
+    // Reading the clock costs more than a resume; skip it with no sleeper
+    uint32_t now = timer_count ? nowMs() : 0;
+
+    for (size_t i = 0; i < timer_count;) {
+        if ((int32_t)(now - timers[i].deadline) >= 0 && schedule(timers[i].handle)) {
+            timers[i] = timers[--timer_count];
+        } else {
+            i++;
+        }
+    }
+
+    // Only run what was ready on entry, so a coroutine that reschedules itself
+    // cannot starve the network
+    size_t count = ready_queue.size();
+    std::coroutine_handle<> handle;
+
+    while (count-- && ready_queue.pop(handle)) {
+        handle.resume();
+    }
+}
+
+bool Executor::SleepAwaiter::await_ready() const noexcept {
+    return (int32_t)(nowMs() - deadline) >= 0;
+}
+
+void Executor::SleepAwaiter::await_suspend(std::coroutine_handle<> handle) noexcept {
+    if (timer_count < PICONET_CORO_TIMERS) {
+        timers[timer_count++] = {deadline, handle};
+    } else {
+        // Out of timers: degrade to a yield rather than losing the coroutine
+        schedule(handle);
+    }
+}
+
+Executor::SleepAwaiter Executor::sleep(uint32_t ms) {
+    return SleepAwaiter{nowMs() + ms};
+}
+
+#endif // PICONET_COROUTINES
@@ -0,0 +1,621 @@
+#include <cstring>
+
+#include "pico-usbnet/HTTPServer.h"
+#include "pico-usbnet/StaticContainers.h"
+
+// tcp_poll() runs every 2 coarse ticks, i.e. once a second
+#define HTTP_POLL_INTERVAL 2
+
+struct HTTPServer::Connection {
+    struct Part {
+        const void *data;
+        uint32_t length;
+    };
+
+    Connection(HTTPServer *server, struct tcp_pcb *pcb)
+        : server(server), pcb(pcb), next(nullptr), received(nullptr), partCount(0), partIndex(0),
+          partOffset(0), responding(false), closeAfterResponse(false), remoteClosed(false), idleSeconds(0) {}
+
+    void addPart(const void *data, uint32_t length) {
+        if (length) {
+            parts[partCount++] = {data, length};
+        }
+    }
+
+    HTTPServer *server;
+    struct tcp_pcb *pcb;
+    Connection *next;
+
+    // Request bytes not parsed yet; acknowledged to lwIP only once consumed
+    struct pbuf *received;
+
+    // Response still to be queued, all of it in flash
+    Part parts[3];
+    uint8_t partCount;
+    uint8_t partIndex;
+    uint32_t partOffset;
+
+    bool responding;
+    bool closeAfterResponse;
+    bool remoteClosed;
+    uint8_t idleSeconds;
+};
+
+static ObjectPool<HTTPServer::Connection, PICONET_HTTP_CONNECTIONS> connection_pool;
+
+// Requests are parsed one at a time straight into a response, so all
+// connections can share one header buffer
+static char request_buffer[PICONET_HTTP_REQUEST_SIZE];
+
+size_t HTTPServer::getSharedSize() {
+    return sizeof(connection_pool) + sizeof(request_buffer);
+}
+
+static const char not_found_header[] =
+    "HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\nContent-Length: 9\r\n\r\n";
+static const char not_found_body[] = "Not Found";
+static const char not_allowed[] =
+    "HTTP/1.1 405 Method Not Allowed\r\nAllow: GET, HEAD\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+static const char bad_request[] =
+    "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+static const char too_large[] =
+    "HTTP/1.1 431 Request Header Fields Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+// Replaces the blank line that ends a precomputed header
+static const char connection_close[] = "Connection: close\r\n\r\n";
+
+static char toLower(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c + ('a' - 'A')) : c;
+}
+
+// 'lower' must be lowercase
+static bool equalsIgnoreCase(const char *text, size_t length, const char *lower) {
+    size_t i = 0;
+
+    for (; i < length && lower[i]; i++) {
+        if (toLower(text[i]) != lower[i]) {
+            return false;
+        }
+    }
+
+    return i == length && !lower[i];
+}
+
+static bool containsIgnoreCase(const char *text, size_t length, const char *lower) {
+    size_t needle = strlen(lower);
+
+    for (size_t i = 0; i + needle <= length; i++) {
+        if (equalsIgnoreCase(text + i, needle, lower)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void trim(const char *&text, size_t &length) {
+    while (length && (*text == ' ' || *text == '\t')) {
+        text++;
+        length--;
+    }
+
+    while (length && (text[length - 1] == ' ' || text[length - 1] == '\t')) {
+        length--;
+    }
+}
+
+// True if an Accept-Encoding value admits gzip, honouring "gzip;q=0"
+static bool acceptsGzip(const char *value, size_t length) {
+    while (length) {
+        const char *comma = static_cast<const char *>(memchr(value, ',', length));
+        size_t itemLength = comma ? (size_t)(comma - value) : length;
+
+        const char *item = value;
+        size_t codingLength = itemLength;
+        const char *semicolon = static_cast<const char *>(memchr(item, ';', itemLength));
+
+        if (semicolon) {
+            codingLength = semicolon - item;
+        }
+
+        const char *coding = item;
+        trim(coding, codingLength);
+
+        if (equalsIgnoreCase(coding, codingLength, "gzip") || equalsIgnoreCase(coding, codingLength, "*")) {
+            if (!semicolon) {
+                return true;
+            }
+
+            // q=0, q=0.0, q=0.00 ... disable the coding; anything else allows it
+            const char *params = semicolon + 1;
+            size_t paramsLength = itemLength - (params - item);
+            trim(params, paramsLength);
+
+            if (paramsLength < 3 || toLower(params[0]) != 'q' || params[1] != '=') {
+                return true;
+            }
+
+            for (size_t i = 2; i < paramsLength; i++) {
+                if (params[i] != '0' && params[i] != '.') {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        if (!comma) {
+            break;
+        }
+
+        length -= itemLength + 1;
+        value = comma + 1;
+    }
+
+    return false;
+}
+
+static bool matchesEtag(const char *value, size_t length, const char *etag) {
+    const char *trimmed = value;
+    size_t trimmedLength = length;
+    trim(trimmed, trimmedLength);
+
+    if (trimmedLength == 1 && *trimmed == '*') {
+        return true;
+    }
+
+    size_t etagLength = strlen(etag);
+
+    for (size_t i = 0; i + etagLength <= length; i++) {
+        if (memcmp(value + i, etag, etagLength) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+HTTPServer::HTTPServer() : pcb(nullptr), image(nullptr), connections(nullptr), stats() {}
+
+HTTPServer::~HTTPServer() {
+    stop();
+}
+
+err_t HTTPServer::start(const WebImage &image, uint16_t port) {
+    if (pcb) {
+        return ERR_ISCONN;
+    }
+
+    struct tcp_pcb *newpcb = tcp_new();
+
+    if (!newpcb) {
+        return ERR_MEM;
+    }
+
+    err_t result = tcp_bind(newpcb, IP_ADDR_ANY, port);
+
+    if (result != ERR_OK) {
+        tcp_close(newpcb);
+
+        return result;
+    }
+
+    pcb = tcp_listen(newpcb);
+
+    if (!pcb) {
+        tcp_close(newpcb);
+
+        return ERR_MEM;
+    }
+
+    this->image = &image;
+
+    tcp_arg(pcb, this);
+    tcp_accept(pcb, acceptWrapper);
+
+    return ERR_OK;
+}
+
+void HTTPServer::stop() {
+    if (pcb) {
+        tcp_arg(pcb, NULL);
+        tcp_accept(pcb, NULL);
+        tcp_close(pcb);
+        pcb = nullptr;
+    }
+
+    // Queued responses reference flash only, so closing lets them drain
+    while (connections) {
+        closeConnection(connections);
+    }
+}
+
+const WebAsset *HTTPServer::find(const char *path, size_t length) const {
+    if (!image) {
+        return nullptr;
+    }
+
+    size_t low = 0;
+    size_t high = image->count;
+
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        const char *candidate = image->assets[middle].path;
+        int order = strncmp(candidate, path, length);
+
+        if (order == 0 && candidate[length] != '\0') {
+            order = 1;
+        }
+
+        if (order == 0) {
+            return &image->assets[middle];
+        }
+
+        if (order < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return nullptr;
+}
+
+void HTTPServer::resetStats() {
+    stats = Stats();
+}
+
+err_t HTTPServer::service(Connection *connection) {
+    while (true) {
+        if (connection->responding) {
+            send(connection);
+
+            if (connection->responding) {
+                return ERR_OK;
+            }
+
+            if (connection->closeAfterResponse) {
+                return closeConnection(connection);
+            }
+        }
+
+        if (!nextRequest(connection)) {
+            return connection->remoteClosed ? closeConnection(connection) : ERR_OK;
+        }
+    }
+}
+
+bool HTTPServer::nextRequest(Connection *connection) {
+    struct pbuf *p = connection->received;
+
+    if (!p || connection->closeAfterResponse) {
+        return false;
+    }
+
+    u16_t end = pbuf_memfind(p, "\r\n\r\n", 4, 0);
+
+    if (end == 0xFFFF && p->tot_len < sizeof(request_buffer)) {
+        return false;
+    }
+
+    if (end == 0xFFFF || end + 4u > sizeof(request_buffer)) {
+        stats.rejected++;
+
+        tcp_recved(connection->pcb, p->tot_len);
+        pbuf_free(p);
+        connection->received = nullptr;
+
+        connection->addPart(too_large, sizeof(too_large) - 1);
+        connection->responding = true;
+        connection->closeAfterResponse = true;
+
+        return true;
+    }
+
+    u16_t length = end + 4;
+
+    pbuf_copy_partial(p, request_buffer, length, 0);
+    connection->received = pbuf_free_header(p, length);
+    tcp_recved(connection->pcb, length);
+
+    respond(connection, request_buffer, length);
+
+    return true;
+}
+
+void HTTPServer::respond(Connection *connection, const char *request, size_t length) {
+    stats.requests++;
+
+    connection->partCount = 0;
+    connection->partIndex = 0;
+    connection->partOffset = 0;
+    connection->responding = true;
+
+    // Request line: METHOD SP target SP version CRLF
+    const char *lineEnd = static_cast<const char *>(memchr(request, '\r', length));
+    const char *methodEnd = static_cast<const char *>(memchr(request, ' ', lineEnd - request));
+    const char *target = methodEnd ? methodEnd + 1 : nullptr;
+    const char *targetEnd = target ? static_cast<const char *>(memchr(target, ' ', lineEnd - target)) : nullptr;
+
+    if (!targetEnd || *target != '/') {
+        stats.rejected++;
+        connection->addPart(bad_request, sizeof(bad_request) - 1);
+        connection->closeAfterResponse = true;
+
+        return;
+    }
+
+    size_t methodLength = methodEnd - request;
+    bool head = methodLength == 4 && memcmp(request, "HEAD", 4) == 0;
+
+    if (!head && !(methodLength == 3 && memcmp(request, "GET", 3) == 0)) {
+        // A request body would follow; closing is simpler than skipping it
+        stats.rejected++;
+        connection->addPart(not_allowed, sizeof(not_allowed) - 1);
+        connection->closeAfterResponse = true;
+
+        return;
+    }
+
+    const char *version = targetEnd + 1;
+    bool keepAlive = (size_t)(lineEnd - version) == 8 && memcmp(version, "HTTP/1.1", 8) == 0;
+    bool gzip = false;
+    const char *ifNoneMatch = nullptr;
+    size_t ifNoneMatchLength = 0;
+
+    // Header fields, one per line up to the blank line
+    const char *line = lineEnd + 2;
+    const char *headersEnd = request + length - 2;
+
+    while (line < headersEnd) {
+        const char *end = static_cast<const char *>(memchr(line, '\r', headersEnd - line + 1));
+        const char *colon = static_cast<const char *>(memchr(line, ':', end - line));
+
+        if (colon) {
+            const char *name = line;
+            size_t nameLength = colon - line;
+            const char *value = colon + 1;
+            size_t valueLength = end - value;
+
+            trim(name, nameLength);
+            trim(value, valueLength);
+
+            if (equalsIgnoreCase(name, nameLength, "accept-encoding")) {
+                gzip = acceptsGzip(value, valueLength);
+            } else if (equalsIgnoreCase(name, nameLength, "if-none-match")) {
+                ifNoneMatch = value;
+                ifNoneMatchLength = valueLength;
+            } else if (equalsIgnoreCase(name, nameLength, "connection")) {
+                if (containsIgnoreCase(value, valueLength, "close")) {
+                    keepAlive = false;
+                } else if (containsIgnoreCase(value, valueLength, "keep-alive")) {
+                    keepAlive = true;
+                }
+            }
+        }
+
+        line = end + 2;
+    }
+
+    connection->closeAfterResponse = !keepAlive;
+
+    // Paths are matched verbatim, without the query string
+    size_t pathLength = targetEnd - target;
+
+    for (size_t i = 0; i < pathLength; i++) {
+        if (target[i] == '?' || target[i] == '#') {
+            pathLength = i;
+            break;
+        }
+    }
+
+    const WebAsset *asset = find(target, pathLength);
+
+    if (!asset) {
+        stats.notFound++;
+        connection->addPart(not_found_header, sizeof(not_found_header) - 1);
+
+        if (!head) {
+            connection->addPart(not_found_body, sizeof(not_found_body) - 1);
+        }
+
+        return;
+    }
+
+    const WebVariant *variant = gzip && asset->gzip.body ? &asset->gzip : &asset->identity;
+
+    if (ifNoneMatch && matchesEtag(ifNoneMatch, ifNoneMatchLength, variant->etag)) {
+        stats.notModified++;
+        connection->addPart(variant->notModified, variant->notModifiedLength);
+
+        return;
+    }
+
+    if (variant == &asset->gzip) {
+        stats.gzipResponses++;
+    }
+
+    if (keepAlive) {
+        connection->addPart(variant->header, variant->headerLength);
+    } else {
+        connection->addPart(variant->header, variant->headerLength - 2);
+        connection->addPart(connection_close, sizeof(connection_close) - 1);
+    }
+
+    if (!head) {
+        connection->addPart(variant->body, variant->bodyLength);
+    }
+}
+
+void HTTPServer::send(Connection *connection) {
+    struct tcp_pcb *tpcb = connection->pcb;
+
+    while (connection->partIndex < connection->partCount) {
+        const Connection::Part &part = connection->parts[connection->partIndex];
+        uint32_t remaining = part.length - connection->partOffset;
+        uint32_t space = tcp_sndbuf(tpcb);
+
+        if (space == 0 || tcp_sndqueuelen(tpcb) >= TCP_SND_QUEUELEN) {
+            break;
+        }
+
+        u16_t chunk = (u16_t)LWIP_MIN(LWIP_MIN(space, remaining), 0xffffu);
+        bool last = chunk == remaining && connection->partIndex + 1 == connection->partCount;
+
+        // No TCP_WRITE_FLAG_COPY: lwIP references the flash image until it is acknowledged
+        err_t result = tcp_write(tpcb, static_cast<const uint8_t *>(part.data) + connection->partOffset,
+                                 chunk, last ? 0 : TCP_WRITE_FLAG_MORE);
+
+        if (result != ERR_OK) {
+            // Out of pbufs or segments; the sent or poll callback resumes
+            break;
+        }
+
+        stats.bytesQueued += chunk;
+        connection->partOffset += chunk;
+
+        if (connection->partOffset == part.length) {
+            connection->partIndex++;
+            connection->partOffset = 0;
+        }
+    }
+
+    if (connection->partIndex == connection->partCount) {
+        connection->responding = false;
+    }
+
+    tcp_output(tpcb);
+}
+
+err_t HTTPServer::closeConnection(Connection *connection) {
+    struct tcp_pcb *tpcb = connection->pcb;
+    err_t result = ERR_OK;
+
+    tcp_arg(tpcb, NULL);
+    tcp_recv(tpcb, NULL);
+    tcp_sent(tpcb, NULL);
+    tcp_poll(tpcb, NULL, 0);
+    tcp_err(tpcb, NULL);
+
+    // tcp_close() answers unreceived data with a RST, which can discard the
+    // response still in flight; take in whatever the client pipelined
+    if (connection->received) {
+        tcp_recved(tpcb, connection->received->tot_len);
+    }
+
+    if (tcp_close(tpcb) != ERR_OK) {
+        tcp_abort(tpcb);
+        result = ERR_ABRT;
+    }
+
+    release(connection);
+
+    return result;
+}
+
+void HTTPServer::release(Connection *connection) {
+    if (connection->received) {
+        pbuf_free(connection->received);
+    }
+
+    Connection **link = &connections;
+
+    while (*link && *link != connection) {
+        link = &(*link)->next;
+    }
+
+    if (*link) {
+        *link = connection->next;
+    }
+
+    connection_pool.release(connection);
+}
+
+err_t HTTPServer::acceptWrapper(void *arg, struct tcp_pcb *newpcb, err_t err) {
+    HTTPServer *instance = static_cast<HTTPServer*>(arg);
+
+    if (err != ERR_OK || !newpcb) {
+        return ERR_VAL;
+    }
+
+    Connection *connection = connection_pool.acquire(instance, newpcb);
+
+    if (!connection) {
+        instance->stats.refused++;
+        tcp_abort(newpcb);
+
+        return ERR_ABRT;
+    }
+
+    connection->next = instance->connections;
+    instance->connections = connection;
+
+    // Responses end on a partial segment; don't let Nagle hold it back
+    tcp_nagle_disable(newpcb);
+
+    tcp_arg(newpcb, connection);
+    tcp_recv(newpcb, receiveWrapper);
+    tcp_sent(newpcb, sentWrapper);
+    tcp_err(newpcb, errorWrapper);
+    tcp_poll(newpcb, pollWrapper, HTTP_POLL_INTERVAL);
+
+    return ERR_OK;
+}
+
+err_t HTTPServer::receiveWrapper(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err) {
+    Connection *connection = static_cast<Connection*>(arg);
+
+    if (!p) {
+        connection->remoteClosed = true;
+
+        return connection->server->service(connection);
+    }
+
+    if (err != ERR_OK) {
+        pbuf_free(p);
+
+        return err;
+    }
+
+    connection->idleSeconds = 0;
+
+    // Anything after a request we are about to close on is discarded
+    if (connection->closeAfterResponse) {
+        tcp_recved(tpcb, p->tot_len);
+        pbuf_free(p);
+
+        return ERR_OK;
+    }
+
+    if (connection->received) {
+        pbuf_cat(connection->received, p);
+    } else {
+        connection->received = p;
+    }
+
+    return connection->server->service(connection);
+}
+
+err_t HTTPServer::sentWrapper(void *arg, struct tcp_pcb *tpcb, u16_t len) {
+    Connection *connection = static_cast<Connection*>(arg);
+
+    connection->idleSeconds = 0;
+
+    return connection->server->service(connection);
+}
+
+err_t HTTPServer::pollWrapper(void *arg, struct tcp_pcb *tpcb) {
+    Connection *connection = static_cast<Connection*>(arg);
+
+    if (++connection->idleSeconds >= PICONET_HTTP_IDLE_TIMEOUT_S) {
+        return connection->server->closeConnection(connection);
+    }
+
+    return connection->server->service(connection);
+}
+
+void HTTPServer::errorWrapper(void *arg, err_t err) {
+    Connection *connection = static_cast<Connection*>(arg);
+
+    // lwIP has already freed the pcb
+    connection->server->release(connection);
+}
@@ -0,0 +1,505 @@
+#include <cstdio>
+#include <cstring>
+
+#include "pico-usbnet/LoopbackBench.h"
+
+#if PICONET_LOOPBACK
+#include "pico-usbnet/TCP.h"
+#include "pico-usbnet/UDP.h"
+#include "pico-usbnet/RPCServer.h"
+#include "pico-usbnet/ConnectionManager.h"
+#include "pico-usbnet/PoolCalibration.h"
+
+#define BENCH_TIMEOUT_US    10000000
+#define BENCH_CHUNK         1024
+#define BENCH_ECHO_SIZE     16
+#define BENCH_CHURN_WAIT_US 100000
+#define BENCH_ECHO_WAIT_US  20000
+
+// TCP and UDP callbacks carry no context, so the bench state is file-wide.
+// The servers stay up between runs.
+static TCP server;
+static TCP client;
+static UDP caller;
+static RPCServer echo;
+static ConnectionManager churn;
+static bool listening = false;
+static bool serving = false;
+static bool churning = false;
+
+static uint32_t received_bytes;
+static bool connect_done;
+static err_t connect_result;
+static uint32_t expected_id;
+static bool reply_received;
+static uint8_t chunk[BENCH_CHUNK];
+static bool client_failed;
+
+// No methods of its own: the RPC server answers echo calls itself
+static const RpcHandler no_methods[] = {nullptr};
+
+// With PICONET_POOL_CALIBRATION every phase is one scenario of the pool sweep
+static void beginScenario() {
+#if PICONET_POOL_CALIBRATION
+    PoolCalibration::reset();
+#endif
+}
+
+static void endScenario(const char *name) {
+#if PICONET_POOL_CALIBRATION
+    PoolCalibration::endScenario(name);
+#else
+    (void)name;
+#endif
+}
+
+static void serverReceive(struct pbuf *p) {
+    received_bytes += p->tot_len;
+}
+
+static void clientConnect(err_t err) {
+    connect_done = true;
+    connect_result = err;
+}
+
+static void clientError(err_t err) {
+    client_failed = true;
+}
+
+// The server ends each churn session as soon as the client's byte arrives
+static void churnReceive(int id, struct pbuf *p) {
+    churn.close(id);
+}
+
+static void echoReply(struct pbuf *p, const ip_addr_t *addr, uint16_t port) {
+    uint8_t header[PICONET_RPC_HEADER_SIZE];
+
+    if (pbuf_copy_partial(p, header, sizeof(header), 0) != sizeof(header)) {
+        return;
+    }
+
+    uint32_t id = (uint32_t)header[4] | ((uint32_t)header[5] << 8) |
+                  ((uint32_t)header[6] << 16) | ((uint32_t)header[7] << 24);
+
+    if ((header[1] & PICONET_RPC_FLAG_RESPONSE) && id == expected_id) {
+        reply_received = true;
+    }
+}
+
+// Connects the client to the server on the device's own address
+static bool connectClient(USBNetwork &network, uint64_t deadline) {
+    if (!listening) {
+        server.init();
+        server.onReceive(serverReceive);
+        server.bind(IP_ADDR_ANY, PICONET_LOOPBACK_BENCH_PORT);
+        server.listen();
+        listening = true;
+    }
+
+    for (size_t i = 0; i < sizeof(chunk); i++) {
+        chunk[i] = (uint8_t)i;
+    }
+
+    received_bytes = 0;
+    connect_done = false;
+
+    client.init();
+    client.onConnect(clientConnect);
+
+    if (client.connect(&network.getIPAddress(), PICONET_LOOPBACK_BENCH_PORT) != ERR_OK) {
+        return false;
+    }
+
+    while (!connect_done && time_us_64() < deadline) {
+        network.work();
+    }
+
+    return connect_done && connect_result == ERR_OK;
+}
+
+// Let both ends finish closing so the next run starts clean
+static void closeClient(USBNetwork &network, uint64_t deadline) {
+    if (client.isConnected()) {
+        client.close();
+    }
+
+    while (server.isConnected() && time_us_64() < deadline) {
+        network.work();
+    }
+}
+
+static bool runTcp(USBNetwork &network, LoopbackBench::Stream &result, uint32_t bytes) {
+    uint64_t deadline = time_us_64() + BENCH_TIMEOUT_US;
+
+    if (!connectClient(network, deadline)) {
+        return false;
+    }
+
+    uint64_t start = time_us_64();
+    uint32_t sent = 0;
+
+    while (received_bytes < bytes && client.isConnected() && time_us_64() < deadline) {
+        uint16_t length = (uint16_t)LWIP_MIN((uint32_t)BENCH_CHUNK, bytes - sent);
+
+        if (sent < bytes && client.getAvailableSize() >= length && client.write(chunk, length) == ERR_OK) {
+            sent += length;
+            client.send();
+        }
+
+        network.work();
+    }
+
+    result.us = (uint32_t)(time_us_64() - start);
+    result.bytes = received_bytes;
+
+    closeClient(network, deadline);
+
+    return received_bytes >= bytes;
+}
+
+static uint8_t request[PICONET_RPC_HEADER_SIZE + PICONET_RPC_CALL_HEADER + BENCH_ECHO_SIZE] = {
+    PICONET_RPC_VERSION, 0, 1, 0, 0, 0, 0, 0,
+    PICONET_RPC_METHOD_ECHO & 0xff, PICONET_RPC_METHOD_ECHO >> 8, BENCH_ECHO_SIZE, 0,
+};
+
+static void sendEcho() {
+    // A fresh id each time, so the server never answers from its reply cache
+    expected_id++;
+    reply_received = false;
+    request[4] = (uint8_t)expected_id;
+    request[5] = (uint8_t)(expected_id >> 8);
+    request[6] = (uint8_t)(expected_id >> 16);
+    request[7] = (uint8_t)(expected_id >> 24);
+
+    caller.send(request, sizeof(request));
+}
+
+static bool runUdp(USBNetwork &network, LoopbackBench::Result &result, uint32_t roundTrips) {
+    if (!serving) {
+        if (echo.start(RpcTable(no_methods), PICONET_LOOPBACK_BENCH_PORT + 1) != ERR_OK) {
+            return false;
+        }
+
+        serving = true;
+    }
+
+    caller.init();
+    caller.onReceive(echoReply);
+    caller.connect(&network.getIPAddress(), PICONET_LOOPBACK_BENCH_PORT + 1);
+
+    uint64_t start = time_us_64();
+    uint64_t deadline = start + BENCH_TIMEOUT_US;
+    uint32_t done = 0;
+
+    for (; done < roundTrips; done++) {
+        sendEcho();
+
+        while (!reply_received && time_us_64() < deadline) {
+            network.work();
+        }
+
+        if (!reply_received) {
+            break;
+        }
+    }
+
+    result.roundTripUs = (uint32_t)(time_us_64() - start);
+    result.roundTrips = done;
+
+    caller.close();
+
+    return done == roundTrips;
+}
+
+#if PICONET_NETIFS > 1
+// Echo calls to target while the client streams to the USB interface's address
+static void runEchoes(USBNetwork &network, const ip_addr_t &target, uint32_t roundTrips,
+                      LoopbackBench::Isolation &result) {
+    uint64_t total = 0;
+
+    caller.init();
+    caller.onReceive(echoReply);
+    caller.connect(&target, PICONET_LOOPBACK_BENCH_PORT + 1);
+
+    for (uint32_t i = 0; i < roundTrips && client.isConnected(); i++) {
+        uint64_t start = time_us_64();
+
+        sendEcho();
+
+        while (!reply_received && time_us_64() - start < BENCH_ECHO_WAIT_US) {
+            if (client.getAvailableSize() >= BENCH_CHUNK && client.write(chunk, BENCH_CHUNK) == ERR_OK) {
+                client.send();
+            }
+
+            network.work();
+        }
+
+        if (!reply_received) {
+            result.lost++;
+            continue;
+        }
+
+        uint32_t rtt = (uint32_t)(time_us_64() - start);
+
+        total += rtt;
+        result.maxUs = LWIP_MAX(result.maxUs, rtt);
+        result.roundTrips++;
+    }
+
+    if (result.roundTrips) {
+        result.meanUs = (uint32_t)(total / result.roundTrips);
+    }
+
+    caller.close();
+}
+
+static bool runIsolation(USBNetwork &network, LoopbackBench::Result &result, uint32_t roundTrips) {
+    size_t local = 1;
+
+    while (local < network.getInterfaceCount() && network.getInterfaceKind(local) != InterfaceKind::Local) {
+        local++;
+    }
+
+    // Nothing to compare without a local interface
+    if (local == network.getInterfaceCount()) {
+        return true;
+    }
+
+    uint64_t deadline = time_us_64() + BENCH_TIMEOUT_US;
+
+    if (!serving || !connectClient(network, deadline)) {
+        return false;
+    }
+
+    runEchoes(network, network.getIPAddress(), roundTrips, result.shared);
+    runEchoes(network, network.getIPAddress(local), roundTrips, result.separate);
+
+    closeClient(network, time_us_64() + BENCH_TIMEOUT_US);
+
+    return result.separate.roundTrips > 0;
+}
+#endif
+
+// One connection of the storm; false when it did not complete
+static bool churnOnce(USBNetwork &network, LoopbackBench::Churn &result, uint64_t &connectTotal) {
+    uint64_t deadline = time_us_64() + BENCH_CHURN_WAIT_US;
+
+    connect_done = false;
+    client_failed = false;
+
+    client.init();
+    client.onConnect(clientConnect);
+    client.onError(clientError);
+
+    uint64_t start = time_us_64();
+
+    if (client.connect(&network.getIPAddress(), PICONET_LOOPBACK_BENCH_PORT + 2) != ERR_OK) {
+        client.close();
+
+        return false;
+    }
+
+    while (!connect_done && !client_failed && time_us_64() < deadline) {
+        network.work();
+    }
+
+    if (!connect_done || connect_result != ERR_OK) {
+        client.close();
+
+        return false;
+    }
+
+    uint32_t connectUs = (uint32_t)(time_us_64() - start);
+
+    connectTotal += connectUs;
+    result.connectMaxUs = LWIP_MAX(result.connectMaxUs, connectUs);
+
+    client.send("x", 1);
+
+    // Ends with the server's FIN, or its reset when closing abortively
+    while (client.isConnected() && time_us_64() < deadline) {
+        network.work();
+    }
+
+    result.maxTimeWait = LWIP_MAX(result.maxTimeWait, (uint32_t)ConnectionManager::getTimeWaitCount());
+
+    if (client.isConnected()) {
+        client.close();
+
+        return false;
+    }
+
+    return true;
+}
+
+static bool runChurn(USBNetwork &network, bool abortive, uint32_t connections, LoopbackBench::Churn &result) {
+    if (!churning) {
+        churn.onReceive(churnReceive);
+
+        if (churn.start(PICONET_LOOPBACK_BENCH_PORT + 2) != ERR_OK) {
+            return false;
+        }
+
+        churning = true;
+    }
+
+    churn.setAbortiveClose(abortive);
+    churn.resetStats();
+
+    uint64_t connectTotal = 0;
+    uint64_t start = time_us_64();
+    uint64_t deadline = start + BENCH_TIMEOUT_US;
+
+    for (uint32_t i = 0; i < connections && time_us_64() < deadline; i++) {
+        if (churnOnce(network, result, connectTotal)) {
+            result.connections++;
+        } else {
+            result.failed++;
+        }
+    }
+
+    result.us = (uint32_t)(time_us_64() - start);
+
+    if (result.connections) {
+        result.connectMeanUs = (uint32_t)(connectTotal / result.connections);
+    }
+
+    result.evicted = churn.getStats().evicted;
+    result.refused = churn.getStats().refused;
+
+    client.onError(nullptr);
+
+    // Callers expect the stack's pools back as they found them, bar TIME_WAIT
+    while (churn.getStats().active && time_us_64() < deadline) {
+        network.work();
+    }
+
+    return result.connections == connections;
+}
+
+// Gives back the pcbs of the listeners; the application starts its own servers after the bench
+static void stopServers() {
+    if (listening) {
+        server.close();
+        server.stopListening();
+        listening = false;
+    }
+
+    if (serving) {
+        echo.stop();
+        serving = false;
+    }
+
+    if (churning) {
+        churn.stop();
+        churning = false;
+    }
+}
+
+bool LoopbackBench::run(USBNetwork &network, Result &result, uint32_t tcpBytes, uint32_t roundTrips,
+                        uint32_t connections) {
+    result = Result();
+
+#if PICONET_POOL_CALIBRATION
+    PoolCalibration::clearSweep();
+#endif
+
+    static const uint16_t mtus[] = {576, 1500, 4000, PICONET_MTU};
+    static const char *const streams[] = {"tcp mtu 576", "tcp mtu 1500", "tcp mtu 4000", "tcp mtu max"};
+    uint16_t mtu = network.getMTU();
+    bool tcpOk = true;
+
+    for (size_t i = 0; i < MaxStreams; i++) {
+        if (mtus[i] > PICONET_MTU || (result.streams && mtus[i] == result.tcp[result.streams - 1].mtu)) {
+            continue;
+        }
+
+        Stream &stream = result.tcp[result.streams++];
+
+        stream.mtu = mtus[i];
+        network.setMTU(mtus[i]);
+        beginScenario();
+        tcpOk = runTcp(network, stream, tcpBytes) && tcpOk;
+        endScenario(streams[i]);
+    }
+
+    network.setMTU(mtu);
+
+    beginScenario();
+    bool udpOk = runUdp(network, result, roundTrips);
+    endScenario("udp echo");
+
+    result.ok = tcpOk && udpOk;
+
+#if PICONET_NETIFS > 1
+    beginScenario();
+    result.ok = runIsolation(network, result, roundTrips) && result.ok;
+    endScenario("isolation");
+#endif
+
+    beginScenario();
+    bool gracefulOk = runChurn(network, false, connections, result.graceful);
+    endScenario("churn graceful");
+    beginScenario();
+    bool abortiveOk = runChurn(network, true, connections, result.abortive);
+    endScenario("churn abortive");
+
+    result.ok = gracefulOk && abortiveOk && result.ok;
+
+    stopServers();
+
+    return result.ok;
+}
+
+void LoopbackBench::print(const Result &result) {
+    static const char *const profiles[] = {"low-RAM", "balanced", "max-throughput"};
+
+    printf("pico-usbnet loopback bench: %s\n", result.ok ? "ok" : "FAILED");
+    printf("  lwIP profile %s: TCP_WND %lu, TCP_SND_BUF %lu, MEM_SIZE %lu, PBUF_POOL_SIZE %lu, budget %lu\n",
+           profiles[PICONET_LWIP_PROFILE], (unsigned long)TCP_WND, (unsigned long)TCP_SND_BUF,
+           (unsigned long)MEM_SIZE, (unsigned long)PBUF_POOL_SIZE, (unsigned long)PICONET_LWIP_RAM_BUDGET);
+
+    for (size_t i = 0; i < result.streams; i++) {
+        const Stream &stream = result.tcp[i];
+
+        if (stream.us) {
+            printf("  tcp  mtu %u: %lu bytes in %lu us, %lu kB/s\n", stream.mtu, (unsigned long)stream.bytes,
+                   (unsigned long)stream.us, (unsigned long)((uint64_t)stream.bytes * 1000 / stream.us));
+        }
+    }
+
+    if (result.roundTrips) {
+        printf("  udp  %lu echo round trips, %lu us each\n", (unsigned long)result.roundTrips,
+               (unsigned long)(result.roundTripUs / result.roundTrips));
+    }
+
+    const Churn *storms[] = {&result.graceful, &result.abortive};
+    const char *const closes[] = {"graceful", "abortive"};
+
+    for (size_t i = 0; i < 2; i++) {
+        const Churn &storm = *storms[i];
+
+        if (!storm.us) {
+            continue;
+        }
+
+        printf("  churn, %s close: %lu connections, %lu/s, connect mean %lu us, max %lu us, %lu failed\n",
+               closes[i], (unsigned long)storm.connections,
+               (unsigned long)((uint64_t)storm.connections * 1000000 / storm.us),
+               (unsigned long)storm.connectMeanUs, (unsigned long)storm.connectMaxUs, (unsigned long)storm.failed);
+        printf("         up to %lu in TIME_WAIT, %lu evicted, %lu refused\n", (unsigned long)storm.maxTimeWait,
+               (unsigned long)storm.evicted, (unsigned long)storm.refused);
+    }
+
+    const Isolation *phases[] = {&result.shared, &result.separate};
+    const char *const names[] = {"same interface", "local interface"};
+
+    for (size_t i = 0; i < 2; i++) {
+        if (phases[i]->roundTrips || phases[i]->lost) {
+            printf("  echo under tcp load, %s: %lu round trips, mean %lu us, max %lu us, %lu lost\n", names[i],
+                   (unsigned long)phases[i]->roundTrips, (unsigned long)phases[i]->meanUs,
+                   (unsigned long)phases[i]->maxUs, (unsigned long)phases[i]->lost);
+        }
+    }
+}
+#endif
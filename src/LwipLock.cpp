@@ -0,0 +1,100 @@
+#include "pico-usbnet/LwipLock.h"
+
+extern "C" {
+    #include "pico/stdlib.h"
+    #include "pico/sync.h"
+}
+
+#if !PICONET_LWIP_LOCK_SINGLE_CORE
+// Only the owning core ever writes its own number here, so a core can test
+// for re-entry without holding the spinlock.
+static volatile int lock_owner = -1;
+#endif
+static uint32_t lock_depth = 0;
+
+#if PICONET_LWIP_LOCK_STATS
+static LwipLock::Stats lock_stats;
+static uint32_t lock_taken_at;
+#endif
+
+sys_prot_t LwipLock::protect() {
+    uint32_t state = save_and_disable_interrupts();
+
+#if !PICONET_LWIP_LOCK_SINGLE_CORE
+    int core = (int)get_core_num();
+
+    if (lock_owner == core) {
+        lock_depth++;
+
+        return (sys_prot_t)state;
+    }
+
+    spin_lock_t *lock = spin_lock_instance(PICONET_LWIP_LOCK_SPINLOCK_ID);
+
+#if PICONET_LWIP_LOCK_STATS
+    // Reading the spinlock register claims it; a zero read means the other core holds it
+    if (!*lock) {
+        lock_stats.contentions++;
+
+        while (!*lock) {
+            tight_loop_contents();
+        }
+    }
+    __mem_fence_acquire();
+#else
+    spin_lock_unsafe_blocking(lock);
+#endif
+
+    lock_owner = core;
+#endif
+
+    if (lock_depth++ == 0) {
+#if PICONET_LWIP_LOCK_STATS
+        lock_stats.acquisitions++;
+        lock_taken_at = time_us_32();
+#endif
+    }
+
+    return (sys_prot_t)state;
+}
+
+void LwipLock::unprotect(sys_prot_t state) {
+    if (lock_depth && --lock_depth == 0) {
+#if PICONET_LWIP_LOCK_STATS
+        uint32_t held = time_us_32() - lock_taken_at;
+
+        lock_stats.totalHoldUs += held;
+
+        if (held > lock_stats.maxHoldUs) {
+            lock_stats.maxHoldUs = held;
+        }
+#endif
+
+#if !PICONET_LWIP_LOCK_SINGLE_CORE
+        lock_owner = -1;
+        spin_unlock_unsafe(spin_lock_instance(PICONET_LWIP_LOCK_SPINLOCK_ID));
+#endif
+    }
+
+    restore_interrupts((uint32_t)state);
+}
+
+LwipLock::Stats LwipLock::getStats() {
+#if PICONET_LWIP_LOCK_STATS
+    sys_prot_t state = protect();
+    Stats stats = lock_stats;
+    unprotect(state);
+
+    return stats;
+#else
+    return Stats{};
+#endif
+}
+
+void LwipLock::resetStats() {
+#if PICONET_LWIP_LOCK_STATS
+    sys_prot_t state = protect();
+    lock_stats = Stats{};
+    unprotect(state);
+#endif
+}
@@ -0,0 +1,83 @@
+#include <cstdio>
+
+#include "pico-usbnet/MemoryReport.h"
+#include "pico-usbnet/BlockRing.h"
+#include "pico-usbnet/ConnectionManager.h"
+#include "pico-usbnet/HTTPServer.h"
+#include "pico-usbnet/RPCServer.h"
+#include "pico-usbnet/USBNetwork.h"
+#include "pico-usbnet/WebSocketServer.h"
+
+extern "C" {
+    #include "lwip/memp.h"
+    #include "lwip/priv/memp_priv.h"
+}
+
+static const char *const memp_names[] = {
+#define LWIP_MEMPOOL(name, num, size, desc) "memp " #name,
+#include "lwip/priv/memp_std.h"
+};
+
+static_assert(sizeof(memp_names) / sizeof(memp_names[0]) == MEMP_MAX, "memp name table out of sync");
+
+size_t MemoryReport::collect(Entry *entries, size_t maxEntries) {
+    size_t count = 0;
+
+    auto add = [&](const char *name, size_t bytes) {
+        if (count < maxEntries) {
+            entries[count] = {name, bytes};
+        }
+
+        count++;
+    };
+
+    add("lwIP heap (MEM_SIZE)", MEM_SIZE);
+
+    for (int i = 0; i < MEMP_MAX; i++) {
+        add(memp_names[i], (size_t)memp_pools[i]->size * memp_pools[i]->num);
+    }
+
+    add("TinyUSB net RX/TX buffers",
+        2 * (CFG_TUD_NET_PACKET_PREFIX_LEN + CFG_TUD_NET_MTU + CFG_TUD_NET_PACKET_SUFFIX_LEN));
+    add("USBNetwork (netif, scheduler)", sizeof(USBNetwork) - sizeof(DHCPServer) - sizeof(DNSServer));
+    add("DHCP lease table", sizeof(DHCPServer));
+    add("DNS records", sizeof(DNSServer));
+    add("Packet filter", sizeof(PacketFilter));
+    add("TX class queues", sizeof(TxScheduler));
+
+    // Shared by every instance, whether or not the application starts one
+    add("HTTP connections and buffer", HTTPServer::getSharedSize());
+    add("WebSocket clients and buffers", WebSocketServer::getSharedSize());
+
+    // Owned by the application, one of each per instance
+    add("RPC server (reply cache)", sizeof(RPCServer));
+    add("Connection manager (sessions)", sizeof(ConnectionManager));
+    add("Block ring", sizeof(BlockRing));
+
+    return count;
+}
+
+size_t MemoryReport::total() {
+    Entry entries[MEMP_MAX + 16];
+    size_t count = collect(entries, sizeof(entries) / sizeof(entries[0]));
+    size_t bytes = 0;
+
+    for (size_t i = 0; i < count && i < sizeof(entries) / sizeof(entries[0]); i++) {
+        bytes += entries[i].bytes;
+    }
+
+    return bytes;
+}
+
+void MemoryReport::print() {
+    Entry entries[MEMP_MAX + 16];
+    size_t count = collect(entries, sizeof(entries) / sizeof(entries[0]));
+
+    printf("pico-usbnet static memory:\n");
+
+    for (size_t i = 0; i < count && i < sizeof(entries) / sizeof(entries[0]); i++) {
+        printf("  %-32s %8u\n", entries[i].name, (unsigned)entries[i].bytes);
+    }
+
+    printf("  %-32s %8u\n", "total", (unsigned)total());
+}
@@ -0,0 +1,155 @@
+#include "pico-usbnet/PacketFilter.h"
+
+#define ETH_HEADER_LEN      14
+#define ETHTYPE_IPV4        0x0800
+#define ETHTYPE_IPV6        0x86DD
+#define IP_PROTO_TCP_NUM    6
+#define IP_PROTO_UDP_NUM    17
+
+static inline uint16_t readBE16(const uint8_t *p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+PacketFilter::PacketFilter() : ruleCount(0), passed(0) {
+#if PICONET_FILTER_DEFAULT_RULES
+    addDefaultRules();
+#endif
+}
+
+void PacketFilter::addDefaultRules() {
+    // Router solicitations, MLD and the IPv6 flavours of mDNS/LLMNR
+    addRule({ETHTYPE_IPV6, 0, 0, FilterAction::Drop});
+    // mDNS, LLMNR, SSDP, NetBIOS name and datagram services
+    addRule({ETHTYPE_IPV4, IP_PROTO_UDP_NUM, 5353, FilterAction::Drop});
+    addRule({ETHTYPE_IPV4, IP_PROTO_UDP_NUM, 5355, FilterAction::Drop});
+    addRule({ETHTYPE_IPV4, IP_PROTO_UDP_NUM, 1900, FilterAction::Drop});
+    addRule({ETHTYPE_IPV4, IP_PROTO_UDP_NUM, 137, FilterAction::Drop});
+    addRule({ETHTYPE_IPV4, IP_PROTO_UDP_NUM, 138, FilterAction::Drop});
+}
+
+int PacketFilter::addRule(const FilterRule &rule) {
+    if (ruleCount >= PICONET_FILTER_MAX_RULES) {
+        return -1;
+    }
+
+    rules[ruleCount] = {rule, nullptr, 0};
+
+    return ruleCount++;
+}
+
+int PacketFilter::addFastPath(uint16_t udpPort, FastPathHandler handler) {
+    int index = addRule({ETHTYPE_IPV4, IP_PROTO_UDP_NUM, udpPort, FilterAction::FastPath});
+
+    if (index >= 0) {
+        rules[index].handler = handler;
+    }
+
+    return index;
+}
+
+void PacketFilter::clear() {
+    ruleCount = 0;
+    passed = 0;
+}
+
+FilterAction PacketFilter::process(const uint8_t *frame, uint16_t size) {
+    if (size < ETH_HEADER_LEN) {
+        passed++;
+
+        return FilterAction::Pass;
+    }
+
+    uint16_t etherType = readBE16(frame + 12);
+    const uint8_t *ip = frame + ETH_HEADER_LEN;
+    uint16_t ipLen = size - ETH_HEADER_LEN;
+    uint16_t headerLen = 0;
+    uint8_t protocol = 0;
+    uint16_t dstPort = 0;
+    bool fragmented = false;
+
+    if (etherType == ETHTYPE_IPV4 && ipLen >= 20 && (ip[0] >> 4) == 4) {
+        headerLen = (ip[0] & 0x0f) * 4;
+        protocol = ip[9];
+
+        // Fragments other than the first carry no transport header
+        bool laterFragment = ((ip[6] & 0x1f) | ip[7]) != 0;
+
+        // Any part of a fragmented datagram (MF set or a nonzero offset) is left to lwIP to reassemble
+        fragmented = ((ip[6] & 0x3f) | ip[7]) != 0;
+
+        if (!laterFragment && headerLen >= 20 && ipLen >= headerLen + 4 &&
+            (protocol == IP_PROTO_TCP_NUM || protocol == IP_PROTO_UDP_NUM)) {
+            dstPort = readBE16(ip + headerLen + 2);
+        }
+    }
+
+    for (int i = 0; i < ruleCount; i++) {
+        Entry &entry = rules[i];
+        const FilterRule &rule = entry.rule;
+
+        if ((rule.etherType && rule.etherType != etherType) ||
+            (rule.ipProtocol && rule.ipProtocol != protocol) ||
+            (rule.dstPort && rule.dstPort != dstPort)) {
+            continue;
+        }
+
+        if (rule.action == FilterAction::FastPath) {
+            if (!entry.handler || protocol != IP_PROTO_UDP_NUM || fragmented || ipLen < headerLen + 8) {
+                continue;
+            }
+
+            dispatch(entry, ip, ipLen, headerLen);
+        }
+
+        entry.hits++;
+
+        if (rule.action != FilterAction::Pass) {
+            return rule.action;
+        }
+
+        break;
+    }
+
+    passed++;
+
+    return FilterAction::Pass;
+}
+
+void PacketFilter::dispatch(const Entry &entry, const uint8_t *ip, uint16_t ipLen, uint16_t headerLen) {
+    // No checksum verification here: the USB link CRC already protects the frame
+    const uint8_t *udp = ip + headerLen;
+    uint16_t length = readBE16(udp + 4);
+
+    if (length < 8 || length > ipLen - headerLen) {
+        length = ipLen - headerLen;
+    }
+
+    ip_addr_t addr;
+    IP_ADDR4(&addr, ip[12], ip[13], ip[14], ip[15]);
+
+    entry.handler(udp + 8, length - 8, &addr, readBE16(udp));
+}
+
+int PacketFilter::getRuleCount() const {
+    return ruleCount;
+}
+
+const FilterRule &PacketFilter::getRule(int index) const {
+    return rules[index].rule;
+}
+
+uint32_t PacketFilter::getHits(int index) const {
+    return (index >= 0 && index < ruleCount) ? rules[index].hits : 0;
+}
+
+uint32_t PacketFilter::getPassed() const {
+    return passed;
+}
+
+void PacketFilter::resetCounters() {
+    for (int i = 0; i < ruleCount; i++) {
+        rules[i].hits = 0;
+    }
+
+    passed = 0;
+}
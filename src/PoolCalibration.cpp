@@ -0,0 +1,161 @@
+#include <cstdio>
+
+#include "pico-usbnet/PoolCalibration.h"
+
+extern "C" {
+    #include "lwip/memp.h"
+    #include "lwip/priv/memp_priv.h"
+    #include "lwip/stats.h"
+    #include "lwip/sys.h"
+}
+
+#define POOL_COUNT (MEMP_MAX + 1)
+
+static const char *const memp_options[] = {
+#define LWIP_MEMPOOL(name, num, size, desc) "MEMP_NUM_" #name,
+#include "lwip/priv/memp_std.h"
+};
+
+static_assert(sizeof(memp_options) / sizeof(memp_options[0]) == MEMP_MAX, "memp option table out of sync");
+
+// Worst case of every pool over the scenarios of a sweep
+static PoolCalibration::Pool sweep_pools[POOL_COUNT];
+static size_t sweep_scenarios = 0;
+
+static uint32_t recommend(uint32_t configured, uint32_t highWater, uint32_t failures) {
+    // An exhausted pool only tells us it was too small; double it and measure again
+    if (failures) {
+        return configured * 2;
+    }
+
+    uint32_t value = (highWater * (100 + PICONET_CALIBRATION_HEADROOM) + 99) / 100;
+
+    if (value <= highWater) {
+        value = highWater + 1;
+    }
+
+    return value;
+}
+
+size_t PoolCalibration::collect(Pool *pools, size_t maxPools) {
+#if PICONET_POOL_CALIBRATION
+    size_t count = 0;
+
+    if (count < maxPools) {
+        pools[count] = {"MEM_SIZE", MEM_SIZE, lwip_stats.mem.max, lwip_stats.mem.err, 0, nullptr};
+    }
+    count++;
+
+    for (int i = 0; i < MEMP_MAX; i++, count++) {
+        if (count >= maxPools) {
+            continue;
+        }
+
+        const struct stats_mem *stats = lwip_stats.memp[i];
+        const char *option = i == MEMP_PBUF_POOL ? "PBUF_POOL_SIZE" : memp_options[i];
+
+        pools[count] = {option, memp_pools[i]->num, stats->max, stats->err, 0, nullptr};
+    }
+
+    for (size_t i = 0; i < count && i < maxPools; i++) {
+        pools[i].recommended = recommend(pools[i].configured, pools[i].highWater, pools[i].failures);
+    }
+
+    return count;
+#else
+    (void)pools;
+    (void)maxPools;
+
+    return 0;
+#endif
+}
+
+void PoolCalibration::reset() {
+#if PICONET_POOL_CALIBRATION
+    SYS_ARCH_DECL_PROTECT(lev);
+    SYS_ARCH_PROTECT(lev);
+
+    lwip_stats.mem.max = lwip_stats.mem.used;
+    lwip_stats.mem.err = 0;
+
+    for (int i = 0; i < MEMP_MAX; i++) {
+        lwip_stats.memp[i]->max = lwip_stats.memp[i]->used;
+        lwip_stats.memp[i]->err = 0;
+    }
+
+    SYS_ARCH_UNPROTECT(lev);
+#endif
+}
+
+void PoolCalibration::endScenario(const char *name) {
+    Pool pools[POOL_COUNT];
+    size_t count = collect(pools, POOL_COUNT);
+
+    for (size_t i = 0; i < count && i < POOL_COUNT; i++) {
+        Pool &worst = sweep_pools[i];
+
+        if (!sweep_scenarios) {
+            worst = pools[i];
+            worst.failures = 0;
+            worst.highWater = 0;
+        }
+
+        worst.failures += pools[i].failures;
+
+        if (pools[i].highWater > worst.highWater || !worst.scenario) {
+            worst.highWater = pools[i].highWater;
+            worst.scenario = name;
+        }
+
+        worst.recommended = recommend(worst.configured, worst.highWater, worst.failures);
+    }
+
+    if (count) {
+        sweep_scenarios++;
+    }
+}
+
+void PoolCalibration::clearSweep() {
+    sweep_scenarios = 0;
+}
+
+void PoolCalibration::printRecommendation() {
+    Pool pools[POOL_COUNT];
+    size_t count = collect(pools, POOL_COUNT);
+
+    if (sweep_scenarios) {
+        for (size_t i = 0; i < count && i < POOL_COUNT; i++) {
+            pools[i] = sweep_pools[i];
+        }
+    }
+
+    if (!count) {
+        printf("/* pico-usbnet: build with PICONET_POOL_CALIBRATION=1 to calibrate pools */\n");
+        return;
+    }
+
+    printf("/* pico-usbnet pool calibration, %d%% headroom", PICONET_CALIBRATION_HEADROOM);
+
+    if (sweep_scenarios) {
+        printf(", worst of %u scenarios", (unsigned)sweep_scenarios);
+    }
+
+    printf(" */\n");
+
+    for (size_t i = 0; i < count && i < POOL_COUNT; i++) {
+        const Pool &pool = pools[i];
+
+        printf("#define %-24s %6u /* high-water %u of %u",
+               pool.option, (unsigned)pool.recommended, (unsigned)pool.highWater, (unsigned)pool.configured);
+
+        if (pool.failures) {
+            printf(", exhausted %u times: re-run after raising", (unsigned)pool.failures);
+        }
+
+        if (pool.scenario) {
+            printf(", in %s", pool.scenario);
+        }
+
+        printf(" */\n");
+    }
+}
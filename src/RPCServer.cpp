@@ -0,0 +1,227 @@
+#include <cstring>
+
+#include "pico-usbnet/RPCServer.h"
+#include "pico-usbnet/TxScheduler.h"
+
+static_assert(PICONET_RPC_MAX_DATAGRAM >= PICONET_RPC_HEADER_SIZE + PICONET_RPC_CALL_HEADER,
+              "PICONET_RPC_MAX_DATAGRAM cannot hold a single result");
+
+// Requests that arrive in a pbuf chain are flattened here
+static uint8_t request_buffer[PICONET_RPC_MAX_DATAGRAM];
+
+static inline uint16_t readLE16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t readLE32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void writeLE16(uint8_t *p, uint16_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+}
+
+RPCServer::RPCServer() : pcb(nullptr), handlers(nullptr), handlerCount(0), replies(), nextReply(0), stats() {}
+
+RPCServer::~RPCServer() {
+    stop();
+}
+
+err_t RPCServer::start(const RpcTable &table, uint16_t port) {
+    if (pcb) {
+        return ERR_ISCONN;
+    }
+
+    pcb = udp_new();
+
+    if (!pcb) {
+        return ERR_MEM;
+    }
+
+    err_t result = udp_bind(pcb, IP_ADDR_ANY, port);
+
+    if (result != ERR_OK) {
+        udp_remove(pcb);
+        pcb = nullptr;
+
+        return result;
+    }
+
+    handlers = table.handlers;
+    handlerCount = table.count;
+
+    // Replies skip the queue behind bulk streams
+    pcb->tos = TxScheduler::tosFor(TxClass::Control);
+
+    udp_recv(pcb, receiveWrapper, this);
+
+    return ERR_OK;
+}
+
+void RPCServer::stop() {
+    if (pcb) {
+        udp_remove(pcb);
+        pcb = nullptr;
+    }
+
+    for (Reply &reply : replies) {
+        reply.length = 0;
+    }
+}
+
+void RPCServer::resetStats() {
+    stats = Stats();
+}
+
+RPCServer::Reply *RPCServer::findReply(const ip_addr_t *addr, uint16_t port, uint32_t requestId) {
+    for (Reply &reply : replies) {
+        if (reply.length && reply.requestId == requestId && reply.port == port && ip_addr_cmp(&reply.addr, addr)) {
+            return &reply;
+        }
+    }
+
+    return nullptr;
+}
+
+void RPCServer::handleRequest(struct pbuf *p, const ip_addr_t *addr, uint16_t port) {
+    const uint8_t *request;
+    uint16_t length = p->tot_len;
+
+    // A single pbuf is parsed in place
+    if (p->len == p->tot_len) {
+        request = static_cast<const uint8_t *>(p->payload);
+    } else if (length <= sizeof(request_buffer)) {
+        request = request_buffer;
+        pbuf_copy_partial(p, request_buffer, length, 0);
+    } else {
+        stats.malformed++;
+
+        return;
+    }
+
+    if (length < PICONET_RPC_HEADER_SIZE || request[0] != PICONET_RPC_VERSION ||
+        (request[1] & PICONET_RPC_FLAG_RESPONSE)) {
+        stats.malformed++;
+
+        return;
+    }
+
+    stats.datagrams++;
+
+    uint8_t callCount = request[2];
+    uint32_t requestId = readLE32(request + 4);
+    Reply *reply = findReply(addr, port, requestId);
+
+    if (reply) {
+        stats.retries++;
+        sendReply(*reply, addr, port);
+
+        return;
+    }
+
+    // Recycle the oldest cached reply
+    reply = &replies[nextReply];
+    nextReply = (nextReply + 1) % PICONET_RPC_REPLY_CACHE;
+
+    // Every call gets a result header, so a batch that cannot hold them all is never half answered
+    if (PICONET_RPC_HEADER_SIZE + (size_t)callCount * PICONET_RPC_CALL_HEADER > sizeof(reply->data)) {
+        stats.malformed++;
+
+        return;
+    }
+
+    uint8_t *out = reply->data;
+    size_t used = PICONET_RPC_HEADER_SIZE;
+    size_t offset = PICONET_RPC_HEADER_SIZE;
+    bool truncated = false;
+
+    for (uint8_t index = 0; index < callCount; index++) {
+        // Header space for the calls after this one stays reserved
+        size_t reserved = (size_t)(callCount - index - 1) * PICONET_RPC_CALL_HEADER;
+
+        if (!truncated && (offset + PICONET_RPC_CALL_HEADER > length ||
+                           offset + PICONET_RPC_CALL_HEADER + readLE16(request + offset + 2) > length)) {
+            stats.malformed++;
+            truncated = true;
+        }
+
+        // Truncated batch: the calls that did not make it are answered, not run
+        if (truncated) {
+            writeLE16(out + used, (uint16_t)RpcStatus::BadArguments);
+            writeLE16(out + used + 2, 0);
+            used += PICONET_RPC_CALL_HEADER;
+
+            continue;
+        }
+
+        uint16_t method = readLE16(request + offset);
+        RpcCall call;
+
+        call.args = request + offset + PICONET_RPC_CALL_HEADER;
+        call.argLength = readLE16(request + offset + 2);
+        call.result = out + used + PICONET_RPC_CALL_HEADER;
+        call.resultCapacity = (uint16_t)(sizeof(reply->data) - used - PICONET_RPC_CALL_HEADER - reserved);
+        call.resultLength = 0;
+
+        RpcStatus status;
+
+        if (method < handlerCount && handlers[method]) {
+            status = handlers[method](call);
+        } else if (method == PICONET_RPC_METHOD_ECHO) {
+            status = call.write(call.args, call.argLength) ? RpcStatus::Ok : RpcStatus::ResultTooLarge;
+        } else {
+            stats.unknownMethods++;
+            status = RpcStatus::UnknownMethod;
+        }
+
+        // A handler that overran its capacity gets its payload dropped
+        if (call.resultLength > call.resultCapacity) {
+            status = RpcStatus::ResultTooLarge;
+            call.resultLength = 0;
+        }
+
+        writeLE16(out + used, (uint16_t)status);
+        writeLE16(out + used + 2, call.resultLength);
+        used += PICONET_RPC_CALL_HEADER + call.resultLength;
+        offset += PICONET_RPC_CALL_HEADER + call.argLength;
+
+        stats.calls++;
+    }
+
+    out[0] = PICONET_RPC_VERSION;
+    out[1] = PICONET_RPC_FLAG_RESPONSE;
+    out[2] = callCount;
+    out[3] = 0;
+    memcpy(out + 4, request + 4, 4);
+
+    ip_addr_copy(reply->addr, *addr);
+    reply->port = port;
+    reply->requestId = requestId;
+    reply->length = (uint16_t)used;
+
+    sendReply(*reply, addr, port);
+}
+
+void RPCServer::sendReply(const Reply &reply, const ip_addr_t *addr, uint16_t port) {
+    // Referenced, not copied: the driver (or a TX queue) copies it before the cache slot is reused
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, reply.length, PBUF_REF);
+
+    if (!p) {
+        return;
+    }
+
+    p->payload = const_cast<uint8_t *>(reply.data);
+
+    udp_sendto(pcb, p, addr, port);
+    pbuf_free(p);
+}
+
+void RPCServer::receiveWrapper(void *arg, struct udp_pcb *upcb, struct pbuf *p,
+                               const ip_addr_t *addr, uint16_t port) {
+    RPCServer *instance = static_cast<RPCServer*>(arg);
+
+    instance->handleRequest(p, addr, port);
+
+    pbuf_free(p);
+}
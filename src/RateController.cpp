@@ -0,0 +1,262 @@
+#include "pico-usbnet/RateController.h"
+#include "pico-usbnet/USBNetwork.h"
+
+// Intervals after a step down before pressure may cause another one, so the
+// smoothed value can catch up with the reduced rate
+#define RATE_HOLD_INTERVALS     2
+
+static const RateLevel default_levels[] = {
+    {RateMode::Full, 1, 0},
+    {RateMode::Average, 2, 0},
+    {RateMode::Average, 4, 0},
+    {RateMode::Decimate, 8, 0},
+    {RateMode::Decimate, 16, 0},
+};
+
+static inline uint8_t percentOf(uint32_t used, uint32_t total) {
+    return total ? (uint8_t)(used >= total ? 100 : used * 100 / total) : 0;
+}
+
+RateController::RateController()
+    : levelCount(0), level(0),
+      highPercent(PICONET_RATE_HIGH_PERCENT), lowPercent(PICONET_RATE_LOW_PERCENT),
+      recoverIntervals(PICONET_RATE_RECOVER_INTERVALS), quietIntervals(0), holdIntervals(0),
+      started(false), intervalStartMs(0), peak(0), smoothed(0), draining(true),
+      lastWritten(0), lastAcked(0), lastMemErrors(0), sum(0), phase(0), stats() {
+    setPolicy(default_levels, sizeof(default_levels) / sizeof(default_levels[0]));
+}
+
+bool RateController::setPolicy(const RateLevel *policy, size_t count) {
+    if (count == 0 || count > PICONET_RATE_MAX_LEVELS) {
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        levels[i] = policy[i];
+
+        if (levels[i].factor == 0) {
+            levels[i].factor = 1;
+        }
+    }
+
+    levelCount = count;
+    reset();
+
+    return true;
+}
+
+void RateController::setThresholds(uint8_t high, uint8_t low, uint16_t recover) {
+    highPercent = high;
+    lowPercent = low < high ? low : high;
+    recoverIntervals = recover ? recover : 1;
+}
+
+void RateController::reset() {
+    setLevel(0);
+
+    started = false;
+    peak = 0;
+    smoothed = 0;
+    draining = true;
+    quietIntervals = 0;
+    holdIntervals = 0;
+}
+
+void RateController::resetStats() {
+    stats = Stats();
+}
+
+void RateController::setLevel(size_t index) {
+    level = index;
+    sum = 0;
+    phase = 0;
+
+    if (level > stats.maxLevel) {
+        stats.maxLevel = (uint8_t)level;
+    }
+}
+
+bool RateController::update(TCP &tcp, uint32_t nowMs) {
+    if (!tcp.isConnected()) {
+        // The next client starts at full quality
+        if (started) {
+            reset();
+        }
+
+        return false;
+    }
+
+    const TCP::Stats &tcpStats = tcp.getStats();
+
+    if (!started) {
+        lastWritten = tcpStats.written;
+        lastAcked = tcpStats.acked;
+        lastMemErrors = tcpStats.memErrors;
+    }
+
+    uint8_t pressure = percentOf(TCP_SND_BUF - tcp.getAvailableSize(), TCP_SND_BUF);
+    uint8_t queue = percentOf(tcp.getQueueLength(), TCP_SND_QUEUELEN);
+
+    if (queue > pressure) {
+        pressure = queue;
+    }
+
+#if PICONET_TX_SCHEDULER
+    TxScheduler &scheduler = USBNetwork::getTxScheduler();
+
+    for (TxClass txClass : {TxClass::Normal, TxClass::Bulk}) {
+        uint8_t depth = percentOf(scheduler.getStats(txClass).depth, PICONET_TX_QUEUE_DEPTH);
+
+        if (depth > pressure) {
+            pressure = depth;
+        }
+    }
+#endif
+
+    bool overflow = tcpStats.memErrors != lastMemErrors;
+
+    stats.overflows += tcpStats.memErrors - lastMemErrors;
+    lastMemErrors = tcpStats.memErrors;
+
+    uint32_t intervals = stats.intervals;
+    bool changed = update(pressure, overflow, tcpStats.acked - lastAcked >= tcpStats.written - lastWritten, nowMs);
+
+    // ACK pacing is judged per interval
+    if (stats.intervals != intervals) {
+        lastWritten = tcpStats.written;
+        lastAcked = tcpStats.acked;
+    }
+
+    return changed;
+}
+
+bool RateController::update(uint8_t pressure, bool overflow, bool drained, uint32_t nowMs) {
+    if (!started) {
+        started = true;
+        intervalStartMs = nowMs;
+    }
+
+    if (pressure > peak) {
+        peak = pressure;
+    }
+
+    draining = drained;
+
+    // Data is already being refused: step down without waiting for the interval
+    if (overflow && holdIntervals == 0 && level + 1 < levelCount) {
+        setLevel(level + 1);
+        stats.degrades++;
+        holdIntervals = RATE_HOLD_INTERVALS;
+        quietIntervals = 0;
+
+        return true;
+    }
+
+    if (nowMs - intervalStartMs < PICONET_RATE_INTERVAL_MS) {
+        return false;
+    }
+
+    return evaluate(overflow, nowMs);
+}
+
+bool RateController::evaluate(bool overflow, uint32_t nowMs) {
+    stats.intervals++;
+
+    // Exponential average with weight 1/4, kept in quarter percent
+    smoothed = (uint16_t)(smoothed - smoothed / 4 + peak);
+    stats.pressure = (uint8_t)(smoothed / 4);
+
+    intervalStartMs = nowMs;
+    peak = 0;
+
+    if (holdIntervals) {
+        holdIntervals--;
+    }
+
+    if ((overflow || stats.pressure >= highPercent) && holdIntervals == 0) {
+        quietIntervals = 0;
+
+        if (level + 1 < levelCount) {
+            setLevel(level + 1);
+            stats.degrades++;
+            holdIntervals = RATE_HOLD_INTERVALS;
+
+            return true;
+        }
+
+        return false;
+    }
+
+    if (stats.pressure > lowPercent || !draining) {
+        quietIntervals = 0;
+
+        return false;
+    }
+
+    if (++quietIntervals < recoverIntervals || level == 0) {
+        return false;
+    }
+
+    quietIntervals = 0;
+    setLevel(level - 1);
+    stats.restores++;
+
+    return true;
+}
+
+bool RateController::reduce(float in, float &out) {
+    const RateLevel &current = levels[level];
+
+    stats.samplesIn++;
+
+    switch (current.mode) {
+    case RateMode::Average:
+        sum += in;
+
+        if (++phase < current.factor) {
+            return false;
+        }
+
+        out = sum / phase;
+        sum = 0;
+        phase = 0;
+        break;
+    case RateMode::Decimate: {
+        bool keep = phase == 0;
+
+        if (++phase >= current.factor) {
+            phase = 0;
+        }
+
+        if (!keep) {
+            return false;
+        }
+
+        out = in;
+        break;
+    }
+    default:
+        out = in;
+        break;
+    }
+
+    stats.samplesOut++;
+
+    return true;
+}
+
+size_t RateController::encodeReport(uint8_t *out) const {
+    uint32_t marker = PICONET_RATE_REPORT_MARKER;
+    const RateLevel &current = levels[level];
+
+    out[0] = (uint8_t)marker;
+    out[1] = (uint8_t)(marker >> 8);
+    out[2] = (uint8_t)(marker >> 16);
+    out[3] = (uint8_t)(marker >> 24);
+    out[4] = (uint8_t)level;
+    out[5] = (uint8_t)current.mode;
+    out[6] = current.factor;
+    out[7] = current.codec;
+
+    return PICONET_RATE_REPORT_SIZE;
+}
@@ -0,0 +1,192 @@
+#include "pico-usbnet/Scheduler.h"
+
+extern "C" {
+    #include "pico/stdlib.h"
+}
+
+static_assert(PICONET_SCHED_TASKS <= 255, "heap positions are kept in a byte");
+static_assert(PICONET_SCHED_CATCH_UP >= 1, "a due task runs at least once");
+
+#define NOT_QUEUED 0xff
+
+Scheduler::Scheduler() : slots(), heap(), heapSize(0) {}
+
+int Scheduler::schedulePeriodic(Task task, uint32_t periodUs, uint64_t firstUs) {
+    if (periodUs == 0) {
+        return -1;
+    }
+
+    return allocate(task, periodUs, firstUs ? firstUs : time_us_64() + periodUs);
+}
+
+int Scheduler::scheduleAt(Task task, uint64_t deadlineUs) {
+    return allocate(task, 0, deadlineUs);
+}
+
+int Scheduler::allocate(Task task, uint32_t periodUs, uint64_t deadlineUs) {
+    if (!task) {
+        return -1;
+    }
+
+    for (int i = 0; i < PICONET_SCHED_TASKS; i++) {
+        Slot &slot = slots[i];
+
+        if (!slot.active) {
+            slot.task = task;
+            slot.periodUs = periodUs;
+            slot.deadlineUs = deadlineUs;
+            slot.active = true;
+            slot.generation++;
+            slot.stats = TaskStats();
+            push((uint8_t)i);
+
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void Scheduler::cancel(int id) {
+    if (id < 0 || id >= PICONET_SCHED_TASKS || !slots[id].active) {
+        return;
+    }
+
+    // A task cancelling itself from its callback is not in the heap
+    if (slots[id].heapIndex != NOT_QUEUED) {
+        remove(slots[id].heapIndex);
+    }
+
+    slots[id].active = false;
+}
+
+uint64_t Scheduler::nextDeadlineUs() const {
+    return heapSize ? slots[heap[0]].deadlineUs : UINT64_MAX;
+}
+
+size_t Scheduler::runDue(uint64_t nowUs) {
+    size_t runs = 0;
+
+    while (heapSize && slots[heap[0]].deadlineUs <= nowUs) {
+        uint8_t id = heap[0];
+        Slot &slot = slots[id];
+
+        uint32_t generation = slot.generation;
+
+        remove(0);
+
+        for (int pass = 0; pass < PICONET_SCHED_CATCH_UP && slot.deadlineUs <= nowUs; pass++) {
+            uint64_t startUs = time_us_64();
+            uint32_t lateUs = startUs > slot.deadlineUs ? (uint32_t)(startUs - slot.deadlineUs) : 0;
+
+            slot.stats.runs++;
+            slot.stats.lastLateUs = lateUs;
+            slot.stats.totalLateUs += lateUs;
+
+            if (lateUs > slot.stats.maxLateUs) {
+                slot.stats.maxLateUs = lateUs;
+            }
+
+            slot.task(slot.deadlineUs);
+            runs++;
+
+            if (!slot.active || slot.generation != generation || slot.periodUs == 0) {
+                break;
+            }
+
+            slot.deadlineUs += slot.periodUs;
+        }
+
+        // A new task in the slot was queued when it was scheduled
+        if (!slot.active || slot.generation != generation) {
+            continue;
+        }
+
+        if (slot.periodUs == 0) {
+            slot.active = false;
+            continue;
+        }
+
+        // Beyond the catch-up allowance, keep the phase and give up the rest
+        if (slot.deadlineUs <= nowUs) {
+            uint64_t skipped = (nowUs - slot.deadlineUs) / slot.periodUs + 1;
+
+            slot.stats.missed += (uint32_t)skipped;
+            slot.deadlineUs += skipped * slot.periodUs;
+        }
+
+        push(id);
+    }
+
+    return runs;
+}
+
+void Scheduler::resetStats() {
+    for (Slot &slot : slots) {
+        slot.stats = TaskStats();
+    }
+}
+
+void Scheduler::push(uint8_t slot) {
+    place(heapSize++, slot);
+    siftUp(heapSize - 1);
+}
+
+void Scheduler::remove(size_t index) {
+    slots[heap[index]].heapIndex = NOT_QUEUED;
+
+    if (--heapSize == index) {
+        return;
+    }
+
+    place(index, heap[heapSize]);
+    siftDown(index);
+    siftUp(index);
+}
+
+void Scheduler::siftUp(size_t index) {
+    uint8_t slot = heap[index];
+
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+
+        if (slots[heap[parent]].deadlineUs <= slots[slot].deadlineUs) {
+            break;
+        }
+
+        place(index, heap[parent]);
+        index = parent;
+    }
+
+    place(index, slot);
+}
+
+void Scheduler::siftDown(size_t index) {
+    uint8_t slot = heap[index];
+
+    for (;;) {
+        size_t child = 2 * index + 1;
+
+        if (child >= heapSize) {
+            break;
+        }
+
+        if (child + 1 < heapSize && slots[heap[child + 1]].deadlineUs < slots[heap[child]].deadlineUs) {
+            child++;
+        }
+
+        if (slots[slot].deadlineUs <= slots[heap[child]].deadlineUs) {
+            break;
+        }
+
+        place(index, heap[child]);
+        index = child;
+    }
+
+    place(index, slot);
+}
+
+void Scheduler::place(size_t index, uint8_t slot) {
+    heap[index] = slot;
+    slots[slot].heapIndex = (uint8_t)index;
+}
@@ -1,6 +1,8 @@
 #include "pico-usbnet/TCP.h"
 
-TCP::TCP() {
+TCP::TCP() : pcb(nullptr), client(nullptr), listener(nullptr), tos(0), stats(),
+    receiveCallback(nullptr), errorCallback(nullptr), closeCallback(nullptr),
+    acceptCallback(nullptr), connectCallback(nullptr), sentCallback(nullptr) {
     
 }
 
@@ -8,6 +10,8 @@ TCP::~TCP() {
     if (pcb) {
         this->close();
     }
+
+    stopListening();
 }
 
 void TCP::init() {
@@ -19,6 +23,10 @@ void TCP::init() {
     }
 
     tcp_arg(pcb, this);
+
+    if (pcb) {
+        pcb->tos = tos;
+    }
 }
 
 void TCP::keepAlive(bool enable, uint32_t interval) {
@@ -30,16 +38,46 @@ void TCP::keepAlive(bool enable, uint32_t interval) {
     }
 }
 
-void TCP::bind(const ip_addr_t *ipaddr, uint16_t port) {
+void TCP::bind(const ip_addr_t *ipaddr, uint16_t port, bool reuseAddress) {
+    if (reuseAddress) {
+        ip_set_option(pcb, SOF_REUSEADDR);
+    }
+
     tcp_bind(pcb, ipaddr, port);
 }
 
 void TCP::listen() {
     struct tcp_pcb* listen = tcp_listen(pcb);
     pcb = listen;
+    listener = listen;
     tcp_accept(listen, acceptWrapper);
 }
 
+void TCP::stopListening() {
+    if (!listener) {
+        return;
+    }
+
+    tcp_close(listener);
+
+    if (pcb == listener) {
+        pcb = nullptr;
+    }
+
+    listener = nullptr;
+}
+
+err_t TCP::connect(const ip_addr_t *ipaddr, uint16_t port) {
+    if (!pcb) {
+        return ERR_CONN;
+    }
+
+    // A refused or timed-out connect frees the pcb before reporting it, so it must be forgotten, not closed
+    tcp_err(pcb, pcbErrorWrapper);
+
+    return tcp_connect(pcb, ipaddr, port, connectWrapper);
+}
+
 void TCP::close() {
     closeWrapper(this);
 }
@@ -66,7 +104,20 @@ err_t TCP::send() {
 }
 
 uint16_t TCP::getAvailableSize() {
-    return tcp_sndbuf(pcb);
+    return pcb ? tcp_sndbuf(pcb) : 0;
+}
+
+uint16_t TCP::getQueueLength() {
+    return client ? tcp_sndqueuelen(client) : 0;
+}
+
+void TCP::setPriority(TxClass txClass) {
+    tos = TxScheduler::tosFor(txClass);
+
+    // Accepted connections pick it up in acceptWrapper()
+    if (pcb) {
+        pcb->tos = tos;
+    }
 }
 
 err_t TCP::write(const void *data, uint16_t len) {
@@ -86,11 +137,17 @@ err_t TCP::write(const void *data, uint16_t len) {
     err_t result = tcp_write(pcb, data, len, TCP_WRITE_FLAG_COPY);
 
     if (result != ERR_OK) {
+        if (result == ERR_MEM) {
+            stats.memErrors++;
+        }
+
         errorWrapper(this, result);
 
         return result;
     }
 
+    stats.written += len;
+
     return ERR_OK;
 }
 
@@ -110,6 +167,10 @@ void TCP::onAccept(void (*callback)(struct tcp_pcb *newpcb, err_t err)) {
     acceptCallback = callback;
 }
 
+void TCP::onConnect(void (*callback)(err_t err)) {
+    connectCallback = callback;
+}
+
 void TCP::onSent(void (*callback)(err_t err)) {
     sentCallback = callback;
 }
@@ -124,6 +185,13 @@ err_t TCP::receiveWrapper(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t
         return err;
     }
 
+    // The peer closed its side
+    if (p == NULL) {
+        instance->close();
+
+        return ERR_OK;
+    }
+
     tcp_recved(tpcb, p->tot_len);
     tcp_sent(tpcb, sentWrapper);
 
@@ -136,6 +204,8 @@ err_t TCP::receiveWrapper(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t
         instance->receiveCallback(p);
     }
 
+    pbuf_free(p);
+
     return ERR_OK;
 }
 
@@ -151,6 +221,16 @@ void TCP::errorWrapper(void *arg, err_t err) {
     }
 }
 
+// lwIP reports resets and aborts here, after it has freed the pcb
+void TCP::pcbErrorWrapper(void *arg, err_t err) {
+    TCP *instance = static_cast<TCP*>(arg);
+
+    instance->pcb = nullptr;
+    instance->client = nullptr;
+
+    errorWrapper(instance, err);
+}
+
 err_t TCP::acceptWrapper(void *arg, struct tcp_pcb *newpcb, err_t err) {
     TCP *instance = static_cast<TCP*>(arg);
 
@@ -161,11 +241,15 @@ err_t TCP::acceptWrapper(void *arg, struct tcp_pcb *newpcb, err_t err) {
     }
 
     tcp_setprio(newpcb, TCP_PRIO_MAX);
+    newpcb->tos = instance->tos;
     tcp_recv(newpcb, receiveWrapper);
-    tcp_err(newpcb, errorWrapper);
+    tcp_err(newpcb, pcbErrorWrapper);
     tcp_poll(newpcb, NULL, 4);
+    // ACKs are counted whether or not the peer ever sends anything
+    tcp_sent(newpcb, sentWrapper);
 
     instance->pcb = newpcb;
+    instance->client = newpcb;
     
     if (instance && instance->acceptCallback) {
         instance->acceptCallback(newpcb, err);
@@ -174,10 +258,43 @@ err_t TCP::acceptWrapper(void *arg, struct tcp_pcb *newpcb, err_t err) {
     return err;
 }
 
+err_t TCP::connectWrapper(void *arg, struct tcp_pcb *tpcb, err_t err) {
+    TCP *instance = static_cast<TCP*>(arg);
+
+    if (err == ERR_OK) {
+        tcp_recv(tpcb, receiveWrapper);
+        tcp_sent(tpcb, sentWrapper);
+        instance->client = tpcb;
+    }
+
+    if (instance->connectCallback) {
+        instance->connectCallback(err);
+    }
+
+    return ERR_OK;
+}
+
 void TCP::closeWrapper(void *arg) {
     TCP *instance = static_cast<TCP*>(arg);
 
-    tcp_close(instance->pcb);
+    if (instance->pcb) {
+        // A closing pcb lingers; its late events must not reach an instance that owns a new one by then
+        if (instance->pcb->state != LISTEN) {
+            tcp_arg(instance->pcb, NULL);
+            tcp_recv(instance->pcb, NULL);
+            tcp_sent(instance->pcb, NULL);
+            tcp_err(instance->pcb, NULL);
+        }
+
+        if (instance->pcb == instance->listener) {
+            instance->listener = nullptr;
+        }
+
+        tcp_close(instance->pcb);
+        instance->pcb = nullptr;
+    }
+
+    instance->client = nullptr;
 
     if (instance && instance->closeCallback) {
         instance->closeCallback();
@@ -187,6 +304,8 @@ void TCP::closeWrapper(void *arg) {
 err_t TCP::sentWrapper(void *arg, struct tcp_pcb *tpcb, u16_t len) {
     TCP *instance = static_cast<TCP*>(arg);
 
+    instance->stats.acked += len;
+
     if (instance && instance->sentCallback) {
         instance->sentCallback(ERR_OK);
     }
@@ -0,0 +1,201 @@
+#include "pico-usbnet/TimeSync.h"
+#include "pico-usbnet/TxScheduler.h"
+#include "pico-usbnet/USBNetwork.h"
+
+extern "C" {
+    #include "lwip/timeouts.h"
+}
+
+static inline uint32_t readLE32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t readLE64(const uint8_t *p) {
+    return (uint64_t)readLE32(p) | ((uint64_t)readLE32(p + 4) << 32);
+}
+
+static inline void writeLE32(uint8_t *p, uint32_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+}
+
+static inline void writeLE64(uint8_t *p, uint64_t value) {
+    writeLE32(p, (uint32_t)value);
+    writeLE32(p + 4, (uint32_t)(value >> 32));
+}
+
+TimeSync::TimeSync()
+    : pcb(nullptr), server(), serverPort(0), hasServer(false),
+      sequence(0), pending(false), sentUs(0), estimator(), stats() {}
+
+TimeSync::~TimeSync() {
+    stop();
+}
+
+err_t TimeSync::start(uint16_t port) {
+    if (pcb) {
+        return ERR_ISCONN;
+    }
+
+    pcb = udp_new();
+
+    if (!pcb) {
+        return ERR_MEM;
+    }
+
+    err_t result = udp_bind(pcb, IP_ADDR_ANY, port);
+
+    if (result != ERR_OK) {
+        udp_remove(pcb);
+        pcb = nullptr;
+
+        return result;
+    }
+
+    // Queueing behind bulk streams would show up as delay
+    pcb->tos = TxScheduler::tosFor(TxClass::Control);
+
+    udp_recv(pcb, receiveWrapper, this);
+    sys_timeout(PICONET_TIMESYNC_INTERVAL_MS, timerWrapper, this);
+
+    return ERR_OK;
+}
+
+void TimeSync::stop() {
+    if (pcb) {
+        sys_untimeout(timerWrapper, this);
+        udp_remove(pcb);
+        pcb = nullptr;
+    }
+
+    pending = false;
+}
+
+void TimeSync::setServer(const ip_addr_t &addr, uint16_t port) {
+    ip_addr_copy(server, addr);
+    serverPort = port;
+    hasServer = true;
+}
+
+void TimeSync::resetStats() {
+    stats = Stats();
+}
+
+size_t TimeSync::encodeStamp(uint8_t *out, uint64_t deviceUs) const {
+    writeLE32(out, PICONET_TIMESYNC_STAMP_MARKER);
+    writeLE32(out + 4, 0);
+    writeLE64(out + 8, isSynced() ? (uint64_t)toHostTimeUs(deviceUs) : 0);
+
+    return PICONET_TIMESYNC_STAMP_SIZE;
+}
+
+void TimeSync::sendRequest() {
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, PICONET_TIMESYNC_MESSAGE_SIZE, PBUF_RAM);
+
+    if (!p) {
+        return;
+    }
+
+    uint8_t *message = static_cast<uint8_t *>(p->payload);
+
+    sequence++;
+    sentUs = time_us_64();
+
+    message[0] = PICONET_TIMESYNC_VERSION;
+    message[1] = (uint8_t)TimeSyncType::Request;
+    message[2] = isSynced() ? PICONET_TIMESYNC_FLAG_SYNCED : 0;
+    message[3] = 0;
+    writeLE32(message + 4, sequence);
+    writeLE64(message + 8, sentUs);
+    writeLE64(message + 16, isSynced() ? (uint64_t)toHostTimeUs(sentUs) : 0);
+    writeLE64(message + 24, 0);
+    writeLE32(message + 32, (uint32_t)getDriftPpb());
+    writeLE32(message + 36, stats.lastDelayUs);
+
+    // The precise send time is taken when the driver gets the frame
+    USBNetwork::stampTransmit(p);
+
+    if (udp_sendto(pcb, p, &server, serverPort) == ERR_OK) {
+        pending = true;
+        stats.requests++;
+    } else {
+        USBNetwork::stampTransmit(nullptr);
+    }
+
+    pbuf_free(p);
+}
+
+void TimeSync::handleResponse(const uint8_t *message) {
+    if (!pending || readLE32(message + 4) != sequence) {
+        stats.stale++;
+
+        return;
+    }
+
+    pending = false;
+
+    uint64_t t1 = USBNetwork::getTransmitTimeUs();
+    int64_t t2 = (int64_t)readLE64(message + 16);
+    int64_t t3 = (int64_t)readLE64(message + 24);
+    uint64_t t4 = USBNetwork::getReceiveTimeUs();
+
+    // Not stamped (e.g. still waiting in an ARP queue, or dropped): fall back to the send call
+    if (t1 < sentUs) {
+        t1 = sentUs;
+    }
+
+    // One-way times by the model as it stood before this exchange
+    if (isSynced()) {
+        stats.upUs = (int32_t)(t2 - toHostTimeUs(t1));
+        stats.downUs = (int32_t)(toHostTimeUs(t4) - t3);
+    }
+
+    uint32_t delayUs;
+
+    if (estimator.addExchange(t1, t2, t3, t4, delayUs)) {
+        stats.points++;
+    }
+
+    stats.responses++;
+    stats.lastDelayUs = delayUs;
+
+    if (!stats.minDelayUs || delayUs < stats.minDelayUs) {
+        stats.minDelayUs = delayUs;
+    }
+}
+
+void TimeSync::timerWrapper(void *arg) {
+    TimeSync *instance = static_cast<TimeSync*>(arg);
+
+    if (instance->hasServer) {
+        instance->sendRequest();
+    }
+
+    // Faster exchanges until there is a drift estimate
+    uint32_t interval = PICONET_TIMESYNC_INTERVAL_MS;
+
+    if (instance->estimator.getPointCount() < 2) {
+        interval /= 4;
+    }
+
+    sys_timeout(interval, timerWrapper, instance);
+}
+
+void TimeSync::receiveWrapper(void *arg, struct udp_pcb *upcb, struct pbuf *p,
+                              const ip_addr_t *addr, uint16_t port) {
+    TimeSync *instance = static_cast<TimeSync*>(arg);
+    uint8_t message[PICONET_TIMESYNC_MESSAGE_SIZE];
+
+    if (pbuf_copy_partial(p, message, sizeof(message), 0) == sizeof(message) &&
+        message[0] == PICONET_TIMESYNC_VERSION) {
+        if (message[1] == (uint8_t)TimeSyncType::Announce) {
+            instance->setServer(*addr, port);
+        } else if (message[1] == (uint8_t)TimeSyncType::Response) {
+            instance->handleResponse(message);
+        }
+    }
+
+    pbuf_free(p);
+}
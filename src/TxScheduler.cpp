@@ -0,0 +1,273 @@
+#include "pico-usbnet/TxScheduler.h"
+
+#define ETH_HEADER_LEN      14
+#define ETHTYPE_IPV4        0x0800
+#define IP_PROTO_ICMP_NUM   1
+#define IP_PROTO_TCP_NUM    6
+#define IP_PROTO_UDP_NUM    17
+
+#define TCP_FLAG_FIN        0x01
+#define TCP_FLAG_SYN        0x02
+#define TCP_FLAG_RST        0x04
+
+// DSCP code points written by tosFor(): CS6, AF21 and CS1
+#define DSCP_CONTROL        48
+#define DSCP_NORMAL         18
+#define DSCP_BULK           8
+#define DSCP_EF             46
+
+static inline uint16_t readBE16(const uint8_t *p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+TxScheduler::TxScheduler() : current((size_t)TxClass::Normal), freshTurn(true), queued(0), stats() {
+    for (size_t i = 0; i < classCount; i++) {
+        deficit[i] = 0;
+    }
+
+    quantum[(size_t)TxClass::Control] = 0;
+    setWeight(TxClass::Normal, PICONET_TX_WEIGHT_NORMAL);
+    setWeight(TxClass::Bulk, PICONET_TX_WEIGHT_BULK);
+}
+
+uint8_t TxScheduler::tosFor(TxClass txClass) {
+    switch (txClass) {
+    case TxClass::Control:
+        return DSCP_CONTROL << 2;
+    case TxClass::Bulk:
+        return DSCP_BULK << 2;
+    default:
+        return DSCP_NORMAL << 2;
+    }
+}
+
+bool TxScheduler::setPortClass(uint16_t port, TxClass txClass) {
+    for (PortClass &entry : ports) {
+        if (entry.port == port) {
+            entry.txClass = txClass;
+
+            return true;
+        }
+    }
+
+    return ports.push_back({port, txClass});
+}
+
+void TxScheduler::clearPortClasses() {
+    ports.clear();
+}
+
+void TxScheduler::setWeight(TxClass txClass, uint8_t weight) {
+    if (txClass == TxClass::Control || txClass == TxClass::Count) {
+        return;
+    }
+
+    // One quantum always covers a full frame, so every turn sends something
+    quantum[(size_t)txClass] = (uint32_t)(weight ? weight : 1) * (PICONET_MTU + ETH_HEADER_LEN);
+}
+
+bool TxScheduler::lookupPort(uint16_t port, TxClass &txClass) const {
+    for (const PortClass &entry : ports) {
+        if (entry.port == port) {
+            txClass = entry.txClass;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+TxClass TxScheduler::classify(struct pbuf *p) const {
+    // Ethernet, IPv4 with options, and the TCP header up to its flags
+    uint8_t headers[ETH_HEADER_LEN + 60 + 14];
+    uint16_t length = pbuf_copy_partial(p, headers, sizeof(headers), 0);
+
+    if (length < ETH_HEADER_LEN + 20 || readBE16(headers + 12) != ETHTYPE_IPV4) {
+        // ARP and anything else that is not IPv4
+        return TxClass::Control;
+    }
+
+    const uint8_t *ip = headers + ETH_HEADER_LEN;
+    uint8_t dscp = ip[1] >> 2;
+    uint8_t protocol = ip[9];
+    uint16_t headerLen = (ip[0] & 0x0f) * 4;
+    // Fragments other than the first carry no transport header
+    bool fragment = ((ip[6] & 0x1f) | ip[7]) != 0;
+    bool ports = !fragment && (protocol == IP_PROTO_TCP_NUM || protocol == IP_PROTO_UDP_NUM) &&
+                 length >= ETH_HEADER_LEN + headerLen + 14;
+    const uint8_t *transport = ip + headerLen;
+
+    // Segments without payload carry no stream data and are cheap to send early,
+    // even on a socket marked Bulk, so its ACKs do not queue behind the bulk
+    // data. FIN and RST stay in order behind the data they end.
+    if (ports && protocol == IP_PROTO_TCP_NUM) {
+        uint16_t tcpHeaderLen = (transport[12] >> 4) * 4;
+        bool payload = readBE16(ip + 2) > headerLen + tcpHeaderLen;
+
+        if (!payload && !(transport[13] & (TCP_FLAG_FIN | TCP_FLAG_RST))) {
+            return TxClass::Control;
+        }
+    }
+
+    if (dscp == DSCP_BULK) {
+        return TxClass::Bulk;
+    } else if (dscp == DSCP_EF || dscp >= DSCP_CONTROL) {
+        return TxClass::Control;
+    } else if (dscp) {
+        return TxClass::Normal;
+    }
+
+    if (protocol == IP_PROTO_ICMP_NUM) {
+        return TxClass::Control;
+    }
+
+    if (!ports) {
+        return TxClass::Normal;
+    }
+
+    uint16_t srcPort = readBE16(transport);
+    TxClass txClass;
+
+    if (lookupPort(srcPort, txClass)) {
+        return txClass;
+    }
+
+    if (protocol == IP_PROTO_UDP_NUM) {
+        // DHCP and DNS replies
+        return (srcPort == 67 || srcPort == 53) ? TxClass::Control : TxClass::Normal;
+    }
+
+    return TxClass::Normal;
+}
+
+err_t TxScheduler::enqueue(struct pbuf *p, TxClass txClass, uint32_t nowUs) {
+    size_t index = (size_t)txClass;
+    auto &queue = queues[index];
+
+    if (queue.full()) {
+        stats[index].stalls++;
+
+        return ERR_WOULDBLOCK;
+    }
+
+    // lwIP may reuse PBUF_REF data as soon as linkoutput returns
+    struct pbuf *held = p;
+
+    if (PBUF_NEEDS_COPY(p)) {
+        held = pbuf_clone(PBUF_RAW, PBUF_RAM, p);
+
+        if (!held) {
+            return ERR_MEM;
+        }
+
+        stats[index].copied++;
+    } else {
+        pbuf_ref(p);
+    }
+
+    queue.push({held, nowUs});
+    queued++;
+
+    stats[index].depth = (uint16_t)queue.size();
+
+    if (stats[index].depth > stats[index].maxDepth) {
+        stats[index].maxDepth = stats[index].depth;
+    }
+
+    return ERR_OK;
+}
+
+void TxScheduler::nextTurn() {
+    current = current + 1 < classCount ? current + 1 : (size_t)TxClass::Normal;
+    freshTurn = true;
+}
+
+struct pbuf *TxScheduler::peek(TxClass &txClass) {
+    if (!queues[(size_t)TxClass::Control].empty()) {
+        txClass = TxClass::Control;
+
+        return queues[(size_t)TxClass::Control].front().p;
+    }
+
+    if (queued == 0) {
+        return nullptr;
+    }
+
+    // Deficit round robin over the remaining classes
+    for (;;) {
+        auto &queue = queues[current];
+
+        if (queue.empty()) {
+            deficit[current] = 0;
+            nextTurn();
+        } else if (deficit[current] >= queue.front().p->tot_len) {
+            txClass = (TxClass)current;
+
+            return queue.front().p;
+        } else if (freshTurn) {
+            deficit[current] += quantum[current];
+            freshTurn = false;
+        } else {
+            nextTurn();
+        }
+    }
+}
+
+void TxScheduler::pop(TxClass txClass, uint32_t nowUs) {
+    size_t index = (size_t)txClass;
+    Entry entry;
+
+    if (!queues[index].pop(entry)) {
+        return;
+    }
+
+    queued--;
+
+    if (txClass != TxClass::Control) {
+        deficit[index] -= entry.p->tot_len;
+    }
+
+    uint32_t latency = nowUs - entry.queuedUs;
+    ClassStats &classStats = stats[index];
+
+    classStats.sent++;
+    classStats.depth = (uint16_t)queues[index].size();
+    classStats.totalLatencyUs += latency;
+
+    if (latency > classStats.maxLatencyUs) {
+        classStats.maxLatencyUs = latency;
+    }
+
+    pbuf_free(entry.p);
+}
+
+void TxScheduler::countDirect(TxClass txClass) {
+    stats[(size_t)txClass].sent++;
+    stats[(size_t)txClass].direct++;
+}
+
+void TxScheduler::clear() {
+    for (size_t i = 0; i < classCount; i++) {
+        Entry entry;
+
+        while (queues[i].pop(entry)) {
+            pbuf_free(entry.p);
+        }
+
+        deficit[i] = 0;
+        stats[i].depth = 0;
+    }
+
+    queued = 0;
+    freshTurn = true;
+}
+
+void TxScheduler::resetStats() {
+    for (size_t i = 0; i < classCount; i++) {
+        uint16_t depth = stats[i].depth;
+
+        stats[i] = ClassStats();
+        stats[i].depth = depth;
+    }
+}
@@ -1,6 +1,7 @@
 #include "pico-usbnet/UDP.h"
+#include "pico-usbnet/CopyEngine.h"
 
-UDP::UDP() : pcb(nullptr), receiveCallback(nullptr) {}
+UDP::UDP() : pcb(nullptr), tos(0), receiveCallback(nullptr) {}
 
 UDP::~UDP() {
     close();
@@ -10,7 +11,10 @@ void UDP::init() {
     pcb = udp_new();
     if (!pcb) {
         // Handle error, e.g., throw exception or set error status
+        return;
     }
+
+    pcb->tos = tos;
 }
 
 void UDP::bind(const ip_addr_t *ipaddr, uint16_t port) {
@@ -19,6 +23,12 @@ void UDP::bind(const ip_addr_t *ipaddr, uint16_t port) {
     }
 }
 
+void UDP::connect(const ip_addr_t *ipaddr, uint16_t port) {
+    if (pcb) {
+        udp_connect(pcb, ipaddr, port);
+    }
+}
+
 void UDP::send(const void *data, uint16_t len) {
     if (pcb) {
         struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
@@ -28,8 +38,14 @@ void UDP::send(const void *data, uint16_t len) {
             return;
         }
 
-        memcpy(p->payload, data, len);
+#if LWIP_CHECKSUM_ON_COPY
+        // Sum the payload while copying it so udp_send() only has to add the headers
+        u16_t chksum = LWIP_CHKSUM_COPY(p->payload, data, len);
+        udp_send_chksum(pcb, p, 1, (u16_t)~chksum);
+#else
+        CopyEngine::copy(p->payload, data, len);
         udp_send(pcb, p);
+#endif
         pbuf_free(p);
     }
 }
@@ -41,6 +57,14 @@ void UDP::close() {
     }
 }
 
+void UDP::setPriority(TxClass txClass) {
+    tos = TxScheduler::tosFor(txClass);
+
+    if (pcb) {
+        pcb->tos = tos;
+    }
+}
+
 void UDP::onReceive(void (*callback)(struct pbuf *p, const ip_addr_t *addr, uint16_t port)) {
     receiveCallback = callback;
 
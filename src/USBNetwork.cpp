@@ -1,6 +1,32 @@
+#include <cstdio>
+
 #include "pico-usbnet/USBNetwork.h"
+#include "pico-usbnet/LwipLock.h"
+#include "pico-usbnet/Async.h"
+#include "pico-usbnet/CopyEngine.h"
 
+extern "C" {
+#include "lwip/prot/ethernet.h"
+#include "lwip/prot/ip.h"
+#include "lwip/snmp.h"
+}
+
+USBNetwork *USBNetwork::usb_interface = nullptr;
+InterfaceStats *USBNetwork::usb_stats = nullptr;
 struct pbuf* USBNetwork::received_frame = nullptr;
+PacketFilter USBNetwork::packet_filter;
+TxScheduler USBNetwork::tx_scheduler;
+bool USBNetwork::received_verified = false;
+bool USBNetwork::received_copying = false;
+uint32_t USBNetwork::link_up_us = 0;
+uint32_t USBNetwork::first_byte_us = 0;
+uint64_t USBNetwork::received_us = 0;
+struct pbuf *USBNetwork::stamp_pbuf = nullptr;
+uint64_t USBNetwork::stamped_us = 0;
+
+#if PICONET_COPY_DMA
+static DmaCopyEngine dma_copy_engine;
+#endif
 
 /* this is used by this code, ./class/net/net_driver.c, and usb_descriptors.c */
 /* ideally speaking, this should be generated from the hardware's unique ID (if available) */
@@ -11,35 +37,31 @@ USBNetwork::USBNetwork(
     const ip_addr_t &ipaddr,
     const ip_addr_t &netmask,
     const ip_addr_t &gateway,
-    const std::vector<dhcp_entry_t>& dhcpEntries
-) : ipaddr(ipaddr), netmask(netmask), gateway(gateway), dhcp_entries(dhcpEntries) {
-    // If no DHCP entries are provided, use a default entry
-    /* database IP addresses that can be offered to the host; this must be in RAM to store assigned MAC addresses */
-    if (dhcp_entries.empty()) {
-        dhcp_entry_t defaultEntry = { {0}, IPADDR4_INIT_BYTES(192, 168, 5, 3), 24 * 60 * 60 }; // 24-hour lease time
-        dhcp_entries.push_back(defaultEntry);
-    }
-
-    // Initialize the DHCP server configuration
-    dhcp_config =
-    {
-        /* router address (if any) */
-        .router = gateway,
-        /* listen port */
-        .port = 67,
-        /* dns server (if any) */
-        .dns = IPADDR4_INIT_BYTES(0, 0, 0, 0),
-        /* dns suffix */
-        "usb",
-        /* dhcp database */
-        static_cast<int>(dhcp_entries.size()),
-        dhcp_entries.data()
-    };
+    const DHCPPool &dhcpPool
+) : started(false), usb(false), event_mask(0), event_us(), event_callback(nullptr),
+    interfaces(), interface_count(1), trust_link_checksums(false) {
+    interfaces[0].kind = InterfaceKind::Usb;
+    interfaces[0].ipaddr = ipaddr;
+    interfaces[0].netmask = netmask;
+    interfaces[0].gateway = gateway;
+
+    // Hosts get the router and this device as resolver
+    dhcp_server.configure(ipaddr, netmask, gateway, ipaddr, PICONET_DNS_DOMAIN, dhcpPool);
+
+    dns_server.addRecord(PICONET_HOSTNAME, ipaddr);
 }
 
 void USBNetwork::init() {
+#if PICONET_COPY_DMA
+    // Large frame copies go to a DMA channel when one is free
+    if (!CopyEngine::getInstalled() && dma_copy_engine.claim()) {
+        CopyEngine::install(&dma_copy_engine);
+    }
+#endif
+
     // Initialize tinyUSB
     tusb_init();
+    usb = true;
 
     // Initialize lwip
     lwip_init();
@@ -47,83 +69,559 @@ void USBNetwork::init() {
     // Initialize network interface
     initNetworkInterface();
 
-    // wait for network to be up
-    waitForNetworkUp();
+    // Servers and milestones follow from work(), so callers can keep producing meanwhile
+    started = true;
+    advanceInit();
+}
+
+void USBNetwork::initLoopback() {
+    lwip_init();
+    initNetworkInterface();
 
-    // Start DHCP server
-    startDhcpServer();
+    started = true;
+    advanceInit();
+}
+
+int USBNetwork::addLocalInterface(const ip_addr_t &ipaddr, const ip_addr_t &netmask) {
+    if (started || interface_count == PICONET_NETIFS) {
+        return -1;
+    }
+
+    Interface &interface = interfaces[interface_count];
+
+    interface.kind = InterfaceKind::Local;
+    interface.ipaddr = ipaddr;
+    interface.netmask = netmask;
+    ip_addr_set_zero(&interface.gateway);
+
+    return (int)interface_count++;
+}
+
+void USBNetwork::resetInterfaceStats() {
+    for (size_t i = 0; i < interface_count; i++) {
+        interfaces[i].stats = InterfaceStats();
+#if MIB2_STATS
+        memset(&interfaces[i].netif.mib2_counters, 0, sizeof(interfaces[i].netif.mib2_counters));
+#endif
+    }
+}
+
+void USBNetwork::printInterfaceStats() const {
+    printf("pico-usbnet interfaces:\n");
+
+    for (size_t i = 0; i < interface_count; i++) {
+        const Interface &interface = interfaces[i];
+        const InterfaceStats &stats = interface.stats;
+
+        printf("  %c%c%u %s: rx %lu frames %lu bytes %lu dropped, tx %lu frames %lu bytes %lu dropped\n",
+               interface.netif.name[0], interface.netif.name[1], (unsigned)i, ipaddr_ntoa(&interface.ipaddr),
+               (unsigned long)stats.rxFrames, (unsigned long)stats.rxBytes, (unsigned long)stats.rxDropped,
+               (unsigned long)stats.txFrames, (unsigned long)stats.txBytes, (unsigned long)stats.txDropped);
+    }
 }
 
 void USBNetwork::waitForNetworkUp() {
-    while (!netif_is_up(&netif_data));
+    while (!isReady()) {
+        work();
+    }
+}
+
+err_t USBNetwork::startDhcpServer() {
+    // Start the DHCP server with the pool given to the constructor
+    err_t result = dhcp_server.start();
+
+    if (result != ERR_OK && result != ERR_ISCONN) {
+        return result;
+    }
+
+    // DHCP advertises this device as the resolver
+    result = dns_server.start();
+
+    return result == ERR_ISCONN ? ERR_OK : result;
 }
 
-void USBNetwork::startDhcpServer() {
-    // Initialize and start DHCP server with the provided configuration
-    while (dhserv_init(&dhcp_config) != ERR_OK);
+void USBNetwork::onEvent(EventCallback callback) {
+    event_callback = callback;
+}
+
+uint32_t USBNetwork::getEventTimeUs(NetworkEvent event) const {
+    return reached(event) ? event_us[(uint8_t)event] : 0;
+}
+
+void USBNetwork::printBootTimings() const {
+    static const char *const names[] = {
+        "interface up", "dhcp ready", "usb mounted", "link up", "first offer", "first lease", "first byte",
+    };
+
+    static_assert(sizeof(names) / sizeof(names[0]) == (size_t)NetworkEvent::Count, "event name table out of sync");
+
+    printf("pico-usbnet boot timings:\n");
+
+    for (uint8_t i = 0; i < (uint8_t)NetworkEvent::Count; i++) {
+        if (reached((NetworkEvent)i)) {
+            printf("  %-32s %8lu us\n", names[i], (unsigned long)event_us[i]);
+        } else {
+            printf("  %-32s %11s\n", names[i], "-");
+        }
+    }
+}
+
+void USBNetwork::emit(NetworkEvent event, uint32_t timeUs) {
+    event_mask |= 1u << (uint8_t)event;
+    event_us[(uint8_t)event] = timeUs;
+
+    if (event_callback) {
+        event_callback(event, timeUs);
+    }
+}
+
+// One step of bring-up per call; nothing here waits on the host
+void USBNetwork::advanceInit() {
+    const uint8_t all = (1u << (uint8_t)NetworkEvent::Count) - 1;
+
+    if (!started || event_mask == all) {
+        return;
+    }
+
+    uint32_t now = time_us_32();
+
+    if (!reached(NetworkEvent::InterfaceUp) && netif_is_up(&interfaces[0].netif)) {
+        emit(NetworkEvent::InterfaceUp, now);
+    }
+
+    // A failed start (e.g. out of pcbs) is retried on the next call
+    if (reached(NetworkEvent::InterfaceUp) && !reached(NetworkEvent::DhcpReady) &&
+        startDhcpServer() == ERR_OK) {
+        emit(NetworkEvent::DhcpReady, now);
+    }
+
+    if (!reached(NetworkEvent::UsbMounted) && usb && tud_mounted()) {
+        emit(NetworkEvent::UsbMounted, now);
+    }
+
+    if (!reached(NetworkEvent::LinkUp) && link_up_us) {
+        emit(NetworkEvent::LinkUp, link_up_us);
+    }
+
+    // Offers and ACKs go out from serviceTraffic(), just before this runs
+    if (!reached(NetworkEvent::FirstOffer) && dhcp_server.getStats().offers) {
+        emit(NetworkEvent::FirstOffer, now);
+    }
+
+    if (!reached(NetworkEvent::FirstLease) && dhcp_server.getStats().acks) {
+        emit(NetworkEvent::FirstLease, now);
+    }
+
+    if (!reached(NetworkEvent::FirstByte) && first_byte_us) {
+        emit(NetworkEvent::FirstByte, link_up_us + first_byte_us);
+    }
 }
 
 void USBNetwork::initNetworkInterface() {
     // Initialize and add network interface
-    struct netif *netif = &netif_data;
+    Interface &link = interfaces[0];
+    struct netif *netif = &link.netif;
     netif->hwaddr_len = sizeof(tud_network_mac_address);
     memcpy(netif->hwaddr, tud_network_mac_address, sizeof(tud_network_mac_address));
     netif->hwaddr[5] ^= 0x01; // Toggle LSbit to ensure different MAC address from the host
 
-    netif_add(netif, &ipaddr, &netmask, &gateway, NULL, netifInitCallback, ip_input);
+    netif_add(netif, &link.ipaddr, &link.netmask, &link.gateway, &link, netifInitCallback, ip_input);
+    // Broadcasts, DHCP replies among them, leave through the USB interface
     netif_set_default(netif);
     netif_set_up(netif);
+
+    for (size_t i = 1; i < interface_count; i++) {
+        Interface &local = interfaces[i];
+
+        netif_add(&local.netif, &local.ipaddr, &local.netmask, &local.gateway, &local, localInitCallback, ip_input);
+        netif_set_up(&local.netif);
+    }
+
+    usb_interface = this;
+    usb_stats = &link.stats;
+}
+
+void USBNetwork::setMTU(uint16_t mtu) {
+    interfaces[0].netif.mtu = LWIP_MIN(LWIP_MAX(mtu, 576), PICONET_MTU);
+}
+
+void USBNetwork::setTrustLinkChecksums(bool trust) {
+    trust_link_checksums = trust;
 }
 
 void USBNetwork::serviceTraffic() {
     // handle any packet received by tud_network_recv_cb()
     if (received_frame) {
-        ethernet_input(received_frame, &netif_data);
+        // An offloaded copy has to land before lwIP reads the frame
+        if (received_copying) {
+            CopyEngine::finish();
+            received_copying = false;
+        }
+
+        // Frames verified during the copy (or a trusted link) skip lwIP's second pass
+        u16_t checks = NETIF_CHECKSUM_CHECK_IP | NETIF_CHECKSUM_CHECK_UDP | NETIF_CHECKSUM_CHECK_TCP;
+
+        if (trust_link_checksums) {
+            checks |= NETIF_CHECKSUM_CHECK_ICMP;
+        }
+
+        if (trust_link_checksums || received_verified) {
+            NETIF_SET_CHECKSUM_CTRL(&interfaces[0].netif, NETIF_CHECKSUM_ENABLE_ALL & ~checks);
+        } else {
+            NETIF_SET_CHECKSUM_CTRL(&interfaces[0].netif, NETIF_CHECKSUM_ENABLE_ALL);
+        }
+
+        ethernet_input(received_frame, &interfaces[0].netif);
         pbuf_free(received_frame);
         received_frame = NULL;
         tud_network_recv_renew();
     }
 
+#if PICONET_LOOPBACK
+    // Deliver what the device sent to itself, each interface from its own queue
+    if (interfaces[0].netif.loop_first) {
+        // No driver to time looped packets; leaving the queue is the nearest thing
+        received_us = time_us_64();
+    }
+
+    netif_poll(&interfaces[0].netif);
+
+    for (size_t i = 1; i < interface_count; i++) {
+        pollLocal(interfaces[i]);
+    }
+#endif
+
     // Process lwIP timeouts
     sys_check_timeouts();
 }
 
+#if PICONET_NETIFS > 1
+void USBNetwork::pollLocal(Interface &interface) {
+    if (interface.netif.loop_first) {
+        received_us = time_us_64();
+    }
+
+    netif_poll(&interface.netif);
+
+    // netif_loop_output() counts what it queues and refuses, netif_poll() what it delivers
+    const struct stats_mib2_netif_ctrs &counters = interface.netif.mib2_counters;
+
+    interface.stats.rxFrames = counters.ifinucastpkts;
+    interface.stats.rxBytes = counters.ifinoctets;
+    interface.stats.txFrames = counters.ifoutucastpkts;
+    interface.stats.txBytes = counters.ifoutoctets;
+    interface.stats.txDropped = counters.ifoutdiscards;
+}
+#else
+void USBNetwork::pollLocal(Interface &interface) {
+    (void)interface;
+}
+#endif
+
 void USBNetwork::work() {
-    // Handle USB tasks
-    tud_task();
+    if (usb) {
+        // Handle USB tasks
+        tud_task();
+
+        // Send what queued up while the link was busy
+        drainTx();
+    }
 
     // Process network traffic and handle timeouts
     serviceTraffic();
+
+    // Report bring-up milestones reached by the traffic above
+    advanceInit();
+
+#if PICONET_COROUTINES
+    // Resume coroutines woken by the callbacks above
+    Executor::poll();
+#endif
+}
+
+// Anything work() could make progress on right now
+bool USBNetwork::hasPendingWork() const {
+    if (received_frame) {
+        return true;
+    }
+
+    if (usb && (tud_task_event_ready() || (tud_ready() && !tx_scheduler.empty()))) {
+        return true;
+    }
+
+#if PICONET_LOOPBACK
+    for (size_t i = 0; i < interface_count; i++) {
+        if (interfaces[i].netif.loop_first) {
+            return true;
+        }
+    }
+#endif
+
+    return false;
+}
+
+void USBNetwork::service() {
+    scheduler.runDue(time_us_64());
+
+    uint64_t end = LWIP_MIN(time_us_64() + PICONET_SCHED_SLICE_US, scheduler.nextDeadlineUs());
+
+    do {
+        work();
+    } while (hasPendingWork() && time_us_64() < end);
+
+#if PICONET_SCHED_IDLE_WFE
+    if (hasPendingWork()) {
+        return;
+    }
+
+    // lwIP's timers and the tasks are one queue as far as waking up goes
+    uint32_t lwipMs = sys_timeouts_sleeptime();
+    uint64_t now = time_us_64();
+
+    if (lwipMs != SYS_TIMEOUTS_SLEEPTIME_INFINITE) {
+        end = LWIP_MIN(end, now + (uint64_t)lwipMs * 1000);
+    }
+
+    // USB interrupts end the wait early; one taken since the check above leaves the event flag set
+    if (end > now) {
+        best_effort_wfe_or_timeout(from_us_since_boot(end));
+    }
+#endif
+}
+
+PacketFilter &USBNetwork::getPacketFilter() {
+    return packet_filter;
+}
+
+TxScheduler &USBNetwork::getTxScheduler() {
+    return tx_scheduler;
+}
+
+DNSServer &USBNetwork::getDNSServer() {
+    return dns_server;
+}
+
+DHCPServer &USBNetwork::getDHCPServer() {
+    return dhcp_server;
+}
+
+uint32_t USBNetwork::getTimeToFirstByteUs() {
+    return first_byte_us;
+}
+
+uint64_t USBNetwork::getReceiveTimeUs() {
+    return received_us;
+}
+
+void USBNetwork::stampTransmit(struct pbuf *p) {
+    dropStamp(stamp_pbuf);
+
+    // Held until sent or dropped, so no later frame can be allocated at its address and take the stamp
+    if (p) {
+        pbuf_ref(p);
+    }
+
+    stamp_pbuf = p;
+    stamped_us = 0;
+}
+
+void USBNetwork::dropStamp(struct pbuf *p) {
+    if (p && p == stamp_pbuf) {
+        stamp_pbuf = nullptr;
+        pbuf_free(p);
+    }
+}
+
+uint64_t USBNetwork::getTransmitTimeUs() {
+    return stamped_us;
 }
 
 void USBNetwork::networkInitHandler() {
     // Initialization logic that was previously in tud_network_init_cb
     if (received_frame) {
+        // The engine may still be writing into it
+        CopyEngine::finish();
         pbuf_free(received_frame);
         received_frame = nullptr;
+        received_copying = false;
+    }
+
+    // Frames queued for the previous session are stale
+    tx_scheduler.clear();
+
+    link_up_us = time_us_32();
+    first_byte_us = 0;
+}
+
+enum class FrameCopy { Copied, Verified, Corrupt };
+
+static inline uint16_t readBE16(const uint8_t *p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+// True for an IPv4 TCP segment that carries payload
+static bool carriesTcpPayload(struct pbuf *p) {
+    uint8_t headers[SIZEOF_ETH_HDR + 20 + 20];
+
+    if (pbuf_copy_partial(p, headers, sizeof(headers), 0) != sizeof(headers)) {
+        return false;
+    }
+
+    const uint8_t *ip = headers + SIZEOF_ETH_HDR;
+    uint16_t headerLen = (ip[0] & 0x0f) * 4;
+
+    if (readBE16(headers + 12) != ETHTYPE_IP || ip[9] != IP_PROTO_TCP || headerLen != 20) {
+        return false;
+    }
+
+    uint16_t tcpHeaderLen = (ip[headerLen + 12] >> 4) * 4;
+
+    return readBE16(ip + 2) > headerLen + tcpHeaderLen;
+}
+
+// Copy src into the chain at byte offset 'offset', returning the sum of the copied bytes
+static uint32_t copyAndSum(struct pbuf *p, uint16_t offset, const uint8_t *src, uint16_t len) {
+    uint32_t acc = 0;
+    uint16_t done = 0;
+
+    for (struct pbuf *q = p; q != NULL && done < len; q = q->next) {
+        if (offset >= q->len) {
+            offset -= q->len;
+            continue;
+        }
+
+        uint16_t chunk = LWIP_MIN((uint16_t)(q->len - offset), (uint16_t)(len - done));
+        uint16_t sum = usbnet_chksum_copy((uint8_t *)q->payload + offset, src + done, chunk);
+
+        // A chunk starting at an odd position contributes byte-swapped words
+        if (done & 1) {
+            sum = (uint16_t)((sum << 8) | (sum >> 8));
+        }
+
+        acc += sum;
+        done += chunk;
+        offset = 0;
     }
+
+    return acc;
+}
+
+// Copy an inbound frame into its pbuf, verifying IPv4 TCP/UDP checksums in the same pass
+static FrameCopy copyFrame(struct pbuf *p, const uint8_t *src, uint16_t size) {
+    const uint8_t *ip = src + SIZEOF_ETH_HDR;
+    uint16_t ipLen = size > SIZEOF_ETH_HDR ? size - SIZEOF_ETH_HDR : 0;
+
+    if (ipLen < 20 || readBE16(src + 12) != ETHTYPE_IP || (ip[0] >> 4) != 4 ||
+        ((ip[6] & 0x3f) | ip[7]) != 0 || (ip[9] != IP_PROTO_TCP && ip[9] != IP_PROTO_UDP)) {
+        pbuf_take(p, src, size);
+        return FrameCopy::Copied;
+    }
+
+    uint16_t headerLen = (ip[0] & 0x0f) * 4;
+    uint16_t totalLen = readBE16(ip + 2);
+
+    if (headerLen < 20 || totalLen < headerLen + 8 || totalLen > ipLen) {
+        pbuf_take(p, src, size);
+        return FrameCopy::Copied;
+    }
+
+    if (usbnet_chksum(ip, headerLen) != 0xffff) {
+        return FrameCopy::Corrupt;
+    }
+
+    uint16_t l4Offset = SIZEOF_ETH_HDR + headerLen;
+    uint16_t l4Len = totalLen - headerLen;
+    const uint8_t *l4 = src + l4Offset;
+
+    pbuf_take(p, src, l4Offset);
+
+    uint32_t acc = copyAndSum(p, l4Offset, l4, l4Len);
+
+    if (size > l4Offset + l4Len) {
+        pbuf_take_at(p, l4 + l4Len, size - l4Offset - l4Len, l4Offset + l4Len);
+    }
+
+    // UDP datagrams without a checksum are accepted as-is
+    if (ip[9] == IP_PROTO_UDP && l4[6] == 0 && l4[7] == 0) {
+        return FrameCopy::Verified;
+    }
+
+    // Pseudo header: source and destination address, protocol and transport length
+    acc += usbnet_chksum(ip + 12, 8);
+    acc += lwip_htons(ip[9]);
+    acc += lwip_htons(l4Len);
+    acc = (acc >> 16) + (acc & 0xffff);
+    acc = (acc >> 16) + (acc & 0xffff);
+
+    return acc == 0xffff ? FrameCopy::Verified : FrameCopy::Corrupt;
+}
+
+// Copy a frame into a pbuf chain through the copy engine; true if part of it is still in flight
+static bool startCopy(struct pbuf *p, const uint8_t *src, uint16_t size) {
+    bool offloaded = false;
+
+    for (struct pbuf *q = p; q != NULL && size; q = q->next) {
+        uint16_t chunk = LWIP_MIN(q->len, size);
+
+        offloaded |= CopyEngine::copyAsync(q->payload, src, chunk);
+        src += chunk;
+        size -= chunk;
+    }
+
+    return offloaded;
 }
 
 bool USBNetwork::networkReceiveHandler(const uint8_t *src, uint16_t size) {
     // Handle received network packet
     /* this shouldn't happen, but if we get another packet before 
     parsing the previous, we must signal our inability to accept it */
-    if (received_frame) return false;
-    
-    if (size)
-    {
-        struct pbuf *p = pbuf_alloc(PBUF_RAW, size, PBUF_POOL);
-
-        if (p)
-        {
-            /* pbuf_alloc() has already initialized struct; all we need to do is copy the data */
-            memcpy(p->payload, src, size);
-        
-            /* store away the pointer for service_traffic() to later handle */
-            received_frame = p;
-        }
+    if (received_frame) {
+        usb_stats->rxDropped++;
+        return false;
+    }
+
+    /* as early as the frame can be timed; the copy and filtering come after */
+    received_us = time_us_64();
+
+    /* returning false hands the buffer straight back to TinyUSB, which renews reception */
+    if (!size) return false;
+
+#if PICONET_FILTER_ENABLED
+    /* unwanted and fast-path frames never reach the pbuf pool */
+    if (packet_filter.process(src, size) != FilterAction::Pass) return false;
+#endif
+
+    struct pbuf *p = pbuf_alloc(PBUF_RAW, size, PBUF_POOL);
+
+    if (!p) {
+        usb_stats->rxDropped++;
+        return false;
+    }
+
+    /* pbuf_alloc() has already initialized struct; all we need to do is copy the data */
+    FrameCopy copy = FrameCopy::Copied;
+
+    if (usb_interface && usb_interface->trust_link_checksums) {
+        /* nothing to verify, so the copy can run in the background until serviceTraffic() */
+        received_copying = startCopy(p, src, size);
+    } else {
+        copy = copyFrame(p, src, size);
     }
 
+    if (copy == FrameCopy::Corrupt) {
+        usb_stats->rxDropped++;
+        pbuf_free(p);
+        return false;
+    }
+
+    usb_stats->rxFrames++;
+    usb_stats->rxBytes += size;
+
+    received_verified = copy == FrameCopy::Verified;
+
+    /* store away the pointer for service_traffic() to later handle */
+    received_frame = p;
+
     return true;
 }
 
@@ -135,23 +633,30 @@ uint16_t USBNetwork::networkTransmitHandler(uint8_t *dst, void *ref, uint16_t ar
 
     (void)arg; /* unused for this example */
 
+    /* linkoutput_fn() already refused anything larger than the driver's buffer */
+    if (p->tot_len > CFG_TUD_NET_MTU) return 0;
+
+    bool offloaded = false;
+
     /* traverse the "pbuf chain"; see ./lwip/src/core/pbuf.c for more info */
     for(q = p; q != NULL; q = q->next)
     {
-        memcpy(dst, (char *)q->payload, q->len);
+        offloaded |= CopyEngine::copyAsync(dst, (char *)q->payload, q->len);
         dst += q->len;
         len += q->len;
         if (q->len == q->tot_len) break;
     }
 
+    /* TinyUSB starts the transfer as soon as this returns, so every segment has to be in place */
+    if (offloaded) CopyEngine::finish();
+
     return len;
 }
 
 err_t USBNetwork::netifInitCallback(struct netif *netif) {
     LWIP_ASSERT("netif != NULL", (netif != NULL));
-    netif->mtu = CFG_TUD_NET_MTU;
+    netif->mtu = PICONET_MTU;
     netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_LINK_UP | NETIF_FLAG_UP;
-    netif->state = NULL;
     netif->name[0] = 'E';
     netif->name[1] = 'X';
     netif->linkoutput = linkoutput_fn;
@@ -159,10 +664,105 @@ err_t USBNetwork::netifInitCallback(struct netif *netif) {
     return ERR_OK;
 }
 
+err_t USBNetwork::localInitCallback(struct netif *netif) {
+    netif->mtu = PICONET_MTU;
+    netif->flags = NETIF_FLAG_LINK_UP | NETIF_FLAG_UP;
+    netif->name[0] = 'L';
+    netif->name[1] = 'O';
+    netif->output = localOutput;
+    return ERR_OK;
+}
+
+err_t USBNetwork::localOutput(struct netif *netif, struct pbuf *p, const ip_addr_t *addr) {
+    (void)p;
+    (void)addr;
+
+    /* the interface's own address is looped back before output is called; nothing else lives here */
+    MIB2_STATS_NETIF_INC(netif, ifoutdiscards);
+    return ERR_RTE;
+}
+
 // Implement linkoutput_fn and output_fn as in your original code
+void USBNetwork::transmit(struct pbuf *p) {
+    if (!first_byte_us && link_up_us && carriesTcpPayload(p)) {
+        first_byte_us = LWIP_MAX(time_us_32() - link_up_us, 1u);
+    }
+
+    /* lwIP adds its headers in place, so the stamped pbuf is the frame itself */
+    if (p == stamp_pbuf) {
+        stamped_us = time_us_64();
+        dropStamp(p);
+    }
+
+    usb_stats->txFrames++;
+    usb_stats->txBytes += p->tot_len;
+
+    tud_network_xmit(p, 0 /* unused for this example */);
+}
+
+void USBNetwork::drainTx() {
+    TxClass txClass;
+    struct pbuf *p;
+
+    /* highest class first; each frame leaves the queue once the driver has copied it */
+    while (tud_ready() && (p = tx_scheduler.peek(txClass)) != NULL && tud_network_can_xmit(p->tot_len)) {
+        transmit(p);
+        tx_scheduler.pop(txClass, time_us_32());
+    }
+}
+
 err_t USBNetwork::linkoutput_fn(struct netif *netif, struct pbuf *p) {
     (void)netif;
-    
+
+    err_t result = sendFrame(p);
+
+    /* a frame that never reaches the driver is never stamped */
+    if (result != ERR_OK) {
+        usb_stats->txDropped++;
+        dropStamp(p);
+    }
+
+    return result;
+}
+
+err_t USBNetwork::sendFrame(struct pbuf *p) {
+    /* a frame that does not fit the driver's transmit buffer can never be sent */
+    if (p->tot_len > CFG_TUD_NET_MTU)
+      return ERR_BUF;
+
+#if PICONET_TX_SCHEDULER
+    /* if TinyUSB isn't ready, we must signal back to lwip that there is nothing we can do */
+    if (!tud_ready())
+      return ERR_USE;
+
+    TxClass txClass = tx_scheduler.classify(p);
+
+    /* nothing waiting ahead of it and the driver is free: no need to queue */
+    if (tx_scheduler.empty() && tud_network_can_xmit(p->tot_len))
+    {
+      transmit(p);
+      tx_scheduler.countDirect(txClass);
+      return ERR_OK;
+    }
+
+    for (;;)
+    {
+      err_t result = tx_scheduler.enqueue(p, txClass, time_us_32());
+
+      if (result != ERR_WOULDBLOCK)
+      {
+        drainTx();
+        return result;
+      }
+
+      /* the class queue is full: wait for the link as the unscheduled path does */
+      if (!tud_ready())
+        return ERR_USE;
+
+      tud_task();
+      drainTx();
+    }
+#else
     for (;;)
     {
       /* if TinyUSB isn't ready, we must signal back to lwip that there is nothing we can do */
@@ -174,23 +774,20 @@ err_t USBNetwork::linkoutput_fn(struct netif *netif, struct pbuf *p) {
       // Provided a size
       if (tud_network_can_xmit(p->tot_len))
       {
-        tud_network_xmit(p, 0 /* unused for this example */);
+        transmit(p);
         return ERR_OK;
       }
     
       /* transfer execution to TinyUSB in the hopes that it will finish transmitting the prior packet */
       tud_task();
     }
+#endif
 }
 
 err_t USBNetwork::output_fn(struct netif *netif, struct pbuf *p, const ip_addr_t *addr) {
     return etharp_output(netif, p, addr);
 }
 
-/* lwip platform specific routines for Pico */
-static mutex_t lwip_mutex;
-static int lwip_mutex_count = 0;
-
 extern "C" {
 
 void tud_network_init_cb(void) {
@@ -208,35 +805,15 @@ uint16_t tud_network_xmit_cb(uint8_t *dst, void *ref, uint16_t arg) {
     return USBNetwork::networkTransmitHandler(dst, ref, arg);
 }
 
+/* lwip platform specific routines for Pico */
 sys_prot_t sys_arch_protect(void)
 {
-    uint32_t owner;
-    if (!mutex_try_enter(&lwip_mutex, &owner))
-    {
-        if (owner != get_core_num())
-        {
-            // Wait until other core releases mutex
-            mutex_enter_blocking(&lwip_mutex);
-        }
-    }
-
-    lwip_mutex_count++;
-    
-    return 0;
+    return LwipLock::protect();
 }
 
 void sys_arch_unprotect(sys_prot_t pval)
 {
-    (void)pval;
-    
-    if (lwip_mutex_count)
-    {
-        lwip_mutex_count--;
-        if (!lwip_mutex_count)
-        {
-            mutex_exit(&lwip_mutex);
-        }
-    }
+    LwipLock::unprotect(pval);
 }
 
 uint32_t sys_now(void)
@@ -0,0 +1,75 @@
+#include "pico-usbnet/VendorStream.h"
+
+#if PICONET_VENDOR_BULK
+extern "C" {
+    #include "tusb.h"
+}
+
+VendorStream::VendorStream() : ring(nullptr), consumer(-1), stats() {}
+
+void VendorStream::start(BlockRing &blocks) {
+    stop();
+
+    ring = &blocks;
+}
+
+void VendorStream::stop() {
+    if (ring && consumer >= 0) {
+        ring->detach(consumer);
+    }
+
+    ring = nullptr;
+    consumer = -1;
+}
+
+void VendorStream::poll() {
+    if (!ring) {
+        return;
+    }
+
+    if (!tud_vendor_mounted()) {
+        if (consumer >= 0) {
+            ring->detach(consumer);
+            consumer = -1;
+        }
+
+        return;
+    }
+
+    if (consumer < 0) {
+        consumer = ring->attach();
+
+        if (consumer < 0) {
+            return;
+        }
+
+        stats.attaches++;
+    }
+
+    const uint8_t *data;
+    size_t length;
+    bool wrote = false;
+
+    while ((data = ring->peek(consumer, length)) != nullptr) {
+        uint32_t room = tud_vendor_write_available();
+
+        if (room == 0) {
+            break;
+        }
+
+        uint32_t written = tud_vendor_write(data, length < room ? (uint32_t)length : room);
+
+        ring->consume(consumer, written);
+        stats.bytes += written;
+        wrote = true;
+
+        if (written == 0) {
+            break;
+        }
+    }
+
+    if (wrote) {
+        tud_vendor_write_flush();
+    }
+}
+#endif
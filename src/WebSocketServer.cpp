@@ -0,0 +1,888 @@
+#include <cstring>
+
+#include "pico-usbnet/WebSocketServer.h"
+#include "pico-usbnet/StaticContainers.h"
+
+// tcp_poll() runs every 2 coarse ticks, i.e. once a second
+#define WS_POLL_INTERVAL    2
+
+#define WS_FIN              0x80
+#define WS_MASK             0x80
+#define WS_OPCODE_CONTINUE  0x0
+#define WS_OPCODE_TEXT      0x1
+#define WS_OPCODE_BINARY    0x2
+#define WS_OPCODE_CLOSE     0x8
+#define WS_OPCODE_PING      0x9
+#define WS_OPCODE_PONG      0xA
+
+#define WS_CLOSE_NORMAL     1000
+#define WS_CLOSE_PROTOCOL   1002
+#define WS_CLOSE_TOO_BIG    1009
+
+static_assert(PICONET_WS_BLOCKS >= 3, "PICONET_WS_BLOCKS must be at least 3");
+static_assert(PICONET_WS_BLOCK_SIZE >= 126 && PICONET_WS_BLOCK_SIZE <= 0xffff,
+              "PICONET_WS_BLOCK_SIZE must fit a 16-bit frame length");
+static_assert(PICONET_WS_CLIENTS < 256, "block reference counts are 8 bit");
+// writeFrame() needs room for a whole block even at the smallest MSS (MTU 576)
+static_assert(1 + 2 * ((PICONET_WS_BLOCK_SIZE + 535) / 536) <= TCP_SND_QUEUELEN,
+              "a block needs more pbufs than TCP_SND_QUEUELEN allows");
+
+// A slow client can hold this many blocks, which leaves two for everybody else
+static constexpr size_t max_in_flight = PICONET_WS_BLOCKS - 2;
+
+struct WebSocketServer::Client {
+    enum State : uint8_t { Handshake, Open, Closing, Failed };
+
+    struct InFlight {
+        Block *block;
+        uint32_t end;           // 'written' once the frame was queued
+    };
+
+    Client(WebSocketServer *server, struct tcp_pcb *pcb)
+        : server(server), pcb(pcb), next(nullptr), received(nullptr), state(Handshake), textMessage(false),
+          remoteClosed(false), idleSeconds(0), written(0), acked(0) {}
+
+    WebSocketServer *server;
+    struct tcp_pcb *pcb;
+    Client *next;
+
+    // Bytes not parsed yet; acknowledged to lwIP only once consumed
+    struct pbuf *received;
+
+    State state;
+    bool textMessage;           // type of the message continuation frames belong to
+    bool remoteClosed;
+    uint8_t idleSeconds;
+
+    // Blocks queued by reference, in the order they were written
+    RingQueue<InFlight, PICONET_WS_BLOCKS> inFlight;
+    uint32_t written;
+    uint32_t acked;
+};
+
+static ObjectPool<WebSocketServer::Client, PICONET_WS_CLIENTS> client_pool;
+
+// Handshakes and client frames are handled one at a time, so all clients
+// share the buffers
+static char request_buffer[PICONET_WS_REQUEST_SIZE];
+static uint8_t message_buffer[PICONET_WS_MESSAGE_SIZE];
+
+size_t WebSocketServer::getSharedSize() {
+    return sizeof(client_pool) + sizeof(request_buffer) + sizeof(message_buffer);
+}
+
+static const char websocket_guid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+static const char switching_protocols[] =
+    "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: ";
+static const char bad_request[] =
+    "HTTP/1.1 400 Bad Request\r\nSec-WebSocket-Version: 13\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+static const char too_large[] =
+    "HTTP/1.1 431 Request Header Fields Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+static inline uint32_t rotateLeft(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+static void sha1Block(uint32_t state[5], const uint8_t *block) {
+    uint32_t w[80];
+
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) |
+               ((uint32_t)block[i * 4 + 2] << 8) | block[i * 4 + 3];
+    }
+
+    for (int i = 16; i < 80; i++) {
+        w[i] = rotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5a827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ed9eba1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8f1bbcdc;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xca62c1d6;
+        }
+
+        uint32_t temp = rotateLeft(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rotateLeft(b, 30);
+        b = a;
+        a = temp;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+static void sha1(const uint8_t *data, size_t length, uint8_t digest[20]) {
+    uint32_t state[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+    uint8_t block[64];
+    size_t offset = 0;
+    bool padded = false;
+
+    for (;;) {
+        size_t chunk = length - offset < 64 ? length - offset : 64;
+
+        memcpy(block, data + offset, chunk);
+        offset += chunk;
+
+        if (chunk == 64) {
+            sha1Block(state, block);
+            continue;
+        }
+
+        memset(block + chunk, 0, 64 - chunk);
+
+        if (!padded) {
+            block[chunk++] = 0x80;
+            padded = true;
+        }
+
+        // The bit length goes into the last 8 bytes, or into one more block
+        if (chunk <= 56) {
+            uint64_t bits = (uint64_t)length * 8;
+
+            for (int i = 0; i < 8; i++) {
+                block[63 - i] = (uint8_t)(bits >> (i * 8));
+            }
+
+            sha1Block(state, block);
+            break;
+        }
+
+        sha1Block(state, block);
+    }
+
+    for (int i = 0; i < 20; i++) {
+        digest[i] = (uint8_t)(state[i / 4] >> (24 - (i % 4) * 8));
+    }
+}
+
+static size_t base64Encode(const uint8_t *data, size_t length, char *out) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t used = 0;
+
+    for (size_t i = 0; i < length; i += 3) {
+        uint32_t group = (uint32_t)data[i] << 16;
+
+        if (i + 1 < length) {
+            group |= (uint32_t)data[i + 1] << 8;
+        }
+
+        if (i + 2 < length) {
+            group |= data[i + 2];
+        }
+
+        out[used++] = alphabet[(group >> 18) & 0x3f];
+        out[used++] = alphabet[(group >> 12) & 0x3f];
+        out[used++] = i + 1 < length ? alphabet[(group >> 6) & 0x3f] : '=';
+        out[used++] = i + 2 < length ? alphabet[group & 0x3f] : '=';
+    }
+
+    return used;
+}
+
+static char toLower(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c + ('a' - 'A')) : c;
+}
+
+// 'lower' must be lowercase
+static bool equalsIgnoreCase(const char *text, size_t length, const char *lower) {
+    size_t i = 0;
+
+    for (; i < length && lower[i]; i++) {
+        if (toLower(text[i]) != lower[i]) {
+            return false;
+        }
+    }
+
+    return i == length && !lower[i];
+}
+
+static bool containsIgnoreCase(const char *text, size_t length, const char *lower) {
+    size_t needle = strlen(lower);
+
+    for (size_t i = 0; i + needle <= length; i++) {
+        if (equalsIgnoreCase(text + i, needle, lower)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void trim(const char *&text, size_t &length) {
+    while (length && (*text == ' ' || *text == '\t')) {
+        text++;
+        length--;
+    }
+
+    while (length && (text[length - 1] == ' ' || text[length - 1] == '\t')) {
+        length--;
+    }
+}
+
+WebSocketServer::WebSocketServer()
+    : pcb(nullptr), clients(nullptr), blocks(), open(nullptr), text(false), messageCallback(nullptr), stats() {}
+
+WebSocketServer::~WebSocketServer() {
+    stop();
+}
+
+err_t WebSocketServer::start(uint16_t port) {
+    if (pcb) {
+        return ERR_ISCONN;
+    }
+
+    struct tcp_pcb *newpcb = tcp_new();
+
+    if (!newpcb) {
+        return ERR_MEM;
+    }
+
+    err_t result = tcp_bind(newpcb, IP_ADDR_ANY, port);
+
+    if (result != ERR_OK) {
+        tcp_close(newpcb);
+
+        return result;
+    }
+
+    pcb = tcp_listen(newpcb);
+
+    if (!pcb) {
+        tcp_close(newpcb);
+
+        return ERR_MEM;
+    }
+
+    tcp_arg(pcb, this);
+    tcp_accept(pcb, acceptWrapper);
+
+    return ERR_OK;
+}
+
+void WebSocketServer::stop() {
+    if (pcb) {
+        tcp_arg(pcb, NULL);
+        tcp_accept(pcb, NULL);
+        tcp_close(pcb);
+        pcb = nullptr;
+    }
+
+    // Queued frames reference the blocks in this object, so they cannot be left to drain
+    while (clients) {
+        Client *client = clients;
+
+        tcp_arg(client->pcb, NULL);
+        tcp_err(client->pcb, NULL);
+        tcp_abort(client->pcb);
+        release(client);
+    }
+
+    open = nullptr;
+}
+
+void WebSocketServer::setTextFrames(bool text) {
+    this->text = text;
+}
+
+void WebSocketServer::onMessage(MessageCallback callback) {
+    messageCallback = callback;
+}
+
+bool WebSocketServer::send(const void *data, size_t length) {
+    if (!getClientCount() || length > PICONET_WS_BLOCK_SIZE) {
+        stats.dropped++;
+
+        return false;
+    }
+
+    if (open && open->length + length > PICONET_WS_BLOCK_SIZE) {
+        seal();
+    }
+
+    if (!open && !(open = allocate())) {
+        stats.dropped++;
+
+        return false;
+    }
+
+    memcpy(open->data + open->length, data, length);
+    open->length += (uint16_t)length;
+    stats.messages++;
+
+    // Coalesce only while every client is busy; an idle client gets the data now
+    if (open->length == PICONET_WS_BLOCK_SIZE || hasIdleClient()) {
+        seal();
+    }
+
+    return true;
+}
+
+void WebSocketServer::flush() {
+    seal();
+}
+
+size_t WebSocketServer::getClientCount() const {
+    size_t count = 0;
+
+    for (const Client *client = clients; client; client = client->next) {
+        if (client->state == Client::Open) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+void WebSocketServer::resetStats() {
+    stats = Stats();
+}
+
+WebSocketServer::Block *WebSocketServer::allocate() {
+    for (Block &block : blocks) {
+        if (&block != open && block.refs == 0) {
+            block.length = 0;
+
+            return &block;
+        }
+    }
+
+    return nullptr;
+}
+
+void WebSocketServer::unref(Block *block) {
+    if (block->refs) {
+        block->refs--;
+    }
+}
+
+bool WebSocketServer::hasIdleClient() const {
+    for (const Client *client = clients; client; client = client->next) {
+        if (client->state == Client::Open && client->inFlight.empty()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WebSocketServer::seal() {
+    Block *block = open;
+
+    if (!block || !block->length) {
+        return;
+    }
+
+    open = nullptr;
+    stats.frames++;
+
+    for (Client *client = clients; client; client = client->next) {
+        if (client->state != Client::Open) {
+            continue;
+        }
+
+        if (writeFrame(client, block)) {
+            stats.framesSent++;
+        } else {
+            stats.framesSkipped++;
+        }
+    }
+}
+
+bool WebSocketServer::writeFrame(Client *client, Block *block) {
+    struct tcp_pcb *tpcb = client->pcb;
+    uint8_t header[4];
+    size_t headerLength = 2;
+
+    if (client->inFlight.size() >= max_in_flight) {
+        return false;
+    }
+
+    header[0] = WS_FIN | (text ? WS_OPCODE_TEXT : WS_OPCODE_BINARY);
+
+    if (block->length < 126) {
+        header[1] = (uint8_t)block->length;
+    } else {
+        header[1] = 126;
+        header[2] = (uint8_t)(block->length >> 8);
+        header[3] = (uint8_t)block->length;
+        headerLength = 4;
+    }
+
+    // Header and payload go in together or not at all. The header takes one
+    // pbuf; each segment of the block takes a header pbuf and a reference.
+    u16_t mss = LWIP_MAX(tcp_mss(tpcb), (u16_t)1);
+    size_t queued = 1 + 2 * ((block->length + mss - 1) / mss);
+
+    if (tcp_sndbuf(tpcb) < headerLength + block->length || tcp_sndqueuelen(tpcb) + queued > TCP_SND_QUEUELEN) {
+        return false;
+    }
+
+    if (tcp_write(tpcb, header, (u16_t)headerLength, TCP_WRITE_FLAG_COPY | TCP_WRITE_FLAG_MORE) != ERR_OK) {
+        return false;
+    }
+
+    // No TCP_WRITE_FLAG_COPY: lwIP references the block until the client acknowledges it
+    if (tcp_write(tpcb, block->data, block->length, 0) != ERR_OK) {
+        // The header is already queued, so the stream cannot continue
+        client->state = Client::Failed;
+
+        return false;
+    }
+
+    client->written += headerLength + block->length;
+    client->inFlight.push({block, client->written});
+    block->refs++;
+
+    tcp_output(tpcb);
+
+    return true;
+}
+
+err_t WebSocketServer::service(Client *client) {
+    if (client->state == Client::Failed) {
+        tcp_arg(client->pcb, NULL);
+        tcp_err(client->pcb, NULL);
+        tcp_abort(client->pcb);
+        release(client);
+
+        return ERR_ABRT;
+    }
+
+    if (client->state == Client::Handshake) {
+        handshake(client);
+    }
+
+    while (client->state == Client::Open && nextFrame(client)) {
+    }
+
+    if (client->remoteClosed || client->state == Client::Closing) {
+        return finish(client);
+    }
+
+    return ERR_OK;
+}
+
+bool WebSocketServer::handshake(Client *client) {
+    struct pbuf *p = client->received;
+
+    if (!p) {
+        return false;
+    }
+
+    u16_t end = pbuf_memfind(p, "\r\n\r\n", 4, 0);
+
+    if (end == 0xFFFF && p->tot_len < sizeof(request_buffer)) {
+        return false;
+    }
+
+    if (end == 0xFFFF || end + 4u > sizeof(request_buffer)) {
+        stats.rejected++;
+        writeCopy(client, too_large, sizeof(too_large) - 1);
+        client->state = Client::Closing;
+        discardReceived(client);
+
+        return false;
+    }
+
+    u16_t length = end + 4;
+
+    pbuf_copy_partial(p, request_buffer, length, 0);
+    client->received = pbuf_free_header(p, length);
+    tcp_recved(client->pcb, length);
+
+    const char *request = request_buffer;
+    const char *lineEnd = static_cast<const char *>(memchr(request, '\r', length));
+    bool valid = (size_t)(lineEnd - request) > 13 && memcmp(request, "GET ", 4) == 0 &&
+                 memcmp(lineEnd - 9, " HTTP/1.1", 9) == 0;
+    bool upgrade = false;
+    bool version = false;
+    const char *key = nullptr;
+    size_t keyLength = 0;
+
+    // Header fields, one per line up to the blank line
+    const char *line = lineEnd + 2;
+    const char *headersEnd = request + length - 2;
+
+    while (valid && line < headersEnd) {
+        const char *fieldEnd = static_cast<const char *>(memchr(line, '\r', headersEnd - line + 1));
+        const char *colon = static_cast<const char *>(memchr(line, ':', fieldEnd - line));
+
+        if (colon) {
+            const char *name = line;
+            size_t nameLength = colon - line;
+            const char *value = colon + 1;
+            size_t valueLength = fieldEnd - value;
+
+            trim(name, nameLength);
+            trim(value, valueLength);
+
+            if (equalsIgnoreCase(name, nameLength, "upgrade")) {
+                upgrade = containsIgnoreCase(value, valueLength, "websocket");
+            } else if (equalsIgnoreCase(name, nameLength, "sec-websocket-version")) {
+                version = valueLength == 2 && memcmp(value, "13", 2) == 0;
+            } else if (equalsIgnoreCase(name, nameLength, "sec-websocket-key")) {
+                key = value;
+                keyLength = valueLength;
+            }
+        }
+
+        line = fieldEnd + 2;
+    }
+
+    // The key is 16 random bytes in base64
+    if (!valid || !upgrade || !version || keyLength != 24) {
+        stats.rejected++;
+        writeCopy(client, bad_request, sizeof(bad_request) - 1);
+        client->state = Client::Closing;
+        discardReceived(client);
+
+        return false;
+    }
+
+    uint8_t concatenated[24 + sizeof(websocket_guid) - 1];
+    uint8_t digest[20];
+    char response[sizeof(switching_protocols) - 1 + 28 + 4];
+    size_t used = sizeof(switching_protocols) - 1;
+
+    memcpy(concatenated, key, 24);
+    memcpy(concatenated + 24, websocket_guid, sizeof(websocket_guid) - 1);
+    sha1(concatenated, sizeof(concatenated), digest);
+
+    memcpy(response, switching_protocols, used);
+    used += base64Encode(digest, sizeof(digest), response + used);
+    memcpy(response + used, "\r\n\r\n", 4);
+    used += 4;
+
+    if (writeCopy(client, response, used) != ERR_OK) {
+        client->state = Client::Failed;
+
+        return false;
+    }
+
+    tcp_output(client->pcb);
+
+    stats.handshakes++;
+    client->state = Client::Open;
+    client->idleSeconds = 0;
+
+    return true;
+}
+
+bool WebSocketServer::nextFrame(Client *client) {
+    struct pbuf *p = client->received;
+
+    if (!p || p->tot_len < 2) {
+        return false;
+    }
+
+    uint8_t header[14];
+    u16_t available = pbuf_copy_partial(p, header, sizeof(header), 0);
+    bool fin = header[0] & WS_FIN;
+    uint8_t opcode = header[0] & 0x0f;
+    size_t headerLength = 2;
+    uint32_t length = header[1] & 0x7f;
+
+    // No extensions are negotiated, and clients must mask
+    if ((header[0] & 0x70) || !(header[1] & WS_MASK)) {
+        stats.rejected++;
+        sendClose(client, WS_CLOSE_PROTOCOL);
+
+        return false;
+    }
+
+    if (length == 126) {
+        if (available < 4) {
+            return false;
+        }
+
+        length = (header[2] << 8) | header[3];
+        headerLength = 4;
+    } else if (length == 127) {
+        if (available < 10) {
+            return false;
+        }
+
+        // Anything needing more than 16 bits is too big anyway
+        length = 0xffffffff;
+        headerLength = 10;
+    }
+
+    headerLength += 4;
+
+    if (length > sizeof(message_buffer)) {
+        stats.rejected++;
+        sendClose(client, WS_CLOSE_TOO_BIG);
+
+        return false;
+    }
+
+    // Control frames are short and never fragmented
+    if ((opcode & 0x8) && (!fin || length > 125)) {
+        stats.rejected++;
+        sendClose(client, WS_CLOSE_PROTOCOL);
+
+        return false;
+    }
+
+    if (available < headerLength || p->tot_len < headerLength + length) {
+        return false;
+    }
+
+    const uint8_t *mask = header + headerLength - 4;
+
+    pbuf_copy_partial(p, message_buffer, (u16_t)length, (u16_t)headerLength);
+
+    for (uint32_t i = 0; i < length; i++) {
+        message_buffer[i] ^= mask[i % 4];
+    }
+
+    client->received = pbuf_free_header(p, (u16_t)(headerLength + length));
+    tcp_recved(client->pcb, (u16_t)(headerLength + length));
+
+    switch (opcode) {
+    case WS_OPCODE_TEXT:
+    case WS_OPCODE_BINARY:
+        client->textMessage = opcode == WS_OPCODE_TEXT;
+        // fall through
+    case WS_OPCODE_CONTINUE:
+        if (messageCallback) {
+            messageCallback(message_buffer, length, client->textMessage);
+        }
+        break;
+    case WS_OPCODE_PING: {
+        uint8_t pong[2] = {WS_FIN | WS_OPCODE_PONG, (uint8_t)length};
+
+        writeCopy(client, pong, sizeof(pong));
+        writeCopy(client, message_buffer, length);
+        tcp_output(client->pcb);
+        break;
+    }
+    case WS_OPCODE_PONG:
+        break;
+    case WS_OPCODE_CLOSE:
+        // Echo the status code back, as the closing handshake asks
+        sendClose(client, length >= 2 ? (uint16_t)((message_buffer[0] << 8) | message_buffer[1]) : WS_CLOSE_NORMAL);
+
+        return false;
+    default:
+        stats.rejected++;
+        sendClose(client, WS_CLOSE_PROTOCOL);
+
+        return false;
+    }
+
+    return true;
+}
+
+err_t WebSocketServer::writeCopy(Client *client, const void *data, size_t length) {
+    if (!length) {
+        return ERR_OK;
+    }
+
+    err_t result = tcp_write(client->pcb, data, (u16_t)length, TCP_WRITE_FLAG_COPY);
+
+    if (result == ERR_OK) {
+        client->written += length;
+    }
+
+    return result;
+}
+
+void WebSocketServer::sendClose(Client *client, uint16_t status) {
+    uint8_t frame[4] = {WS_FIN | WS_OPCODE_CLOSE, 2, (uint8_t)(status >> 8), (uint8_t)status};
+
+    writeCopy(client, frame, sizeof(frame));
+    tcp_output(client->pcb);
+
+    client->state = Client::Closing;
+    client->idleSeconds = 0;
+
+    // Whatever else the client sent is ignored
+    discardReceived(client);
+}
+
+// Acknowledge and drop unparsed input; tcp_close() would answer it with a RST
+void WebSocketServer::discardReceived(Client *client) {
+    if (client->received) {
+        tcp_recved(client->pcb, client->received->tot_len);
+        pbuf_free(client->received);
+        client->received = nullptr;
+    }
+}
+
+err_t WebSocketServer::finish(Client *client) {
+    // lwIP still references blocks this client has not acknowledged
+    if (!client->inFlight.empty()) {
+        client->state = Client::Closing;
+
+        return ERR_OK;
+    }
+
+    struct tcp_pcb *tpcb = client->pcb;
+    err_t result = ERR_OK;
+
+    tcp_arg(tpcb, NULL);
+    tcp_recv(tpcb, NULL);
+    tcp_sent(tpcb, NULL);
+    tcp_poll(tpcb, NULL, 0);
+    tcp_err(tpcb, NULL);
+
+    discardReceived(client);
+
+    if (tcp_close(tpcb) != ERR_OK) {
+        tcp_abort(tpcb);
+        result = ERR_ABRT;
+    }
+
+    release(client);
+
+    return result;
+}
+
+void WebSocketServer::release(Client *client) {
+    if (client->received) {
+        pbuf_free(client->received);
+    }
+
+    Client::InFlight entry;
+
+    while (client->inFlight.pop(entry)) {
+        unref(entry.block);
+    }
+
+    Client **link = &clients;
+
+    while (*link && *link != client) {
+        link = &(*link)->next;
+    }
+
+    if (*link) {
+        *link = client->next;
+    }
+
+    client_pool.release(client);
+}
+
+void WebSocketServer::acknowledge(Client *client, uint16_t length) {
+    client->acked += length;
+
+    while (!client->inFlight.empty() && (int32_t)(client->inFlight.front().end - client->acked) <= 0) {
+        Client::InFlight entry;
+
+        client->inFlight.pop(entry);
+        unref(entry.block);
+    }
+}
+
+err_t WebSocketServer::acceptWrapper(void *arg, struct tcp_pcb *newpcb, err_t err) {
+    WebSocketServer *instance = static_cast<WebSocketServer*>(arg);
+
+    if (err != ERR_OK || !newpcb) {
+        return ERR_VAL;
+    }
+
+    Client *client = client_pool.acquire(instance, newpcb);
+
+    if (!client) {
+        instance->stats.refused++;
+        tcp_abort(newpcb);
+
+        return ERR_ABRT;
+    }
+
+    client->next = instance->clients;
+    instance->clients = client;
+
+    // Frames are coalesced here already; Nagle would only add delay
+    tcp_nagle_disable(newpcb);
+
+    tcp_arg(newpcb, client);
+    tcp_recv(newpcb, receiveWrapper);
+    tcp_sent(newpcb, sentWrapper);
+    tcp_err(newpcb, errorWrapper);
+    tcp_poll(newpcb, pollWrapper, WS_POLL_INTERVAL);
+
+    return ERR_OK;
+}
+
+err_t WebSocketServer::receiveWrapper(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err) {
+    Client *client = static_cast<Client*>(arg);
+
+    if (!p) {
+        client->remoteClosed = true;
+
+        return client->server->service(client);
+    }
+
+    if (err != ERR_OK) {
+        pbuf_free(p);
+
+        return err;
+    }
+
+    if (client->state == Client::Closing || client->state == Client::Failed) {
+        tcp_recved(tpcb, p->tot_len);
+        pbuf_free(p);
+
+        return client->server->service(client);
+    }
+
+    if (client->received) {
+        pbuf_cat(client->received, p);
+    } else {
+        client->received = p;
+    }
+
+    return client->server->service(client);
+}
+
+err_t WebSocketServer::sentWrapper(void *arg, struct tcp_pcb *tpcb, u16_t len) {
+    Client *client = static_cast<Client*>(arg);
+    WebSocketServer *server = client->server;
+
+    server->acknowledge(client, len);
+
+    // The pipe to this client just drained: send what accumulated meanwhile
+    if (client->state == Client::Open && client->inFlight.empty()) {
+        server->seal();
+    }
+
+    return server->service(client);
+}
+
+err_t WebSocketServer::pollWrapper(void *arg, struct tcp_pcb *tpcb) {
+    Client *client = static_cast<Client*>(arg);
+
+    // Handshakes and closes that stall are cut short
+    if ((client->state == Client::Handshake || client->state == Client::Closing) &&
+        ++client->idleSeconds >= PICONET_WS_TIMEOUT_S) {
+        client->state = Client::Failed;
+    }
+
+    return client->server->service(client);
+}
+
+void WebSocketServer::errorWrapper(void *arg, err_t err) {
+    Client *client = static_cast<Client*>(arg);
+
+    // lwIP has already freed the pcb and everything queued on it
+    client->server->release(client);
+}
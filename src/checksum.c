@@ -0,0 +1,160 @@
+#include <string.h>
+
+#include "pico-usbnet/checksum.h"
+
+/* Words are summed into a 64-bit accumulator so no carry handling is needed in
+ * the loop; on the M0+ that is one ADDS/ADCS pair per word. A leading odd byte is
+ * parked in the high half of 't' and the result byte swapped, as lwIP does. */
+
+static inline uint16_t fold(uint64_t acc, uint16_t t, int odd)
+{
+    uint32_t sum;
+
+    acc += t;
+    acc = (acc >> 32) + (acc & 0xffffffffu);
+    acc = (acc >> 32) + (acc & 0xffffffffu);
+    sum = (uint32_t)acc;
+    sum = (sum >> 16) + (sum & 0xffffu);
+    sum = (sum >> 16) + (sum & 0xffffu);
+
+    if (odd)
+    {
+        sum = ((sum & 0xffu) << 8) | ((sum >> 8) & 0xffu);
+    }
+
+    return (uint16_t)sum;
+}
+
+uint16_t usbnet_chksum(const void *dataptr, int len)
+{
+    const uint8_t *p = (const uint8_t *)dataptr;
+    const uint32_t *w;
+    uint64_t acc = 0;
+    uint16_t t = 0;
+    int odd = (int)((uintptr_t)p & 1);
+
+    if (odd && len > 0)
+    {
+        ((uint8_t *)&t)[1] = *p++;
+        len--;
+    }
+
+    if (((uintptr_t)p & 2) && len >= 2)
+    {
+        acc += *(const uint16_t *)p;
+        p += 2;
+        len -= 2;
+    }
+
+    w = (const uint32_t *)p;
+
+    while (len >= 32)
+    {
+        acc += (uint64_t)w[0] + w[1];
+        acc += (uint64_t)w[2] + w[3];
+        acc += (uint64_t)w[4] + w[5];
+        acc += (uint64_t)w[6] + w[7];
+        w += 8;
+        len -= 32;
+    }
+
+    while (len >= 4)
+    {
+        acc += *w++;
+        len -= 4;
+    }
+
+    p = (const uint8_t *)w;
+
+    if (len >= 2)
+    {
+        acc += *(const uint16_t *)p;
+        p += 2;
+        len -= 2;
+    }
+
+    if (len > 0)
+    {
+        ((uint8_t *)&t)[0] = *p;
+    }
+
+    return fold(acc, t, odd);
+}
+
+uint16_t usbnet_chksum_copy(void *dst, const void *src, uint16_t len)
+{
+    const uint8_t *s = (const uint8_t *)src;
+    uint8_t *d = (uint8_t *)dst;
+    const uint32_t *sw;
+    uint32_t *dw;
+    uint64_t acc = 0;
+    uint16_t t = 0;
+    int odd = (int)((uintptr_t)s & 1);
+
+    if (((uintptr_t)s ^ (uintptr_t)d) & 3)
+    {
+        memcpy(dst, src, len);
+        return usbnet_chksum(dst, len);
+    }
+
+    if (odd && len > 0)
+    {
+        ((uint8_t *)&t)[1] = *d++ = *s++;
+        len--;
+    }
+
+    if (((uintptr_t)s & 2) && len >= 2)
+    {
+        uint16_t v = *(const uint16_t *)s;
+        *(uint16_t *)d = v;
+        acc += v;
+        s += 2;
+        d += 2;
+        len -= 2;
+    }
+
+    sw = (const uint32_t *)s;
+    dw = (uint32_t *)d;
+
+    while (len >= 16)
+    {
+        uint32_t v0 = sw[0], v1 = sw[1], v2 = sw[2], v3 = sw[3];
+        dw[0] = v0;
+        dw[1] = v1;
+        dw[2] = v2;
+        dw[3] = v3;
+        acc += (uint64_t)v0 + v1;
+        acc += (uint64_t)v2 + v3;
+        sw += 4;
+        dw += 4;
+        len -= 16;
+    }
+
+    while (len >= 4)
+    {
+        uint32_t v = *sw++;
+        *dw++ = v;
+        acc += v;
+        len -= 4;
+    }
+
+    s = (const uint8_t *)sw;
+    d = (uint8_t *)dw;
+
+    if (len >= 2)
+    {
+        uint16_t v = *(const uint16_t *)s;
+        *(uint16_t *)d = v;
+        acc += v;
+        s += 2;
+        d += 2;
+        len -= 2;
+    }
+
+    if (len > 0)
+    {
+        ((uint8_t *)&t)[0] = *d = *s;
+    }
+
+    return fold(acc, t, odd);
+}
@@ -1,23 +1,59 @@
 #include "hardware/gpio.h"
 #include "hardware/adc.h"
+#include "hardware/clocks.h"
 #include "math.h"
+#include <cstdio>
+#include <cstring>
 
 #include "pico-usbnet/USBNetwork.h"
 #include "pico-usbnet/TCP.h"
+#include "pico-usbnet/WebSocketServer.h"
+#include "pico-usbnet/RPCServer.h"
+#include "pico-usbnet/RateController.h"
+#include "pico-usbnet/LoopbackBench.h"
+#include "pico-usbnet/ChecksumBench.h"
+#include "pico-usbnet/PoolCalibration.h"
+#include "pico-usbnet/TimeSync.h"
+#include "pico-usbnet/VendorStream.h"
 
 #define LED_PIN 25
 
 TCP tcp;
+WebSocketServer ws;
+RPCServer rpc;
+RateController rate;
+TimeSync timeSync;
+
+#if PICONET_VENDOR_BULK
+// Raw blocks of samples, over the vendor endpoint and over TCP port 5558 for comparison
+BlockRing blocks;
+VendorStream vendor;
+TCP blockTcp;
+int blockConsumer = -1;
+#endif
 
 float frequency = 200.0;                        // Sine wave frequency in Hz
 float sampleRate = 250000;                      // Sample rate in samples per second
 int waveLength = (int)(sampleRate / frequency); // Number of samples per wave cycle
 int counter = 0;
+bool reportPending = false;                     // a level change the client has not seen yet
+int samplesSinceStamp = 0;
+const int stampInterval = 4096;                 // samples between host-time stamps in the TCP stream
+
+// Degradation ladder of the TCP stream; codec 1 sends int16 samples scaled to +-32000
+static const RateLevel ratePolicy[] = {
+    {RateMode::Full, 1, 0},
+    {RateMode::Average, 2, 0},
+    {RateMode::Average, 4, 0},
+    {RateMode::Average, 4, 1},
+    {RateMode::Decimate, 8, 1},
+    {RateMode::Decimate, 16, 1},
+};
 
-std::vector<dhcp_entry_t> dhcp = {
-    {{0}, IPADDR4_INIT_BYTES(192, 168, 7, 3), 24 * 60 * 60},
-    {{0}, IPADDR4_INIT_BYTES(192, 168, 7, 4), 24 * 60 * 60},
-    {{0}, IPADDR4_INIT_BYTES(192, 168, 7, 5), 24 * 60 * 60},
+DHCPPool dhcp = {
+    IPADDR4_INIT_BYTES(192, 168, 7, 3),   // First address handed out
+    3,                                    // Pool size
+    24 * 60 * 60                          // Lease time in seconds
 };
 
 USBNetwork network(
@@ -38,16 +74,103 @@ void blinkPattern(int pin, int blinks, int duration)
     }
 }
 
-bool sendValue(struct repeating_timer *t)
+// Scheduled once per sample period; now is the sample's deadline, so pacing
+// jitter does not show up in the timestamps
+void sendValue(uint64_t now)
 {
     float wave = sin(2 * M_PI * frequency * (counter / sampleRate));
-    tcp.send(&wave, sizeof(wave));
+    float sample;
+
+    // Host time of the next sample, once tools/timesync_host.py has synced the clocks
+    if (tcp.isConnected() && timeSync.isSynced() && ++samplesSinceStamp >= stampInterval)
+    {
+        uint8_t stamp[PICONET_TIMESYNC_STAMP_SIZE];
+
+        timeSync.encodeStamp(stamp, now);
+
+        if (tcp.send(stamp, sizeof(stamp)) == ERR_OK)
+        {
+            samplesSinceStamp = 0;
+        }
+    }
+
+    if (tcp.isConnected() && rate.reduce(wave, sample))
+    {
+        // The report goes out before any sample in the new format
+        if (reportPending)
+        {
+            uint8_t report[PICONET_RATE_REPORT_SIZE];
+
+            rate.encodeReport(report);
+            reportPending = tcp.send(report, sizeof(report)) != ERR_OK;
+        }
+
+        if (!reportPending && rate.getLevel().codec == 1)
+        {
+            int16_t scaled = (int16_t)(sample * 32000);
+            tcp.send(&scaled, sizeof(scaled));
+        }
+        else if (!reportPending)
+        {
+            tcp.send(&sample, sizeof(sample));
+        }
+    }
+
+    // Browsers get the same samples, coalesced into frames
+    ws.send(&wave, sizeof(wave));
+
+#if PICONET_VENDOR_BULK
+    blocks.append(&wave, sizeof(wave), now);
+#endif
 
     // Reset counter after each cycle
     counter = (counter + 1) % waveLength;
+}
+
+#if PICONET_VENDOR_BULK
+void serveBlocks()
+{
+    if (!blockTcp.isConnected())
+    {
+        if (blockConsumer >= 0)
+        {
+            blocks.detach(blockConsumer);
+            blockConsumer = -1;
+        }
 
-    return true;
+        return;
+    }
+
+    if (blockConsumer < 0)
+    {
+        blockConsumer = blocks.attach();
+    }
+
+    const uint8_t *data;
+    size_t length;
+    bool wrote = false;
+
+    // write() copies, so the ring can move on straight away
+    while (blockConsumer >= 0 && (data = blocks.peek(blockConsumer, length)) != nullptr)
+    {
+        uint16_t room = blockTcp.getAvailableSize();
+        uint16_t chunk = length < room ? (uint16_t)length : room;
+
+        if (chunk == 0 || blockTcp.write(data, chunk) != ERR_OK)
+        {
+            break;
+        }
+
+        blocks.consume(blockConsumer, chunk);
+        wrote = true;
+    }
+
+    if (wrote)
+    {
+        blockTcp.send();
+    }
 }
+#endif
 
 void acceptCallback(struct tcp_pcb *newpcb, err_t err)
 {
@@ -59,6 +182,69 @@ void closeCallback()
     blinkPattern(LED_PIN, 15, 25);
 }
 
+// A service that could not start (usually out of lwIP pcbs) is reported
+// instead of failing silently
+void checkStarted(const char *service, err_t result)
+{
+    if (result != ERR_OK)
+    {
+        printf("%s did not start: error %d\n", service, (int)result);
+        blinkPattern(LED_PIN, 3, 500);
+    }
+}
+
+// RPC method 0: on-chip temperature in degrees Celsius (float)
+RpcStatus getTemperature(RpcCall &call)
+{
+    float voltage = adc_read() * 3.3f / (1 << 12);
+    float celsius = 27.0f - (voltage - 0.706f) / 0.001721f;
+
+    if (!call.write(&celsius, sizeof(celsius)))
+    {
+        return RpcStatus::ResultTooLarge;
+    }
+
+    return RpcStatus::Ok;
+}
+
+// RPC method 1: set the sine frequency in Hz (float)
+RpcStatus setFrequency(RpcCall &call)
+{
+    float hz;
+
+    if (call.argLength != sizeof(hz))
+    {
+        return RpcStatus::BadArguments;
+    }
+
+    memcpy(&hz, call.args, sizeof(hz));
+
+    if (!(hz > 0 && hz <= sampleRate / 2))
+    {
+        return RpcStatus::BadArguments;
+    }
+
+    frequency = hz;
+    waveLength = (int)(sampleRate / frequency);
+    counter = 0;
+
+    return RpcStatus::Ok;
+}
+
+static const RpcHandler rpcMethods[] = {
+    getTemperature,
+    setFrequency,
+};
+
+void networkEvent(NetworkEvent event, uint32_t timeUs)
+{
+    // LED stays on once the host has an address
+    if (event == NetworkEvent::FirstLease)
+    {
+        gpio_put(LED_PIN, 1);
+    }
+}
+
 int main()
 {
     // Set up GPIO
@@ -70,11 +256,36 @@ int main()
     adc_set_temp_sensor_enabled(true);
     adc_select_input(4);
 
-    // Set up network
+#if PICONET_NETIFS > 1
+    // Device-local address whose queue is separate from the streams on 192.168.7.6
+    network.addLocalInterface(IPADDR4_INIT_BYTES(10, 77, 0, 1), IPADDR4_INIT_BYTES(255, 255, 255, 255));
+#endif
+
+    // Set up network; returns before the host enumerates
+    network.onEvent(networkEvent);
     network.init();
 
-    // Initialize TCP
+#if PICONET_LOOPBACK
+    // Stack self-test on the device's own address; needs no host
+    stdio_init_all();
+
+    LoopbackBench::Result bench;
+    LoopbackBench::run(network, bench);
+    LoopbackBench::print(bench);
+    network.printInterfaceStats();
+#if PICONET_POOL_CALIBRATION
+    PoolCalibration::printRecommendation();
+#endif
+
+    ChecksumBench::Result sums;
+    ChecksumBench::run(sums);
+    ChecksumBench::print(sums, clock_get_hz(clk_sys));
+#endif
+
+    // Initialize TCP; the sample stream yields to control traffic
     tcp.init();
+    tcp.setPriority(TxClass::Bulk);
+    rate.setPolicy(ratePolicy, sizeof(ratePolicy) / sizeof(ratePolicy[0]));
 
     // Setup TCP callbacks
     tcp.onAccept(acceptCallback);
@@ -84,12 +295,43 @@ int main()
     tcp.bind(IP_ADDR_ANY, 5555);
     tcp.listen();
 
+    // Live view for browsers: ws://pico.usb:8080/
+    checkStarted("websocket server", ws.start(8080));
+
+    // Control commands, see tools/rpc_client.py
+    checkStarted("rpc server", rpc.start(RpcTable(rpcMethods)));
+
+    // Host clock for the stream stamps
+    checkStarted("time sync", timeSync.start());
+
+#if PICONET_VENDOR_BULK
+    // Raw sample blocks, see tools/usbfs_reader.c
+    blocks.setTimeSync(&timeSync);
+    vendor.start(blocks);
+
+    blockTcp.init();
+    blockTcp.setPriority(TxClass::Bulk);
+    blockTcp.bind(IP_ADDR_ANY, 5558);
+    blockTcp.listen();
+#endif
+
+    // Samples at their deadlines; the time in between goes to USB and lwIP
+    network.getScheduler().schedulePeriodic(sendValue, (uint32_t)(1e6 / sampleRate));
+
     while (true)
     {
-        sendValue(NULL);
-        sleep_us(1e6 / sampleRate);
+        network.service();
+
+#if PICONET_VENDOR_BULK
+        vendor.poll();
+        serveBlocks();
+#endif
 
-        network.work();
+        // Thin the stream while the host or the link falls behind, see tools/throttle_reader.py
+        if (rate.update(tcp, to_ms_since_boot(get_absolute_time())))
+        {
+            reportPending = true;
+        }
     }
 
     return 0;
@@ -44,13 +44,17 @@ enum
   STRID_PRODUCT,
   STRID_SERIAL,
   STRID_INTERFACE,
-  STRID_MAC
+  STRID_MAC,
+  STRID_VENDOR
 };
 
 enum
 {
   ITF_NUM_CDC = 0,
   ITF_NUM_CDC_DATA,
+#if CFG_TUD_VENDOR
+  ITF_NUM_VENDOR,     // raw sample blocks, see VendorStream
+#endif
   ITF_NUM_TOTAL
 };
 
@@ -98,8 +102,14 @@ uint8_t const * tud_descriptor_device_cb(void)
 //--------------------------------------------------------------------+
 // Configuration Descriptor
 //--------------------------------------------------------------------+
-#define MAIN_CONFIG_TOTAL_LEN    (TUD_CONFIG_DESC_LEN + TUD_RNDIS_DESC_LEN)
-#define ALT_CONFIG_TOTAL_LEN     (TUD_CONFIG_DESC_LEN + TUD_CDC_ECM_DESC_LEN)
+#if CFG_TUD_VENDOR
+  #define VENDOR_DESC_LEN        TUD_VENDOR_DESC_LEN
+#else
+  #define VENDOR_DESC_LEN        0
+#endif
+
+#define MAIN_CONFIG_TOTAL_LEN    (TUD_CONFIG_DESC_LEN + TUD_RNDIS_DESC_LEN + VENDOR_DESC_LEN)
+#define ALT_CONFIG_TOTAL_LEN     (TUD_CONFIG_DESC_LEN + TUD_CDC_ECM_DESC_LEN + VENDOR_DESC_LEN)
 
 #if CFG_TUSB_MCU == OPT_MCU_LPC175X_6X || CFG_TUSB_MCU == OPT_MCU_LPC177X_8X || CFG_TUSB_MCU == OPT_MCU_LPC40XX
   // LPC 17xx and 40xx endpoint type (bulk/interrupt/iso) are fixed by its number
@@ -107,6 +117,8 @@ uint8_t const * tud_descriptor_device_cb(void)
   #define EPNUM_NET_NOTIF   0x81
   #define EPNUM_NET_OUT     0x02
   #define EPNUM_NET_IN      0x82
+  #define EPNUM_VENDOR_OUT  0x05
+  #define EPNUM_VENDOR_IN   0x85
 
 #elif CFG_TUSB_MCU == OPT_MCU_SAMG
   // SAMG doesn't support a same endpoint number with different direction IN and OUT
@@ -114,13 +126,19 @@ uint8_t const * tud_descriptor_device_cb(void)
   #define EPNUM_NET_NOTIF   0x81
   #define EPNUM_NET_OUT     0x02
   #define EPNUM_NET_IN      0x83
+  #define EPNUM_VENDOR_OUT  0x04
+  #define EPNUM_VENDOR_IN   0x85
 
 #else
   #define EPNUM_NET_NOTIF   0x81
   #define EPNUM_NET_OUT     0x02
   #define EPNUM_NET_IN      0x82
+  #define EPNUM_VENDOR_OUT  0x03
+  #define EPNUM_VENDOR_IN   0x83
 #endif
 
+#define VENDOR_EP_SIZE      (TUD_OPT_HIGH_SPEED ? 512 : 64)
+
 static uint8_t const rndis_configuration[] =
 {
   // Config number (index+1), interface count, string index, total length, attribute, power in mA
@@ -128,6 +146,11 @@ static uint8_t const rndis_configuration[] =
 
   // Interface number, string index, EP notification address and size, EP data address (out, in) and size.
   TUD_RNDIS_DESCRIPTOR(ITF_NUM_CDC, STRID_INTERFACE, EPNUM_NET_NOTIF, 8, EPNUM_NET_OUT, EPNUM_NET_IN, CFG_TUD_NET_ENDPOINT_SIZE),
+
+#if CFG_TUD_VENDOR
+  // Interface number, string index, EP out & in address, EP size
+  TUD_VENDOR_DESCRIPTOR(ITF_NUM_VENDOR, STRID_VENDOR, EPNUM_VENDOR_OUT, EPNUM_VENDOR_IN, VENDOR_EP_SIZE),
+#endif
 };
 
 static uint8_t const ecm_configuration[] =
@@ -137,6 +160,11 @@ static uint8_t const ecm_configuration[] =
 
   // Interface number, description string index, MAC address string index, EP notification address and size, EP data address (out, in), and size, max segment size.
   TUD_CDC_ECM_DESCRIPTOR(ITF_NUM_CDC, STRID_INTERFACE, STRID_MAC, EPNUM_NET_NOTIF, 64, EPNUM_NET_OUT, EPNUM_NET_IN, CFG_TUD_NET_ENDPOINT_SIZE, CFG_TUD_NET_MTU),
+
+#if CFG_TUD_VENDOR
+  // Interface number, string index, EP out & in address, EP size
+  TUD_VENDOR_DESCRIPTOR(ITF_NUM_VENDOR, STRID_VENDOR, EPNUM_VENDOR_OUT, EPNUM_VENDOR_IN, VENDOR_EP_SIZE),
+#endif
 };
 
 // Configuration array: RNDIS and CDC-ECM
@@ -169,7 +197,8 @@ static char const* string_desc_arr [] =
   [STRID_MANUFACTURER] = "TinyUSB",                     // Manufacturer
   [STRID_PRODUCT]      = "Go to http://192.168.7.1/",   // Product
   //[STRID_SERIAL]       = "123456",                      // Serial
-  [STRID_INTERFACE]    = "TinyUSB Network Interface"    // Interface Description
+  [STRID_INTERFACE]    = "TinyUSB Network Interface",   // Interface Description
+  [STRID_VENDOR]       = "pico-usbnet Sample Stream"    // Vendor bulk interface
 
   // STRID_MAC index is handled separately
   // STRID_SERIAL index is handled seperately
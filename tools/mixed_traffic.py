@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+"""Measure the device's control-path RTT while a bulk TCP stream is running.
+
+One thread drains the bulk stream (the example firmware streams samples on
+port 5555) as fast as it can. The main thread times TCP handshakes to a probe
+port; an open port answers with SYN-ACK and a closed one with RST, and both
+are bare segments the TxScheduler sends in the Control class. Run it once with
+--no-bulk for the idle baseline and once with the stream, then compare.
+
+    mixed_traffic.py [--host 192.168.7.6] [--bulk-port 5555] [--probe-port 7]
+"""
+
+import argparse
+import socket
+import statistics
+import sys
+import threading
+import time
+
+
+def drain(host, port, stop, counter):
+    with socket.create_connection((host, port), timeout=5) as sock:
+        sock.settimeout(0.5)
+
+        while not stop.is_set():
+            try:
+                data = sock.recv(65536)
+            except socket.timeout:
+                continue
+
+            if not data:
+                break
+
+            counter[0] += len(data)
+
+
+def probe(host, port, timeout):
+    start = time.perf_counter()
+
+    try:
+        with socket.create_connection((host, port), timeout=timeout):
+            pass
+    except ConnectionRefusedError:
+        pass
+    except OSError:
+        return None
+
+    return (time.perf_counter() - start) * 1e6
+
+
+def percentile(values, fraction):
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(fraction * len(ordered)))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default="192.168.7.6")
+    parser.add_argument("--bulk-port", type=int, default=5555)
+    parser.add_argument("--probe-port", type=int, default=7)
+    parser.add_argument("--count", type=int, default=200, help="handshakes to time")
+    parser.add_argument("--interval", type=float, default=0.01, help="seconds between handshakes")
+    parser.add_argument("--no-bulk", action="store_true", help="measure the idle baseline")
+    args = parser.parse_args()
+
+    stop = threading.Event()
+    received = [0]
+    worker = None
+
+    if not args.no_bulk:
+        worker = threading.Thread(target=drain, args=(args.host, args.bulk_port, stop, received), daemon=True)
+        worker.start()
+        # Let the stream fill the device's queues first
+        time.sleep(1.0)
+
+    samples = []
+    lost = 0
+    started = time.perf_counter()
+
+    for _ in range(args.count):
+        rtt = probe(args.host, args.probe_port, 1.0)
+
+        if rtt is None:
+            lost += 1
+        else:
+            samples.append(rtt)
+
+        time.sleep(args.interval)
+
+    elapsed = time.perf_counter() - started
+    stop.set()
+
+    if worker:
+        worker.join(timeout=2)
+
+    if not samples:
+        sys.exit("no handshake completed")
+
+    print(f"handshakes  {len(samples)} ok, {lost} lost")
+    print(f"rtt us      min {min(samples):.0f}  median {statistics.median(samples):.0f}  "
+          f"p99 {percentile(samples, 0.99):.0f}  max {max(samples):.0f}")
+
+    if worker:
+        print(f"bulk        {received[0] * 8 / elapsed / 1e6:.2f} Mbit/s")
+
+
+if __name__ == "__main__":
+    main()
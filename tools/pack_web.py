@@ -0,0 +1,204 @@
+#!/usr/bin/env python3
+"""Pack a directory of web assets into a C++ source holding a WebImage.
+
+Every file gets its complete response header, a 304 response and an ETag
+precomputed at build time. Text-like files also get a gzip variant when that
+saves at least 10%. All of it ends up as const data, which the RP2040 keeps in
+XIP flash, so HTTPServer hands it to tcp_write() without copying.
+
+    pack_web.py [--symbol web_image] <web directory> <output.cpp>
+
+index.html is additionally served for its directory ("/" and "/docs/").
+"""
+
+import argparse
+import gzip
+import hashlib
+import os
+import sys
+
+CONTENT_TYPES = {
+    ".html": "text/html; charset=utf-8",
+    ".htm": "text/html; charset=utf-8",
+    ".css": "text/css; charset=utf-8",
+    ".js": "text/javascript; charset=utf-8",
+    ".mjs": "text/javascript; charset=utf-8",
+    ".json": "application/json",
+    ".txt": "text/plain; charset=utf-8",
+    ".svg": "image/svg+xml",
+    ".xml": "application/xml",
+    ".wasm": "application/wasm",
+    ".ico": "image/x-icon",
+    ".png": "image/png",
+    ".jpg": "image/jpeg",
+    ".jpeg": "image/jpeg",
+    ".gif": "image/gif",
+    ".webp": "image/webp",
+    ".woff": "font/woff",
+    ".woff2": "font/woff2",
+}
+
+# Formats that are already compressed
+INCOMPRESSIBLE = {".png", ".jpg", ".jpeg", ".gif", ".webp", ".woff", ".woff2"}
+
+MIN_SAVING = 0.10
+
+
+def c_string(data):
+    out = []
+    for ch in data:
+        if ch == "\\" or ch == '"':
+            out.append("\\" + ch)
+        elif ch == "\r":
+            out.append("\\r")
+        elif ch == "\n":
+            out.append("\\n")
+        else:
+            out.append(ch)
+    return '"' + "".join(out) + '"'
+
+
+def c_bytes(data):
+    lines = []
+    for i in range(0, len(data), 16):
+        lines.append("    " + ", ".join("0x%02x" % b for b in data[i:i + 16]) + ",")
+    return "\n".join(lines)
+
+
+def response_header(content_type, length, etag, encoding, vary):
+    lines = [
+        "HTTP/1.1 200 OK",
+        "Content-Type: " + content_type,
+        "Content-Length: %d" % length,
+    ]
+    if encoding:
+        lines.append("Content-Encoding: " + encoding)
+    if vary:
+        lines.append("Vary: Accept-Encoding")
+    lines.append("ETag: " + etag)
+    # Always revalidate; the ETag turns repeat loads into 304s
+    lines.append("Cache-Control: no-cache")
+    return "\r\n".join(lines) + "\r\n\r\n"
+
+
+def not_modified_header(etag, vary):
+    lines = ["HTTP/1.1 304 Not Modified", "ETag: " + etag, "Cache-Control: no-cache"]
+    if vary:
+        lines.append("Vary: Accept-Encoding")
+    return "\r\n".join(lines) + "\r\n\r\n"
+
+
+def emit_variant(out, name, data, header, etag, vary):
+    """Emit one encoding's body, header and 304; return its WebVariant initializer."""
+    # C has no empty arrays: an empty file gets a dummy byte and length 0
+    out.append("static const uint8_t %s[] = {" % name)
+    out.append(c_bytes(data) if data else "    0x00,")
+    out.append("};")
+    out.append("static const char %s_header[] = %s;" % (name, c_string(header)))
+    out.append("static const char %s_not_modified[] = %s;" % (name, c_string(not_modified_header(etag, vary))))
+    return "{%s_header, sizeof(%s_header) - 1, %s, %d, %s, %s_not_modified, sizeof(%s_not_modified) - 1}" % (
+        name, name, name, len(data), c_string(etag), name, name)
+
+
+def collect(root):
+    files = []
+    for directory, dirs, names in os.walk(root):
+        dirs.sort()
+        for name in sorted(names):
+            if name.startswith("."):
+                continue
+            path = os.path.join(directory, name)
+            url = "/" + os.path.relpath(path, root).replace(os.sep, "/")
+            files.append((url, path))
+    return files
+
+
+def pack(root, symbol):
+    out = [
+        "// Generated by tools/pack_web.py from %s; do not edit" % os.path.basename(os.path.normpath(root)),
+        "",
+        '#include "pico-usbnet/HTTPServer.h"',
+        "",
+    ]
+    entries = []
+
+    for index, (url, path) in enumerate(collect(root)):
+        with open(path, "rb") as f:
+            data = f.read()
+
+        ext = os.path.splitext(path)[1].lower()
+        content_type = CONTENT_TYPES.get(ext, "application/octet-stream")
+        tag = hashlib.sha1(data).hexdigest()[:16]
+
+        compressed = None
+        if ext not in INCOMPRESSIBLE and data:
+            # mtime=0 keeps the output reproducible
+            candidate = gzip.compress(data, compresslevel=9, mtime=0)
+            if len(candidate) <= len(data) * (1 - MIN_SAVING):
+                compressed = candidate
+
+        vary = compressed is not None
+        name = "asset%d" % index
+
+        out.append("// %s" % url)
+        # Strong ETags must differ between encodings whose bytes differ
+        etag = '"%s"' % tag
+        identity_header = response_header(content_type, len(data), etag, None, vary)
+        identity_variant = emit_variant(out, name + "_identity", data, identity_header, etag, vary)
+
+        if compressed is not None:
+            etag = '"%s-gz"' % tag
+            gzip_header = response_header(content_type, len(compressed), etag, "gzip", vary)
+            gzip_variant = emit_variant(out, name + "_gzip", compressed, gzip_header, etag, vary)
+        else:
+            gzip_variant = "{nullptr, 0, nullptr, 0, nullptr, nullptr, 0}"
+
+        out.append("")
+
+        entry = "{%%s,\n     %s,\n     %s}" % (identity_variant, gzip_variant)
+
+        entries.append((url, entry))
+        if url.endswith("/index.html"):
+            entries.append((url[:-len("index.html")], entry))
+
+    if not entries:
+        sys.exit("pack_web.py: no files found in %s" % root)
+
+    # HTTPServer bisects on the path, so keep strcmp() order
+    entries.sort(key=lambda e: e[0].encode("utf-8"))
+
+    out.append("static const WebAsset assets[] = {")
+    for url, entry in entries:
+        out.append("    " + (entry % c_string(url)) + ",")
+    out.append("};")
+    out.append("")
+    out.append("extern const WebImage %s = {assets, sizeof(assets) / sizeof(assets[0])};" % symbol)
+    out.append("")
+
+    return "\n".join(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--symbol", default="web_image", help="name of the generated WebImage")
+    parser.add_argument("directory")
+    parser.add_argument("output")
+    args = parser.parse_args()
+
+    if not os.path.isdir(args.directory):
+        sys.exit("pack_web.py: %s is not a directory" % args.directory)
+
+    source = pack(args.directory, args.symbol)
+
+    # Only touch the output when it changes, to avoid needless rebuilds
+    if os.path.exists(args.output):
+        with open(args.output) as f:
+            if f.read() == source:
+                return
+
+    with open(args.output, "w") as f:
+        f.write(source)
+
+
+if __name__ == "__main__":
+    main()
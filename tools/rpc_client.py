@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+"""Host client for RPCServer, usable as a module or from the command line.
+
+    from rpc_client import RpcClient
+    client = RpcClient("192.168.7.6")
+    status, result = client.call(0)
+    results = client.batch([(0, b""), (1, struct.pack("<f", 440.0))])
+
+From the command line it times round trips of the built-in echo method:
+
+    rpc_client.py [--host 192.168.7.6] [--port 5556] [--count 1000] [--size 16] [--batch 1]
+"""
+
+import argparse
+import os
+import socket
+import statistics
+import struct
+import sys
+import time
+
+VERSION = 1
+FLAG_RESPONSE = 0x01
+METHOD_ECHO = 0xFFFF
+
+HEADER = struct.Struct("<BBBBI")
+ITEM = struct.Struct("<HH")
+
+STATUS_NAMES = {0: "ok", 1: "unknown method", 2: "bad arguments", 3: "result too large", 4: "failed"}
+
+# Stands in for a result the response did not carry; never sent by the device
+STATUS_MISSING = -1
+STATUS_NAMES[STATUS_MISSING] = "missing"
+
+
+class RpcError(Exception):
+    pass
+
+
+class RpcClient:
+    def __init__(self, host, port=5556, timeout=0.05, retries=5):
+        self.address = (host, port)
+        self.timeout = timeout
+        self.retries = retries
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.connect(self.address)
+        self.next_id = int.from_bytes(os.urandom(4), "little")
+        self.resent = 0
+
+    def close(self):
+        self.sock.close()
+
+    def call(self, method, args=b""):
+        status, result = self.batch([(method, args)])[0]
+
+        if status == STATUS_MISSING:
+            raise RpcError(f"no result for method {method:#06x}")
+
+        return status, result
+
+    def batch(self, calls):
+        """Send several calls in one datagram; returns [(status, payload), ...]."""
+        if len(calls) > 255:
+            raise RpcError("at most 255 calls per batch")
+
+        request_id = self.next_id
+        self.next_id = (self.next_id + 1) & 0xFFFFFFFF
+
+        datagram = bytearray(HEADER.pack(VERSION, 0, len(calls), 0, request_id))
+
+        for method, args in calls:
+            datagram += ITEM.pack(method, len(args)) + bytes(args)
+
+        # Retries reuse the id, so the device answers them without running the calls again
+        for attempt in range(self.retries + 1):
+            if attempt:
+                self.resent += 1
+
+            self.sock.send(datagram)
+            deadline = time.monotonic() + self.timeout
+
+            while True:
+                remaining = deadline - time.monotonic()
+
+                if remaining <= 0:
+                    break
+
+                self.sock.settimeout(remaining)
+
+                try:
+                    response = self.sock.recv(65536)
+                except socket.timeout:
+                    break
+
+                results = self._parse(response, request_id)
+
+                if results is not None:
+                    # A short or cut-off response still yields one entry per call
+                    results += [(STATUS_MISSING, b"")] * (len(calls) - len(results))
+                    return results[:len(calls)]
+
+        raise RpcError(f"no response to request {request_id:#010x}")
+
+    @staticmethod
+    def _parse(response, request_id):
+        if len(response) < HEADER.size:
+            return None
+
+        version, flags, count, _, response_id = HEADER.unpack_from(response)
+
+        # Late answers to earlier attempts are skipped
+        if version != VERSION or not flags & FLAG_RESPONSE or response_id != request_id:
+            return None
+
+        results = []
+        offset = HEADER.size
+
+        for _ in range(count):
+            if offset + ITEM.size > len(response):
+                break
+
+            status, length = ITEM.unpack_from(response, offset)
+            offset += ITEM.size
+            results.append((status, response[offset:offset + length]))
+            offset += length
+
+        return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default="192.168.7.6")
+    parser.add_argument("--port", type=int, default=5556)
+    parser.add_argument("--count", type=int, default=1000, help="round trips to time")
+    parser.add_argument("--size", type=int, default=16, help="echo payload bytes")
+    parser.add_argument("--batch", type=int, default=1, help="calls per datagram")
+    args = parser.parse_args()
+
+    client = RpcClient(args.host, args.port)
+    payload = os.urandom(args.size)
+    calls = [(METHOD_ECHO, payload)] * args.batch
+    samples = []
+
+    # Warm up ARP and the caches
+    client.batch(calls)
+
+    for _ in range(args.count):
+        start = time.perf_counter()
+        results = client.batch(calls)
+        samples.append((time.perf_counter() - start) * 1e6)
+
+        for status, result in results:
+            if status != 0 or result != payload:
+                sys.exit(f"bad echo: {STATUS_NAMES.get(status, status)}")
+
+    samples.sort()
+    print(f"round trips {len(samples)}, {args.batch} call(s) of {args.size} bytes each, {client.resent} resent")
+    print(f"rtt us      min {samples[0]:.0f}  median {statistics.median(samples):.0f}  "
+          f"p99 {samples[min(len(samples) - 1, int(0.99 * len(samples)))]:.0f}  max {samples[-1]:.0f}")
+    print(f"calls/s     {args.batch * len(samples) / (sum(samples) / 1e6):.0f}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+"""Read the example sample stream through a throttled link and follow the
+degradation reports RateController puts in it.
+
+The reader limits itself to a byte rate per phase, with a small receive
+buffer, so the device sees a slow host: its send buffer fills, the producer
+steps down and the stream carries a report for each step. A run passes when
+the connection survives every phase and, after a slow phase, the device
+climbs back to full quality in the fast one.
+
+    throttle_reader.py [--host 192.168.7.6] [--port 5555] [--phases 0:5,20000:20,0:30]
+
+Phases are rate:seconds, with rate in bytes per second and 0 for unlimited.
+"""
+
+import argparse
+import socket
+import struct
+import sys
+import time
+
+MARKER = struct.pack("<I", 0x7FC05243)
+REPORT = struct.Struct("<4sBBBB")
+# Host-time stamps from TimeSync are skipped
+STAMP_MARKER = struct.pack("<I", 0x7FC05354)
+STAMP_SIZE = 16
+MODES = {0: "full", 1: "average", 2: "decimate"}
+# Codec tiers of the example firmware
+SAMPLE_SIZE = {0: 4, 1: 2}
+
+
+class StreamParser:
+    def __init__(self):
+        self.buffer = bytearray()
+        self.codec = 0
+        self.level = 0
+        self.samples = 0
+        self.reports = []
+
+    def feed(self, data, now):
+        self.buffer += data
+        offset = 0
+
+        while True:
+            size = SAMPLE_SIZE.get(self.codec, 4)
+            remaining = len(self.buffer) - offset
+
+            # Wait for more data while it could still turn out to be a report
+            head = bytes(self.buffer[offset:offset + 4])
+
+            if (remaining < REPORT.size and MARKER.startswith(head)) or \
+                    (remaining < STAMP_SIZE and STAMP_MARKER.startswith(head)):
+                break
+
+            if head == STAMP_MARKER:
+                offset += STAMP_SIZE
+            elif head == MARKER:
+                _, level, mode, factor, codec = REPORT.unpack_from(self.buffer, offset)
+                self.reports.append((now, level, mode, factor, codec))
+                self.level = level
+                self.codec = codec
+                offset += REPORT.size
+            elif remaining >= size:
+                self.samples += 1
+                offset += size
+            else:
+                break
+
+        del self.buffer[:offset]
+
+
+def parse_phases(text):
+    phases = []
+
+    for item in text.split(","):
+        rate, seconds = item.split(":")
+        phases.append((int(rate), float(seconds)))
+
+    return phases
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default="192.168.7.6")
+    parser.add_argument("--port", type=int, default=5555)
+    parser.add_argument("--phases", default="0:5,20000:20,0:30", help="rate:seconds, comma separated")
+    parser.add_argument("--rcvbuf", type=int, default=4096, help="socket receive buffer bytes")
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    # Set before connecting so the advertised window stays small
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, args.rcvbuf)
+    sock.settimeout(5)
+    sock.connect((args.host, args.port))
+
+    stream = StreamParser()
+    start = time.monotonic()
+    survived = True
+    phase_levels = []
+
+    for rate, seconds in parse_phases(args.phases):
+        phase_start = time.monotonic()
+        phase_end = phase_start + seconds
+        received = 0
+        samples = stream.samples
+        chunk = 1024 if rate else 65536
+
+        print(f"{phase_start - start:7.1f}s  phase {'unlimited' if rate == 0 else f'{rate} B/s'} for {seconds:g}s")
+
+        while time.monotonic() < phase_end:
+            if rate:
+                # Token bucket: never be ahead of rate * elapsed
+                ahead = received / rate - (time.monotonic() - phase_start)
+
+                if ahead > 0:
+                    time.sleep(min(ahead, phase_end - time.monotonic(), 0.1))
+                    continue
+
+            try:
+                data = sock.recv(chunk)
+            except socket.timeout:
+                continue
+            except OSError as error:
+                print(f"connection failed: {error}")
+                survived = False
+                break
+
+            if not data:
+                print("connection closed by the device")
+                survived = False
+                break
+
+            received += len(data)
+            reports = len(stream.reports)
+            stream.feed(data, time.monotonic() - start)
+
+            for when, level, mode, factor, codec in stream.reports[reports:]:
+                print(f"{when:7.1f}s  level {level}: {MODES.get(mode, mode)} x{factor}, codec {codec}")
+
+        elapsed = time.monotonic() - phase_start
+        print(f"{time.monotonic() - start:7.1f}s  {received / elapsed / 1000:.1f} kB/s, "
+              f"{(stream.samples - samples) / elapsed:.0f} samples/s, ending at level {stream.level}")
+        phase_levels.append(stream.level)
+
+        if not survived:
+            break
+
+    sock.close()
+
+    print(f"reports {len(stream.reports)}, connection {'held' if survived else 'lost'}")
+
+    recovered = len(phase_levels) < 2 or phase_levels[-1] == 0
+
+    if not recovered:
+        print(f"did not return to full quality (level {phase_levels[-1]})")
+
+    sys.exit(0 if survived and recovered else 1)
+
+
+if __name__ == "__main__":
+    main()
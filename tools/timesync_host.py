@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+"""Time server for TimeSync, with a clock that can be skewed on purpose.
+
+Announces itself to the device, answers its requests with host receive and
+send times, and checks the estimates the device reports back: every synced
+request carries the device's idea of host time at the moment it was sent,
+which is compared with the receive time less half the measured delay.
+
+    timesync_host.py [--device 192.168.7.6] [--port 5557] [--skew-ppm 0] [--offset-ms 0] [--jitter-us 0]
+
+--skew-ppm runs this clock fast (or slow, negative) against the real one and
+--offset-ms shifts it, so the device has to find the offset and drift from
+scratch. --jitter-us adds random one-way delays to the exchange. The drift the
+device reports includes its own crystal error, normally a few ppm.
+"""
+
+import argparse
+import random
+import socket
+import statistics
+import struct
+import time
+
+VERSION = 1
+ANNOUNCE, REQUEST, RESPONSE = 0, 1, 2
+FLAG_SYNCED = 0x01
+
+MESSAGE = struct.Struct("<BBBBIQQQiI")
+
+
+class SkewedClock:
+    def __init__(self, skew_ppm, offset_ms):
+        self.skew = skew_ppm * 1e-6
+        self.offset = offset_ms * 1000
+        self.start = time.time_ns() // 1000
+
+    def now_us(self):
+        real = time.time_ns() // 1000
+        return int(real + self.offset + self.skew * (real - self.start))
+
+
+def percentile(values, fraction):
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(fraction * len(ordered)))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--device", default="192.168.7.6")
+    parser.add_argument("--port", type=int, default=5557)
+    parser.add_argument("--skew-ppm", type=float, default=0.0)
+    parser.add_argument("--offset-ms", type=float, default=0.0)
+    parser.add_argument("--jitter-us", type=float, default=0.0, help="mean of random extra one-way delays")
+    parser.add_argument("--report", type=float, default=5.0, help="seconds between summaries")
+    parser.add_argument("--seconds", type=float, default=0.0, help="stop after this long (0: run until interrupted)")
+    args = parser.parse_args()
+
+    clock = SkewedClock(args.skew_ppm, args.offset_ms)
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("", 0))
+    sock.settimeout(0.5)
+    device = (args.device, args.port)
+
+    def jitter():
+        if args.jitter_us > 0:
+            time.sleep(random.expovariate(1 / args.jitter_us) / 1e6)
+
+    started = time.monotonic()
+    next_announce = 0.0
+    next_report = started + args.report
+    errors = []
+    delays = []
+    drift_ppb = None
+    requests = 0
+
+    print(f"serving on port {sock.getsockname()[1]}, skew {args.skew_ppm:+g} ppm, offset {args.offset_ms:+g} ms")
+
+    while not args.seconds or time.monotonic() - started < args.seconds:
+        now = time.monotonic()
+
+        # Repeated, so a device that restarts finds the server again
+        if now >= next_announce:
+            sock.sendto(MESSAGE.pack(VERSION, ANNOUNCE, 0, 0, 0, 0, 0, 0, 0, 0), device)
+            next_announce = now + 2.0
+
+        if now >= next_report:
+            if errors:
+                print(f"{now - started:7.1f}s  requests {requests}, drift {drift_ppb / 1000:+.3f} ppm, "
+                      f"estimate error us mean {statistics.mean(errors):+.1f} "
+                      f"p95 |{percentile([abs(e) for e in errors], 0.95):.1f}|, "
+                      f"delay us median {statistics.median(delays):.0f}")
+            else:
+                print(f"{now - started:7.1f}s  requests {requests}, not synced yet")
+
+            errors.clear()
+            delays.clear()
+            next_report = now + args.report
+
+        try:
+            data, sender = sock.recvfrom(64)
+        except socket.timeout:
+            continue
+
+        # Simulated uplink delay lands before the receive stamp
+        jitter()
+        received = clock.now_us()
+
+        if len(data) < MESSAGE.size:
+            continue
+
+        version, kind, flags, _, sequence, sent, estimate, _, drift, delay = MESSAGE.unpack_from(data)
+
+        if version != VERSION or kind != REQUEST:
+            continue
+
+        requests += 1
+
+        if flags & FLAG_SYNCED and delay:
+            errors.append(estimate - (received - delay / 2))
+            delays.append(delay)
+            drift_ppb = drift
+
+        response = MESSAGE.pack(VERSION, RESPONSE, 0, 0, sequence, sent, received, clock.now_us(), 0, 0)
+        # And downlink delay after the send stamp
+        jitter()
+        sock.sendto(response, sender)
+
+
+if __name__ == "__main__":
+    main()
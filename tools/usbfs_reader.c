@@ -0,0 +1,485 @@
+/*
+ * Reader for the raw sample blocks of VendorStream (PICONET_VENDOR_BULK).
+ *
+ * Talks to the vendor bulk IN endpoint through Linux usbfs ioctls, so it
+ * needs neither libusb nor a kernel driver. The same blocks are served on
+ * TCP port 5558, and a simulated endpoint can stand in for the device, so
+ * the three paths are measured by the same parser. The simulation only
+ * generates blocks; the device's BlockRing and VendorStream are exercised
+ * against a fake endpoint by host/test_block_ring.cpp.
+ *
+ *   usbfs_reader [--usb [/dev/bus/usb/BBB/DDD]] [--interface 2] [--endpoint 0x83]
+ *   usbfs_reader --tcp 192.168.7.6[:5558]
+ *   usbfs_reader --sim [--sim-rate BYTES_PER_S] [--sim-drop N]
+ *   common: [--seconds 10]
+ *
+ * Without a path, --usb looks for the first device with VID 0xCAFE whose
+ * product id has the vendor interface bit set. The device node must be
+ * readable, e.g. through a udev rule or by running as root.
+ *
+ * Build: cc -O2 -o usbfs_reader tools/usbfs_reader.c
+ */
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/usbdevice_fs.h>
+#include <netdb.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BLOCK_MAGIC         0x4B4C4250u
+#define BLOCK_HEADER_SIZE   24
+#define FLAG_HOST_TIME      0x01
+#define MAX_BLOCK           65536
+#define TRANSFER_SIZE       16384
+#define USB_VENDOR_ID       0xCAFE
+#define PID_VENDOR_BIT      (1 << 4)
+
+/* Same layout as the device's usb_descriptors.c on the RP2040 */
+#define DEFAULT_INTERFACE   2
+#define DEFAULT_ENDPOINT    0x83
+
+#define SIM_PACKET          64
+#define SIM_BLOCK           2048
+
+struct backend {
+    const char *name;
+    /* Bytes read, 0 on timeout, -1 on error */
+    int (*read)(struct backend *backend, uint8_t *buffer, int length);
+    int fd;
+    unsigned endpoint;
+
+    /* Simulated endpoint */
+    uint32_t sim_sequence;
+    uint32_t sim_value;
+    uint8_t sim_block[BLOCK_HEADER_SIZE + SIM_BLOCK];
+    int sim_offset;
+    double sim_rate;
+    uint32_t sim_drop;
+    double sim_start;
+    uint64_t sim_sent;
+};
+
+struct stats {
+    uint64_t bytes;
+    uint64_t blocks;
+    uint64_t gaps;
+    uint64_t resyncs;
+    uint32_t last_sequence;
+    int64_t last_timestamp;
+    uint32_t last_flags;
+};
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t read_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void write_le32(uint8_t *p, uint32_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+}
+
+/* usbfs: one bulk transfer per call; a short packet from the device ends it early */
+static int usb_read(struct backend *backend, uint8_t *buffer, int length)
+{
+    struct usbdevfs_bulktransfer transfer = {
+        .ep = backend->endpoint,
+        .len = (unsigned)length,
+        .timeout = 500,
+        .data = buffer,
+    };
+
+    int result = ioctl(backend->fd, USBDEVFS_BULK, &transfer);
+
+    if (result < 0)
+        return errno == ETIMEDOUT ? 0 : -1;
+
+    return result;
+}
+
+static int find_usb_device(char *path, size_t size)
+{
+    DIR *dir = opendir("/sys/bus/usb/devices");
+    struct dirent *entry;
+    int found = 0;
+
+    if (!dir)
+        return 0;
+
+    while (!found && (entry = readdir(dir)) != NULL) {
+        char file[512];
+        unsigned vendor = 0, product = 0, bus = 0, device = 0;
+        FILE *f;
+
+        snprintf(file, sizeof(file), "/sys/bus/usb/devices/%s/idVendor", entry->d_name);
+        if (!(f = fopen(file, "r")))
+            continue;
+        if (fscanf(f, "%x", &vendor) != 1)
+            vendor = 0;
+        fclose(f);
+
+        snprintf(file, sizeof(file), "/sys/bus/usb/devices/%s/idProduct", entry->d_name);
+        if (!(f = fopen(file, "r")))
+            continue;
+        if (fscanf(f, "%x", &product) != 1)
+            product = 0;
+        fclose(f);
+
+        if (vendor != USB_VENDOR_ID || !(product & PID_VENDOR_BIT))
+            continue;
+
+        snprintf(file, sizeof(file), "/sys/bus/usb/devices/%s/busnum", entry->d_name);
+        if ((f = fopen(file, "r"))) {
+            if (fscanf(f, "%u", &bus) != 1)
+                bus = 0;
+            fclose(f);
+        }
+
+        snprintf(file, sizeof(file), "/sys/bus/usb/devices/%s/devnum", entry->d_name);
+        if ((f = fopen(file, "r"))) {
+            if (fscanf(f, "%u", &device) != 1)
+                device = 0;
+            fclose(f);
+        }
+
+        if (bus && device) {
+            snprintf(path, size, "/dev/bus/usb/%03u/%03u", bus, device);
+            found = 1;
+        }
+    }
+
+    closedir(dir);
+
+    return found;
+}
+
+static int open_usb(struct backend *backend, const char *path, unsigned interface, unsigned endpoint)
+{
+    char found[64];
+
+    if (!path) {
+        if (!find_usb_device(found, sizeof(found))) {
+            fprintf(stderr, "no device with VID %04x and the vendor interface\n", USB_VENDOR_ID);
+            return -1;
+        }
+
+        path = found;
+    }
+
+    backend->fd = open(path, O_RDWR);
+
+    if (backend->fd < 0) {
+        perror(path);
+        return -1;
+    }
+
+    if (ioctl(backend->fd, USBDEVFS_CLAIMINTERFACE, &interface) < 0) {
+        perror("claim interface");
+        return -1;
+    }
+
+    backend->name = "usbfs";
+    backend->read = usb_read;
+    backend->endpoint = endpoint;
+
+    printf("reading %s interface %u endpoint 0x%02x\n", path, interface, endpoint);
+
+    return 0;
+}
+
+static int tcp_read(struct backend *backend, uint8_t *buffer, int length)
+{
+    ssize_t result = recv(backend->fd, buffer, (size_t)length, 0);
+
+    if (result < 0)
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+
+    /* Closed by the device */
+    if (result == 0)
+        return -1;
+
+    return (int)result;
+}
+
+static int open_tcp(struct backend *backend, const char *target)
+{
+    char host[256];
+    const char *port = "5558";
+    const char *colon = strrchr(target, ':');
+    struct addrinfo hints = {.ai_family = AF_INET, .ai_socktype = SOCK_STREAM};
+    struct addrinfo *address;
+    struct timeval timeout = {.tv_sec = 0, .tv_usec = 500000};
+
+    snprintf(host, sizeof(host), "%.*s", colon ? (int)(colon - target) : (int)strlen(target), target);
+
+    if (colon)
+        port = colon + 1;
+
+    if (getaddrinfo(host, port, &hints, &address) != 0) {
+        fprintf(stderr, "cannot resolve %s\n", host);
+        return -1;
+    }
+
+    backend->fd = socket(address->ai_family, address->ai_socktype, 0);
+
+    if (backend->fd < 0 || connect(backend->fd, address->ai_addr, address->ai_addrlen) < 0) {
+        perror("connect");
+        freeaddrinfo(address);
+        return -1;
+    }
+
+    freeaddrinfo(address);
+    setsockopt(backend->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    backend->name = "tcp";
+    backend->read = tcp_read;
+
+    printf("reading tcp %s:%s\n", host, port);
+
+    return 0;
+}
+
+static void sim_next_block(struct backend *backend)
+{
+    uint8_t *block = backend->sim_block;
+
+    /* --sim-drop N loses every Nth block, as an overrun on the device would */
+    if (backend->sim_drop && backend->sim_sequence % backend->sim_drop == backend->sim_drop - 1)
+        backend->sim_sequence++;
+
+    write_le32(block, BLOCK_MAGIC);
+    write_le32(block + 4, backend->sim_sequence++);
+    write_le32(block + 8, SIM_BLOCK);
+    write_le32(block + 12, 0);
+    memset(block + 16, 0, 8);
+
+    for (int i = 0; i < SIM_BLOCK; i += 4)
+        write_le32(block + BLOCK_HEADER_SIZE + i, backend->sim_value++);
+
+    backend->sim_offset = 0;
+}
+
+/*
+ * Simulated endpoint: serves blocks the way the device's FIFO does, in
+ * 64-byte packets, ending a transfer on the short packet that closes a block.
+ */
+static int sim_read(struct backend *backend, uint8_t *buffer, int length)
+{
+    int done = 0;
+    int total = BLOCK_HEADER_SIZE + SIM_BLOCK;
+
+    if (backend->sim_rate > 0) {
+        double due = backend->sim_sent / backend->sim_rate - (now_seconds() - backend->sim_start);
+
+        if (due > 0) {
+            usleep((useconds_t)(due > 0.5 ? 500000 : due * 1e6));
+            return 0;
+        }
+    }
+
+    while (done + SIM_PACKET <= length) {
+        int packet = total - backend->sim_offset;
+
+        if (packet > SIM_PACKET)
+            packet = SIM_PACKET;
+
+        memcpy(buffer + done, backend->sim_block + backend->sim_offset, (size_t)packet);
+        backend->sim_offset += packet;
+        done += packet;
+
+        if (backend->sim_offset == total)
+            sim_next_block(backend);
+
+        if (packet < SIM_PACKET)
+            break;
+    }
+
+    backend->sim_sent += (uint64_t)done;
+
+    return done;
+}
+
+static void open_sim(struct backend *backend, double rate, uint32_t drop)
+{
+    backend->name = "sim";
+    backend->read = sim_read;
+    backend->sim_rate = rate;
+    backend->sim_drop = drop;
+    backend->sim_start = now_seconds();
+    sim_next_block(backend);
+
+    printf("reading simulated endpoint%s\n", rate > 0 ? ", rate limited" : "");
+}
+
+/* Consume whole blocks from the front of the buffer; returns bytes used */
+static size_t parse(struct stats *stats, const uint8_t *buffer, size_t length)
+{
+    size_t used = 0;
+
+    while (length - used >= BLOCK_HEADER_SIZE) {
+        const uint8_t *block = buffer + used;
+
+        if (read_le32(block) != BLOCK_MAGIC) {
+            /* Lost framing: look for the next header */
+            stats->resyncs++;
+            used++;
+
+            while (length - used >= 4 && read_le32(buffer + used) != BLOCK_MAGIC)
+                used++;
+
+            continue;
+        }
+
+        uint32_t payload = read_le32(block + 8);
+
+        if (payload > MAX_BLOCK - BLOCK_HEADER_SIZE) {
+            stats->resyncs++;
+            used++;
+            continue;
+        }
+
+        if (length - used < BLOCK_HEADER_SIZE + payload)
+            break;
+
+        uint32_t sequence = read_le32(block + 4);
+
+        if (stats->blocks && sequence != stats->last_sequence + 1)
+            stats->gaps += sequence - stats->last_sequence - 1;
+
+        stats->last_sequence = sequence;
+        stats->last_flags = read_le32(block + 12);
+        stats->last_timestamp = (int64_t)((uint64_t)read_le32(block + 16) | ((uint64_t)read_le32(block + 20) << 32));
+        stats->blocks++;
+        stats->bytes += payload;
+        used += BLOCK_HEADER_SIZE + payload;
+    }
+
+    return used;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [--usb [PATH] [--interface N] [--endpoint EP] | --tcp HOST[:PORT] | --sim [--sim-rate B/s] [--sim-drop N]]\n"
+            "          [--seconds S]\n", name);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    struct backend backend = {.fd = -1};
+    struct stats stats = {0};
+    const char *usb_path = NULL;
+    const char *tcp_target = NULL;
+    unsigned interface = DEFAULT_INTERFACE;
+    unsigned endpoint = DEFAULT_ENDPOINT;
+    int mode = 'u';
+    double seconds = 10;
+    double sim_rate = 0;
+    uint32_t sim_drop = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--usb")) {
+            mode = 'u';
+            if (i + 1 < argc && argv[i + 1][0] == '/')
+                usb_path = argv[++i];
+        } else if (!strcmp(argv[i], "--tcp") && i + 1 < argc) {
+            mode = 't';
+            tcp_target = argv[++i];
+        } else if (!strcmp(argv[i], "--sim")) {
+            mode = 's';
+        } else if (!strcmp(argv[i], "--interface") && i + 1 < argc) {
+            interface = (unsigned)strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "--endpoint") && i + 1 < argc) {
+            endpoint = (unsigned)strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "--seconds") && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--sim-rate") && i + 1 < argc) {
+            sim_rate = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--sim-drop") && i + 1 < argc) {
+            sim_drop = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else {
+            usage(argv[0]);
+        }
+    }
+
+    if (mode == 'u' && open_usb(&backend, usb_path, interface, endpoint) < 0)
+        return 1;
+    if (mode == 't' && open_tcp(&backend, tcp_target) < 0)
+        return 1;
+    if (mode == 's')
+        open_sim(&backend, sim_rate, sim_drop);
+
+    static uint8_t buffer[MAX_BLOCK + TRANSFER_SIZE];
+    size_t filled = 0;
+    double start = now_seconds();
+    double next_report = start + 1;
+    uint64_t reported_bytes = 0;
+    int failed = 0;
+
+    while (now_seconds() - start < seconds) {
+        int result = backend.read(&backend, buffer + filled, TRANSFER_SIZE);
+
+        if (result < 0) {
+            perror(backend.name);
+            failed = 1;
+            break;
+        }
+
+        filled += (size_t)result;
+
+        size_t used = parse(&stats, buffer, filled);
+
+        memmove(buffer, buffer + used, filled - used);
+        filled -= used;
+
+        /* A buffer that fills without a complete block only holds garbage */
+        if (filled > MAX_BLOCK) {
+            stats.resyncs++;
+            filled = 0;
+        }
+
+        double now = now_seconds();
+
+        if (now >= next_report) {
+            printf("%6.1fs  %8.1f kB/s  blocks %llu  gaps %llu  last seq %u  %s time %lld us\n",
+                   now - start, (stats.bytes - reported_bytes) / (now - next_report + 1) / 1000,
+                   (unsigned long long)stats.blocks, (unsigned long long)stats.gaps, stats.last_sequence,
+                   stats.last_flags & FLAG_HOST_TIME ? "host" : "device", (long long)stats.last_timestamp);
+            reported_bytes = stats.bytes;
+            next_report += 1;
+        }
+    }
+
+    double elapsed = now_seconds() - start;
+
+    printf("%s: %llu payload bytes in %.1f s, %.1f kB/s, %llu blocks, %llu lost, %llu resyncs\n",
+           backend.name, (unsigned long long)stats.bytes, elapsed, stats.bytes / elapsed / 1000,
+           (unsigned long long)stats.blocks, (unsigned long long)stats.gaps, (unsigned long long)stats.resyncs);
+
+    if (backend.fd >= 0)
+        close(backend.fd);
+
+    return failed;
+}
@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+"""Measure WebSocketServer throughput with several browser-like clients.
+
+Each client does the RFC 6455 handshake and then reads frames as fast as it
+can, counting frames and payload bytes. Messages per second assume the
+application sends fixed-size messages (the example firmware sends one float
+per sample, i.e. 4 bytes). Use --slow to add a client that reads at a
+throttled rate; the others should keep their rate while it gets a decimated
+stream.
+
+    ws_bench.py [--host 192.168.7.6] [--port 8080] [--clients 4] [--seconds 10]
+"""
+
+import argparse
+import base64
+import hashlib
+import os
+import socket
+import struct
+import threading
+import time
+
+GUID = b"258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+
+class Client:
+    def __init__(self, host, port, delay):
+        self.host = host
+        self.port = port
+        self.delay = delay
+        self.frames = 0
+        self.payload = 0
+        self.error = None
+
+    def connect(self):
+        sock = socket.create_connection((self.host, self.port), timeout=5)
+        key = base64.b64encode(os.urandom(16))
+        request = (b"GET / HTTP/1.1\r\nHost: " + self.host.encode() + b"\r\nUpgrade: websocket\r\n"
+                   b"Connection: Upgrade\r\nSec-WebSocket-Key: " + key + b"\r\nSec-WebSocket-Version: 13\r\n\r\n")
+        sock.sendall(request)
+
+        response = b""
+
+        while b"\r\n\r\n" not in response:
+            chunk = sock.recv(1024)
+
+            if not chunk:
+                raise ConnectionError("closed during handshake")
+
+            response += chunk
+
+        header, rest = response.split(b"\r\n\r\n", 1)
+        expected = base64.b64encode(hashlib.sha1(key + GUID).digest())
+
+        if not header.startswith(b"HTTP/1.1 101") or expected not in header:
+            raise ConnectionError("handshake rejected: " + header.split(b"\r\n")[0].decode())
+
+        return sock, rest
+
+    def run(self, stop):
+        try:
+            sock, buffer = self.connect()
+            sock.settimeout(0.5)
+
+            while not stop.is_set():
+                # Parse every complete frame in the buffer
+                while len(buffer) >= 2:
+                    length = buffer[1] & 0x7F
+                    offset = 2
+
+                    if length == 126:
+                        if len(buffer) < 4:
+                            break
+                        length = struct.unpack(">H", buffer[2:4])[0]
+                        offset = 4
+                    elif length == 127:
+                        if len(buffer) < 10:
+                            break
+                        length = struct.unpack(">Q", buffer[2:10])[0]
+                        offset = 10
+
+                    if len(buffer) < offset + length:
+                        break
+
+                    if buffer[0] & 0x0F in (1, 2, 0):
+                        self.frames += 1
+                        self.payload += length
+
+                    buffer = buffer[offset + length:]
+
+                try:
+                    chunk = sock.recv(65536)
+                except socket.timeout:
+                    continue
+
+                if not chunk:
+                    raise ConnectionError("closed by device")
+
+                buffer += chunk
+
+                if self.delay:
+                    time.sleep(self.delay)
+
+            sock.close()
+        except OSError as error:
+            self.error = error
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default="192.168.7.6")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--clients", type=int, default=4)
+    parser.add_argument("--seconds", type=float, default=10.0)
+    parser.add_argument("--message-size", type=int, default=4, help="bytes per application message")
+    parser.add_argument("--slow", action="store_true", help="add one client that reads every 50 ms")
+    args = parser.parse_args()
+
+    clients = [Client(args.host, args.port, 0) for _ in range(args.clients)]
+
+    if args.slow:
+        clients.append(Client(args.host, args.port, 0.05))
+
+    stop = threading.Event()
+    threads = [threading.Thread(target=client.run, args=(stop,), daemon=True) for client in clients]
+
+    for thread in threads:
+        thread.start()
+
+    started = time.perf_counter()
+    time.sleep(args.seconds)
+    stop.set()
+
+    for thread in threads:
+        thread.join(timeout=2)
+
+    elapsed = time.perf_counter() - started
+    total = 0
+
+    for index, client in enumerate(clients):
+        label = "slow" if client.delay else "client"
+        messages = client.payload / args.message_size / elapsed
+        total += messages
+
+        if client.error:
+            print(f"{label} {index}: error: {client.error}")
+            continue
+
+        average = client.payload / client.frames if client.frames else 0
+        print(f"{label} {index}: {messages:10.0f} msg/s  {client.frames / elapsed:8.0f} frames/s  "
+              f"{average:6.0f} bytes/frame")
+
+    print(f"total:    {total:10.0f} msg/s")
+
+
+if __name__ == "__main__":
+    main()